@@ -2,7 +2,11 @@
 #define CATEGORY_MATCHER_H
 
 #include <osmium/osm/tag.hpp>
+#include <ankerl/unordered_dense.h>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -20,7 +24,7 @@ public:
     static std::unique_ptr<CategoryMatcher> from_yaml_file(const std::string& yaml_path);
     
     // Match OSM tags against categories, return category index if matched, or -1 if no match
-    // Categories are checked in order, first match wins
+    // Categories are checked in order, first match wins; one hash lookup per tag
     int match_category(const osmium::TagList& tags) const;
     
     // Get category by index
@@ -36,8 +40,30 @@ public:
     CategoryMatcher() = default;
     std::vector<Category> categories_;
     
-    // Check if a tag matches a rule
-    bool tag_matches_rule(const osmium::TagList& tags, const std::string& key, const std::string& value) const;
+    // Build the rule index from categories_; call again after changing them
+    void compile();
+
+private:
+    static constexpr int NO_CATEGORY = -1;
+    
+    // String hash usable with std::string_view lookups, so tag keys and values need no copies
+    struct StringHash {
+        using is_transparent = void;
+        using is_avalanching = void;
+        uint64_t operator()(std::string_view str) const noexcept {
+            return ankerl::unordered_dense::hash<std::string_view>{}(str);
+        }
+    };
+    template <typename T>
+    using StringMap = ankerl::unordered_dense::map<std::string, T, StringHash, std::equal_to<>>;
+    
+    // Rules of one tag key; categories are stored by index, where the lowest index wins
+    struct KeyRules {
+        int wildcard_category = NO_CATEGORY;  // First category with key=*
+        StringMap<int> value_categories;      // First category with key=value, per value
+    };
+    
+    StringMap<KeyRules> rules_by_key_;
 };
 
 } // namespace CategoryMatcher
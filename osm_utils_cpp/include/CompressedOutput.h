@@ -0,0 +1,104 @@
+#ifndef COMPRESSED_OUTPUT_H
+#define COMPRESSED_OUTPUT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace CompressedOutput {
+
+enum class Format {
+    Plain,
+    Gzip,  // Concatenated gzip members, one per block (like pigz)
+    Zstd,  // Concatenated zstd frames, one per block (needs a build with zstd)
+};
+
+// Format of an output path by its extension: .gz, .zst, anything else plain
+Format format_for_path(const std::string& path);
+
+// File extension of a format including the dot ("" for plain)
+const char* format_extension(Format format);
+
+// Parse "gzip", "zstd" or "none"; throws std::invalid_argument otherwise
+Format parse_format(const std::string& name);
+
+// Whether this build can write zstd
+bool zstd_available();
+
+// Stream buffer compressing fixed-size blocks on worker threads and writing them to the
+// file in order, so the output never exists uncompressed. Each block is an independent
+// gzip member or zstd frame; standard decompressors read the concatenation as one stream.
+class BlockCompressorBuf : public std::streambuf {
+public:
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    // threads <= 1 compresses on the writing thread
+    BlockCompressorBuf(const std::string& path, Format format, unsigned threads);
+    ~BlockCompressorBuf() override;
+
+    BlockCompressorBuf(const BlockCompressorBuf&) = delete;
+    BlockCompressorBuf& operator=(const BlockCompressorBuf&) = delete;
+
+    // Compress and write the remaining data and close the file; throws on any write or
+    // compression error, including ones from worker threads
+    void close();
+
+protected:
+    int_type overflow(int_type ch) override;
+
+private:
+    struct Block {
+        std::string input;
+        std::string output;
+        std::string error;
+        bool done = false;
+    };
+
+    void submit_block();
+    void write_completed(bool wait_all);
+    void worker_loop();
+    std::string compress(const std::string& input) const;
+
+    std::FILE* file_ = nullptr;
+    Format format_;
+    std::string buffer_;
+    bool closed_ = false;
+    std::string error_;  // First error of a write through the stream
+
+    // Blocks in output order, and the ones no worker has taken yet
+    std::deque<std::shared_ptr<Block>> in_flight_;
+    std::deque<std::shared_ptr<Block>> pending_;
+    size_t max_in_flight_;
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable block_done_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// std::ostream writing through a BlockCompressorBuf
+class CompressedWriter : public std::ostream {
+public:
+    CompressedWriter(const std::string& path, Format format, unsigned threads)
+        : std::ostream(nullptr), buf_(path, format, threads) {
+        rdbuf(&buf_);
+    }
+
+    // See BlockCompressorBuf::close()
+    void close() { buf_.close(); }
+
+private:
+    BlockCompressorBuf buf_;
+};
+
+} // namespace CompressedOutput
+
+#endif // COMPRESSED_OUTPUT_H
@@ -1,8 +1,11 @@
 #ifndef NUTS_REGION_LOOKUP_H
 #define NUTS_REGION_LOOKUP_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 #include <geos/geom/Geometry.h>
 #include <geos/geom/Point.h>
 #include <geos/geom/prep/PreparedGeometry.h>
@@ -12,33 +15,84 @@ namespace NUTSRegionLookup {
 
 class NUTSIndex {
 public:
+    // Region index returned when no region contains a point
+    static constexpr int NO_REGION = -1;
+
+    // Default resolution of the pre-classification grid: 2^11 x 2^11 cells (8 MB)
+    static constexpr unsigned DEFAULT_GRID_BITS = 11;
+
     // Create NUTSIndex from GeoJSON file
-    static std::unique_ptr<NUTSIndex> from_geojson_file(const std::string& geojson_path);
-    
+    // grid_bits sets the grid to 2^grid_bits cells per side (0 disables it)
+    static std::unique_ptr<NUTSIndex> from_geojson_file(const std::string& geojson_path,
+                                                        unsigned grid_bits = DEFAULT_GRID_BITS);
+
     // Find the NUTS region containing a WGS84 latitude/longitude point
     // Returns NUTS2 region code (4 characters like "NL31") or empty string if not found
+    // Lookups may run concurrently from several threads once the index is built
     std::string lookup_wgs84(double lat, double lon);
-    
+
     // Find the NUTS region containing a Web Mercator point
     // Returns NUTS2 region code (4 characters like "NL31") or empty string if not found
     std::string lookup_web_mercator(double x, double y);
-    
+
+    // Same as a region index (NO_REGION if not found), see region_code()
+    int lookup_index_wgs84(double lat, double lon);
+    int lookup_index_web_mercator(double x, double y);
+
+    // Region indices of count WGS84 points; points in grid cells inside one region are
+    // answered first, the rest then get exact tests
+    void lookup_index_wgs84_batch(const double* lats, const double* lons, size_t count, int* region_indices);
+
+    // NUTS code of a region index
+    const std::string& region_code(int index) const { return regions_[index].nuts_id; }
+
+    size_t region_count() const { return regions_.size(); }
+
+    // Share of grid cells that need an exact test (0 without a grid)
+    double grid_boundary_fraction() const;
+
     // Constructor (public for make_unique)
     NUTSIndex() = default;
-    
+
 private:
-    
+
     struct RegionData {
         std::string nuts_id;
         std::string name;
         std::unique_ptr<geos::geom::Geometry> geometry;
         std::unique_ptr<geos::geom::prep::PreparedGeometry> prepared_geom;
     };
-    
+
+    // Grid cell values besides region index + 1
+    static constexpr uint16_t CELL_OUTSIDE = 0;
+    static constexpr uint16_t CELL_BOUNDARY = 0xFFFF;
+
     std::vector<RegionData> regions_;
     std::unique_ptr<geos::index::strtree::STRtree> spatial_index_;
-    
+
+    // Uniform grid over the envelope of all regions (Web Mercator), row-major
+    std::vector<uint16_t> grid_cells_;
+    unsigned grid_size_ = 0;  // Cells per side
+    double grid_min_x_ = 0.0;
+    double grid_min_y_ = 0.0;
+    double grid_cell_width_ = 0.0;
+    double grid_cell_height_ = 0.0;
+
     void build_index();
+    void build_grid(unsigned grid_bits);
+
+    // Classify the size x size cells at (x0, y0) against the regions that may touch them:
+    // cells inside one region get its index, cells on a boundary are split until size 1
+    void classify_cells(unsigned x0, unsigned y0, unsigned size, const std::vector<size_t>& candidates,
+                        const geos::geom::GeometryFactory* factory);
+
+    void fill_cells(unsigned x0, unsigned y0, unsigned size, uint16_t value);
+
+    // Grid value of a point (CELL_BOUNDARY without a grid)
+    uint16_t grid_cell(double x, double y) const;
+
+    // STRtree query and exact tests
+    int exact_lookup(double x, double y);
 };
 
 } // namespace NUTSRegionLookup
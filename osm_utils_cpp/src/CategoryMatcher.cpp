@@ -2,8 +2,6 @@
 #include <yaml-cpp/yaml.h>
 #include <fstream>
 #include <stdexcept>
-#include <algorithm>
-#include <cstring>
 
 namespace CategoryMatcher {
 
@@ -54,37 +52,57 @@ std::unique_ptr<CategoryMatcher> CategoryMatcher::from_yaml_file(const std::stri
         matcher->categories_.push_back(std::move(cat));
     }
     
+    matcher->compile();
     return matcher;
 }
 
-bool CategoryMatcher::tag_matches_rule(const osmium::TagList& tags, const std::string& key, const std::string& value) const {
-    const char* tag_value = tags.get_value_by_key(key.c_str());
-    if (!tag_value) {
-        return false;
-    }
+void CategoryMatcher::compile() {
+    rules_by_key_.clear();
     
-    // Wildcard match
-    if (value == "*") {
-        return true;
+    // Rules are visited in category order, so the first category of each rule is the one kept
+    for (size_t i = 0; i < categories_.size(); ++i) {
+        const int category = static_cast<int>(i);
+        for (const auto& rule : categories_[i].tag_rules) {
+            KeyRules& key_rules = rules_by_key_[rule.first];
+            if (rule.second == "*") {
+                if (key_rules.wildcard_category == NO_CATEGORY) {
+                    key_rules.wildcard_category = category;
+                }
+            } else {
+                key_rules.value_categories.try_emplace(rule.second, category);
+            }
+        }
     }
-    
-    // Exact match
-    return std::strcmp(tag_value, value.c_str()) == 0;
 }
 
 int CategoryMatcher::match_category(const osmium::TagList& tags) const {
-    for (size_t i = 0; i < categories_.size(); ++i) {
-        const auto& cat = categories_[i];
-        
-        // Check if any tag rule matches
-        for (const auto& rule : cat.tag_rules) {
-            if (tag_matches_rule(tags, rule.first, rule.second)) {
-                return static_cast<int>(i);
+    // Lowest category index matched by any tag
+    int best = NO_CATEGORY;
+    auto improve = [&best](int category) {
+        if (category != NO_CATEGORY && (best == NO_CATEGORY || category < best)) {
+            best = category;
+        }
+    };
+    
+    for (const auto& tag : tags) {
+        auto key_it = rules_by_key_.find(std::string_view(tag.key()));
+        if (key_it == rules_by_key_.end()) {
+            continue;
+        }
+        const KeyRules& key_rules = key_it->second;
+        improve(key_rules.wildcard_category);
+        if (!key_rules.value_categories.empty()) {
+            auto value_it = key_rules.value_categories.find(std::string_view(tag.value()));
+            if (value_it != key_rules.value_categories.end()) {
+                improve(value_it->second);
             }
         }
+        if (best == 0) {
+            break;  // Nothing can beat the first category
+        }
     }
     
-    return -1;  // No match
+    return best;
 }
 
 std::vector<std::string> CategoryMatcher::get_category_names() const {
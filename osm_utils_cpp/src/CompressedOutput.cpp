@@ -0,0 +1,277 @@
+#include "CompressedOutput.h"
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <algorithm>
+#include <stdexcept>
+
+namespace CompressedOutput {
+
+namespace {
+    constexpr int GZIP_LEVEL = 6;
+    constexpr int ZSTD_LEVEL = 3;
+
+    // Blocks queued or being compressed per worker thread
+    constexpr size_t BLOCKS_IN_FLIGHT_PER_THREAD = 2;
+
+    bool ends_with(const std::string& str, const std::string& suffix) {
+        return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::string gzip_member(const std::string& input) {
+        z_stream stream{};
+        // windowBits 15 + 16 writes a gzip header and trailer
+        if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to initialize gzip compression");
+        }
+        std::string output(deflateBound(&stream, input.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+        stream.avail_out = static_cast<uInt>(output.size());
+        int result = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        if (result != Z_STREAM_END) {
+            throw std::runtime_error("Failed to compress data");
+        }
+        return output;
+    }
+
+#ifdef HAVE_ZSTD
+    std::string zstd_frame(const std::string& input) {
+        std::string output(ZSTD_compressBound(input.size()), '\0');
+        size_t size = ZSTD_compress(&output[0], output.size(), input.data(), input.size(), ZSTD_LEVEL);
+        if (ZSTD_isError(size)) {
+            throw std::runtime_error(std::string("Failed to compress data: ") + ZSTD_getErrorName(size));
+        }
+        output.resize(size);
+        return output;
+    }
+#endif
+}
+
+Format format_for_path(const std::string& path) {
+    if (ends_with(path, ".gz")) {
+        return Format::Gzip;
+    }
+    if (ends_with(path, ".zst")) {
+        return Format::Zstd;
+    }
+    return Format::Plain;
+}
+
+const char* format_extension(Format format) {
+    switch (format) {
+        case Format::Gzip: return ".gz";
+        case Format::Zstd: return ".zst";
+        case Format::Plain: break;
+    }
+    return "";
+}
+
+Format parse_format(const std::string& name) {
+    if (name == "gzip") {
+        return Format::Gzip;
+    }
+    if (name == "zstd") {
+        return Format::Zstd;
+    }
+    if (name == "none") {
+        return Format::Plain;
+    }
+    throw std::invalid_argument("Unknown compression: " + name + " (expected gzip, zstd or none)");
+}
+
+bool zstd_available() {
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+BlockCompressorBuf::BlockCompressorBuf(const std::string& path, Format format, unsigned threads)
+    : format_(format)
+    , buffer_(BLOCK_SIZE, '\0')
+    , max_in_flight_(std::max(1u, threads) * BLOCKS_IN_FLIGHT_PER_THREAD) {
+    if (format_ == Format::Zstd && !zstd_available()) {
+        throw std::runtime_error("zstd output requested but this build has no zstd support: " + path);
+    }
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+
+    // Plain output is only copied, workers would not help
+    if (threads > 1 && format_ != Format::Plain) {
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back(&BlockCompressorBuf::worker_loop, this);
+        }
+    }
+}
+
+BlockCompressorBuf::~BlockCompressorBuf() {
+    try {
+        close();
+    } catch (...) {
+        // Errors are reported by an explicit close()
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+void BlockCompressorBuf::close() {
+    if (!error_.empty()) {
+        std::string error;
+        error.swap(error_);
+        throw std::runtime_error(error);
+    }
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    submit_block();
+    write_completed(true);
+    std::FILE* file = file_;
+    file_ = nullptr;
+    if (std::fclose(file) != 0) {
+        throw std::runtime_error("Failed to write output file");
+    }
+}
+
+BlockCompressorBuf::int_type BlockCompressorBuf::overflow(int_type ch) {
+    if (closed_) {
+        return traits_type::eof();
+    }
+    try {
+        submit_block();
+    } catch (const std::exception& e) {
+        // The stream only sees a failed write; close() reports why
+        error_ = e.what();
+        closed_ = true;
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+void BlockCompressorBuf::submit_block() {
+    size_t size = static_cast<size_t>(pptr() - pbase());
+    if (size == 0) {
+        return;
+    }
+    auto block = std::make_shared<Block>();
+    block->input = std::move(buffer_);
+    block->input.resize(size);
+    buffer_.assign(BLOCK_SIZE, '\0');
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+
+    if (workers_.empty()) {
+        block->output = compress(block->input);
+        block->done = true;
+        in_flight_.push_back(std::move(block));
+        write_completed(true);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_.push_back(block);
+        pending_.push_back(std::move(block));
+    }
+    work_available_.notify_one();
+    write_completed(false);
+}
+
+void BlockCompressorBuf::write_completed(bool wait_all) {
+    while (true) {
+        std::shared_ptr<Block> block;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (in_flight_.empty()) {
+                return;
+            }
+            // Keep at most max_in_flight_ blocks (and their memory) queued
+            if (wait_all || in_flight_.size() > max_in_flight_) {
+                block_done_.wait(lock, [this]() { return in_flight_.front()->done; });
+            } else if (!in_flight_.front()->done) {
+                return;
+            }
+            block = std::move(in_flight_.front());
+            in_flight_.pop_front();
+        }
+        if (!block->error.empty()) {
+            throw std::runtime_error(block->error);
+        }
+        if (std::fwrite(block->output.data(), 1, block->output.size(), file_) != block->output.size()) {
+            throw std::runtime_error("Failed to write output file");
+        }
+    }
+}
+
+void BlockCompressorBuf::worker_loop() {
+    while (true) {
+        std::shared_ptr<Block> block;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;
+            }
+            block = std::move(pending_.front());
+            pending_.pop_front();
+        }
+
+        std::string output;
+        std::string error;
+        try {
+            output = compress(block->input);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            block->output = std::move(output);
+            block->error = std::move(error);
+            std::string().swap(block->input);
+            block->done = true;
+        }
+        block_done_.notify_all();
+    }
+}
+
+std::string BlockCompressorBuf::compress(const std::string& input) const {
+    switch (format_) {
+        case Format::Gzip:
+            return gzip_member(input);
+        case Format::Zstd:
+#ifdef HAVE_ZSTD
+            return zstd_frame(input);
+#else
+            break;
+#endif
+        case Format::Plain:
+            return input;
+    }
+    throw std::runtime_error("zstd support not built");
+}
+
+} // namespace CompressedOutput
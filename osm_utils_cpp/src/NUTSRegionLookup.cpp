@@ -12,6 +12,7 @@
 #include <geos/geom/prep/PreparedGeometryFactory.h>
 #include <geos/index/strtree/STRtree.h>
 #include <geos/geom/Envelope.h>
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <sstream>
@@ -114,7 +115,7 @@ namespace {
     }
 }
 
-std::unique_ptr<NUTSIndex> NUTSIndex::from_geojson_file(const std::string& geojson_path) {
+std::unique_ptr<NUTSIndex> NUTSIndex::from_geojson_file(const std::string& geojson_path, unsigned grid_bits) {
     std::ifstream file(geojson_path);
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open GeoJSON file: " + geojson_path);
@@ -172,6 +173,7 @@ std::unique_ptr<NUTSIndex> NUTSIndex::from_geojson_file(const std::string& geojs
     }
     
     index->build_index();
+    index->build_grid(grid_bits);
     return index;
 }
 
@@ -186,29 +188,147 @@ void NUTSIndex::build_index() {
         regions_[i].prepared_geom = geos::geom::prep::PreparedGeometryFactory::prepare(
             regions_[i].geometry.get()
         );
+        
+        // GEOS builds the point locator of a prepared geometry on its first contains() check;
+        // trigger that here so that concurrent lookups only ever read it
+        std::unique_ptr<geos::geom::Point> interior(regions_[i].geometry->getInteriorPoint());
+        if (interior && !interior->isEmpty()) {
+            regions_[i].prepared_geom->contains(interior.get());
+        }
     }
+    
+    // Same for the tree, which is built on its first query
+    geos::geom::Envelope env(0.0, 0.0, 0.0, 0.0);
+    std::vector<void*> candidates;
+    spatial_index_->query(&env, candidates);
 }
 
-std::string NUTSIndex::lookup_web_mercator(double x, double y) {
+void NUTSIndex::build_grid(unsigned grid_bits) {
+    grid_cells_.clear();
+    grid_size_ = 0;
+    // Cell values hold region index + 1 next to the two markers
+    if (grid_bits == 0 || regions_.empty() || regions_.size() >= CELL_BOUNDARY - 1) {
+        return;
+    }
+    
+    geos::geom::Envelope bounds;
+    for (const auto& region : regions_) {
+        bounds.expandToInclude(region.geometry->getEnvelopeInternal());
+    }
+    if (bounds.getWidth() <= 0.0 || bounds.getHeight() <= 0.0) {
+        return;
+    }
+    
+    grid_size_ = 1u << grid_bits;
+    grid_min_x_ = bounds.getMinX();
+    grid_min_y_ = bounds.getMinY();
+    grid_cell_width_ = bounds.getWidth() / grid_size_;
+    grid_cell_height_ = bounds.getHeight() / grid_size_;
+    grid_cells_.assign(static_cast<size_t>(grid_size_) * grid_size_, CELL_OUTSIDE);
+    
+    std::vector<size_t> all_regions(regions_.size());
+    for (size_t i = 0; i < regions_.size(); ++i) {
+        all_regions[i] = i;
+    }
+    geos::geom::GeometryFactory::Ptr factory = geos::geom::GeometryFactory::create();
+    classify_cells(0, 0, grid_size_, all_regions, factory.get());
+}
+
+void NUTSIndex::classify_cells(unsigned x0, unsigned y0, unsigned size, const std::vector<size_t>& candidates,
+                               const geos::geom::GeometryFactory* factory) {
+    geos::geom::Envelope env(grid_min_x_ + x0 * grid_cell_width_, grid_min_x_ + (x0 + size) * grid_cell_width_,
+                             grid_min_y_ + y0 * grid_cell_height_, grid_min_y_ + (y0 + size) * grid_cell_height_);
+    
+    std::vector<size_t> touching;
+    for (size_t idx : candidates) {
+        if (regions_[idx].geometry->getEnvelopeInternal()->intersects(&env)) {
+            touching.push_back(idx);
+        }
+    }
+    if (touching.empty()) {
+        return;  // Cells stay CELL_OUTSIDE
+    }
+    
+    std::unique_ptr<geos::geom::Geometry> cell(factory->toGeometry(&env));
+    for (size_t idx : touching) {
+        if (regions_[idx].prepared_geom->contains(cell.get())) {
+            fill_cells(x0, y0, size, static_cast<uint16_t>(idx + 1));
+            return;
+        }
+    }
+    
+    std::vector<size_t> intersecting;
+    for (size_t idx : touching) {
+        if (regions_[idx].prepared_geom->intersects(cell.get())) {
+            intersecting.push_back(idx);
+        }
+    }
+    if (intersecting.empty()) {
+        return;
+    }
+    if (size == 1) {
+        grid_cells_[static_cast<size_t>(y0) * grid_size_ + x0] = CELL_BOUNDARY;
+        return;
+    }
+    
+    unsigned half = size / 2;
+    classify_cells(x0, y0, half, intersecting, factory);
+    classify_cells(x0 + half, y0, half, intersecting, factory);
+    classify_cells(x0, y0 + half, half, intersecting, factory);
+    classify_cells(x0 + half, y0 + half, half, intersecting, factory);
+}
+
+void NUTSIndex::fill_cells(unsigned x0, unsigned y0, unsigned size, uint16_t value) {
+    for (unsigned y = y0; y < y0 + size; ++y) {
+        std::fill_n(grid_cells_.begin() + static_cast<size_t>(y) * grid_size_ + x0, size, value);
+    }
+}
+
+double NUTSIndex::grid_boundary_fraction() const {
+    if (grid_cells_.empty()) {
+        return 0.0;
+    }
+    size_t boundary = std::count(grid_cells_.begin(), grid_cells_.end(), CELL_BOUNDARY);
+    return static_cast<double>(boundary) / grid_cells_.size();
+}
+
+uint16_t NUTSIndex::grid_cell(double x, double y) const {
+    if (grid_cells_.empty()) {
+        return CELL_BOUNDARY;
+    }
+    double cx = (x - grid_min_x_) / grid_cell_width_;
+    double cy = (y - grid_min_y_) / grid_cell_height_;
+    // Outside the envelope of all regions (NaN fails these too)
+    if (!(cx >= 0.0 && cy >= 0.0 && cx <= grid_size_ && cy <= grid_size_)) {
+        return CELL_OUTSIDE;
+    }
+    // The far edges belong to the last cells
+    unsigned col = std::min(static_cast<unsigned>(cx), grid_size_ - 1);
+    unsigned row = std::min(static_cast<unsigned>(cy), grid_size_ - 1);
+    return grid_cells_[static_cast<size_t>(row) * grid_size_ + col];
+}
+
+int NUTSIndex::exact_lookup(double x, double y) {
     if (!spatial_index_) {
-        return "";
+        return NO_REGION;
     }
     
     // Create envelope directly from coordinates
     geos::geom::Envelope env(x, x, y, y);
     
-    std::vector<void*> candidates;
+    thread_local std::vector<void*> candidates;
+    candidates.clear();
     spatial_index_->query(&env, candidates);
     
     if (candidates.empty()) {
-        return "";
+        return NO_REGION;
     }
     
-    // Use default factory instance (thread-safe singleton) to avoid creating new factories
-    static const geos::geom::GeometryFactory* factory = geos::geom::GeometryFactory::getDefaultInstance();
+    // One factory per thread: geometries update a reference count on their factory, which
+    // must not be shared between threads
+    thread_local geos::geom::GeometryFactory::Ptr factory = geos::geom::GeometryFactory::create();
     
     // Create Point for contains() check
-    // getDefaultInstance() returns raw pointer, so we need to manage cleanup manually
     std::unique_ptr<geos::geom::Point> point(factory->createPoint(geos::geom::Coordinate(x, y)));
     
     // Perform contains() checks
@@ -216,15 +336,58 @@ std::string NUTSIndex::lookup_web_mercator(double x, double y) {
         size_t idx = reinterpret_cast<size_t>(candidate);
         if (idx < regions_.size()) {
             if (regions_[idx].prepared_geom->contains(point.get())) {
-                // Point will be destroyed when unique_ptr goes out of scope
-                return regions_[idx].nuts_id;
+                return static_cast<int>(idx);
             }
         }
     }
     
-    // Point is automatically destroyed here via unique_ptr destructor
+    return NO_REGION;
+}
+
+int NUTSIndex::lookup_index_web_mercator(double x, double y) {
+    uint16_t cell = grid_cell(x, y);
+    if (cell == CELL_OUTSIDE) {
+        return NO_REGION;
+    }
+    if (cell != CELL_BOUNDARY) {
+        return cell - 1;
+    }
+    return exact_lookup(x, y);
+}
+
+int NUTSIndex::lookup_index_wgs84(double lat, double lon) {
+    auto coords = PlaceExtraction::wgs84_to_web_mercator(lat, lon);
+    return lookup_index_web_mercator(coords.first, coords.second);
+}
+
+void NUTSIndex::lookup_index_wgs84_batch(const double* lats, const double* lons, size_t count, int* region_indices) {
+    // Grid pass first, so the exact tests of boundary points run back to back
+    thread_local std::vector<std::pair<double, double>> pending;  // Mercator coordinates
+    thread_local std::vector<size_t> pending_indices;
+    pending.clear();
+    pending_indices.clear();
     
-    return "";
+    for (size_t i = 0; i < count; ++i) {
+        auto coords = PlaceExtraction::wgs84_to_web_mercator(lats[i], lons[i]);
+        uint16_t cell = grid_cell(coords.first, coords.second);
+        if (cell == CELL_OUTSIDE) {
+            region_indices[i] = NO_REGION;
+        } else if (cell != CELL_BOUNDARY) {
+            region_indices[i] = cell - 1;
+        } else {
+            pending.push_back(coords);
+            pending_indices.push_back(i);
+        }
+    }
+    
+    for (size_t j = 0; j < pending.size(); ++j) {
+        region_indices[pending_indices[j]] = exact_lookup(pending[j].first, pending[j].second);
+    }
+}
+
+std::string NUTSIndex::lookup_web_mercator(double x, double y) {
+    int index = lookup_index_web_mercator(x, y);
+    return index == NO_REGION ? std::string() : regions_[index].nuts_id;
 }
 
 std::string NUTSIndex::lookup_wgs84(double lat, double lon) {
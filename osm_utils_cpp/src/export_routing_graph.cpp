@@ -0,0 +1,159 @@
+// Builds the routing server's graph offline and writes it as a graph snapshot the server
+// memory-maps at startup. The graph comes from the server's own profile and loader
+// (routing_server/src/RoutingProfile.cpp), so the export and a server-side rebuild agree.
+#include "ArcCostKernels.h"
+#include "GraphSnapshot.h"
+#include "RoutingProfile.h"
+
+#include <routingkit/contraction_hierarchy.h>
+#include <routingkit/inverse_vector.h>
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Same path the server derives from its OSM file when GRAPH_SNAPSHOT_FILE is not set
+std::string get_default_snapshot_name(const std::string& input_file) {
+    fs::path snapshot_path(input_file);
+    snapshot_path.replace_extension(".graph_snapshot.bin");
+    return snapshot_path.string();
+}
+
+// Travel time weights as the server computes them for its travel time CH
+std::vector<unsigned> compute_travel_times(const RoutingKit::OSMRoutingGraph& graph,
+                                           const std::vector<unsigned>& way_speed) {
+    using RoutingServer::ArcCostKernels;
+    std::vector<uint16_t> arc_speed(graph.arc_count());
+    for (size_t arc = 0; arc < arc_speed.size(); ++arc) {
+        arc_speed[arc] = static_cast<uint16_t>(std::min(way_speed[graph.way[arc]], ArcCostKernels::NO_SPEED_CAP));
+    }
+    std::vector<unsigned> travel_time(graph.arc_count());
+    ArcCostKernels::computeWeights(graph.geo_distance.data(), arc_speed.data(), arc_speed.size(),
+                                   ArcCostKernels::NO_SPEED_CAP, ArcCostKernels::MAX_ARC_TIME_MS,
+                                   travel_time.data());
+    return travel_time;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--output <snapshot_file>] [--ch all|geo|none] [--geo-order]\n";
+        return 1;
+    }
+
+    std::string input_file = argv[1];
+    std::string output_file;
+    std::string ch_mode = "all";
+    bool geo_order = false;
+
+    // Parse command line arguments
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--output" || arg == "-o") {
+            if (i + 1 < argc) {
+                output_file = argv[++i];
+            } else {
+                std::cerr << "Error: --output requires a filename\n";
+                return 1;
+            }
+        } else if (arg == "--ch" && i + 1 < argc) {
+            ch_mode = argv[++i];
+            if (ch_mode != "all" && ch_mode != "geo" && ch_mode != "none") {
+                std::cerr << "Error: --ch must be all, geo or none\n";
+                return 1;
+            }
+        } else if (arg == "--geo-order") {
+            geo_order = true;
+        }
+    }
+
+    if (geo_order && ch_mode != "all") {
+        std::cerr << "Error: --geo-order only applies with --ch all\n";
+        return 1;
+    }
+    if (output_file.empty()) {
+        output_file = get_default_snapshot_name(input_file);
+    }
+
+    // The server compares this against its OSM file, if it has one, to detect stale snapshots
+    auto source = RoutingServer::SnapshotSource::fromFile(input_file);
+    if (!source.has_value()) {
+        std::cerr << "Error: Input file not found: " << input_file << "\n";
+        return 1;
+    }
+
+    std::cout << "Exporting routing graph from: " << input_file << "\n";
+    std::cout << "Output snapshot: " << output_file << "\n";
+    std::cout << "Input file size: " << std::fixed << std::setprecision(1)
+              << (source->file_size / (1024.0 * 1024.0)) << " MB\n";
+
+    auto start_time = std::chrono::steady_clock::now();
+    try {
+        auto log_message = [](const std::string& msg) { std::cout << msg << "\n"; };
+        RoutingServer::ProfileGraph loaded = RoutingServer::loadProfileGraphFromPbf(input_file, log_message);
+        const RoutingKit::OSMRoutingGraph& graph = loaded.graph;
+        std::vector<unsigned> tail = RoutingKit::invert_inverse_vector(graph.first_out);
+        std::cout << "Graph loaded in " << seconds_since(start_time) << " s\n";
+
+        std::unique_ptr<RoutingKit::ContractionHierarchy> ch_geo;
+        std::unique_ptr<RoutingKit::ContractionHierarchy> ch_time;
+        if (ch_mode != "none") {
+            auto ch_start = std::chrono::steady_clock::now();
+            ch_geo = std::make_unique<RoutingKit::ContractionHierarchy>(
+                RoutingKit::ContractionHierarchy::build(graph.node_count(), tail, graph.head, graph.geo_distance));
+            std::cout << "Geo distance CH built in " << seconds_since(ch_start) << " s\n";
+        }
+        if (ch_mode == "all") {
+            // --geo-order mirrors the server's CH_TIME_BUILD_MODE=geo_order
+            auto ch_start = std::chrono::steady_clock::now();
+            std::vector<unsigned> travel_time = compute_travel_times(graph, loaded.way_speed);
+            ch_time = std::make_unique<RoutingKit::ContractionHierarchy>(
+                geo_order ? RoutingKit::ContractionHierarchy::build_given_rank(ch_geo->rank, tail, graph.head, travel_time)
+                          : RoutingKit::ContractionHierarchy::build(graph.node_count(), tail, graph.head, travel_time));
+            std::cout << "Travel time CH built in " << seconds_since(ch_start) << " s\n";
+        }
+
+        fs::path output_path(output_file);
+        if (output_path.has_parent_path()) {
+            fs::create_directories(output_path.parent_path());
+        }
+        RoutingServer::GraphSnapshot::Writer writer(output_file, *source);
+        writer.addVector(RoutingServer::SnapshotSection::FirstOut, graph.first_out);
+        writer.addVector(RoutingServer::SnapshotSection::Head, graph.head);
+        writer.addVector(RoutingServer::SnapshotSection::GeoDistance, graph.geo_distance);
+        writer.addVector(RoutingServer::SnapshotSection::Way, graph.way);
+        writer.addVector(RoutingServer::SnapshotSection::Latitude, graph.latitude);
+        writer.addVector(RoutingServer::SnapshotSection::Longitude, graph.longitude);
+        writer.addVector(RoutingServer::SnapshotSection::WaySpeed, loaded.way_speed);
+        writer.addVector(RoutingServer::SnapshotSection::Tail, tail);
+        if (ch_geo) {
+            writer.addContractionHierarchy(RoutingServer::SnapshotSection::GeoContractionHierarchy, *ch_geo);
+        }
+        if (ch_time) {
+            writer.addContractionHierarchy(RoutingServer::SnapshotSection::TimeContractionHierarchy, *ch_time);
+        }
+        writer.finish();
+
+        std::cout << "Wrote " << graph.node_count() << " nodes and " << graph.arc_count() << " arcs"
+                  << (ch_time ? " with both CHs" : ch_geo ? " with the geo distance CH" : " without CHs")
+                  << " in " << seconds_since(start_time) << " s\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "CategoryMatcher.h"
+#include "CompressedOutput.h"
 #include "NUTSRegionLookup.h"
 #include "PlaceExtraction.h"
 #include <osmium/handler.hpp>
@@ -20,14 +21,20 @@
 #include <string>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <numeric>
 #include <random>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
-#include <zlib.h>
+#include <cstdint>
 #include <cstring>
 #include <algorithm>
-#include <ctime>
 #include <cmath>
 #include <memory>
 #include <unistd.h>
@@ -109,20 +116,14 @@ struct RelationData {
 };
 
 // Data structure for priority queue
+// The region is the index of the queue in region_codes_, the tags live in a tag slot of the
+// reservoirs, so entries stay small and cheap to move while the heap is reordered
 struct PlaceQueueData {
     osmium::object_id_type id;
-    std::string tags_json;
-    std::string region_code;  // Store region code to avoid memory-backed maps
-    
-    bool operator==(const PlaceQueueData& other) const {
-        return id == other.id && tags_json == other.tags_json;
-    }
+    uint32_t tags_slot;
     
     bool operator<(const PlaceQueueData& other) const {
-        if (id != other.id) {
-            return id < other.id;
-        }
-        return tags_json < other.tags_json;
+        return id < other.id;
     }
 };
 
@@ -168,194 +169,251 @@ struct MemoryStats {
     }
 };
 
-// Single-pass handler
-class SinglePassHandler : public osmium::handler::Handler {
-private:
-    CategoryMatcher::CategoryMatcher* category_matcher_;
-    NUTSRegionLookup::NUTSIndex* nuts_index_;
-    
-    // Disk-backed indices (POD data only)
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, NodeData> node_index_;
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, WayData> way_index_;
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, RelationData> relation_index_;
-    
-    // Reservoir sampling: 2D queue structure [category_idx][region_idx]
-    using QueueType = std::priority_queue<std::pair<double, PlaceQueueData>, 
+using NodeIndex = osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, NodeData>;
+using WayIndex = osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, WayData>;
+using RelationIndex = osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, RelationData>;
+
+// Reservoir sampling: 2D queue structure [category_idx][region_idx] per object type.
+// Every object has a fixed random key and each queue keeps the max_per_region largest keys,
+// so reservoirs filled by different threads merge into exactly the sample one reservoir
+// would have kept.
+class PlaceReservoirs {
+public:
+    using QueueType = std::priority_queue<std::pair<double, PlaceQueueData>,
                                          std::vector<std::pair<double, PlaceQueueData>>,
                                          std::greater<std::pair<double, PlaceQueueData>>>;
-    std::vector<std::vector<QueueType>> node_queues_;
-    std::vector<std::vector<QueueType>> way_queues_;
-    std::vector<std::vector<QueueType>> relation_queues_;
-    
-    // Mappings
-    std::vector<std::string> category_names_;
-    std::vector<std::string> region_codes_;
-    ankerl::unordered_dense::map<std::string, size_t> region_code_to_index_;
-    
-    // Random number generator
-    std::mt19937 rng_;
-    std::uniform_real_distribution<double> dist_;
-    
-    // Statistics
-    uint64_t processed_nodes_ = 0;
-    uint64_t processed_ways_ = 0;
-    uint64_t processed_relations_ = 0;
-    uint64_t matched_nodes_ = 0;
-    uint64_t matched_ways_ = 0;
-    uint64_t matched_relations_ = 0;
-    
-    // Progress tracking
-    uint64_t file_size_ = 0;
-    std::chrono::steady_clock::time_point start_time_;
-    std::chrono::steady_clock::time_point last_progress_time_;
-    
+    using QueueGrid = std::vector<std::vector<QueueType>>;
+
+    explicit PlaceReservoirs(size_t num_categories)
+        : node_queues_(num_categories)
+        , way_queues_(num_categories)
+        , relation_queues_(num_categories) {}
+
+    // Returned by admit() when the queue keeps its current items
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    QueueGrid& node_queues() { return node_queues_; }
+    QueueGrid& way_queues() { return way_queues_; }
+    QueueGrid& relation_queues() { return relation_queues_; }
+    const std::vector<std::string>& region_codes() const { return region_codes_; }
+
+    // Serialized tags of a queue entry
+    std::string& tags(uint32_t slot) { return tag_slots_[slot]; }
+    const std::string& tags(uint32_t slot) const { return tag_slots_[slot]; }
+
     // Get or create region index
     size_t get_or_create_region_index(const std::string& region_code) {
         auto it = region_code_to_index_.find(region_code);
         if (it != region_code_to_index_.end()) {
             return it->second;
         }
-        
+
         size_t idx = region_codes_.size();
         region_codes_.push_back(region_code);
         region_code_to_index_[region_code] = idx;
-        
+
         // Expand queues for new region
-        for (auto& cat_queues : node_queues_) {
-            cat_queues.resize(idx + 1);
-        }
-        for (auto& cat_queues : way_queues_) {
-            cat_queues.resize(idx + 1);
-        }
-        for (auto& cat_queues : relation_queues_) {
-            cat_queues.resize(idx + 1);
+        for (QueueGrid* grid : {&node_queues_, &way_queues_, &relation_queues_}) {
+            for (auto& cat_queues : *grid) {
+                cat_queues.resize(idx + 1);
+            }
         }
-        
+
         return idx;
     }
-    
-    // Apply reservoir sampling
-    void apply_reservoir_sampling(QueueType& queue, const PlaceQueueData& data, int max_per_region) {
-        double random = dist_(rng_);
-        
+
+    // Region indices ordered by region code, so the output order does not depend on which
+    // region a thread happened to see first
+    std::vector<size_t> regions_by_code() const {
+        std::vector<size_t> order(region_codes_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return region_codes_[a] < region_codes_[b];
+        });
+        return order;
+    }
+
+    // Apply reservoir sampling to the key alone: returns the tag slot the admitted item must
+    // fill, or NO_SLOT. Callers serialize tags only after admission, and an evicted item hands
+    // its slot (and the slot's string buffer) to the item replacing it.
+    uint32_t admit(QueueType& queue, double key, osmium::object_id_type id, int max_per_region) {
         if (queue.size() < static_cast<size_t>(max_per_region)) {
-            queue.push({random, data});
-        } else if (random > queue.top().first) {
+            uint32_t slot = static_cast<uint32_t>(tag_slots_.size());
+            tag_slots_.emplace_back();
+            queue.push({key, PlaceQueueData{id, slot}});
+            return slot;
+        }
+        if (!queue.empty() && key > queue.top().first) {
+            uint32_t slot = queue.top().second.tags_slot;
             queue.pop();
-            queue.push({random, data});
+            queue.push({key, PlaceQueueData{id, slot}});
+            return slot;
         }
+        return NO_SLOT;
     }
-    
-    void update_progress() {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_progress_time_);
-        
-        // Only log every 5 seconds
-        if (elapsed.count() < 5000) {
-            return;
+
+    // Move all items of other into these reservoirs (other is left empty)
+    void merge(PlaceReservoirs& other, const CategoryMatcher::CategoryMatcher& category_matcher) {
+        merge_grid(node_queues_, other.node_queues_, other, category_matcher);
+        merge_grid(way_queues_, other.way_queues_, other, category_matcher);
+        merge_grid(relation_queues_, other.relation_queues_, other, category_matcher);
+        std::vector<std::string>().swap(other.tag_slots_);
+    }
+
+private:
+    void merge_grid(QueueGrid& target, QueueGrid& source, PlaceReservoirs& other,
+                    const CategoryMatcher::CategoryMatcher& category_matcher) {
+        for (size_t cat_idx = 0; cat_idx < source.size(); ++cat_idx) {
+            int max_per_region = category_matcher.get_category(cat_idx).max_per_region;
+            for (size_t reg_idx = 0; reg_idx < source[cat_idx].size(); ++reg_idx) {
+                auto& queue = source[cat_idx][reg_idx];
+                if (queue.empty()) {
+                    continue;
+                }
+                size_t target_idx = get_or_create_region_index(other.region_codes_[reg_idx]);
+                while (!queue.empty()) {
+                    auto item = queue.top();
+                    queue.pop();
+                    uint32_t slot = admit(target[cat_idx][target_idx], item.first, item.second.id, max_per_region);
+                    if (slot != NO_SLOT) {
+                        tag_slots_[slot] = std::move(other.tag_slots_[item.second.tags_slot]);
+                    }
+                }
+            }
         }
-        
-        last_progress_time_ = now;
-        
-        auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time_);
-        int64_t elapsed_sec = total_elapsed.count();
-        
-        int64_t hours_spent = elapsed_sec / 3600;
-        int64_t minutes_spent = (elapsed_sec % 3600) / 60;
-        int64_t seconds_spent = elapsed_sec % 60;
-        
-        std::ostringstream time_oss;
-        if (hours_spent > 0) {
-            time_oss << hours_spent << "h" << minutes_spent << "m" << seconds_spent << "s";
-        } else if (minutes_spent > 0) {
-            time_oss << minutes_spent << "m" << seconds_spent << "s";
-        } else {
-            time_oss << seconds_spent << "s";
+    }
+
+    QueueGrid node_queues_;
+    QueueGrid way_queues_;
+    QueueGrid relation_queues_;
+
+    // Tags of all queue entries, indexed by PlaceQueueData::tags_slot; slots are only ever
+    // reused, never freed, so the pool is bounded by the total reservoir capacity
+    std::vector<std::string> tag_slots_;
+
+    // Mappings
+    std::vector<std::string> region_codes_;
+    ankerl::unordered_dense::map<std::string, size_t> region_code_to_index_;
+};
+
+// Disk index entries and counts produced from one input buffer
+struct BufferResult {
+    std::vector<std::pair<osmium::unsigned_object_id_type, NodeData>> nodes;
+    std::vector<std::pair<osmium::unsigned_object_id_type, WayData>> ways;
+    std::vector<std::pair<osmium::unsigned_object_id_type, RelationData>> relations;
+
+    uint64_t processed_nodes = 0;
+    uint64_t processed_ways = 0;
+    uint64_t processed_relations = 0;
+    uint64_t matched_nodes = 0;
+    uint64_t matched_ways = 0;
+    uint64_t matched_relations = 0;
+};
+
+// Per-object work of one thread: region lookup, category matching, tag serialization and
+// sampling into its own reservoirs. Index entries go to the current BufferResult instead of the
+// indices, which only the pipeline writes. Ways and relations read the node and way indices,
+// which are complete and no longer written by the time ways and relations are classified.
+class PlaceClassifier : public osmium::handler::Handler {
+private:
+    const CategoryMatcher::CategoryMatcher* category_matcher_;
+    NUTSRegionLookup::NUTSIndex* nuts_index_;
+    const NodeIndex* node_index_;
+    const WayIndex* way_index_;
+    uint64_t seed_;
+    PlaceReservoirs reservoirs_;
+    BufferResult* result_ = nullptr;
+
+    // Reservoir region index of each NUTS region index (SIZE_MAX until first seen)
+    std::vector<size_t> reservoir_regions_;
+
+    // Regions of the located nodes of the current buffer, looked up in one batch
+    std::vector<double> node_lats_;
+    std::vector<double> node_lons_;
+    std::vector<int> node_regions_;
+    size_t next_node_ = 0;
+
+    // Random key of an object: a hash of the seed and the object, so the sample is the same
+    // whichever thread sees the object and in whatever order
+    double sample_key(osmium::item_type type, osmium::object_id_type id) const {
+        // splitmix64 finalizer
+        uint64_t z = seed_ ^ (static_cast<uint64_t>(type) << 56) ^ static_cast<uint64_t>(id);
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        return static_cast<double>(z >> 11) * (1.0 / 9007199254740992.0); // 53 bits in [0, 1)
+    }
+
+    void sample(PlaceReservoirs::QueueGrid& queues, int category_idx, int nuts_region_idx,
+                const osmium::OSMObject& object) {
+        // Get or create region index
+        size_t& region_idx = reservoir_regions_[nuts_region_idx];
+        if (region_idx == SIZE_MAX) {
+            region_idx = reservoirs_.get_or_create_region_index(nuts_index_->region_code(nuts_region_idx));
         }
-        
-        // Get current memory usage
-        MemoryStats mem_stats = MemoryStats::get_current();
-        
-        std::ostringstream progress_oss;
-        progress_oss << "Processing: Nodes " << processed_nodes_ 
-                     << " (" << matched_nodes_ << " matched)"
-                     << " | Ways " << processed_ways_ 
-                     << " (" << matched_ways_ << " matched)"
-                     << " | Relations " << processed_relations_
-                     << " (" << matched_relations_ << " matched)"
-                     << " | RAM: " << mem_stats.format()
-                     << " | " << time_oss.str();
-        
-        std::string progress_str = progress_oss.str();
-        
-        static bool is_tty = isatty(STDOUT_FILENO);
-        if (is_tty) {
-            winsize ws{};
-            size_t cols = 0;
-            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
-                cols = static_cast<size_t>(ws.ws_col);
-            }
-            if (cols > 0 && progress_str.size() >= cols) {
-                const size_t keep = (cols > 4) ? (cols - 4) : 0;
-                progress_str = progress_str.substr(0, keep) + "...";
-            }
-            std::cout << "\r\033[2K" << progress_str << std::flush;
-        } else {
-            std::cout << progress_str << "\n" << std::flush;
+
+        // Draw the key first: in large categories most objects are rejected here, before any
+        // tag serialization
+        const auto& category = category_matcher_->get_category(category_idx);
+        uint32_t slot = reservoirs_.admit(queues[category_idx][region_idx],
+                                          sample_key(object.type(), object.id()),
+                                          object.id(), category.max_per_region);
+        if (slot != PlaceReservoirs::NO_SLOT) {
+            reservoirs_.tags(slot) = PlaceExtraction::tags_to_json(object.tags());
         }
     }
-    
+
 public:
-    SinglePassHandler(CategoryMatcher::CategoryMatcher* category_matcher,
-                     NUTSRegionLookup::NUTSIndex* nuts_index,
-                     uint64_t file_size,
-                     unsigned int seed = std::random_device{}())
+    PlaceClassifier(const CategoryMatcher::CategoryMatcher* category_matcher,
+                    NUTSRegionLookup::NUTSIndex* nuts_index,
+                    const NodeIndex* node_index,
+                    const WayIndex* way_index,
+                    uint64_t seed)
         : category_matcher_(category_matcher)
         , nuts_index_(nuts_index)
-        , rng_(seed)
-        , dist_(0.0, 1.0)
-        , file_size_(file_size)
-        , start_time_(std::chrono::steady_clock::now())
-        , last_progress_time_(start_time_) {
-        
-        // Initialize category names
-        category_names_ = category_matcher_->get_category_names();
-        
-        // Initialize 2D queue structures
-        size_t num_categories = category_matcher_->category_count();
-        node_queues_.resize(num_categories);
-        way_queues_.resize(num_categories);
-        relation_queues_.resize(num_categories);
-        
-        for (size_t i = 0; i < num_categories; ++i) {
-            node_queues_[i].resize(1);  // Will grow as regions are encountered
-            way_queues_[i].resize(1);
-            relation_queues_[i].resize(1);
+        , node_index_(node_index)
+        , way_index_(way_index)
+        , seed_(seed)
+        , reservoirs_(category_matcher->category_count())
+        , reservoir_regions_(nuts_index->region_count(), SIZE_MAX) {}
+
+    // Where the index entries and counts of the following objects go
+    void set_result(BufferResult* result) { result_ = result; }
+
+    // Look up the regions of all nodes of a buffer before its objects are classified
+    void prepare(const osmium::memory::Buffer& buffer) {
+        node_lats_.clear();
+        node_lons_.clear();
+        for (auto it = buffer.cbegin<osmium::Node>(); it != buffer.cend<osmium::Node>(); ++it) {
+            if (it->location().valid()) {
+                node_lats_.push_back(it->location().lat());
+                node_lons_.push_back(it->location().lon());
+            }
         }
+        node_regions_.resize(node_lats_.size());
+        nuts_index_->lookup_index_wgs84_batch(node_lats_.data(), node_lons_.data(), node_lats_.size(), node_regions_.data());
+        next_node_ = 0;
     }
-    
+
+    PlaceReservoirs& reservoirs() { return reservoirs_; }
+
     void node(const osmium::Node& node) {
-        processed_nodes_++;
-        
+        result_->processed_nodes++;
+
         if (!node.location().valid()) {
-            if (processed_nodes_ % 10000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
-        // Lookup region
-        std::string region_code = nuts_index_->lookup_wgs84(node.location().lat(), node.location().lon());
-        if (region_code.empty()) {
-            if (processed_nodes_ % 10000 == 0) {
-                update_progress();
-            }
+
+        // Region from the batch lookup in prepare()
+        int region_idx = node_regions_[next_node_++];
+        if (region_idx == NUTSRegionLookup::NUTSIndex::NO_REGION) {
             return;
         }
-        
+
         // Compute Web Mercator coordinates
         auto mercator = PlaceExtraction::wgs84_to_web_mercator(node.location().lat(), node.location().lon());
-        
+
         // Store ALL nodes in disk index (not just categorized ones)
         // This is critical: ways need to reference any node (not just categorized ones) to compute
         // their centroid. If we only stored categorized nodes, ways with non-categorized member
@@ -364,51 +422,29 @@ public:
         node_data.location_wgs84 = node.location();
         node_data.x_mercator = mercator.first;
         node_data.y_mercator = mercator.second;
-        node_index_.set(static_cast<osmium::unsigned_object_id_type>(node.id()), node_data);
-        
+        result_->nodes.emplace_back(static_cast<osmium::unsigned_object_id_type>(node.id()), node_data);
+
         // Check if this node matches a category
         int category_idx = category_matcher_->match_category(node.tags());
         if (category_idx < 0) {
             // Node doesn't match any category, but we've stored it for way lookups
-            if (processed_nodes_ % 10000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         // This node matches a category, add it to reservoir sampling
-        matched_nodes_++;
-        
-        // Get or create region index
-        size_t region_idx = get_or_create_region_index(region_code);
-        
-        // Serialize tags
-        std::string tags_json = PlaceExtraction::tags_to_json(node.tags());
-        
-        // Apply reservoir sampling (only for categorized nodes)
-        // Store region_code in PlaceQueueData to avoid memory-backed maps
-        PlaceQueueData queue_data;
-        queue_data.id = node.id();
-        queue_data.tags_json = std::move(tags_json);
-        queue_data.region_code = region_code;
-        
-        const auto& category = category_matcher_->get_category(category_idx);
-        apply_reservoir_sampling(node_queues_[category_idx][region_idx], queue_data, category.max_per_region);
-        
-        if (processed_nodes_ % 10000 == 0) {
-            update_progress();
-        }
+        result_->matched_nodes++;
+        sample(reservoirs_.node_queues(), category_idx, region_idx, node);
     }
-    
+
     void way(const osmium::Way& way) {
-        processed_ways_++;
-        
+        result_->processed_ways++;
+
         // Load node locations from disk index
         // All nodes are stored in node_index_, so we can look them up here
         std::vector<osmium::Location> node_locations;
         for (const auto& node_ref : way.nodes()) {
             try {
-                NodeData node_data = node_index_.get(static_cast<osmium::unsigned_object_id_type>(node_ref.ref()));
+                NodeData node_data = node_index_->get(static_cast<osmium::unsigned_object_id_type>(node_ref.ref()));
                 if (node_data.location_wgs84.valid()) {
                     node_locations.push_back(node_data.location_wgs84);
                 }
@@ -416,36 +452,27 @@ public:
                 // Node not found in index, skip
             }
         }
-        
+
         if (node_locations.empty()) {
-            if (processed_ways_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         // Compute centroid
         osmium::Location centroid = PlaceExtraction::compute_centroid(node_locations);
         if (!centroid.valid()) {
-            if (processed_ways_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         // Compute Web Mercator coordinates
         auto mercator = PlaceExtraction::wgs84_to_web_mercator(centroid.lat(), centroid.lon());
-        
+
         // Determine region (use centroid's region)
-        std::string region_code = nuts_index_->lookup_wgs84(centroid.lat(), centroid.lon());
-        
-        if (region_code.empty()) {
-            if (processed_ways_ % 1000 == 0) {
-                update_progress();
-            }
+        int region_idx = nuts_index_->lookup_index_wgs84(centroid.lat(), centroid.lon());
+
+        if (region_idx == NUTSRegionLookup::NUTSIndex::NO_REGION) {
             return;
         }
-        
+
         // Store ALL ways in disk index (not just categorized ones)
         // This is critical: relations may reference any way (not just categorized ones) to compute
         // their centroid. If we only stored categorized ways, relations with non-categorized
@@ -454,64 +481,39 @@ public:
         way_data.centroid_wgs84 = centroid;
         way_data.x_mercator = mercator.first;
         way_data.y_mercator = mercator.second;
-        way_index_.set(static_cast<osmium::unsigned_object_id_type>(way.id()), way_data);
-        
+        result_->ways.emplace_back(static_cast<osmium::unsigned_object_id_type>(way.id()), way_data);
+
         // Check if this way matches a category
         int category_idx = category_matcher_->match_category(way.tags());
         if (category_idx < 0) {
             // Way doesn't match any category, but we've stored it for relation lookups
-            if (processed_ways_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         // This way matches a category, add it to reservoir sampling
-        matched_ways_++;
-        
-        // Get or create region index
-        size_t region_idx = get_or_create_region_index(region_code);
-        
-        // Serialize tags
-        std::string tags_json = PlaceExtraction::tags_to_json(way.tags());
-        
-        // Apply reservoir sampling (only for categorized ways)
-        // Store region_code in PlaceQueueData to avoid memory-backed maps
-        PlaceQueueData queue_data;
-        queue_data.id = way.id();
-        queue_data.tags_json = std::move(tags_json);
-        queue_data.region_code = region_code;
-        
-        const auto& category = category_matcher_->get_category(category_idx);
-        apply_reservoir_sampling(way_queues_[category_idx][region_idx], queue_data, category.max_per_region);
-        
-        if (processed_ways_ % 1000 == 0) {
-            update_progress();
-        }
+        result_->matched_ways++;
+        sample(reservoirs_.way_queues(), category_idx, region_idx, way);
     }
-    
+
     void relation(const osmium::Relation& relation) {
-        processed_relations_++;
-        
+        result_->processed_relations++;
+
         int category_idx = category_matcher_->match_category(relation.tags());
         if (category_idx < 0) {
-            if (processed_relations_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
-        matched_relations_++;
-        
+
+        result_->matched_relations++;
+
         // Load way centroids from disk index (for outer ring ways)
         std::vector<osmium::Location> way_centroids;
         std::vector<uint32_t> way_node_counts;  // For weighted centroid
-        
+
         for (const auto& member : relation.members()) {
-            if (member.type() == osmium::item_type::way && 
+            if (member.type() == osmium::item_type::way &&
                 std::strcmp(member.role(), "outer") == 0) {
                 try {
-                    WayData way_data = way_index_.get(static_cast<osmium::unsigned_object_id_type>(member.ref()));
+                    WayData way_data = way_index_->get(static_cast<osmium::unsigned_object_id_type>(member.ref()));
                     if (way_data.centroid_wgs84.valid()) {
                         way_centroids.push_back(way_data.centroid_wgs84);
                         // Estimate node count (we don't store this, use 1 as default)
@@ -522,19 +524,16 @@ public:
                 }
             }
         }
-        
+
         if (way_centroids.empty()) {
-            if (processed_relations_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         // Compute weighted centroid
         double sum_lat = 0.0;
         double sum_lon = 0.0;
         uint64_t total_weight = 0;
-        
+
         for (size_t i = 0; i < way_centroids.size(); ++i) {
             if (way_centroids[i].valid()) {
                 uint32_t weight = way_node_counts[i];
@@ -543,79 +542,371 @@ public:
                 total_weight += weight;
             }
         }
-        
+
         if (total_weight == 0) {
-            if (processed_relations_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         osmium::Location centroid(sum_lon / total_weight, sum_lat / total_weight);
         if (!centroid.valid()) {
-            if (processed_relations_ % 1000 == 0) {
-                update_progress();
-            }
             return;
         }
-        
+
         // Compute Web Mercator coordinates
         auto mercator = PlaceExtraction::wgs84_to_web_mercator(centroid.lat(), centroid.lon());
-        
+
         // Determine region (use centroid's region)
-        std::string region_code = nuts_index_->lookup_wgs84(centroid.lat(), centroid.lon());
-        
-        if (region_code.empty()) {
-            if (processed_relations_ % 1000 == 0) {
-                update_progress();
-            }
+        int region_idx = nuts_index_->lookup_index_wgs84(centroid.lat(), centroid.lon());
+
+        if (region_idx == NUTSRegionLookup::NUTSIndex::NO_REGION) {
             return;
         }
-        
+
         // Store in disk index
         RelationData relation_data;
         relation_data.centroid_wgs84 = centroid;
         relation_data.x_mercator = mercator.first;
         relation_data.y_mercator = mercator.second;
-        relation_index_.set(static_cast<osmium::unsigned_object_id_type>(relation.id()), relation_data);
-        
-        // Get or create region index
-        size_t region_idx = get_or_create_region_index(region_code);
-        
-        // Serialize tags
-        std::string tags_json = PlaceExtraction::tags_to_json(relation.tags());
-        
-        // Apply reservoir sampling
-        // Store region_code in PlaceQueueData to avoid memory-backed maps
-        PlaceQueueData queue_data;
-        queue_data.id = relation.id();
-        queue_data.tags_json = std::move(tags_json);
-        queue_data.region_code = region_code;
-        
-        const auto& category = category_matcher_->get_category(category_idx);
-        apply_reservoir_sampling(relation_queues_[category_idx][region_idx], queue_data, category.max_per_region);
-        
-        if (processed_relations_ % 1000 == 0) {
-            update_progress();
+        result_->relations.emplace_back(static_cast<osmium::unsigned_object_id_type>(relation.id()), relation_data);
+
+        sample(reservoirs_.relation_queues(), category_idx, region_idx, relation);
+    }
+};
+
+// Runs the classifiers over the input: decoded buffers fan out to worker threads, and their
+// index entries are committed in input order, which keeps the sparse indices sorted by id.
+// Ways need every node location and relations every way centroid, so a buffer of another
+// object type waits until all buffers before it are committed. With one thread everything
+// runs on the reading thread.
+class PlacePipeline {
+private:
+    // Per worker thread; more buffers than this are not decoded ahead
+    static constexpr size_t BUFFERS_IN_FLIGHT_PER_THREAD = 4;
+
+    struct Task {
+        uint64_t sequence = 0;
+        osmium::memory::Buffer buffer;
+    };
+
+    const CategoryMatcher::CategoryMatcher* category_matcher_;
+
+    // Disk-backed indices (POD data only)
+    NodeIndex node_index_;
+    WayIndex way_index_;
+    RelationIndex relation_index_;
+
+    // Classifier of the reading thread (inline processing) and one per worker
+    std::unique_ptr<PlaceClassifier> inline_classifier_;
+    std::vector<std::unique_ptr<PlaceClassifier>> worker_classifiers_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable result_ready_;
+    std::deque<Task> tasks_;
+    std::map<uint64_t, BufferResult> completed_;
+    std::exception_ptr error_;
+    bool stopping_ = false;
+    uint64_t next_sequence_ = 0;
+    uint64_t committed_ = 0;
+    size_t max_in_flight_;
+    osmium::item_type phase_ = osmium::item_type::undefined;
+
+    // Statistics
+    BufferResult totals_;
+
+    // Progress tracking
+    std::chrono::steady_clock::time_point start_time_;
+    std::chrono::steady_clock::time_point last_progress_time_;
+    uint64_t last_progress_check_objects_ = 0;
+
+    void worker_loop(PlaceClassifier& classifier) {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+
+            BufferResult result;
+            try {
+                classifier.set_result(&result);
+                classifier.prepare(task.buffer);
+                osmium::apply(task.buffer, classifier);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed_.emplace(task.sequence, std::move(result));
+            }
+            result_ready_.notify_one();
         }
     }
-    
+
+    void commit(const BufferResult& result) {
+        for (const auto& [id, node_data] : result.nodes) {
+            node_index_.set(id, node_data);
+        }
+        for (const auto& [id, way_data] : result.ways) {
+            way_index_.set(id, way_data);
+        }
+        for (const auto& [id, relation_data] : result.relations) {
+            relation_index_.set(id, relation_data);
+        }
+
+        totals_.processed_nodes += result.processed_nodes;
+        totals_.processed_ways += result.processed_ways;
+        totals_.processed_relations += result.processed_relations;
+        totals_.matched_nodes += result.matched_nodes;
+        totals_.matched_ways += result.matched_ways;
+        totals_.matched_relations += result.matched_relations;
+        update_progress();
+    }
+
+    // Commit finished buffers in input order; with wait, block until the next one is finished
+    void collect(bool wait) {
+        std::vector<BufferResult> ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (wait) {
+                result_ready_.wait(lock, [this] { return error_ || completed_.count(committed_) > 0; });
+            }
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            for (auto it = completed_.find(committed_); it != completed_.end(); it = completed_.find(committed_)) {
+                ready.push_back(std::move(it->second));
+                completed_.erase(it);
+                ++committed_;
+            }
+        }
+        for (const auto& result : ready) {
+            commit(result);
+        }
+    }
+
+    // Wait until every submitted buffer is committed
+    void drain() {
+        while (committed_ < next_sequence_) {
+            collect(true);
+        }
+    }
+
+    void submit(osmium::memory::Buffer&& buffer) {
+        while (next_sequence_ - committed_ >= max_in_flight_) {
+            collect(true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(Task{next_sequence_++, std::move(buffer)});
+        }
+        work_ready_.notify_one();
+        collect(false);
+    }
+
+    // Classify on this thread, committing whenever the object type changes so that ways see
+    // the nodes, and relations the ways, of the same buffer
+    void process_inline(osmium::memory::Buffer& buffer) {
+        BufferResult result;
+        auto type = osmium::item_type::undefined;
+        inline_classifier_->prepare(buffer);
+        inline_classifier_->set_result(&result);
+        for (auto& item : buffer) {
+            if (item.type() != type) {
+                commit(result);
+                result = BufferResult();
+                type = item.type();
+            }
+            osmium::apply_item(item, *inline_classifier_);
+        }
+        commit(result);
+    }
+
+    // Lowest and highest of the node, way and relation types in a buffer
+    // (undefined if the buffer has none of them)
+    static std::pair<osmium::item_type, osmium::item_type> buffer_phases(const osmium::memory::Buffer& buffer) {
+        auto first = osmium::item_type::undefined;
+        auto last = osmium::item_type::undefined;
+        for (auto it = buffer.cbegin<osmium::OSMObject>(); it != buffer.cend<osmium::OSMObject>(); ++it) {
+            osmium::item_type type = it->type();
+            if (type != osmium::item_type::node && type != osmium::item_type::way &&
+                type != osmium::item_type::relation) {
+                continue;
+            }
+            if (first == osmium::item_type::undefined || type < first) {
+                first = type;
+            }
+            if (last == osmium::item_type::undefined || type > last) {
+                last = type;
+            }
+        }
+        return {first, last};
+    }
+
+    void stop_workers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        workers_.clear();
+    }
+
+    void update_progress() {
+        // Look at the clock only every 10000 objects
+        uint64_t objects = totals_.processed_nodes + totals_.processed_ways + totals_.processed_relations;
+        if (objects - last_progress_check_objects_ < 10000) {
+            return;
+        }
+        last_progress_check_objects_ = objects;
+
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_progress_time_);
+
+        // Only log every 5 seconds
+        if (elapsed.count() < 5000) {
+            return;
+        }
+
+        last_progress_time_ = now;
+
+        auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time_);
+        int64_t elapsed_sec = total_elapsed.count();
+
+        int64_t hours_spent = elapsed_sec / 3600;
+        int64_t minutes_spent = (elapsed_sec % 3600) / 60;
+        int64_t seconds_spent = elapsed_sec % 60;
+
+        std::ostringstream time_oss;
+        if (hours_spent > 0) {
+            time_oss << hours_spent << "h" << minutes_spent << "m" << seconds_spent << "s";
+        } else if (minutes_spent > 0) {
+            time_oss << minutes_spent << "m" << seconds_spent << "s";
+        } else {
+            time_oss << seconds_spent << "s";
+        }
+
+        // Get current memory usage
+        MemoryStats mem_stats = MemoryStats::get_current();
+
+        std::ostringstream progress_oss;
+        progress_oss << "Processing: Nodes " << totals_.processed_nodes
+                     << " (" << totals_.matched_nodes << " matched)"
+                     << " | Ways " << totals_.processed_ways
+                     << " (" << totals_.matched_ways << " matched)"
+                     << " | Relations " << totals_.processed_relations
+                     << " (" << totals_.matched_relations << " matched)"
+                     << " | RAM: " << mem_stats.format()
+                     << " | " << time_oss.str();
+
+        std::string progress_str = progress_oss.str();
+
+        static bool is_tty = isatty(STDOUT_FILENO);
+        if (is_tty) {
+            winsize ws{};
+            size_t cols = 0;
+            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+                cols = static_cast<size_t>(ws.ws_col);
+            }
+            if (cols > 0 && progress_str.size() >= cols) {
+                const size_t keep = (cols > 4) ? (cols - 4) : 0;
+                progress_str = progress_str.substr(0, keep) + "...";
+            }
+            std::cout << "\r\033[2K" << progress_str << std::flush;
+        } else {
+            std::cout << progress_str << "\n" << std::flush;
+        }
+    }
+
+public:
+    PlacePipeline(CategoryMatcher::CategoryMatcher* category_matcher,
+                  NUTSRegionLookup::NUTSIndex* nuts_index,
+                  uint64_t seed,
+                  unsigned int num_threads)
+        : category_matcher_(category_matcher)
+        , max_in_flight_(BUFFERS_IN_FLIGHT_PER_THREAD * std::max(1u, num_threads))
+        , start_time_(std::chrono::steady_clock::now())
+        , last_progress_time_(start_time_) {
+
+        inline_classifier_ = std::make_unique<PlaceClassifier>(category_matcher, nuts_index, &node_index_, &way_index_, seed);
+        if (num_threads > 1) {
+            for (unsigned int i = 0; i < num_threads; ++i) {
+                worker_classifiers_.push_back(
+                    std::make_unique<PlaceClassifier>(category_matcher, nuts_index, &node_index_, &way_index_, seed));
+            }
+            for (auto& classifier : worker_classifiers_) {
+                workers_.emplace_back([this, &classifier]() { worker_loop(*classifier); });
+            }
+        }
+    }
+
+    ~PlacePipeline() {
+        stop_workers();
+    }
+
+    PlacePipeline(const PlacePipeline&) = delete;
+    PlacePipeline& operator=(const PlacePipeline&) = delete;
+
+    void run(osmium::io::Reader& reader) {
+        while (osmium::memory::Buffer buffer = reader.read()) {
+            auto [first_phase, last_phase] = buffer_phases(buffer);
+            if (first_phase == osmium::item_type::undefined) {
+                continue;
+            }
+
+            // Buffers mixing object types (rare in PBF files) are classified inline in order
+            if (workers_.empty() || first_phase != last_phase) {
+                drain();
+                process_inline(buffer);
+                phase_ = last_phase;
+                continue;
+            }
+
+            if (first_phase != phase_) {
+                drain();
+                phase_ = first_phase;
+            }
+            submit(std::move(buffer));
+        }
+        drain();
+        stop_workers();
+    }
+
+    // Reservoirs of all threads merged into one; call once after run
+    PlaceReservoirs merged_reservoirs() {
+        PlaceReservoirs merged(category_matcher_->category_count());
+        merged.merge(inline_classifier_->reservoirs(), *category_matcher_);
+        for (auto& classifier : worker_classifiers_) {
+            merged.merge(classifier->reservoirs(), *category_matcher_);
+        }
+        return merged;
+    }
+
     void finalize_progress() {
+        last_progress_time_ = std::chrono::steady_clock::time_point();
         update_progress();
         std::cout << "\n";
         MemoryStats mem = MemoryStats::get_current();
         std::cout << "Final memory: RSS=" << mem.format() << "\n";
     }
-    
+
     // Getters for CSV writing
-    std::vector<std::vector<QueueType>>& get_node_queues() { return node_queues_; }
-    std::vector<std::vector<QueueType>>& get_way_queues() { return way_queues_; }
-    std::vector<std::vector<QueueType>>& get_relation_queues() { return relation_queues_; }
-    const std::vector<std::string>& get_category_names() const { return category_names_; }
-    const std::vector<std::string>& get_region_codes() const { return region_codes_; }
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, NodeData>& get_node_index() { return node_index_; }
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, WayData>& get_way_index() { return way_index_; }
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, RelationData>& get_relation_index() { return relation_index_; }
+    NodeIndex& get_node_index() { return node_index_; }
+    WayIndex& get_way_index() { return way_index_; }
+    RelationIndex& get_relation_index() { return relation_index_; }
 };
 
 // Helper to extract all items from a priority queue (destructive - empties the queue)
@@ -629,33 +920,9 @@ std::vector<PlaceQueueData> extract_queue_items(QueueType& queue) {
     return items;
 }
 
-// Compress CSV file
-void compress_csv(const std::string& input_file, const std::string& output_file) {
-    std::ifstream in(input_file, std::ios::binary);
-    if (!in) {
-        throw std::runtime_error("Failed to open CSV file for compression: " + input_file);
-    }
-    
-    gzFile out = gzopen(output_file.c_str(), "wb");
-    if (!out) {
-        throw std::runtime_error("Failed to open output file for compression: " + output_file);
-    }
-    
-    char buffer[8192];
-    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
-        int written = gzwrite(out, buffer, static_cast<unsigned>(in.gcount()));
-        if (written == 0) {
-            gzclose(out);
-            throw std::runtime_error("Failed to write compressed data");
-        }
-    }
-    
-    gzclose(out);
-}
-
 int main(int argc, char* argv[]) {
     if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <input.osm.pbf> --config <config.yaml> --regions-geojson <regions.geojson> [--output <output.csv.gz>]\n";
+        std::cerr << "Usage: " << argv[0] << " <input.osm.pbf> --config <config.yaml> --regions-geojson <regions.geojson> [--output <output.csv.gz>] [--threads <n>] [--seed <n>]\n";
         return 1;
     }
     
@@ -663,6 +930,8 @@ int main(int argc, char* argv[]) {
     std::string config_file;
     std::string regions_geojson;
     std::string output_file;
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t seed = std::random_device{}();
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -673,6 +942,22 @@ int main(int argc, char* argv[]) {
             regions_geojson = argv[++i];
         } else if (arg == "--output" && i + 1 < argc) {
             output_file = argv[++i];
+        } else if ((arg == "--threads" || arg == "--seed") && i + 1 < argc) {
+            std::string value = argv[++i];
+            try {
+                if (arg == "--threads") {
+                    num_threads = static_cast<unsigned int>(std::stoul(value));
+                } else {
+                    seed = std::stoull(value);
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid value for " << arg << ": " << value << "\n";
+                return 1;
+            }
+            if (num_threads == 0) {
+                std::cerr << "Error: --threads must be at least 1\n";
+                return 1;
+            }
         } else if (arg[0] != '-') {
             input_file = arg;
         }
@@ -680,7 +965,7 @@ int main(int argc, char* argv[]) {
     
     if (input_file.empty() || config_file.empty() || regions_geojson.empty()) {
         std::cerr << "Error: Missing required arguments\n";
-        std::cerr << "Usage: " << argv[0] << " <input.osm.pbf> --config <config.yaml> --regions-geojson <regions.geojson> [--output <output.csv.gz>]\n";
+        std::cerr << "Usage: " << argv[0] << " <input.osm.pbf> --config <config.yaml> --regions-geojson <regions.geojson> [--output <output.csv.gz>] [--threads <n>] [--seed <n>]\n";
         return 1;
     }
     
@@ -709,11 +994,15 @@ int main(int argc, char* argv[]) {
     
     std::cout << "Loading NUTS regions from: " << regions_geojson << "\n";
     auto nuts_index = NUTSRegionLookup::NUTSIndex::from_geojson_file(regions_geojson);
+    std::cout << "Loaded " << nuts_index->region_count() << " regions, "
+              << std::fixed << std::setprecision(1) << (nuts_index->grid_boundary_fraction() * 100.0)
+              << "% of grid cells need exact tests\n";
     
     std::cout << "Processing OSM file: " << input_file << "\n";
     std::cout << "Output file: " << output_file << "\n";
     std::cout << "Input file size: " << std::fixed << std::setprecision(1) 
               << (file_size / (1024.0 * 1024.0)) << " MB\n";
+    std::cout << "Threads: " << num_threads << ", sampling seed: " << seed << "\n";
     
     // Remove output file if it exists
     if (fs::exists(output_file)) {
@@ -721,13 +1010,16 @@ int main(int argc, char* argv[]) {
         fs::remove(output_file);
     }
     
-    // Create temporary CSV file
-    fs::path temp_csv = fs::temp_directory_path() / ("places_" + std::to_string(std::time(nullptr)) + ".csv");
-    std::ofstream csv_file(temp_csv);
-    if (!csv_file) {
-        std::cerr << "Error: Failed to open temporary CSV file\n";
+    // Open the output; CSV is compressed in blocks as it is written (format by file extension)
+    std::unique_ptr<CompressedOutput::CompressedWriter> csv_writer;
+    try {
+        csv_writer = std::make_unique<CompressedOutput::CompressedWriter>(
+            output_file, CompressedOutput::format_for_path(output_file), num_threads);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
+    std::ostream& csv_file = *csv_writer;
     
     // Write CSV header
     csv_file << "id,category,lat,lon,x_mercator,y_mercator,region,is_node,is_way,is_relation,tags\n";
@@ -737,28 +1029,30 @@ int main(int argc, char* argv[]) {
     
     try {
         // Single pass processing
-        // All nodes are stored in node_index_ as they're processed, so ways can look them up directly
+        // All nodes are stored in the node index before any way is classified, so ways can look them up directly
         osmium::io::Reader reader(input_file);
-        SinglePassHandler handler(category_matcher.get(), nuts_index.get(), file_size);
-        osmium::apply(reader, handler);
+        PlacePipeline pipeline(category_matcher.get(), nuts_index.get(), seed, num_threads);
+        pipeline.run(reader);
         reader.close();
-        handler.finalize_progress();
+        pipeline.finalize_progress();
         
         std::cout << "\nWriting CSV...\n";
         
         // Write all sampled places to CSV
-        const auto& category_names = handler.get_category_names();
-        const auto& region_codes = handler.get_region_codes();
+        PlaceReservoirs reservoirs = pipeline.merged_reservoirs();
+        const auto category_names = category_matcher->get_category_names();
+        const std::vector<size_t> region_order = reservoirs.regions_by_code();
+        const auto& region_codes = reservoirs.region_codes();
         
         // Process nodes
-        auto& node_queues = handler.get_node_queues();
+        auto& node_queues = reservoirs.node_queues();
         for (size_t cat_idx = 0; cat_idx < node_queues.size(); ++cat_idx) {
-            for (size_t reg_idx = 0; reg_idx < node_queues[cat_idx].size(); ++reg_idx) {
+            for (size_t reg_idx : region_order) {
                 auto items = extract_queue_items(node_queues[cat_idx][reg_idx]);
                 
                 for (const auto& item : items) {
                     try {
-                        NodeData node_data = handler.get_node_index().get(static_cast<osmium::unsigned_object_id_type>(item.id));
+                        NodeData node_data = pipeline.get_node_index().get(static_cast<osmium::unsigned_object_id_type>(item.id));
                         
                         csv_file << item.id << ","
                                 << "\"" << PlaceExtraction::csv_escape(category_names[cat_idx]) << "\","
@@ -766,9 +1060,9 @@ int main(int argc, char* argv[]) {
                                 << node_data.location_wgs84.lon() << ","
                                 << node_data.x_mercator << ","
                                 << node_data.y_mercator << ","
-                                << "\"" << PlaceExtraction::csv_escape(item.region_code) << "\","
+                                << "\"" << PlaceExtraction::csv_escape(region_codes[reg_idx]) << "\","
                                 << "1,0,0,"
-                                << "\"" << PlaceExtraction::csv_escape(item.tags_json) << "\"\n";
+                                << "\"" << PlaceExtraction::csv_escape(reservoirs.tags(item.tags_slot)) << "\"\n";
                     } catch (...) {
                         // Skip if not found
                     }
@@ -777,14 +1071,14 @@ int main(int argc, char* argv[]) {
         }
         
         // Process ways
-        auto& way_queues = handler.get_way_queues();
+        auto& way_queues = reservoirs.way_queues();
         for (size_t cat_idx = 0; cat_idx < way_queues.size(); ++cat_idx) {
-            for (size_t reg_idx = 0; reg_idx < way_queues[cat_idx].size(); ++reg_idx) {
+            for (size_t reg_idx : region_order) {
                 auto items = extract_queue_items(way_queues[cat_idx][reg_idx]);
                 
                 for (const auto& item : items) {
                     try {
-                        WayData way_data = handler.get_way_index().get(static_cast<osmium::unsigned_object_id_type>(item.id));
+                        WayData way_data = pipeline.get_way_index().get(static_cast<osmium::unsigned_object_id_type>(item.id));
                         
                         csv_file << item.id << ","
                                 << "\"" << PlaceExtraction::csv_escape(category_names[cat_idx]) << "\","
@@ -792,9 +1086,9 @@ int main(int argc, char* argv[]) {
                                 << way_data.centroid_wgs84.lon() << ","
                                 << way_data.x_mercator << ","
                                 << way_data.y_mercator << ","
-                                << "\"" << PlaceExtraction::csv_escape(item.region_code) << "\","
+                                << "\"" << PlaceExtraction::csv_escape(region_codes[reg_idx]) << "\","
                                 << "0,1,0,"
-                                << "\"" << PlaceExtraction::csv_escape(item.tags_json) << "\"\n";
+                                << "\"" << PlaceExtraction::csv_escape(reservoirs.tags(item.tags_slot)) << "\"\n";
                     } catch (...) {
                         // Skip if not found
                     }
@@ -803,14 +1097,14 @@ int main(int argc, char* argv[]) {
         }
         
         // Process relations
-        auto& relation_queues = handler.get_relation_queues();
+        auto& relation_queues = reservoirs.relation_queues();
         for (size_t cat_idx = 0; cat_idx < relation_queues.size(); ++cat_idx) {
-            for (size_t reg_idx = 0; reg_idx < relation_queues[cat_idx].size(); ++reg_idx) {
+            for (size_t reg_idx : region_order) {
                 auto items = extract_queue_items(relation_queues[cat_idx][reg_idx]);
                 
                 for (const auto& item : items) {
                     try {
-                        RelationData relation_data = handler.get_relation_index().get(static_cast<osmium::unsigned_object_id_type>(item.id));
+                        RelationData relation_data = pipeline.get_relation_index().get(static_cast<osmium::unsigned_object_id_type>(item.id));
                         
                         csv_file << item.id << ","
                                 << "\"" << PlaceExtraction::csv_escape(category_names[cat_idx]) << "\","
@@ -818,9 +1112,9 @@ int main(int argc, char* argv[]) {
                                 << relation_data.centroid_wgs84.lon() << ","
                                 << relation_data.x_mercator << ","
                                 << relation_data.y_mercator << ","
-                                << "\"" << PlaceExtraction::csv_escape(item.region_code) << "\","
+                                << "\"" << PlaceExtraction::csv_escape(region_codes[reg_idx]) << "\","
                                 << "0,0,1,"
-                                << "\"" << PlaceExtraction::csv_escape(item.tags_json) << "\"\n";
+                                << "\"" << PlaceExtraction::csv_escape(reservoirs.tags(item.tags_slot)) << "\"\n";
                     } catch (...) {
                         // Skip if not found
                     }
@@ -828,22 +1122,16 @@ int main(int argc, char* argv[]) {
             }
         }
         
-        csv_file.close();
-        
-        // Compress CSV file
-        std::cout << "Compressing CSV...\n";
-        compress_csv(temp_csv.string(), output_file);
-        
-        // Remove temporary CSV
-        fs::remove(temp_csv);
+        csv_writer->close();
         
         std::cout << "Processing complete!\n";
         std::cout << "Output written to: " << output_file << "\n";
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
-        if (fs::exists(temp_csv)) {
-            fs::remove(temp_csv);
+        csv_writer.reset();
+        if (fs::exists(output_file)) {
+            fs::remove(output_file);
         }
         return 1;
     }
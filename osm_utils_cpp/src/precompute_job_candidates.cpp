@@ -0,0 +1,530 @@
+// Precomputes job candidates for the routing server: for every NUTS region and place category,
+// (pickup, delivery) address pairs with their route distance and travel time per speed tier.
+// Pickups are the addresses next to the categorized places, deliveries are drawn uniformly from
+// distance bands around them like the game's annulus sampling. Every pair is routed on the
+// travel time CH of a graph snapshot, and each pickup's deliveries are pinned once per speed tier
+// on a CCH customized like the server's tiers. The server samples the result without routing.
+#include "AddressLoader.h"
+#include "ArcCostKernels.h"
+#include "GraphSnapshot.h"
+#include "JobCandidateTable.h"
+#include "SamplingGrid.h"
+#include "ShortcutTotals.h"
+
+#include <routingkit/contraction_hierarchy.h>
+#include <routingkit/customizable_contraction_hierarchy.h>
+#include <routingkit/geo_position_to_node.h>
+#include <routingkit/nested_dissection.h>
+#include <routingkit/vector_io.h>
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+
+namespace fs = std::filesystem;
+using RoutingServer::ArcCostKernels;
+using RoutingServer::JobCandidateTable;
+
+namespace {
+
+// Snapping and walking as in RoutingEngine: nearest node within 1 km, walked at 6 km/h
+constexpr float MAX_SNAP_RADIUS_M = 1000.0f;
+constexpr double WALKING_SPEED_MPS = 1.67;
+
+// Places further than this from every address are dropped, as in RoutingEngine::loadPlacesFromCSV
+constexpr float MAX_PLACE_ADDRESS_DISTANCE_M = 250.0f;
+
+struct DistanceBand {
+    double min_km;
+    double max_km;
+};
+
+// Route distance ranges of the game's job tiers (routing-app generateJobs.ts)
+const std::vector<DistanceBand> DEFAULT_BANDS = {
+    {0.1, 0.6}, {0.25, 1.5}, {0.6, 4}, {1.5, 10}, {4, 25}, {10, 60}, {25, 150}, {60, 950},
+};
+
+// Speed caps of the server's default CCH speed tiers
+const std::vector<uint32_t> DEFAULT_SPEED_TIERS = {15, 18, 20, 25, 45, 70, 75, 80, 85, 90, 105, 110, 120};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double haversine_m(double lat1, double lon1, double lat2, double lon2) {
+    constexpr double R = 6371000.0;
+    const double phi1 = lat1 * M_PI / 180.0;
+    const double phi2 = lat2 * M_PI / 180.0;
+    const double sin_dlat = std::sin((lat2 - lat1) * M_PI / 360.0);
+    const double sin_dlon = std::sin((lon2 - lon1) * M_PI / 360.0);
+    const double h = sin_dlat * sin_dlat + std::cos(phi1) * std::cos(phi2) * sin_dlon * sin_dlon;
+    return 2.0 * R * std::atan2(std::sqrt(h), std::sqrt(1.0 - h));
+}
+
+// Parse "min:max,min:max,..." in km
+std::vector<DistanceBand> parse_bands(const std::string& value) {
+    std::vector<DistanceBand> bands;
+    std::istringstream stream(value);
+    std::string token;
+    while (std::getline(stream, token, ',')) {
+        size_t colon = token.find(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument("band without ':': " + token);
+        }
+        DistanceBand band{std::stod(token.substr(0, colon)), std::stod(token.substr(colon + 1))};
+        if (band.min_km < 0.0 || band.max_km <= band.min_km) {
+            throw std::invalid_argument("empty band: " + token);
+        }
+        bands.push_back(band);
+    }
+    return bands;
+}
+
+std::vector<uint32_t> parse_speed_tiers(const std::string& value) {
+    std::vector<uint32_t> speeds;
+    std::istringstream stream(value);
+    std::string token;
+    while (std::getline(stream, token, ',')) {
+        unsigned long speed = std::stoul(token);
+        if (speed == 0) {
+            throw std::invalid_argument("speed tiers must be positive");
+        }
+        speeds.push_back(static_cast<uint32_t>(speed));
+    }
+    // Tier times are written in the order JobCandidateTable keeps its tiers
+    std::sort(speeds.begin(), speeds.end());
+    speeds.erase(std::unique(speeds.begin(), speeds.end()), speeds.end());
+    return speeds;
+}
+
+std::string get_default_output_name(const std::string& places_file) {
+    fs::path output_path(places_file);
+    output_path.replace_extension(".job_candidates.bin");
+    return output_path.string();
+}
+
+// Routing graph of a snapshot: what routing a pair needs, nothing else
+struct SnapshotGraph {
+    std::vector<unsigned> tail;
+    std::vector<unsigned> head;
+    std::vector<unsigned> geo_distance;
+    std::vector<uint16_t> arc_speed;
+    std::vector<float> latitude;
+    std::vector<float> longitude;
+    std::unique_ptr<RoutingKit::ContractionHierarchy> ch_time;
+};
+
+SnapshotGraph load_snapshot_graph(const std::string& snapshot_file) {
+    RoutingServer::GraphSnapshot::Reader reader(snapshot_file);
+    if (!reader.hasSection(RoutingServer::SnapshotSection::TimeContractionHierarchy)) {
+        throw std::runtime_error("snapshot has no travel time CH (export it with --ch all, or let the server complete it)");
+    }
+    SnapshotGraph graph;
+    graph.tail = reader.readVector<unsigned>(RoutingServer::SnapshotSection::Tail);
+    graph.head = reader.readVector<unsigned>(RoutingServer::SnapshotSection::Head);
+    graph.geo_distance = reader.readVector<unsigned>(RoutingServer::SnapshotSection::GeoDistance);
+    graph.latitude = reader.readVector<float>(RoutingServer::SnapshotSection::Latitude);
+    graph.longitude = reader.readVector<float>(RoutingServer::SnapshotSection::Longitude);
+    std::vector<unsigned> way = reader.readVector<unsigned>(RoutingServer::SnapshotSection::Way);
+    std::vector<unsigned> way_speed = reader.readVector<unsigned>(RoutingServer::SnapshotSection::WaySpeed);
+    graph.ch_time = std::make_unique<RoutingKit::ContractionHierarchy>(
+        reader.readContractionHierarchy(RoutingServer::SnapshotSection::TimeContractionHierarchy));
+    if (way.size() != graph.geo_distance.size() || graph.tail.size() != way.size() || graph.head.size() != way.size() ||
+        graph.ch_time->node_count() != graph.latitude.size()) {
+        throw std::runtime_error("inconsistent section sizes");
+    }
+
+    // Same saturation as RoutingEngine::buildArcSpeeds
+    graph.arc_speed.resize(way.size());
+    for (size_t arc = 0; arc < way.size(); ++arc) {
+        if (way[arc] >= way_speed.size()) {
+            throw std::runtime_error("arc references an unknown way");
+        }
+        graph.arc_speed[arc] = static_cast<uint16_t>(std::min(way_speed[way[arc]], ArcCostKernels::NO_SPEED_CAP));
+    }
+    return graph;
+}
+
+// Nested dissection order of the graph, cached in order_file like RoutingEngine's CCH_ORDER_FILE
+std::vector<unsigned> load_or_compute_cch_order(const SnapshotGraph& graph, const std::string& order_file) {
+    const unsigned node_count = static_cast<unsigned>(graph.latitude.size());
+    if (!order_file.empty() && fs::exists(order_file)) {
+        std::vector<unsigned> order = RoutingKit::load_vector<unsigned>(order_file);
+        if (order.size() == node_count) {
+            std::cout << "CCH order loaded from " << order_file << "\n";
+            return order;
+        }
+        std::cout << "CCH order in " << order_file << " has " << order.size() << " nodes, recomputing\n";
+    }
+    std::vector<unsigned> order = RoutingKit::compute_nested_node_dissection_order_using_inertial_flow(
+        node_count, graph.tail, graph.head, graph.latitude, graph.longitude);
+    if (!order_file.empty()) {
+        RoutingKit::save_vector(order_file, order);
+        std::cout << "CCH order saved to " << order_file << "\n";
+    }
+    return order;
+}
+
+// One customized metric per speed tier, with the weights RoutingEngine::initCustomizableHierarchy
+// gives the tier of the same speed
+struct SpeedTierMetric {
+    std::vector<unsigned> weights;
+    std::unique_ptr<RoutingKit::CustomizableContractionHierarchyMetric> metric;
+};
+
+// One pickup of one table; its candidates are routed by one worker
+struct PickupTask {
+    size_t table;
+    unsigned address;
+};
+
+struct PickupResult {
+    std::vector<JobCandidateTable::Candidate> candidates;
+    std::vector<uint32_t> tier_times;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <graph_snapshot.bin> --addresses <addresses.csv[.gz]> --places <places.csv[.gz]> "
+                  << "[--output <file>] [--bands <min:max,...>] [--per-band <n>] [--speed-tiers <kmh,...>] [--cch-order <file>] "
+                  << "[--threads <n>] [--seed <n>]\n";
+        return 1;
+    }
+
+    std::string snapshot_file = argv[1];
+    std::string addresses_file;
+    std::string places_file;
+    std::string output_file;
+    std::string cch_order_file;
+    std::vector<DistanceBand> bands = DEFAULT_BANDS;
+    std::vector<uint32_t> speed_tiers = DEFAULT_SPEED_TIERS;
+    unsigned per_band = 4;
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned seed = 42;
+
+    // Parse command line arguments
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error: " << arg << " requires a value\n";
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--addresses") {
+                addresses_file = value;
+            } else if (arg == "--places") {
+                places_file = value;
+            } else if (arg == "--output" || arg == "-o") {
+                output_file = value;
+            } else if (arg == "--bands") {
+                bands = parse_bands(value);
+            } else if (arg == "--per-band") {
+                per_band = static_cast<unsigned>(std::stoul(value));
+            } else if (arg == "--speed-tiers") {
+                speed_tiers = parse_speed_tiers(value);
+            } else if (arg == "--cch-order") {
+                cch_order_file = value;
+            } else if (arg == "--threads") {
+                num_threads = static_cast<unsigned>(std::stoul(value));
+            } else if (arg == "--seed") {
+                seed = static_cast<unsigned>(std::stoul(value));
+            } else {
+                std::cerr << "Error: Unknown option: " << arg << "\n";
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << value << "\n";
+            return 1;
+        }
+    }
+
+    if (addresses_file.empty() || places_file.empty()) {
+        std::cerr << "Error: --addresses and --places are required\n";
+        return 1;
+    }
+    if (bands.empty() || per_band == 0 || num_threads == 0) {
+        std::cerr << "Error: --bands, --per-band and --threads must not be empty or 0\n";
+        return 1;
+    }
+    if (output_file.empty()) {
+        output_file = get_default_output_name(places_file);
+    }
+    auto source = RoutingServer::SnapshotSource::fromFile(places_file);
+    if (!source.has_value()) {
+        std::cerr << "Error: Places file not found: " << places_file << "\n";
+        return 1;
+    }
+    // Candidates name addresses by id, so the server must load this very file
+    auto address_source = RoutingServer::SnapshotSource::fromFile(addresses_file);
+    if (!address_source.has_value()) {
+        std::cerr << "Error: Addresses file not found: " << addresses_file << "\n";
+        return 1;
+    }
+
+    std::cout << "Graph snapshot: " << snapshot_file << "\n";
+    std::cout << "Addresses: " << addresses_file << "\n";
+    std::cout << "Places: " << places_file << "\n";
+    std::cout << "Output: " << output_file << "\n";
+    std::cout << "Bands: " << bands.size() << ", deliveries per band: " << per_band << ", speed tiers: "
+              << speed_tiers.size() << ", threads: " << num_threads << "\n";
+
+    auto start_time = std::chrono::steady_clock::now();
+    try {
+        SnapshotGraph graph = load_snapshot_graph(snapshot_file);
+        RoutingKit::GeoPositionToNode node_index(graph.latitude, graph.longitude);
+        std::cout << "Graph loaded: " << graph.latitude.size() << " nodes, " << graph.geo_distance.size()
+                  << " arcs (" << seconds_since(start_time) << " s)\n";
+
+        // Tier times come from the same capped, customized metrics the server routes its
+        // max_speed requests on, so the tiers a server assigns match the stored times
+        RoutingKit::CustomizableContractionHierarchy cch(
+            load_or_compute_cch_order(graph, cch_order_file), graph.tail, graph.head);
+        RoutingKit::CustomizableContractionHierarchyParallelization parallel_customization(cch);
+        std::vector<SpeedTierMetric> tier_metrics(speed_tiers.size());
+        for (size_t tier = 0; tier < speed_tiers.size(); ++tier) {
+            tier_metrics[tier].weights.resize(graph.geo_distance.size());
+            ArcCostKernels::computeWeights(graph.geo_distance.data(), graph.arc_speed.data(), graph.geo_distance.size(),
+                                           speed_tiers[tier], ArcCostKernels::MAX_ARC_TIME_MS,
+                                           tier_metrics[tier].weights.data());
+            tier_metrics[tier].metric = std::make_unique<RoutingKit::CustomizableContractionHierarchyMetric>(
+                cch, tier_metrics[tier].weights.data());
+            parallel_customization.customize(*tier_metrics[tier].metric, num_threads);
+        }
+        std::cout << "CCH customized for " << speed_tiers.size() << " speed tiers (" << seconds_since(start_time) << " s)\n";
+
+        auto addresses = RoutingServer::AddressLoader::loadCsv(addresses_file, num_threads);
+        if (!addresses || addresses->empty()) {
+            throw std::runtime_error("no addresses loaded from " + addresses_file);
+        }
+        auto places = RoutingServer::AddressLoader::loadPlaces(places_file);
+        if (!places) {
+            throw std::runtime_error("cannot read " + places_file);
+        }
+        std::cout << "Loaded " << addresses->size() << " addresses and " << places->size() << " places\n";
+
+        // Pickups: the address next to each place, once per table
+        std::vector<float> address_lats(addresses->size());
+        std::vector<float> address_lons(addresses->size());
+        for (size_t i = 0; i < addresses->size(); ++i) {
+            address_lats[i] = static_cast<float>(addresses->latitude(i));
+            address_lons[i] = static_cast<float>(addresses->longitude(i));
+        }
+        RoutingKit::GeoPositionToNode address_index(address_lats, address_lons);
+        std::map<std::pair<std::string, std::string>, std::vector<unsigned>> table_pickups;
+        size_t unmatched = 0;
+        for (const auto& place : *places) {
+            auto nearest = address_index.find_nearest_neighbor_within_radius(
+                static_cast<float>(place.latitude), static_cast<float>(place.longitude), MAX_PLACE_ADDRESS_DISTANCE_M);
+            if (nearest.id == RoutingKit::invalid_id || place.region.empty()) {
+                ++unmatched;
+                continue;
+            }
+            table_pickups[{place.region, place.category}].push_back(nearest.id);
+        }
+        std::vector<std::pair<std::string, std::string>> table_keys;
+        std::vector<PickupTask> tasks;
+        for (auto& [key, pickups] : table_pickups) {
+            std::sort(pickups.begin(), pickups.end());
+            pickups.erase(std::unique(pickups.begin(), pickups.end()), pickups.end());
+            for (unsigned address : pickups) {
+                tasks.push_back({table_keys.size(), address});
+            }
+            table_keys.push_back(key);
+        }
+        std::cout << tasks.size() << " pickups in " << table_keys.size() << " region/category tables ("
+                  << unmatched << " places without an address or region)\n";
+
+        // Road length of the fastest route per CH arc, as the server totals metadata-only routes
+        RoutingServer::ShortcutTotals road_totals(*graph.ch_time, graph.geo_distance);
+
+        RoutingServer::SamplingGrid delivery_grid(*addresses);
+        auto snap = [&](unsigned address, double& walk_m) {
+            double lat = addresses->latitude(address);
+            double lon = addresses->longitude(address);
+            auto nearest = node_index.find_nearest_neighbor_within_radius(
+                static_cast<float>(lat), static_cast<float>(lon), MAX_SNAP_RADIUS_M);
+            if (nearest.id != RoutingKit::invalid_id) {
+                walk_m = haversine_m(lat, lon, graph.latitude[nearest.id], graph.longitude[nearest.id]);
+            }
+            return nearest.id;
+        };
+
+        // Workers take pickups in order; results are stored per task, so the output does not
+        // depend on the thread count
+        std::vector<PickupResult> results(tasks.size());
+        std::atomic<size_t> next_task{0};
+        std::atomic<size_t> routed{0};
+        std::atomic<size_t> unsnapped{0};
+        std::mutex progress_mutex;
+        auto route_start = std::chrono::steady_clock::now();
+        // Every task counts, routed or not, so the final progress line is always printed
+        auto count_routed = [&]() {
+            size_t done = ++routed;
+            if (done % 1000 == 0 || done == tasks.size()) {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                std::cout << "Routed " << done << "/" << tasks.size() << " pickups ("
+                          << seconds_since(route_start) << " s)\n";
+            }
+        };
+        auto worker = [&]() {
+            RoutingServer::ShortcutTotalsQuery query;
+            RoutingKit::CustomizableContractionHierarchyQuery tier_query(*tier_metrics.front().metric);
+            struct Delivery {
+                unsigned address;
+                unsigned node;
+                double walk_m;
+            };
+            std::vector<Delivery> deliveries;
+            std::vector<unsigned> target_nodes;
+            std::unordered_map<unsigned, unsigned> pin_of_node;
+            std::vector<std::vector<unsigned>> tier_distances(tier_metrics.size());
+            std::vector<uint32_t> times(tier_metrics.size());
+            for (size_t task_index = next_task++; task_index < tasks.size(); task_index = next_task++) {
+                const PickupTask& task = tasks[task_index];
+                PickupResult& result = results[task_index];
+                std::seed_seq seeds{seed, static_cast<unsigned>(task_index), static_cast<unsigned>(task_index >> 32)};
+                std::mt19937 gen(seeds);
+
+                double pickup_walk_m = 0.0;
+                unsigned pickup_node = snap(task.address, pickup_walk_m);
+                if (pickup_node == RoutingKit::invalid_id) {
+                    ++unsnapped;
+                    count_routed();
+                    continue;
+                }
+
+                // Draw every delivery first, so each speed tier routes to all of them in one query
+                deliveries.clear();
+                target_nodes.clear();
+                pin_of_node.clear();
+                double pickup_lat = addresses->latitude(task.address);
+                double pickup_lon = addresses->longitude(task.address);
+                for (const DistanceBand& band : bands) {
+                    auto ring = delivery_grid.ring(pickup_lat, pickup_lon, band.min_km * 1000.0, band.max_km * 1000.0);
+                    if (ring.size() == 0) {
+                        continue;
+                    }
+                    for (unsigned draw = 0; draw < per_band; ++draw) {
+                        unsigned delivery = ring.draw(gen);
+                        double delivery_walk_m = 0.0;
+                        unsigned delivery_node = snap(delivery, delivery_walk_m);
+                        if (delivery == task.address || delivery_node == RoutingKit::invalid_id) {
+                            continue;
+                        }
+                        deliveries.push_back({delivery, delivery_node, delivery_walk_m});
+                        if (delivery_node != pickup_node &&
+                            pin_of_node.emplace(delivery_node, static_cast<unsigned>(target_nodes.size())).second) {
+                            target_nodes.push_back(delivery_node);
+                        }
+                    }
+                }
+                if (!target_nodes.empty()) {
+                    for (size_t tier = 0; tier < tier_metrics.size(); ++tier) {
+                        tier_query.reset(*tier_metrics[tier].metric).pin_targets(target_nodes);
+                        tier_query.add_source(pickup_node).run_to_pinned_targets();
+                        tier_distances[tier] = tier_query.get_distances_to_targets();
+                    }
+                }
+
+                for (const Delivery& delivery : deliveries) {
+                    // The road length needs the fastest route itself, which pinned queries do not
+                    // report; the totals query carries it without unpacking the route
+                    uint32_t drive_ms = 0;
+                    uint64_t road_m = 0;
+                    if (delivery.node != pickup_node) {
+                        auto route = query.run(*graph.ch_time, road_totals, pickup_node, delivery.node);
+                        if (route.distance == RoutingKit::inf_weight) {
+                            continue;
+                        }
+                        drive_ms = route.distance;
+                        road_m = route.total;
+                    }
+
+                    // Totals as the server reports them for a route between the two addresses
+                    double walk_m = pickup_walk_m + delivery.walk_m;
+                    uint32_t walk_ms = static_cast<uint32_t>(pickup_walk_m * 1000.0 / WALKING_SPEED_MPS) +
+                                       static_cast<uint32_t>(delivery.walk_m * 1000.0 / WALKING_SPEED_MPS);
+
+                    // Every tier stores a time, so a pair that some tier cannot route is dropped
+                    bool routed_in_every_tier = true;
+                    for (size_t tier = 0; tier < tier_metrics.size(); ++tier) {
+                        uint32_t time = delivery.node == pickup_node ? 0 : tier_distances[tier][pin_of_node.at(delivery.node)];
+                        if (time == RoutingKit::inf_weight) {
+                            routed_in_every_tier = false;
+                            break;
+                        }
+                        times[tier] = walk_ms + time;
+                    }
+                    if (!routed_in_every_tier) {
+                        continue;
+                    }
+
+                    JobCandidateTable::Candidate candidate;
+                    candidate.pickup_address = task.address;
+                    candidate.delivery_address = delivery.address;
+                    candidate.distance_m = static_cast<uint32_t>(std::min<uint64_t>(
+                        road_m + static_cast<uint64_t>(walk_m), UINT32_MAX));
+                    candidate.travel_time_ms = walk_ms + drive_ms;
+                    result.candidates.push_back(candidate);
+                    result.tier_times.insert(result.tier_times.end(), times.begin(), times.end());
+                }
+
+                count_routed();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < num_threads; ++i) {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (unsnapped > 0) {
+            std::cout << unsnapped << " pickups without a road node within " << MAX_SNAP_RADIUS_M << " m\n";
+        }
+
+        // Tasks are grouped by table, in table order
+        JobCandidateTable table;
+        table.setSpeedTiers(speed_tiers);
+        table.setAddressSource(*address_source);
+        size_t task_index = 0;
+        for (size_t table_index = 0; table_index < table_keys.size(); ++table_index) {
+            std::vector<JobCandidateTable::Candidate> candidates;
+            std::vector<uint32_t> tier_times;
+            for (; task_index < tasks.size() && tasks[task_index].table == table_index; ++task_index) {
+                PickupResult& result = results[task_index];
+                candidates.insert(candidates.end(), result.candidates.begin(), result.candidates.end());
+                tier_times.insert(tier_times.end(), result.tier_times.begin(), result.tier_times.end());
+                result = PickupResult();
+            }
+            table.addTable(table_keys[table_index].first, table_keys[table_index].second, std::move(candidates), tier_times);
+        }
+
+        fs::path output_path(output_file);
+        if (output_path.has_parent_path()) {
+            fs::create_directories(output_path.parent_path());
+        }
+        table.save(output_file, *source);
+        std::cout << "Wrote " << table.size() << " candidates in " << table.tableCount() << " tables ("
+                  << table.memoryBytes() / (1024 * 1024) << " MB) in " << seconds_since(start_time) << " s\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include "CompressedOutput.h"
 #include "RoutableWays.h"
 #include <osmium/handler.hpp>
 #include <osmium/io/pbf_input.hpp>
@@ -6,6 +7,8 @@
 #include <osmium/io/writer.hpp>
 #include <osmium/handler/node_locations_for_ways.hpp>
 #include <osmium/index/map/sparse_file_array.hpp>
+#include <osmium/index/node_locations_map.hpp>
+#include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/node.hpp>
 #include <osmium/osm/way.hpp>
 #include <osmium/osm/relation.hpp>
@@ -24,7 +27,7 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
-#include <zlib.h>
+#include <thread>
 #include <cstring>
 #include <algorithm>
 #include <ctime>
@@ -330,8 +333,8 @@ Address extract_address_data_from_relation(const osmium::Relation& relation,
 }
 
 // Shared helper function to write address CSV
-void write_address_csv(std::ofstream* csv_file, const Address& addr) {
-    if (csv_file && csv_file->is_open()) {
+void write_address_csv(std::ostream* csv_file, const Address& addr) {
+    if (csv_file) {
         *csv_file << addr.id << ","
                   << (addr.is_building ? "1" : "0") << ","
                   << (addr.is_addr ? "1" : "0") << ","
@@ -345,10 +348,55 @@ void write_address_csv(std::ofstream* csv_file, const Address& addr) {
     }
 }
 
+// Address of a way with address/building tags from its node locations; false if it has none
+bool write_way_address_csv(std::ostream* csv_file, const osmium::Way& way) {
+    if (!has_address_or_building_tags(way.tags())) {
+        return false;
+    }
+    
+    // Collect node locations for centroid computation
+    std::vector<osmium::Location> node_locations;
+    for (const auto& node_ref : way.nodes()) {
+        if (node_ref.location().valid()) {
+            node_locations.push_back(node_ref.location());
+        }
+    }
+    
+    if (node_locations.empty()) {
+        return false;
+    }
+    
+    Address addr = extract_address_data_from_way(way, node_locations);
+    if (addr.lat == 0.0 && addr.lon == 0.0) {
+        return false;
+    }
+    write_address_csv(csv_file, addr);
+    return true;
+}
+
+// Progress line: rewritten in place on a terminal, one line per update otherwise
+void print_progress_line(std::string progress_str) {
+    static bool is_tty = isatty(STDOUT_FILENO);
+    if (is_tty) {
+        winsize ws{};
+        size_t cols = 0;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+            cols = static_cast<size_t>(ws.ws_col);
+        }
+        if (cols > 0 && progress_str.size() >= cols) {
+            const size_t keep = (cols > 4) ? (cols - 4) : 0;
+            progress_str = progress_str.substr(0, keep) + "...";
+        }
+        std::cout << "\r\033[2K" << progress_str << std::flush;
+    } else {
+        std::cout << progress_str << "\n" << std::flush;
+    }
+}
+
 // Pass 1: Collect node IDs from routable ways and extract addresses/buildings
 class Pass1Handler : public osmium::handler::Handler {
 private:
-    std::ofstream* m_csv_file;
+    std::ostream* m_csv_file;
     ankerl::unordered_dense::set<osmium::object_id_type> m_nodes_needed;
     ankerl::unordered_dense::set<osmium::object_id_type> m_relation_way_ids;
     bool m_routable_only = false;
@@ -431,27 +479,11 @@ private:
                      << " | " << std::fixed << std::setprecision(0) << nodes_per_sec << " nodes/s"
                      << " | " << time_oss.str();
         
-        std::string progress_str = progress_oss.str();
-        
-        static bool is_tty = isatty(STDOUT_FILENO);
-        if (is_tty) {
-            winsize ws{};
-            size_t cols = 0;
-            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
-                cols = static_cast<size_t>(ws.ws_col);
-            }
-            if (cols > 0 && progress_str.size() >= cols) {
-                const size_t keep = (cols > 4) ? (cols - 4) : 0;
-                progress_str = progress_str.substr(0, keep) + "...";
-            }
-            std::cout << "\r\033[2K" << progress_str << std::flush;
-        } else {
-            std::cout << progress_str << "\n" << std::flush;
-        }
+        print_progress_line(progress_oss.str());
     }
     
 public:
-    Pass1Handler(std::ofstream* csv_file, uint64_t file_size, bool routable_only, bool extract_addresses = true)
+    Pass1Handler(std::ostream* csv_file, uint64_t file_size, bool routable_only, bool extract_addresses = true)
         : m_csv_file(csv_file)
         , m_routable_only(routable_only)
         , m_extract_addresses(extract_addresses)
@@ -536,13 +568,107 @@ public:
     }
 };
 
+// Addresses of relations: the centroids of the outer ways they reference are stored while
+// ways are read, and each relation gets the centroid of those, weighted by node count
+class RelationAddressCollector {
+private:
+    const ankerl::unordered_dense::set<osmium::object_id_type>& m_relation_way_ids;
+    
+    // Disk-based storage for way centroids and node counts (only for relation ways)
+    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, osmium::Location> m_way_centroids;
+    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, uint32_t> m_way_node_counts;
+    
+public:
+    explicit RelationAddressCollector(const ankerl::unordered_dense::set<osmium::object_id_type>& relation_way_ids)
+        : m_relation_way_ids(relation_way_ids) {
+    }
+    
+    // Store way centroid + node count if this way is referenced by a relation (needs node locations)
+    void way(const osmium::Way& way) {
+        osmium::object_id_type way_id = static_cast<osmium::object_id_type>(way.id());
+        if (m_relation_way_ids.find(way_id) == m_relation_way_ids.end()) {
+            return;
+        }
+        
+        std::vector<osmium::Location> node_locations;
+        for (const auto& node_ref : way.nodes()) {
+            if (node_ref.location().valid()) {
+                node_locations.push_back(node_ref.location());
+            }
+        }
+        
+        if (!node_locations.empty()) {
+            osmium::Location centroid = compute_centroid(node_locations);
+            if (centroid.valid()) {
+                m_way_centroids.set(static_cast<osmium::unsigned_object_id_type>(way.id()), centroid);
+                m_way_node_counts.set(static_cast<osmium::unsigned_object_id_type>(way.id()), static_cast<uint32_t>(node_locations.size()));
+            }
+        }
+    }
+    
+    // Address of a relation with address/building tags; false if none of its outer ways was stored
+    bool extract(const osmium::Relation& relation, Address& addr) {
+        // Collect way centroids and node counts for outer ring ways
+        std::vector<osmium::Location> way_centroids;
+        std::vector<uint32_t> way_node_counts;
+        
+        for (const auto& member : relation.members()) {
+            if (member.type() == osmium::item_type::way && 
+                std::strcmp(member.role(), "outer") == 0) {
+                osmium::unsigned_object_id_type way_id = static_cast<osmium::unsigned_object_id_type>(member.ref());
+                
+                try {
+                    osmium::Location centroid = m_way_centroids.get(way_id);
+                    uint32_t node_count = m_way_node_counts.get(way_id);
+                    
+                    if (centroid.valid() && node_count > 0) {
+                        way_centroids.push_back(centroid);
+                        way_node_counts.push_back(node_count);
+                    }
+                } catch (...) {
+                    // Way centroid not found, skip this way
+                }
+            }
+        }
+        
+        if (way_centroids.empty()) {
+            return false;
+        }
+        
+        // Compute weighted centroid: sum(centroid * node_count) / sum(node_count)
+        double sum_lat = 0.0;
+        double sum_lon = 0.0;
+        uint64_t total_nodes = 0;
+        
+        for (size_t i = 0; i < way_centroids.size(); ++i) {
+            if (way_centroids[i].valid()) {
+                sum_lat += way_centroids[i].lat() * way_node_counts[i];
+                sum_lon += way_centroids[i].lon() * way_node_counts[i];
+                total_nodes += way_node_counts[i];
+            }
+        }
+        
+        if (total_nodes == 0) {
+            return false;
+        }
+        
+        // osmium::Location constructor takes (lon, lat), not (lat, lon)
+        osmium::Location weighted_centroid(sum_lon / total_nodes, sum_lat / total_nodes);
+        std::vector<osmium::Location> outer_ring_locations;
+        outer_ring_locations.push_back(weighted_centroid);
+        
+        addr = extract_address_data_from_relation(relation, outer_ring_locations);
+        return true;
+    }
+};
+
 // Pass 2: Write nodes (if in set) and routable ways, extract addresses from ways/relations
 class Pass2Handler : public osmium::handler::Handler {
 private:
     const ankerl::unordered_dense::set<osmium::object_id_type>& m_nodes_needed;
-    const ankerl::unordered_dense::set<osmium::object_id_type>& m_relation_way_ids;
+    RelationAddressCollector m_relation_addresses;
     osmium::io::Writer* m_writer;
-    std::ofstream* m_csv_file;
+    std::ostream* m_csv_file;
     bool m_routable_only = false;
     bool m_extract_addresses = false;
     
@@ -553,10 +679,6 @@ private:
     uint64_t m_written_nodes = 0;
     uint64_t m_addresses_found = 0;
     
-    // Disk-based storage for way centroids and node counts (only for relation ways)
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, osmium::Location> m_way_centroids;
-    osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, uint32_t> m_way_node_counts;
-    
     // Progress tracking
     uint64_t m_file_size = 0;
     std::chrono::steady_clock::time_point m_start_time;
@@ -599,35 +721,19 @@ private:
         progress_oss << " | " << std::fixed << std::setprecision(0) << nodes_per_sec << " nodes/s"
                      << " | " << time_oss.str();
         
-        std::string progress_str = progress_oss.str();
-        
-        static bool is_tty = isatty(STDOUT_FILENO);
-        if (is_tty) {
-            winsize ws{};
-            size_t cols = 0;
-            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
-                cols = static_cast<size_t>(ws.ws_col);
-            }
-            if (cols > 0 && progress_str.size() >= cols) {
-                const size_t keep = (cols > 4) ? (cols - 4) : 0;
-                progress_str = progress_str.substr(0, keep) + "...";
-            }
-            std::cout << "\r\033[2K" << progress_str << std::flush;
-        } else {
-            std::cout << progress_str << "\n" << std::flush;
-        }
+        print_progress_line(progress_oss.str());
     }
     
 public:
     Pass2Handler(const ankerl::unordered_dense::set<osmium::object_id_type>& nodes_needed,
                  const ankerl::unordered_dense::set<osmium::object_id_type>& relation_way_ids,
                  osmium::io::Writer* writer,
-                 std::ofstream* csv_file,
+                 std::ostream* csv_file,
                  uint64_t file_size,
                  bool routable_only,
                  bool extract_addresses)
         : m_nodes_needed(nodes_needed)
-        , m_relation_way_ids(relation_way_ids)
+        , m_relation_addresses(relation_way_ids)
         , m_writer(writer)
         , m_csv_file(csv_file)
         , m_routable_only(routable_only)
@@ -671,41 +777,13 @@ public:
         m_processed_ways++;
         
         // Extract addresses/buildings from ways
-        if (m_extract_addresses && has_address_or_building_tags(way.tags())) {
-            // Collect node locations for centroid computation
-            std::vector<osmium::Location> node_locations;
-            for (const auto& node_ref : way.nodes()) {
-                if (node_ref.location().valid()) {
-                    node_locations.push_back(node_ref.location());
-                }
-            }
-            
-            if (!node_locations.empty()) {
-                Address addr = extract_address_data_from_way(way, node_locations);
-                if (addr.lat != 0.0 || addr.lon != 0.0) {
-                    write_address_csv(m_csv_file, addr);
-                    m_addresses_found++;
-                }
-            }
+        if (m_extract_addresses && write_way_address_csv(m_csv_file, way)) {
+            m_addresses_found++;
         }
         
         // Store way centroid + node count if this way is referenced by a relation
-        osmium::object_id_type way_id = static_cast<osmium::object_id_type>(way.id());
-        if (m_extract_addresses && m_relation_way_ids.find(way_id) != m_relation_way_ids.end()) {
-            std::vector<osmium::Location> node_locations;
-            for (const auto& node_ref : way.nodes()) {
-                if (node_ref.location().valid()) {
-                    node_locations.push_back(node_ref.location());
-                }
-            }
-            
-            if (!node_locations.empty()) {
-                osmium::Location centroid = compute_centroid(node_locations);
-                if (centroid.valid()) {
-                    m_way_centroids.set(static_cast<osmium::unsigned_object_id_type>(way.id()), centroid);
-                    m_way_node_counts.set(static_cast<osmium::unsigned_object_id_type>(way.id()), static_cast<uint32_t>(node_locations.size()));
-                }
-            }
+        if (m_extract_addresses) {
+            m_relation_addresses.way(way);
         }
         
         // Write ways: by default include routable ways + ferry/highway, or only routable if flag is set
@@ -728,54 +806,169 @@ public:
         
         // Extract addresses/buildings from relations
         if (m_extract_addresses && has_address_or_building_tags(relation.tags())) {
-            // Collect way centroids and node counts for outer ring ways
-            std::vector<osmium::Location> way_centroids;
-            std::vector<uint32_t> way_node_counts;
-            
+            Address addr;
+            if (m_relation_addresses.extract(relation, addr) && (addr.lat != 0.0 || addr.lon != 0.0)) {
+                write_address_csv(m_csv_file, addr);
+                m_addresses_found++;
+            }
+        }
+        
+        if (m_processed_relations % 1000 == 0) {
+            update_progress();
+        }
+    }
+    
+    // Getters
+    uint64_t processed_nodes() const { return m_processed_nodes; }
+    uint64_t processed_ways() const { return m_processed_ways; }
+    uint64_t processed_relations() const { return m_processed_relations; }
+    uint64_t written_ways() const { return m_written_ways; }
+    uint64_t written_nodes() const { return m_written_nodes; }
+    uint64_t addresses_found() const { return m_addresses_found; }
+    std::chrono::steady_clock::time_point start_time() const { return m_start_time; }
+    
+    void finalize_progress() {
+        update_progress();
+        std::cout << "\n";
+        // Report memory usage at end of pass 2
+        MemoryStats mem = MemoryStats::get_current();
+        std::cout << "Pass 2 memory: RSS=" << mem.format() << ", Peak=" << mem.format_peak() << "\n";
+    }
+};
+
+// Node location index of the single-pass mode; the implementation is picked at runtime
+using LocationIndex = osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location>;
+
+// Inputs from this size on get a dense location index by default. A dense array takes 8 bytes
+// per possible node id, which only pays off when the input has a location for a large part of
+// the id range (planet and continent files); smaller extracts use a sparse array of 16 bytes
+// per node within it.
+constexpr uint64_t DENSE_INDEX_MIN_INPUT_BYTES = 16ULL * 1024 * 1024 * 1024;
+
+// osmium map type for --index auto|dense|sparse
+std::string location_index_type(const std::string& index_mode, uint64_t file_size) {
+    bool dense = index_mode == "dense" || (index_mode == "auto" && file_size >= DENSE_INDEX_MIN_INPUT_BYTES);
+    if (!dense) {
+        return "sparse_file_array";
+    }
+#ifdef __linux__
+    return "dense_mmap_array";
+#else
+    return "dense_file_array";
+#endif
+}
+
+// Single pass: addresses from nodes and ways, routable ways to a temporary file (so the minimal
+// nodes they need can be written ahead of them once all locations are known), and the outer
+// ways of address relations, which a second read of ways and relations picks up if there are
+// any. Node locations come from NodeLocationsForWays running in front of this handler.
+class SinglePassHandler : public osmium::handler::Handler {
+private:
+    std::ostream* m_csv_file;
+    osmium::io::Writer* m_ways_writer;
+    ankerl::unordered_dense::set<osmium::object_id_type> m_nodes_needed;
+    ankerl::unordered_dense::set<osmium::object_id_type> m_relation_way_ids;
+    bool m_routable_only = false;
+    bool m_extract_addresses = true;
+    
+    uint64_t m_processed_nodes = 0;
+    uint64_t m_processed_ways = 0;
+    uint64_t m_processed_relations = 0;
+    uint64_t m_written_ways = 0;
+    uint64_t m_addresses_found = 0;
+    uint64_t m_address_relations = 0;
+    
+    // Progress tracking
+    std::chrono::steady_clock::time_point m_start_time;
+    std::chrono::steady_clock::time_point m_last_progress_time;
+    
+    void update_progress() {
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_last_progress_time);
+        if (elapsed.count() < 100) {
+            return;
+        }
+        m_last_progress_time = now;
+        
+        auto elapsed_sec = std::chrono::duration_cast<std::chrono::seconds>(now - m_start_time).count();
+        double nodes_per_sec = elapsed_sec > 0 ? static_cast<double>(m_processed_nodes) / static_cast<double>(elapsed_sec) : 0.0;
+        
+        std::ostringstream progress_oss;
+        progress_oss << "Single pass: Nodes " << m_processed_nodes
+                     << " | Ways " << m_processed_ways
+                     << " | Relations " << m_processed_relations
+                     << " | Wrote " << m_written_ways << "w";
+        if (m_extract_addresses) {
+            progress_oss << " | Addr " << m_addresses_found;
+        }
+        progress_oss << " | " << std::fixed << std::setprecision(0) << nodes_per_sec << " nodes/s"
+                     << " | " << elapsed_sec << "s";
+        print_progress_line(progress_oss.str());
+    }
+    
+public:
+    SinglePassHandler(std::ostream* csv_file, osmium::io::Writer* ways_writer, bool routable_only, bool extract_addresses)
+        : m_csv_file(csv_file)
+        , m_ways_writer(ways_writer)
+        , m_routable_only(routable_only)
+        , m_extract_addresses(extract_addresses)
+        , m_start_time(std::chrono::steady_clock::now())
+        , m_last_progress_time(m_start_time) {
+    }
+    
+    void node(const osmium::Node& node) {
+        m_processed_nodes++;
+        
+        if (m_extract_addresses && has_address_or_building_tags(node.tags()) && node.location().valid()) {
+            Address addr = extract_address_data(node);
+            if (addr.lat != 0.0 || addr.lon != 0.0) {
+                write_address_csv(m_csv_file, addr);
+                m_addresses_found++;
+            }
+        }
+        
+        if (m_processed_nodes % 10000 == 0) {
+            update_progress();
+        }
+    }
+    
+    void way(const osmium::Way& way) {
+        m_processed_ways++;
+        
+        if (m_extract_addresses && write_way_address_csv(m_csv_file, way)) {
+            m_addresses_found++;
+        }
+        
+        // Keep ways: by default include routable ways + ferry/highway, or only routable if flag is set
+        if (m_ways_writer) {
+            bool should_include = RoutableWays::is_routable_way(way.tags());
+            if (!m_routable_only && !should_include) {
+                should_include = is_ferry_or_highway(way.tags());
+            }
+            if (should_include) {
+                for (const auto& node_ref : way.nodes()) {
+                    m_nodes_needed.insert(static_cast<osmium::object_id_type>(node_ref.ref()));
+                }
+                (*m_ways_writer)(way);
+                m_written_ways++;
+            }
+        }
+        
+        if (m_processed_ways % 1000 == 0) {
+            update_progress();
+        }
+    }
+    
+    void relation(const osmium::Relation& relation) {
+        m_processed_relations++;
+        
+        // Outer ways of address relations, for the second read
+        if (m_extract_addresses && has_address_or_building_tags(relation.tags())) {
+            m_address_relations++;
             for (const auto& member : relation.members()) {
                 if (member.type() == osmium::item_type::way && 
                     std::strcmp(member.role(), "outer") == 0) {
-                    osmium::unsigned_object_id_type way_id = static_cast<osmium::unsigned_object_id_type>(member.ref());
-                    
-                    try {
-                        osmium::Location centroid = m_way_centroids.get(way_id);
-                        uint32_t node_count = m_way_node_counts.get(way_id);
-                        
-                        if (centroid.valid() && node_count > 0) {
-                            way_centroids.push_back(centroid);
-                            way_node_counts.push_back(node_count);
-                        }
-                    } catch (...) {
-                        // Way centroid not found, skip this way
-                    }
-                }
-            }
-            
-            if (!way_centroids.empty()) {
-                // Compute weighted centroid: sum(centroid * node_count) / sum(node_count)
-                double sum_lat = 0.0;
-                double sum_lon = 0.0;
-                uint64_t total_nodes = 0;
-                
-                for (size_t i = 0; i < way_centroids.size(); ++i) {
-                    if (way_centroids[i].valid()) {
-                        sum_lat += way_centroids[i].lat() * way_node_counts[i];
-                        sum_lon += way_centroids[i].lon() * way_node_counts[i];
-                        total_nodes += way_node_counts[i];
-                    }
-                }
-                
-                if (total_nodes > 0) {
-                    // osmium::Location constructor takes (lon, lat), not (lat, lon)
-                    osmium::Location weighted_centroid(sum_lon / total_nodes, sum_lat / total_nodes);
-                    std::vector<osmium::Location> outer_ring_locations;
-                    outer_ring_locations.push_back(weighted_centroid);
-                    
-                    Address addr = extract_address_data_from_relation(relation, outer_ring_locations);
-                    if (addr.lat != 0.0 || addr.lon != 0.0) {
-                        write_address_csv(m_csv_file, addr);
-                        m_addresses_found++;
-                    }
+                    m_relation_way_ids.insert(static_cast<osmium::object_id_type>(member.ref()));
                 }
             }
         }
@@ -786,44 +979,257 @@ public:
     }
     
     // Getters
+    const ankerl::unordered_dense::set<osmium::object_id_type>& nodes_needed() const { return m_nodes_needed; }
+    const ankerl::unordered_dense::set<osmium::object_id_type>& relation_way_ids() const { return m_relation_way_ids; }
     uint64_t processed_nodes() const { return m_processed_nodes; }
     uint64_t processed_ways() const { return m_processed_ways; }
     uint64_t processed_relations() const { return m_processed_relations; }
     uint64_t written_ways() const { return m_written_ways; }
-    uint64_t written_nodes() const { return m_written_nodes; }
     uint64_t addresses_found() const { return m_addresses_found; }
+    uint64_t address_relations() const { return m_address_relations; }
     std::chrono::steady_clock::time_point start_time() const { return m_start_time; }
     
     void finalize_progress() {
+        m_last_progress_time = std::chrono::steady_clock::time_point();
         update_progress();
         std::cout << "\n";
-        // Report memory usage at end of pass 2
         MemoryStats mem = MemoryStats::get_current();
-        std::cout << "Pass 2 memory: RSS=" << mem.format() << ", Peak=" << mem.format_peak() << "\n";
+        std::cout << "Single pass memory: RSS=" << mem.format() << ", Peak=" << mem.format_peak() << "\n";
     }
 };
 
-void compress_csv(const std::string& input_file, const std::string& output_file) {
-    std::ifstream in(input_file, std::ios::binary);
-    if (!in) {
-        throw std::runtime_error("Failed to open CSV file for compression: " + input_file);
+// Second read of the single-pass mode (ways and relations only): addresses of relations
+class RelationAddressHandler : public osmium::handler::Handler {
+private:
+    RelationAddressCollector m_relation_addresses;
+    std::ostream* m_csv_file;
+    uint64_t m_addresses_found = 0;
+    
+public:
+    RelationAddressHandler(const ankerl::unordered_dense::set<osmium::object_id_type>& relation_way_ids,
+                           std::ostream* csv_file)
+        : m_relation_addresses(relation_way_ids)
+        , m_csv_file(csv_file) {
     }
     
-    gzFile out = gzopen(output_file.c_str(), "wb");
-    if (!out) {
-        throw std::runtime_error("Failed to open output file for compression: " + output_file);
+    void way(const osmium::Way& way) {
+        m_relation_addresses.way(way);
     }
     
-    char buffer[8192];
-    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
-        int written = gzwrite(out, buffer, static_cast<unsigned>(in.gcount()));
-        if (written == 0) {
-            gzclose(out);
-            throw std::runtime_error("Failed to write compressed data");
+    void relation(const osmium::Relation& relation) {
+        if (!has_address_or_building_tags(relation.tags())) {
+            return;
+        }
+        Address addr;
+        if (m_relation_addresses.extract(relation, addr) && (addr.lat != 0.0 || addr.lon != 0.0)) {
+            write_address_csv(m_csv_file, addr);
+            m_addresses_found++;
         }
     }
     
-    gzclose(out);
+    uint64_t addresses_found() const { return m_addresses_found; }
+};
+
+// Write minimal nodes (id and location) of the needed ids in id order; returns the count
+uint64_t write_needed_nodes(const ankerl::unordered_dense::set<osmium::object_id_type>& nodes_needed,
+                            const LocationIndex& index,
+                            osmium::io::Writer& writer) {
+    constexpr size_t BUFFER_BYTES = 1024 * 1024;
+    
+    std::vector<osmium::object_id_type> ids(nodes_needed.begin(), nodes_needed.end());
+    std::sort(ids.begin(), ids.end());
+    
+    uint64_t written = 0;
+    osmium::memory::Buffer buffer(BUFFER_BYTES, osmium::memory::Buffer::auto_grow::yes);
+    for (osmium::object_id_type id : ids) {
+        // Only nodes with valid locations (matching the two-pass mode)
+        osmium::Location location = index.get_noexcept(static_cast<osmium::unsigned_object_id_type>(id));
+        if (!location.valid()) {
+            continue;
+        }
+        {
+            osmium::builder::NodeBuilder builder(buffer);
+            builder.set_id(id);
+            builder.set_location(location);
+        }
+        buffer.commit();
+        written++;
+        if (buffer.committed() >= BUFFER_BYTES) {
+            writer(std::move(buffer));
+            buffer = osmium::memory::Buffer(BUFFER_BYTES, osmium::memory::Buffer::auto_grow::yes);
+        }
+    }
+    if (buffer.committed() > 0) {
+        writer(std::move(buffer));
+    }
+    return written;
+}
+
+// Totals of a run, from either mode
+struct RunStats {
+    std::chrono::steady_clock::time_point start_time;
+    uint64_t processed_nodes = 0;
+    uint64_t processed_ways = 0;
+    uint64_t processed_relations = 0;
+    uint64_t written_nodes = 0;
+    uint64_t written_ways = 0;
+    uint64_t pass1_addresses = 0;  // Found in the first read
+    uint64_t pass2_addresses = 0;  // Found in the second read, if there was one
+};
+
+// Read the input once, plus ways and relations a second time only when address relations need
+// way centroids. output_file empty skips the OSM output, csv_file null skips addresses.
+RunStats run_single_pass(const std::string& input_file, const std::string& output_file, std::ostream* csv_file,
+                         bool routable_only, const std::string& index_type) {
+    const bool extract_osm = !output_file.empty();
+    const bool extract_addresses = csv_file != nullptr;
+    
+    std::cout << "Node location index: " << index_type << "\n";
+    const auto& map_factory = osmium::index::MapFactory<osmium::unsigned_object_id_type, osmium::Location>::instance();
+    std::unique_ptr<LocationIndex> index = map_factory.create_map(index_type);
+    osmium::handler::NodeLocationsForWays<LocationIndex> location_handler(*index);
+    location_handler.ignore_errors();
+    
+    // Routable ways wait in a temporary file until their nodes are written
+    const std::string temp_ways_file = output_file + ".ways-tmp.osm.pbf";
+    std::unique_ptr<osmium::io::Writer> ways_writer;
+    if (extract_osm) {
+        ways_writer = std::make_unique<osmium::io::Writer>(temp_ways_file, osmium::io::overwrite::allow);
+    }
+    
+    RunStats stats;
+    std::cout << "\nSingle pass: extracting addresses/buildings and routable ways...\n";
+    SinglePassHandler handler(csv_file, ways_writer.get(), routable_only, extract_addresses);
+    stats.start_time = handler.start_time();
+    try {
+        osmium::io::Reader reader(input_file);
+        osmium::apply(reader, location_handler, handler);
+        reader.close();
+    } catch (...) {
+        ways_writer.reset();
+        std::error_code ec;
+        fs::remove(temp_ways_file, ec);
+        throw;
+    }
+    handler.finalize_progress();
+    stats.processed_nodes = handler.processed_nodes();
+    stats.processed_ways = handler.processed_ways();
+    stats.processed_relations = handler.processed_relations();
+    stats.written_ways = handler.written_ways();
+    stats.pass1_addresses = handler.addresses_found();
+    
+    if (extract_osm) {
+        ways_writer->close();
+        std::cout << "Writing " << handler.nodes_needed().size() << " nodes and "
+                  << handler.written_ways() << " routable ways...\n";
+        osmium::io::Writer writer(output_file);
+        stats.written_nodes = write_needed_nodes(handler.nodes_needed(), *index, writer);
+        {
+            osmium::io::Reader ways_reader(temp_ways_file, osmium::osm_entity_bits::way);
+            while (osmium::memory::Buffer buffer = ways_reader.read()) {
+                writer(std::move(buffer));
+            }
+            ways_reader.close();
+        }
+        writer.close();
+        fs::remove(temp_ways_file);
+    }
+    
+    if (extract_addresses && !handler.relation_way_ids().empty()) {
+        std::cout << "\nReading ways and relations again for " << handler.address_relations()
+                  << " address relations...\n";
+        osmium::io::Reader reader(input_file, osmium::osm_entity_bits::way | osmium::osm_entity_bits::relation);
+        RelationAddressHandler relation_handler(handler.relation_way_ids(), csv_file);
+        osmium::apply(reader, location_handler, relation_handler);
+        reader.close();
+        stats.pass2_addresses = relation_handler.addresses_found();
+    }
+    
+    return stats;
+}
+
+// Read the input twice: node ids of routable ways first, then the nodes and ways themselves
+RunStats run_two_pass(const std::string& input_file, const std::string& output_file, std::ostream* csv_file,
+                      uint64_t file_size, bool routable_only) {
+    const bool extract_osm = !output_file.empty();
+    const bool extract_addresses = csv_file != nullptr;
+    
+    // ===== PASS 1: Collect node IDs and extract addresses/buildings =====
+    std::string pass1_desc = extract_osm ? "\nPass 1/2: Collecting node IDs from routable ways and extracting addresses/buildings...\n" 
+                                         : "\nPass 1/1: Extracting addresses/buildings...\n";
+    std::cout << pass1_desc;
+    osmium::io::Reader reader1(input_file);
+    Pass1Handler pass1_handler(csv_file, file_size, routable_only, extract_addresses);
+    osmium::apply(reader1, pass1_handler);
+    reader1.close();
+    pass1_handler.finalize_progress();
+    
+    if (extract_osm) {
+        std::cout << "Pass 1 complete. Found " << pass1_handler.nodes_needed().size()
+                  << " nodes needed for routable ways.\n";
+    }
+    
+    if (extract_addresses) {
+        std::cout << "Pass 1 complete. Found " << pass1_handler.addresses_found()
+                  << " addresses/buildings.\n";
+    }
+    
+    RunStats stats;
+    stats.start_time = pass1_handler.start_time();
+    stats.processed_nodes = pass1_handler.processed_nodes();
+    stats.processed_ways = pass1_handler.processed_ways();
+    stats.processed_relations = pass1_handler.processed_relations();
+    stats.pass1_addresses = pass1_handler.addresses_found();
+    
+    // ===== PASS 2: Write nodes and ways, extract addresses from ways/relations =====
+    if (extract_osm || extract_addresses) {
+        std::cout << "\nPass 2/2: Writing nodes and routable ways";
+        if (extract_addresses) {
+            std::cout << " and extracting addresses from ways/relations";
+        }
+        std::cout << "...\n";
+        osmium::io::Reader reader2(input_file);
+        osmium::io::Writer* writer = nullptr;
+        std::unique_ptr<osmium::io::Writer> writer_ptr;
+        if (extract_osm) {
+            writer_ptr = std::make_unique<osmium::io::Writer>(output_file);
+            writer = writer_ptr.get();
+        }
+        Pass2Handler handler(pass1_handler.nodes_needed(), 
+                            pass1_handler.relation_way_ids(),
+                            writer,
+                            csv_file,
+                            file_size,
+                            routable_only,
+                            extract_addresses);
+        
+        // Always use NodeLocationsForWays when extracting addresses (needed for way centroids)
+        if (extract_addresses) {
+            using index_type = osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, osmium::Location>;
+            index_type index;
+            osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+            location_handler.ignore_errors();
+            osmium::apply(reader2, location_handler, handler);
+        } else {
+            osmium::apply(reader2, handler);
+        }
+        reader2.close();
+        if (writer_ptr) {
+            writer_ptr->close();
+        }
+        handler.finalize_progress();
+        stats.written_nodes = handler.written_nodes();
+        stats.written_ways = handler.written_ways();
+        stats.pass2_addresses = handler.addresses_found();
+        
+        if (extract_osm) {
+            // Debug: Check if we wrote all expected nodes
+            std::cout << "Debug: Expected " << pass1_handler.nodes_needed().size() 
+                      << " nodes, wrote " << handler.written_nodes() << " nodes\n";
+        }
+    }
+    
+    return stats;
 }
 
 std::string get_default_output_name(const std::string& input_file) {
@@ -839,7 +1245,7 @@ std::string get_default_output_name(const std::string& input_file) {
     return (input_path.parent_path() / (stem + ".ways.osm.pbf")).string();
 }
 
-std::string get_default_csv_name(const std::string& input_file) {
+std::string get_default_csv_name(const std::string& input_file, CompressedOutput::Format format) {
     fs::path input_path(input_file);
     std::string stem = input_path.stem().string();
     
@@ -849,12 +1255,12 @@ std::string get_default_csv_name(const std::string& input_file) {
         stem = stem.substr(0, pos);
     }
     
-    return (input_path.parent_path() / (stem + ".addresses.csv.gz")).string();
+    return (input_path.parent_path() / (stem + ".addresses.csv" + CompressedOutput::format_extension(format))).string();
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> [--output <osm_file>] [--output-dir <dir>] [--routable-only] [--addresses-only] [--osm-only]\n";
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--output <osm_file>] [--output-dir <dir>] [--routable-only] [--addresses-only] [--osm-only] [--compression gzip|zstd|none] [--threads <n>] [--single-pass] [--index auto|dense|sparse]\n";
         return 1;
     }
     
@@ -864,6 +1270,10 @@ int main(int argc, char* argv[]) {
     bool routable_only = false;
     bool addresses_only = false;
     bool osm_only = false;
+    CompressedOutput::Format csv_format = CompressedOutput::Format::Gzip;
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool single_pass = false;
+    std::string index_mode = "auto";
     
     // Parse command line arguments
     for (int i = 2; i < argc; i++) {
@@ -888,9 +1298,38 @@ int main(int argc, char* argv[]) {
             addresses_only = true;
         } else if (arg == "--osm-only") {
             osm_only = true;
+        } else if (arg == "--single-pass") {
+            single_pass = true;
+        } else if (arg == "--index" && i + 1 < argc) {
+            index_mode = argv[++i];
+            if (index_mode != "auto" && index_mode != "dense" && index_mode != "sparse") {
+                std::cerr << "Error: --index must be auto, dense or sparse\n";
+                return 1;
+            }
+        } else if ((arg == "--compression" || arg == "--threads") && i + 1 < argc) {
+            std::string value = argv[++i];
+            try {
+                if (arg == "--compression") {
+                    csv_format = CompressedOutput::parse_format(value);
+                } else {
+                    num_threads = static_cast<unsigned int>(std::stoul(value));
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid value for " << arg << ": " << value << "\n";
+                return 1;
+            }
+            if (num_threads == 0) {
+                std::cerr << "Error: --threads must be at least 1\n";
+                return 1;
+            }
         }
     }
     
+    if (csv_format == CompressedOutput::Format::Zstd && !CompressedOutput::zstd_available()) {
+        std::cerr << "Error: This build has no zstd support\n";
+        return 1;
+    }
+    
     // Validate mutually exclusive options
     if (addresses_only && osm_only) {
         std::cerr << "Error: --addresses-only and --osm-only are mutually exclusive\n";
@@ -908,7 +1347,7 @@ int main(int argc, char* argv[]) {
     fs::path input_path(input_file);
     fs::path csv_output_path;
     if (output_dir.empty()) {
-        csv_output_path = fs::path(get_default_csv_name(input_file));
+        csv_output_path = fs::path(get_default_csv_name(input_file, csv_format));
     } else {
         fs::path output_dir_path(output_dir);
         fs::create_directories(output_dir_path);
@@ -918,7 +1357,7 @@ int main(int argc, char* argv[]) {
         if (pos != std::string::npos) {
             stem = stem.substr(0, pos);
         }
-        csv_output_path = output_dir_path / (stem + ".addresses.csv.gz");
+        csv_output_path = output_dir_path / (stem + ".addresses.csv" + CompressedOutput::format_extension(csv_format));
     }
     
     // Get file size
@@ -950,110 +1389,42 @@ int main(int argc, char* argv[]) {
         fs::remove(csv_output_path);
     }
     
-    // Create temporary CSV file (only if extracting addresses)
-    fs::path temp_csv;
-    std::ofstream csv_file;
+    // Open the addresses CSV (only if extracting addresses); it is compressed in blocks as it is written
+    std::unique_ptr<CompressedOutput::CompressedWriter> csv_file;
     if (extract_addresses) {
-        temp_csv = fs::temp_directory_path() / ("addresses_" + std::to_string(std::time(nullptr)) + ".csv");
-        csv_file.open(temp_csv);
-        if (!csv_file) {
-            std::cerr << "Error: Failed to open temporary CSV file\n";
+        try {
+            csv_file = std::make_unique<CompressedOutput::CompressedWriter>(csv_output_path.string(), csv_format, num_threads);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
             return 1;
         }
         
         // Write CSV header
-        csv_file << "id,is_building,is_addr,is_relation,is_node,is_way,lat,lon,city,tags\n";
+        *csv_file << "id,is_building,is_addr,is_relation,is_node,is_way,lat,lon,city,tags\n";
     }
     
-    std::cout << "Processing ways and extracting addresses/buildings (two-pass approach)...\n";
+    std::cout << "Processing ways and extracting addresses/buildings ("
+              << (single_pass ? "single-pass" : "two-pass") << " approach)...\n";
     
     // Ensure stdout is unbuffered for proper line overwriting
     std::cout.setf(std::ios::unitbuf);
     
     try {
-        // ===== PASS 1: Collect node IDs and extract addresses/buildings =====
-        std::string pass1_desc = extract_osm ? "\nPass 1/2: Collecting node IDs from routable ways and extracting addresses/buildings...\n" 
-                                             : "\nPass 1/1: Extracting addresses/buildings...\n";
-        std::cout << pass1_desc;
-        osmium::io::Reader reader1(input_file);
-        Pass1Handler pass1_handler(extract_addresses ? &csv_file : nullptr, file_size, routable_only, extract_addresses);
-        osmium::apply(reader1, pass1_handler);
-        reader1.close();
-        pass1_handler.finalize_progress();
-        
-        if (extract_osm) {
-            std::cout << "Pass 1 complete. Found " << pass1_handler.nodes_needed().size()
-                      << " nodes needed for routable ways.\n";
-        }
-        
-        if (extract_addresses) {
-            std::cout << "Pass 1 complete. Found " << pass1_handler.addresses_found()
-                      << " addresses/buildings.\n";
-        }
-        
-        // ===== PASS 2: Write nodes and ways, extract addresses from ways/relations =====
-        Pass2Handler* pass2_handler = nullptr;
-        if (extract_osm || extract_addresses) {
-            std::cout << "\nPass 2/2: Writing nodes and routable ways";
-            if (extract_addresses) {
-                std::cout << " and extracting addresses from ways/relations";
-            }
-            std::cout << "...\n";
-            osmium::io::Reader reader2(input_file);
-            osmium::io::Writer* writer = nullptr;
-            std::unique_ptr<osmium::io::Writer> writer_ptr;
-            if (extract_osm) {
-                writer_ptr = std::make_unique<osmium::io::Writer>(output_file);
-                writer = writer_ptr.get();
-            }
-            Pass2Handler handler(pass1_handler.nodes_needed(), 
-                                pass1_handler.relation_way_ids(),
-                                writer,
-                                extract_addresses ? &csv_file : nullptr,
-                                file_size,
-                                routable_only,
-                                extract_addresses);
-            pass2_handler = &handler;
-            
-            // Always use NodeLocationsForWays when extracting addresses (needed for way centroids)
-            if (extract_addresses) {
-                using index_type = osmium::index::map::SparseFileArray<osmium::unsigned_object_id_type, osmium::Location>;
-                index_type index;
-                osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
-                location_handler.ignore_errors();
-                osmium::apply(reader2, location_handler, handler);
-            } else {
-                osmium::apply(reader2, handler);
-            }
-            reader2.close();
-            if (writer_ptr) {
-                writer_ptr->close();
-            }
-            handler.finalize_progress();
-            
-            if (extract_osm) {
-                // Debug: Check if we wrote all expected nodes
-                std::cout << "Debug: Expected " << pass1_handler.nodes_needed().size() 
-                          << " nodes, wrote " << handler.written_nodes() << " nodes\n";
-            }
-        }
+        RunStats stats = single_pass
+            ? run_single_pass(input_file, extract_osm ? output_file : std::string(), csv_file.get(),
+                              routable_only, location_index_type(index_mode, file_size))
+            : run_two_pass(input_file, extract_osm ? output_file : std::string(), csv_file.get(),
+                           file_size, routable_only);
         
-        if (extract_addresses) {
-            csv_file.close();
-            
-            // Compress CSV file
-            std::cout << "\nCompressing addresses CSV...\n";
-            compress_csv(temp_csv.string(), csv_output_path.string());
-            
-            // Remove temporary CSV
-            fs::remove(temp_csv);
+        if (csv_file) {
+            csv_file->close();
         }
         
         // Calculate final statistics (total time from pass 1 start)
         auto final_time = std::chrono::steady_clock::now();
-        auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(final_time - pass1_handler.start_time());
+        auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(final_time - stats.start_time);
         int64_t total_seconds = total_elapsed.count();
-        double nodes_per_sec = total_seconds > 0 ? static_cast<double>(pass1_handler.processed_nodes()) / static_cast<double>(total_seconds) : 0.0;
+        double nodes_per_sec = total_seconds > 0 ? static_cast<double>(stats.processed_nodes) / static_cast<double>(total_seconds) : 0.0;
         
         // Format total time as hh:mm:ss (e.g., 10s, 4m2s, 1h21m3s)
         int64_t hours = total_seconds / 3600;
@@ -1071,27 +1442,24 @@ int main(int argc, char* argv[]) {
         
         // Print statistics
         std::cout << "\nProcessing complete!\n";
-        std::cout << "Processed: " << pass1_handler.processed_nodes() << " nodes, " 
-                  << pass1_handler.processed_ways() << " ways";
-        if (pass1_handler.processed_relations() > 0) {
-            std::cout << ", " << pass1_handler.processed_relations() << " relations";
+        std::cout << "Processed: " << stats.processed_nodes << " nodes, " 
+                  << stats.processed_ways << " ways";
+        if (stats.processed_relations > 0) {
+            std::cout << ", " << stats.processed_relations << " relations";
         }
         std::cout << "\n";
         
-        if (extract_osm && pass2_handler) {
-            std::cout << "Written: " << pass2_handler->written_ways() << " ways, " 
-                      << pass2_handler->written_nodes() << " nodes\n";
+        if (extract_osm) {
+            std::cout << "Written: " << stats.written_ways << " ways, " 
+                      << stats.written_nodes << " nodes\n";
         }
         
         if (extract_addresses) {
-            uint64_t total_addresses = pass1_handler.addresses_found();
-            if (pass2_handler) {
-                total_addresses += pass2_handler->addresses_found();
-            }
+            uint64_t total_addresses = stats.pass1_addresses + stats.pass2_addresses;
             std::cout << "Found: " << total_addresses << " addresses/buildings";
-            if (pass2_handler && pass2_handler->addresses_found() > 0) {
-                std::cout << " (Pass1: " << pass1_handler.addresses_found() 
-                          << ", Pass2: " << pass2_handler->addresses_found() << ")";
+            if (stats.pass2_addresses > 0) {
+                std::cout << " (Pass1: " << stats.pass1_addresses 
+                          << ", Pass2: " << stats.pass2_addresses << ")";
             }
             std::cout << "\n";
         }
@@ -1121,8 +1489,9 @@ int main(int argc, char* argv[]) {
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
-        if (fs::exists(temp_csv)) {
-            fs::remove(temp_csv);
+        if (csv_file) {
+            csv_file.reset();
+            fs::remove(csv_output_path);
         }
         return 1;
     }
@@ -0,0 +1,397 @@
+// Replays a request mix against a running routing server over keep-alive HTTP connections and
+// reports throughput and latency percentiles for each client thread count.
+//
+// Requests come from a file (one request target per line, or server log lines, whose
+// "request: <url>" part is used) or are generated around a center coordinate.
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string requests_file;
+    size_t generate = 0;
+    double center_lat = 52.0907; // Utrecht, the default extract
+    double center_lon = 5.1214;
+    double radius_km = 8.0;
+    unsigned seed = 42;
+    std::vector<unsigned> thread_counts = {1, 2, 4, 8};
+    double duration_s = 10.0;
+    double warmup_s = 2.0;
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " (--requests FILE | --generate N) [options]\n"
+              << "  --requests FILE     Request targets (/api/v1/...) or server log lines, one per line\n"
+              << "  --generate N        Generate N requests: 30% closest_address, 20% annulus sampling,\n"
+              << "                      50% complete_job_route (half of them metadata only)\n"
+              << "  --center LAT,LON    Center of generated coordinates (default 52.0907,5.1214)\n"
+              << "  --radius-km R       Radius of generated coordinates (default 8)\n"
+              << "  --seed S            Seed for generated requests (default 42)\n"
+              << "  --host HOST         Server host (default 127.0.0.1)\n"
+              << "  --port PORT         Server port (default 8080)\n"
+              << "  --threads LIST      Client thread counts, comma separated (default 1,2,4,8)\n"
+              << "  --duration S        Measured seconds per thread count (default 10)\n"
+              << "  --warmup S          Unmeasured seconds before each run (default 2)\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--requests") {
+                options.requests_file = value;
+            } else if (arg == "--generate") {
+                options.generate = std::stoul(value);
+            } else if (arg == "--center") {
+                size_t comma = value.find(',');
+                if (comma == std::string::npos) {
+                    return false;
+                }
+                options.center_lat = std::stod(value.substr(0, comma));
+                options.center_lon = std::stod(value.substr(comma + 1));
+            } else if (arg == "--radius-km") {
+                options.radius_km = std::stod(value);
+            } else if (arg == "--seed") {
+                options.seed = std::stoul(value);
+            } else if (arg == "--host") {
+                options.host = value;
+            } else if (arg == "--port") {
+                options.port = value;
+            } else if (arg == "--threads") {
+                options.thread_counts.clear();
+                std::stringstream list(value);
+                std::string item;
+                while (std::getline(list, item, ',')) {
+                    options.thread_counts.push_back(std::max(1u, static_cast<unsigned>(std::stoul(item))));
+                }
+            } else if (arg == "--duration") {
+                options.duration_s = std::stod(value);
+            } else if (arg == "--warmup") {
+                options.warmup_s = std::stod(value);
+            } else {
+                return false;
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return (!options.requests_file.empty() || options.generate > 0) && !options.thread_counts.empty();
+}
+
+std::vector<std::string> loadRequests(const std::string& file) {
+    std::vector<std::string> requests;
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t logged = line.find("request: /");
+        if (logged != std::string::npos) {
+            line = line.substr(logged + 9);
+        }
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] == '/') {
+            requests.push_back(line);
+        }
+    }
+    return requests;
+}
+
+std::vector<std::string> generateRequests(const Options& options) {
+    std::mt19937 gen(options.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double lat_radius = options.radius_km / 111.1;
+    const double lon_radius = lat_radius / std::cos(options.center_lat * 3.14159265358979 / 180.0);
+    auto coordinate = [&]() {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.6f,%.6f",
+                      options.center_lat + (2.0 * unit(gen) - 1.0) * lat_radius,
+                      options.center_lon + (2.0 * unit(gen) - 1.0) * lon_radius);
+        return std::string(buffer);
+    };
+
+    std::vector<std::string> requests;
+    requests.reserve(options.generate);
+    for (size_t i = 0; i < options.generate; ++i) {
+        double kind = unit(gen);
+        if (kind < 0.3) {
+            requests.push_back("/api/v1/closest_address?location=" + coordinate());
+        } else if (kind < 0.5) {
+            std::string center = coordinate();
+            size_t comma = center.find(',');
+            requests.push_back("/api/v1/uniformRandomAddressInAnnulus?lat=" + center.substr(0, comma) +
+                               "&lon=" + center.substr(comma + 1) + "&min_distance=1&max_distance=5&count=10&seed=" +
+                               std::to_string(gen() % 100000));
+        } else {
+            std::string request = "/api/v1/complete_job_route?from=" + coordinate() + "&via=" + coordinate() +
+                                  "&to=" + coordinate();
+            if (kind < 0.75) {
+                request += "&include_path=0";
+            }
+            requests.push_back(request);
+        }
+    }
+    return requests;
+}
+
+// Endpoint of a request target, for the per-endpoint breakdown
+std::string endpointOf(const std::string& target) {
+    return target.substr(0, target.find('?'));
+}
+
+// Blocking keep-alive HTTP/1.1 connection
+class Connection {
+public:
+    Connection(const std::string& host, const std::string& port) : host_(host), port_(port) {}
+    ~Connection() { close(); }
+
+    // Send a GET and read the whole response; returns the status code, or 0 on a connection error
+    int get(const std::string& target) {
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            if (fd_ < 0 && !connect()) {
+                return 0;
+            }
+            std::string request = "GET " + target + " HTTP/1.1\r\nHost: " + host_ +
+                                  "\r\nAccept-Encoding: gzip\r\nConnection: keep-alive\r\n\r\n";
+            int status = 0;
+            if (sendAll(request) && readResponse(status)) {
+                return status;
+            }
+            // The server may have closed an idle connection; retry once on a fresh one
+            close();
+        }
+        return 0;
+    }
+
+private:
+    bool connect() {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses) != 0) {
+            return false;
+        }
+        for (addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+            fd_ = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd_ >= 0 && ::connect(fd_, address->ai_addr, address->ai_addrlen) == 0) {
+                int no_delay = 1;
+                setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+                break;
+            }
+            close();
+        }
+        freeaddrinfo(addresses);
+        buffer_.clear();
+        return fd_ >= 0;
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    bool sendAll(const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool fill() {
+        char chunk[65536];
+        ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    bool readResponse(int& status) {
+        size_t header_end;
+        while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        std::string headers = buffer_.substr(0, header_end);
+        for (char& c : headers) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        if (headers.compare(0, 5, "http/") != 0 || headers.size() < 12) {
+            return false;
+        }
+        status = std::atoi(headers.c_str() + 9);
+
+        size_t length_pos = headers.find("\r\ncontent-length:");
+        bool keep_alive = headers.find("\r\nconnection: close") == std::string::npos;
+        size_t body_start = header_end + 4;
+        if (length_pos == std::string::npos) {
+            // No length: the body ends with the connection
+            while (fill()) {
+            }
+            buffer_.clear();
+            close();
+            return true;
+        }
+        size_t content_length = std::strtoul(headers.c_str() + length_pos + 17, nullptr, 10);
+        while (buffer_.size() < body_start + content_length) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        buffer_.erase(0, body_start + content_length);
+        if (!keep_alive) {
+            close();
+        }
+        return true;
+    }
+
+    std::string host_;
+    std::string port_;
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+// Latencies of successful requests and count of failed ones, per endpoint
+struct EndpointResult {
+    std::vector<uint32_t> latencies_us;
+    size_t errors = 0;
+};
+
+double percentileMs(const std::vector<uint32_t>& sorted, double percentile) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(percentile / 100.0 * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+void printRow(const std::string& label, const std::vector<uint32_t>& sorted, size_t errors, double seconds) {
+    std::printf("  %-40s %9zu %7zu %10.1f %8.2f %8.2f %8.2f %8.2f %8.2f\n", label.c_str(), sorted.size(), errors,
+                sorted.size() / seconds, percentileMs(sorted, 50), percentileMs(sorted, 90), percentileMs(sorted, 99),
+                percentileMs(sorted, 99.9), sorted.empty() ? 0.0 : sorted.back() / 1000.0);
+}
+
+void runLoad(const Options& options, const std::vector<std::string>& requests, unsigned thread_count) {
+    using Clock = std::chrono::steady_clock;
+    std::atomic<bool> measuring{false};
+    std::atomic<bool> stop{false};
+    std::vector<std::map<std::string, EndpointResult>> results(thread_count);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            Connection connection(options.host, options.port);
+            // Threads start at different offsets so they do not all send the same request at once
+            size_t next = (requests.size() * t) / thread_count;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const std::string& target = requests[next];
+                next = (next + 1) % requests.size();
+                auto start = Clock::now();
+                int status = connection.get(target);
+                auto end = Clock::now();
+                if (!measuring.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                EndpointResult& result = results[t][endpointOf(target)];
+                if (status < 200 || status >= 300) {
+                    ++result.errors;
+                    continue;
+                }
+                result.latencies_us.push_back(static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.warmup_s));
+    measuring = true;
+    auto measure_start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration_s));
+    measuring = false;
+    double seconds = std::chrono::duration<double>(Clock::now() - measure_start).count();
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::map<std::string, EndpointResult> by_endpoint;
+    EndpointResult all;
+    for (const auto& thread_results : results) {
+        for (const auto& [endpoint, result] : thread_results) {
+            EndpointResult& merged = by_endpoint[endpoint];
+            merged.latencies_us.insert(merged.latencies_us.end(), result.latencies_us.begin(), result.latencies_us.end());
+            merged.errors += result.errors;
+            all.latencies_us.insert(all.latencies_us.end(), result.latencies_us.begin(), result.latencies_us.end());
+            all.errors += result.errors;
+        }
+    }
+
+    std::printf("threads=%u\n", thread_count);
+    std::sort(all.latencies_us.begin(), all.latencies_us.end());
+    printRow("all", all.latencies_us, all.errors, seconds);
+    for (auto& [endpoint, result] : by_endpoint) {
+        std::sort(result.latencies_us.begin(), result.latencies_us.end());
+        printRow(endpoint, result.latencies_us, result.errors, seconds);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> requests = options.requests_file.empty() ? generateRequests(options)
+                                                                      : loadRequests(options.requests_file);
+    if (requests.empty()) {
+        std::cerr << "No requests to replay" << std::endl;
+        return 1;
+    }
+    std::printf("Replaying %zu requests against %s:%s, %.1f s per run after %.1f s warmup\n", requests.size(),
+                options.host.c_str(), options.port.c_str(), options.duration_s, options.warmup_s);
+    std::printf("  %-40s %9s %7s %10s %8s %8s %8s %8s %8s\n", "endpoint", "requests", "errors", "req/s",
+                "p50_ms", "p90_ms", "p99_ms", "p99.9_ms", "max_ms");
+    for (unsigned thread_count : options.thread_counts) {
+        runLoad(options, requests, thread_count);
+    }
+    return 0;
+}
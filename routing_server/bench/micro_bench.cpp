@@ -0,0 +1,231 @@
+// Micro-benchmarks of the stages of a route request on a fixed extract:
+// CH query, path expansion, JSON serialization and gzip compression.
+//
+// ROUTING_BENCH_OSM_FILE names the PBF file; the graph snapshot and CH files next to it are
+// used (or written) the same way the server does on startup. ROUTING_BENCH_ADDRESSES_FILE
+// optionally adds an address file for the reachability benchmark.
+
+#include "../include/EngineHolder.h"
+#include "../include/JsonBuilder.h"
+#include "../include/JsonWriter.h"
+#include "../include/ResponseEncoder.h"
+#include "../include/RouteCodec.h"
+#include "../include/RoutingEngine.h"
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace RoutingServer;
+
+namespace {
+
+constexpr size_t SAMPLE_ROUTES = 256;
+
+// Engine and a fixed sample of routes, built once for all benchmarks
+struct Fixture {
+    std::shared_ptr<RoutingEngine> engine;
+    std::vector<std::pair<unsigned, unsigned>> node_pairs; // Pairs with a route between them
+    std::vector<RoutingResult> routes;
+    std::vector<std::vector<RoutePoint>> route_points;
+    std::string error;
+};
+
+const Fixture& fixture() {
+    static const Fixture instance = []() {
+        Fixture f;
+        const char* osm_file = std::getenv("ROUTING_BENCH_OSM_FILE");
+        if (osm_file == nullptr || *osm_file == '\0') {
+            f.error = "Set ROUTING_BENCH_OSM_FILE to the PBF file to benchmark on";
+            return f;
+        }
+        EngineConfig config;
+        config.osm_file = osm_file;
+        const char* addresses_file = std::getenv("ROUTING_BENCH_ADDRESSES_FILE");
+        if (addresses_file != nullptr) {
+            config.addresses_file = addresses_file;
+        }
+        f.engine = EngineHolder::build(config, false);
+
+        // Seeded so every run measures the same routes
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<unsigned> node(0, f.engine->getNodeCount() - 1);
+        for (size_t attempt = 0; attempt < 16 * SAMPLE_ROUTES && f.routes.size() < SAMPLE_ROUTES; ++attempt) {
+            unsigned from = node(gen);
+            unsigned to = node(gen);
+            RoutingResult result = f.engine->computeShortestPath(from, to);
+            if (result.success && !result.arc_path.empty()) {
+                f.node_pairs.emplace_back(from, to);
+                f.route_points.push_back(f.engine->processPathIntoPoints(result));
+                f.routes.push_back(std::move(result));
+            }
+        }
+        if (f.routes.empty()) {
+            f.error = "No routes found between random nodes";
+        }
+        return f;
+    }();
+    return instance;
+}
+
+// Fixture for a benchmark, or null after reporting why it cannot run
+const Fixture* setUp(benchmark::State& state) {
+    const Fixture& f = fixture();
+    if (!f.error.empty()) {
+        state.SkipWithError(f.error.c_str());
+        return nullptr;
+    }
+    return &f;
+}
+
+size_t totalPoints(const Fixture& f) {
+    size_t points = 0;
+    for (const auto& route : f.route_points) {
+        points += route.size();
+    }
+    return points;
+}
+
+// Route JSON of one sample route, written through an encoder
+std::string renderRoute(const Fixture& f, size_t index, ContentEncoding encoding, RouteFormat format) {
+    ResponseEncoder encoder(encoding);
+    {
+        JsonWriter writer(encoder);
+        if (format == RouteFormat::Columnar) {
+            JsonBuilder::writeColumnarRouteResponse(writer, f.routes[index], f.route_points[index]);
+        } else {
+            JsonBuilder::writeRouteResponse(writer, f.routes[index], f.route_points[index]);
+        }
+    }
+    return encoder.finish();
+}
+
+// Args: metric (0 = time, 1 = distance), detail (0 = path, 1 = totals)
+void BM_ComputeShortestPath(benchmark::State& state) {
+    const Fixture* f = setUp(state);
+    if (f == nullptr) {
+        return;
+    }
+    RoutingMetric metric = state.range(0) == 0 ? RoutingMetric::TravelTime : RoutingMetric::GeoDistance;
+    RouteDetail detail = state.range(1) == 0 ? RouteDetail::Path : RouteDetail::Totals;
+    size_t next = 0;
+    for (auto _ : state) {
+        const auto& [from, to] = f->node_pairs[next];
+        next = (next + 1) % f->node_pairs.size();
+        benchmark::DoNotOptimize(f->engine->computeShortestPath(from, to, metric, std::nullopt, detail));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ComputeShortestPath)->ArgNames({"distance", "totals"})->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1});
+
+// Arg: travel time budget in minutes; one PHAST search from a sample route's source per iteration
+void BM_ReachableAddresses(benchmark::State& state) {
+    const Fixture* f = setUp(state);
+    if (f == nullptr) {
+        return;
+    }
+    if (!f->engine->hasReachability()) {
+        state.SkipWithError("Set ROUTING_BENCH_ADDRESSES_FILE (and leave PHAST unset) to benchmark reachability");
+        return;
+    }
+    unsigned max_time_ms = static_cast<unsigned>(state.range(0)) * 60 * 1000;
+    size_t addresses = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        double lat, lon;
+        f->engine->getNodeCoordinates(f->node_pairs[next].first, lat, lon);
+        ReachableResult result = f->engine->computeReachableAddresses(lat, lon, max_time_ms, 1, 42);
+        addresses += result.reachable_count;
+        benchmark::DoNotOptimize(result.addresses.data());
+        next = (next + 1) % f->node_pairs.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["reachable_addresses"] = benchmark::Counter(static_cast<double>(addresses) / state.iterations());
+}
+BENCHMARK(BM_ReachableAddresses)->ArgName("minutes")->Arg(5)->Arg(15)->Arg(60)->Unit(benchmark::kMillisecond);
+
+// Arg: speed cap in km/h (0 = none)
+void BM_ProcessPathIntoPoints(benchmark::State& state) {
+    const Fixture* f = setUp(state);
+    if (f == nullptr) {
+        return;
+    }
+    std::optional<unsigned> max_speed_kmh;
+    if (state.range(0) > 0) {
+        max_speed_kmh = static_cast<unsigned>(state.range(0));
+    }
+    size_t points = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        std::vector<RoutePoint> route_points = f->engine->processPathIntoPoints(f->routes[next], max_speed_kmh);
+        points += route_points.size();
+        benchmark::DoNotOptimize(route_points.data());
+        next = (next + 1) % f->routes.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(points));
+}
+BENCHMARK(BM_ProcessPathIntoPoints)->ArgName("max_speed")->Arg(0)->Arg(25);
+
+// Arg: route format (0 = json, 1 = columnar); uncompressed, so only serialization is measured
+void BM_JsonBuilderRoute(benchmark::State& state) {
+    const Fixture* f = setUp(state);
+    if (f == nullptr) {
+        return;
+    }
+    RouteFormat format = state.range(0) == 0 ? RouteFormat::Json : RouteFormat::Columnar;
+    size_t bytes = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        bytes += renderRoute(*f, next, ContentEncoding::Identity, format).size();
+        next = (next + 1) % f->routes.size();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["points_per_route"] = static_cast<double>(totalPoints(*f)) / f->routes.size();
+}
+BENCHMARK(BM_JsonBuilderRoute)->ArgName("columnar")->Arg(0)->Arg(1);
+
+void BM_EncodeBinaryRoute(benchmark::State& state) {
+    const Fixture* f = setUp(state);
+    if (f == nullptr) {
+        return;
+    }
+    size_t bytes = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        bytes += RouteCodec::encodeBinary(f->routes[next], f->route_points[next]).size();
+        next = (next + 1) % f->routes.size();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_EncodeBinaryRoute);
+
+// Gzip of already serialized route JSON, the compression step of buildJsonResponse
+void BM_GzipRouteJson(benchmark::State& state) {
+    const Fixture* f = setUp(state);
+    if (f == nullptr) {
+        return;
+    }
+    std::vector<std::string> bodies;
+    for (size_t i = 0; i < f->routes.size(); ++i) {
+        bodies.push_back(renderRoute(*f, i, ContentEncoding::Identity, RouteFormat::Json));
+    }
+    size_t bytes = 0;
+    size_t compressed = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        ResponseEncoder encoder(ContentEncoding::Gzip);
+        encoder.write(bodies[next].data(), bodies[next].size());
+        compressed += encoder.finish().size();
+        bytes += bodies[next].size();
+        next = (next + 1) % bodies.size();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["ratio"] = bytes > 0 ? static_cast<double>(compressed) / bytes : 0.0;
+}
+BENCHMARK(BM_GzipRouteJson);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "AddressStore.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace RoutingServer {
+
+// Categorized place from an extract_categorized_places CSV
+struct Place {
+    std::string category;
+    std::string region;
+    double latitude;
+    double longitude;
+};
+
+// Address ingestion: parallel CSV parsing and a binary columnar address store
+class AddressLoader {
+public:
+    // Parse an address file (plain or gzipped) with the given number of threads.
+    // Plain files are memory-mapped; gzipped files are inflated in-process.
+    // Returns nullopt if the file cannot be read.
+    static std::optional<AddressStore> loadCsv(const std::string& csv_file, unsigned thread_count);
+
+    // Load a store written by saveStore; nullopt if missing, unreadable or older than csv_file
+    static std::optional<AddressStore> loadStore(const std::string& store_file, const std::string& csv_file);
+
+    // Write the addresses to a store tagged with the size and modification time of csv_file
+    static void saveStore(const std::string& store_file, const std::string& csv_file, const AddressStore& addresses);
+
+    // Read the category, coordinates and region of every place in a places CSV (plain or gzipped);
+    // nullopt if the file cannot be read
+    static std::optional<std::vector<Place>> loadPlaces(const std::string& places_file);
+
+    // ADDRESS_LOAD_THREADS, default: hardware concurrency
+    static unsigned defaultThreadCount();
+
+private:
+    // Parse the complete lines in [begin, end) and append them to addresses
+    static void parseChunk(const char* begin, const char* end, AddressStore& addresses);
+};
+
+} // namespace RoutingServer
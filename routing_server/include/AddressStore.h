@@ -0,0 +1,116 @@
+#pragma once
+
+#include <crow/json.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace RoutingServer {
+
+// Address information
+struct Address {
+    unsigned id;
+    double latitude;
+    double longitude;
+    std::string street;
+    std::string housenumber;
+    std::string postcode;
+    std::string city;
+
+    // Convert to JSON representation
+    crow::json::wvalue toJson() const {
+        crow::json::wvalue json;
+        json["id"] = id;
+        json["lat"] = latitude;
+        json["lon"] = longitude;
+        json["street"] = street;
+        json["house_number"] = housenumber;
+        json["postcode"] = postcode;
+        json["city"] = city;
+        return json;
+    }
+};
+
+// Deduplicated strings addressed by a dense id. Strings are stored back to back in one
+// character blob; ends_[i] is the end offset of string i.
+class StringPool {
+public:
+    // Id of the string, adding it if it is not in the pool yet
+    uint32_t intern(std::string_view value);
+
+    std::string_view get(uint32_t id) const {
+        uint64_t begin = id == 0 ? 0 : ends_[id - 1];
+        return std::string_view(data_.data() + begin, ends_[id] - begin);
+    }
+
+    size_t size() const { return ends_.size(); }
+    size_t memoryBytes() const { return data_.capacity() + ends_.capacity() * sizeof(uint64_t); }
+
+    // Drop the lookup table used by intern(); the pool stays readable
+    void freeze();
+
+    const std::vector<uint64_t>& ends() const { return ends_; }
+    const std::vector<char>& data() const { return data_; }
+
+    // Pool from serialized columns; throws std::runtime_error if they are inconsistent
+    static StringPool fromColumns(std::vector<uint64_t> ends, std::vector<char> data);
+
+private:
+    std::vector<uint64_t> ends_;
+    std::vector<char> data_;
+    std::unordered_multimap<size_t, uint32_t> lookup_; // String hash -> ids, only while building
+};
+
+// Column-oriented address storage. Coordinates are fixed point at 1e-7 degrees and text
+// fields are ids into one interned pool per field; Address values are only materialized
+// by get() when a response is built.
+class AddressStore {
+public:
+    static constexpr double COORDINATE_SCALE = 1e7;
+
+    enum Field { Street = 0, HouseNumber = 1, Postcode = 2, City = 3, FIELD_COUNT = 4 };
+
+    size_t size() const { return latitudes_.size(); }
+    bool empty() const { return latitudes_.empty(); }
+
+    double latitude(size_t index) const { return latitudes_[index] / COORDINATE_SCALE; }
+    double longitude(size_t index) const { return longitudes_[index] / COORDINATE_SCALE; }
+    std::string_view text(size_t index, Field field) const { return pools_[field].get(ids_[field][index]); }
+
+    // Materialize one address (id is its index)
+    Address get(size_t index) const;
+
+    void reserve(size_t count);
+    void add(double latitude, double longitude, std::string_view street, std::string_view housenumber,
+             std::string_view postcode, std::string_view city);
+
+    // Move all addresses of other to the end, re-interning its strings into these pools
+    void append(AddressStore&& other);
+
+    // Release build-time lookup tables and excess capacity once loading is done
+    void freeze();
+
+    size_t memoryBytes() const;
+
+    // Raw columns for serialization
+    const std::vector<int32_t>& latitudeColumn() const { return latitudes_; }
+    const std::vector<int32_t>& longitudeColumn() const { return longitudes_; }
+    const std::vector<uint32_t>& idColumn(Field field) const { return ids_[field]; }
+    const StringPool& pool(Field field) const { return pools_[field]; }
+
+    // Store from serialized columns; throws std::runtime_error if they are inconsistent
+    static AddressStore fromColumns(std::vector<int32_t> latitudes, std::vector<int32_t> longitudes,
+                                    std::array<std::vector<uint32_t>, FIELD_COUNT> ids,
+                                    std::array<StringPool, FIELD_COUNT> pools);
+
+private:
+    std::vector<int32_t> latitudes_;
+    std::vector<int32_t> longitudes_;
+    std::array<std::vector<uint32_t>, FIELD_COUNT> ids_;
+    std::array<StringPool, FIELD_COUNT> pools_;
+};
+
+} // namespace RoutingServer
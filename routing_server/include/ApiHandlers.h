@@ -1,20 +1,35 @@
 #pragma once
 
 #include "RoutingEngine.h"
+#include "RegionRouter.h"
+#include "JsonWriter.h"
+#include "RouteCodec.h"
+#include "RouteCache.h"
 #include <crow.h>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace RoutingServer {
 
 // Class for handling API endpoints
 class ApiHandlers {
 public:
-    // Constructor with routing engine
-    explicit ApiHandlers(std::shared_ptr<RoutingEngine> engine);
+    // Constructor with the routing engines of all regions (each may be swapped by a reload)
+    explicit ApiHandlers(std::shared_ptr<RegionRouter> regions);
+    ~ApiHandlers();
+    
+    ApiHandlers(const ApiHandlers&) = delete;
+    ApiHandlers& operator=(const ApiHandlers&) = delete;
     
     // Register all API endpoints with the Crow app
     void registerRoutes(crow::SimpleApp& app);
+    
+    // Forget all cached route responses (call when the graph changes)
+    void invalidateRouteCache() { route_cache_.clear(); }
 
 private:
     // Handler for the shortest path endpoint
@@ -26,6 +41,9 @@ private:
     // Handler for the health check endpoint
     crow::response handleHealthCheck(const crow::request& req);
     
+    // Handler for the Prometheus metrics endpoint
+    crow::response handleMetrics(const crow::request& req);
+    
     // Handler for the address bbox endpoint
     crow::response handleAddressBbox(const crow::request& req);
     
@@ -38,9 +56,34 @@ private:
     // Handler for the uniform random address in annulus endpoint
     crow::response handleUniformRandomAddressInAnnulus(const crow::request& req);
     
+    // Handler for the precomputed job candidates endpoint
+    crow::response handleJobCandidates(const crow::request& req);
+    
+    // Handler for the reachable addresses (isochrone) endpoint
+    crow::response handleReachable(const crow::request& req);
+    
     // Handler for the complete job route endpoint
     crow::response handleCompleteJobRoute(const crow::request& req);
     
+    // Handler for the route geometry endpoint (full route of a token from a metadata-only response)
+    crow::response handleRouteGeometry(const crow::request& req);
+    
+    // Route responses once the request is parsed; shared with the route geometry endpoint.
+    // Metadata-only responses carry the route's token.
+    crow::response respondShortestPath(const crow::request& req, const RouteToken& route,
+                                       RouteFormat format, bool include_path, long long start_time);
+    crow::response respondJobRoute(const crow::request& req, const RouteToken& route,
+                                   RouteFormat format, bool include_path, long long start_time);
+    
+    // Handler for the batch complete job route endpoint (POST, metadata only)
+    crow::response handleCompleteJobRouteBatch(const crow::request& req);
+    
+    // Handler for the many-to-many matrix endpoint (POST)
+    crow::response handleMatrix(const crow::request& req);
+    
+    // Handler for the admin reload endpoint (POST starts a reload, GET reports status)
+    crow::response handleAdminReload(const crow::request& req);
+    
     // Parse coordinates from query parameters
     bool parseCoordinates(const crow::request& req, 
                           double& from_lat, double& from_lon, 
@@ -49,8 +92,71 @@ private:
     // Parse a single coordinate pair from query parameter
     bool parseCoordinate(const std::string& param, double& lat, double& lon);
     
-    // Shared routing engine instance
-    std::shared_ptr<RoutingEngine> engine_;
+    // Parse a metric name (time or distance, default time)
+    RoutingMetric parseMetric(const std::string& metric_param);
+    
+    // Parse a JSON [lat, lon] pair
+    bool parseJsonCoordinate(const crow::json::rvalue& value, double& lat, double& lon);
+    
+    // Parse a JSON list of [lat, lon] pairs
+    bool parseJsonCoordinateList(const crow::json::rvalue& value, std::vector<std::pair<double, double>>& coordinates);
+    
+    // Engine of the region named by the region parameter, or else of the smallest region
+    // containing all points (loaded if needed); null with an error message and HTTP code if none
+    std::shared_ptr<const EngineHolder::Current> acquireEngine(const crow::request& req,
+                                                               const std::vector<std::pair<double, double>>& points,
+                                                               std::string& error_message, int& error_code);
+    
+    // Same for a region name (empty: by the points)
+    std::shared_ptr<const EngineHolder::Current> acquireEngine(const std::string& region,
+                                                               const std::vector<std::pair<double, double>>& points,
+                                                               std::string& error_message, int& error_code);
+    
+    // Response encoding for the request's Accept-Encoding header
+    ContentEncoding negotiateEncoding(const crow::request& req);
+    
+    // Stream a JSON body into a response encoded as negotiated from Accept-Encoding
+    // (gzip if the header is missing); json_size receives the uncompressed size
+    crow::response buildJsonResponse(const crow::request& req,
+                                     const std::function<void(JsonWriter&)>& write_body,
+                                     int code = 200, size_t* json_size = nullptr);
+    
+    // Serialize a crow JSON value into a negotiated response
+    crow::response buildJsonResponse(const crow::request& req, const crow::json::wvalue& json, int code = 200);
+    
+    // Record the serialization and compression stage times of a finished body
+    static void recordEncodingTimes(const ResponseEncoder& encoder, long long total_us);
+    
+    // Already serialized body as a negotiated response
+    crow::response buildEncodedResponse(const crow::request& req, const std::string& body,
+                                        const char* content_type, int code = 200);
+    
+    // Route in the requested format; a null route_points gives the metadata-only body
+    // (with the route token, if not empty)
+    crow::response buildRouteResponse(const crow::request& req, const RoutingResult& result,
+                                      const std::vector<RoutePoint>* route_points,
+                                      RouteFormat format, size_t* body_size = nullptr,
+                                      const std::string& route_token = "");
+    
+    // Error body ({"error": ..., "success": false}) as a negotiated response
+    crow::response buildJsonErrorResponse(const crow::request& req, const std::string& error_message, int code);
+    
+    // Routing engines per region; every handler acquires one engine and uses it throughout,
+    // so a reload or eviction never mixes two graphs within one request
+    std::shared_ptr<RegionRouter> regions_;
+    
+    // Shared secret for the admin endpoints (ADMIN_TOKEN); empty disables them
+    std::string admin_token_;
+    
+    // Encoded responses of recent shortest_path and complete_job_route requests
+    RouteCache route_cache_;
+    
+    // Request size limits for the batch endpoints
+    static constexpr size_t MAX_MATRIX_CELLS = 250000;
+    static constexpr size_t MAX_BATCH_JOBS = 1000;
+    static constexpr unsigned MAX_ANNULUS_SAMPLE_COUNT = 10000;
+    static constexpr unsigned MAX_JOB_CANDIDATE_COUNT = 10000;
+    static constexpr unsigned MAX_REACHABLE_COUNT = 10000;
 };
 
 } // namespace RoutingServer 
\ No newline at end of file
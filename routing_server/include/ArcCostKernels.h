@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace RoutingServer {
+
+// Travel time of arcs from their length and speed: time_ms = floor(distance_m * 3600 / speed_kmh).
+// The quotient is taken in double precision, which is exact for these operands (distance_m * 3600
+// stays below 2^44, and a correctly rounded quotient of integers below 2^53 never crosses an
+// integer), so results equal the integer division while the loops avoid a 64-bit divide per arc.
+// The contiguous weight kernel processes four arcs per step with SSE2 where available.
+class ArcCostKernels {
+public:
+    // Speed cap that leaves every arc speed as it is
+    static constexpr unsigned NO_SPEED_CAP = UINT16_MAX;
+
+    // Longest time a single CH arc may take (24 hours); arcs without a usable speed get this
+    // instead of inf_weight, because infinite arcs overflow path sums while the CH is contracted
+    static constexpr unsigned MAX_ARC_TIME_MS = 86400u * 1000u;
+
+    // Summary of a weight sweep; min_ms ignores zero-time arcs
+    struct WeightStats {
+        unsigned min_ms = UINT32_MAX;
+        unsigned max_ms = 0;
+        size_t capped_count = 0;
+        size_t zero_count = 0;
+
+        void merge(const WeightStats& other);
+    };
+
+    // CH weights of count consecutive arcs with speeds capped at cap_kmh. Arcs without speed or
+    // taking longer than max_time_ms (which must be below 2^31) get max_time_ms. Statistics come
+    // from the same sweep.
+    static WeightStats computeWeights(const uint32_t* distance_m, const uint16_t* speed_kmh, size_t count,
+                                      unsigned cap_kmh, unsigned max_time_ms, uint32_t* weights);
+
+    // Times of the arcs of a path, with speeds capped at cap_kmh; arcs without speed take 0 ms.
+    // effective_speed_kmh receives the capped speeds if not null.
+    static void pathTimes(const unsigned* arcs, size_t count, const uint32_t* distance_m,
+                          const uint16_t* speed_kmh, unsigned cap_kmh, uint32_t* time_ms,
+                          uint16_t* effective_speed_kmh);
+
+    // Sum of the path times (wrapping at 2^32 like the per-point cumulative times)
+    static uint32_t pathTotal(const unsigned* arcs, size_t count, const uint32_t* distance_m,
+                              const uint16_t* speed_kmh, unsigned cap_kmh);
+
+    // out[0] = start and out[i + 1] = out[i] + values[i]; out holds count + 1 values
+    static void prefixSums(const uint32_t* values, size_t count, uint32_t start, uint32_t* out);
+
+    // Index of the speed tier closest to max_speed_kmh among count tiers sorted by speed, where
+    // speed_of(i) is the cap of tier i; ties go to the slower tier, and 0 if there are none.
+    // The CCH tiers and the job candidate tables both pick tiers with it, so a table's tier
+    // times belong to the tier the server routes a max_speed request on.
+    template <typename SpeedOf>
+    static size_t nearestSpeedTier(size_t count, unsigned max_speed_kmh, SpeedOf speed_of) {
+        size_t best = 0;
+        unsigned best_difference = UINT32_MAX;
+        for (size_t tier = 0; tier < count; ++tier) {
+            unsigned speed = speed_of(tier);
+            unsigned difference = speed > max_speed_kmh ? speed - max_speed_kmh : max_speed_kmh - speed;
+            if (difference < best_difference) {
+                best = tier;
+                best_difference = difference;
+            }
+        }
+        return best;
+    }
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "RoutingEngine.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace RoutingServer {
+
+// Input files of a routing engine; empty paths are optional inputs that were not given
+struct EngineConfig {
+    std::string osm_file;
+    std::string ch_geo_file;
+    std::string snapshot_file;
+    std::string ch_time_file;
+    std::string addresses_file;
+    std::string places_file;
+    std::string job_candidates_file;
+};
+
+// Owns the routing engine that serves requests and replaces it without downtime.
+// A reload builds a complete new engine from the same files on a background thread (loading
+// the graph snapshot and address store when they are still current) and then swaps it in
+// atomically. Requests that already hold the previous engine keep it until they finish; it is
+// freed with the last of them. Both engines are in memory while a reload runs.
+class EngineHolder {
+public:
+    // Engine in service and the number of reloads it took to get there
+    struct Current {
+        std::shared_ptr<RoutingEngine> engine;
+        uint64_t generation;
+        uint64_t instance; // Unique among all engines ever built by this process
+    };
+
+    struct ReloadStatus {
+        bool in_progress = false;
+        uint64_t generation = 0;
+        uint64_t reloads = 0;
+        uint64_t failures = 0;
+        double last_duration_ms = 0.0;
+        std::string last_error;
+    };
+
+    // Build an engine from the files (throws if the graph cannot be loaded).
+    // With require_addresses a configured address file that fails to load is an error too.
+    static std::shared_ptr<RoutingEngine> build(const EngineConfig& config, bool require_addresses);
+
+    EngineHolder(EngineConfig config, std::shared_ptr<RoutingEngine> engine);
+    ~EngineHolder();
+
+    EngineHolder(const EngineHolder&) = delete;
+    EngineHolder& operator=(const EngineHolder&) = delete;
+
+    // Engine to use for one request; hold on to it until the request is done
+    std::shared_ptr<const Current> current() const { return std::atomic_load(&current_); }
+
+    // Start a background reload; false if one is already running
+    bool startReload();
+
+    ReloadStatus status() const;
+
+    // Called after each successful swap (with nullptr to remove it)
+    void setReloadListener(std::function<void()> listener);
+
+private:
+    void reload();
+
+    static uint64_t nextInstance();
+
+    EngineConfig config_;
+    std::shared_ptr<const Current> current_;
+
+    std::atomic<bool> reloading_{false};
+    std::thread reload_thread_;
+
+    mutable std::mutex mutex_; // Guards status_, listener_ and reload_thread_
+    ReloadStatus status_;
+    std::function<void()> listener_;
+};
+
+} // namespace RoutingServer
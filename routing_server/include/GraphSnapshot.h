@@ -0,0 +1,179 @@
+#pragma once
+
+#include <routingkit/contraction_hierarchy.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace RoutingServer {
+
+// Sections stored in a graph snapshot file. Values are part of the on-disk format, never reuse them.
+enum class SnapshotSection : uint32_t {
+    FirstOut = 1,
+    Head = 2,
+    GeoDistance = 3,
+    Way = 4,
+    Latitude = 5,
+    Longitude = 6,
+    WaySpeed = 7,
+    Tail = 8,
+    GeoContractionHierarchy = 9,
+    TimeContractionHierarchy = 10,
+    // Address store (see AddressLoader). Coordinates are 1e-7 fixed point; each text field is a
+    // per-address id column into a string pool stored as end offsets plus a character blob.
+    AddressLatitude = 20,
+    AddressLongitude = 21,
+    AddressStreetOffsets = 22,
+    AddressStreetData = 23,
+    AddressHouseNumberOffsets = 24,
+    AddressHouseNumberData = 25,
+    AddressPostcodeOffsets = 26,
+    AddressPostcodeData = 27,
+    AddressCityOffsets = 28,
+    AddressCityData = 29,
+    AddressStreetIds = 30,
+    AddressHouseNumberIds = 31,
+    AddressPostcodeIds = 32,
+    AddressCityIds = 33,
+    // Job candidate table (see JobCandidateTable); region and category names share one pool
+    JobSpeedTiers = 40,
+    JobTables = 41,
+    JobNameOffsets = 42,
+    JobNameData = 43,
+    JobCandidates = 44,
+    JobTierTimes = 45,
+    JobAddressSource = 46,
+};
+
+// Read-only array inside a mapped snapshot; valid as long as the Reader that returned it
+template <typename T>
+struct SnapshotView {
+    const T* data = nullptr;
+    size_t count = 0;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t index) const { return data[index]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+};
+
+// Identifies the PBF file a snapshot was built from
+struct SnapshotSource {
+    uint64_t file_size = 0;
+    int64_t modification_time = 0;
+
+    // Returns nullopt if the file does not exist
+    static std::optional<SnapshotSource> fromFile(const std::string& path);
+
+    bool operator==(const SnapshotSource& other) const {
+        return file_size == other.file_size && modification_time == other.modification_time;
+    }
+};
+
+// Versioned binary snapshot of the routing graph and its contraction hierarchies.
+// Layout: fixed header, followed by tagged sections padded to 8-byte boundaries.
+class GraphSnapshot {
+public:
+    static constexpr uint64_t MAGIC = 0x50414e5347525352ULL; // "RSRGSNAP"
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    // Bump whenever the custom routing profile changes the graph it produces
+    static constexpr uint32_t PROFILE_VERSION = 1;
+
+    // Writes sections sequentially to a temporary file and renames it into place on finish()
+    class Writer {
+    public:
+        Writer(const std::string& path, const SnapshotSource& source);
+        ~Writer();
+
+        template <typename T>
+        void addVector(SnapshotSection section, const std::vector<T>& data) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot vectors must be trivially copyable");
+            beginSection(section, sizeof(T));
+            out_.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+            endSection();
+        }
+
+        void addContractionHierarchy(SnapshotSection section, const RoutingKit::ContractionHierarchy& ch);
+
+        // Flushes and atomically replaces the target file
+        void finish();
+
+    private:
+        void beginSection(SnapshotSection section, uint32_t element_size);
+        void endSection();
+
+        std::string path_;
+        std::string temp_path_;
+        std::ofstream out_;
+        std::streampos section_start_;
+        bool finished_ = false;
+    };
+
+    // Memory-maps a snapshot and gives access to its sections. RoutingKit's graph and CH types own
+    // std::vectors, so readVector() and readContractionHierarchy() copy their sections out of the
+    // mapping (one sequential pass instead of parsing the PBF); view() serves a section in place.
+    class Reader {
+    public:
+        // How the mapping is used, for the kernel's read-ahead
+        enum class Access {
+            CopyOut, // Sections are copied out front to back, then the Reader is dropped
+            Serve    // The Reader stays alive and views are read in random order
+        };
+
+        // Throws std::runtime_error if the file cannot be mapped or has an incompatible header
+        explicit Reader(const std::string& path, Access access = Access::CopyOut);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const SnapshotSource& source() const { return source_; }
+        bool hasSection(SnapshotSection section) const;
+
+        template <typename T>
+        std::vector<T> readVector(SnapshotSection section) const {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot vectors must be trivially copyable");
+            const SectionEntry& entry = findSection(section, sizeof(T));
+            std::vector<T> result(entry.size / sizeof(T));
+            if (!result.empty()) {
+                std::memcpy(result.data(), data_ + entry.offset, entry.size);
+            }
+            return result;
+        }
+
+        // Section in place, without a copy; sections start 8-byte aligned
+        template <typename T>
+        SnapshotView<T> view(SnapshotSection section) const {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot vectors must be trivially copyable");
+            static_assert(alignof(T) <= 8, "snapshot sections are 8-byte aligned");
+            const SectionEntry& entry = findSection(section, sizeof(T));
+            return SnapshotView<T>{reinterpret_cast<const T*>(data_ + entry.offset), entry.size / sizeof(T)};
+        }
+
+        RoutingKit::ContractionHierarchy readContractionHierarchy(SnapshotSection section) const;
+
+    private:
+        struct SectionEntry {
+            uint64_t offset;
+            uint64_t size;
+            uint32_t element_size;
+        };
+
+        const SectionEntry& findSection(SnapshotSection section, uint32_t element_size) const;
+
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        SnapshotSource source_;
+        std::map<uint32_t, SectionEntry> sections_;
+    };
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "AddressStore.h"
+#include "GraphSnapshot.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace RoutingServer {
+
+// Precomputed job candidates: (pickup, delivery) address pairs for every NUTS region and place
+// category, with the route distance and the travel time at each speed tier. The table is built
+// offline (osm_utils_cpp precompute_job_candidates) and stored in the graph snapshot file format,
+// so drawing a job with known route totals is a lookup instead of a sample plus a route.
+// A loaded table serves its candidates and tier times straight from the mapped file.
+class JobCandidateTable {
+public:
+    // Addresses are ids into the address file the table was built from (see addressSource()).
+    // Totals include the walks to and from the snapped routing nodes.
+    struct Candidate {
+        uint32_t pickup_address;
+        uint32_t delivery_address;
+        uint32_t distance_m;     // Fastest route without a speed cap
+        uint32_t travel_time_ms; // Fastest route without a speed cap
+    };
+
+    JobCandidateTable() = default;
+    JobCandidateTable(JobCandidateTable&&) = default;
+    JobCandidateTable& operator=(JobCandidateTable&&) = default;
+    // Views point into the owned vectors or the mapping, so copies would share or dangle
+    JobCandidateTable(const JobCandidateTable&) = delete;
+    JobCandidateTable& operator=(const JobCandidateTable&) = delete;
+
+    // Candidates [begin, end) of one table
+    struct Range {
+        size_t begin = 0;
+        size_t end = 0;
+
+        size_t size() const { return end - begin; }
+    };
+
+    // Speed caps in km/h that tierTime() reports; set before adding tables. Tier times are the
+    // fastest route with the speed cap, as the server's CCH tier of that speed routes it.
+    void setSpeedTiers(std::vector<uint32_t> speed_tiers_kmh);
+    const SnapshotView<uint32_t>& speedTiers() const { return speed_tiers_; }
+
+    // Size and modification time of the address file the address ids refer to
+    void setAddressSource(const SnapshotSource& source) { address_source_ = source; }
+    const SnapshotSource& addressSource() const { return address_source_; }
+
+    // Add the table of a region and category; tier_times_ms holds speedTiers().size() times per
+    // candidate, in candidate order. Candidates are stored sorted by distance.
+    // Throws std::invalid_argument if the key already exists or the sizes do not match.
+    void addTable(const std::string& region, const std::string& category, std::vector<Candidate> candidates,
+                  const std::vector<uint32_t>& tier_times_ms);
+
+    // Candidates of a table with a distance in [min_distance_m, max_distance_m]; nullopt if the
+    // region has no table for the category. O(log n) once, then every index in the range is a draw.
+    std::optional<Range> find(const std::string& region, const std::string& category,
+                              uint32_t min_distance_m, uint32_t max_distance_m) const;
+
+    const Candidate& candidate(size_t index) const { return candidates_[index]; }
+    uint32_t tierTime(size_t index, size_t tier) const { return tier_times_[index * speed_tiers_.size() + tier]; }
+
+    // Tier closest to a speed cap, picked like RoutingEngine's CCH tiers (ArcCostKernels::nearestSpeedTier);
+    // speedTiers() must not be empty
+    size_t tierFor(unsigned max_speed_kmh) const;
+
+    size_t size() const { return candidates_.size(); }
+    size_t tableCount() const { return tables_.size(); }
+    size_t memoryBytes() const;       // Heap memory: names, index and a table under construction
+    size_t mappedBytes() const;       // Sections served from the mapped file
+
+    // Write the table tagged with the size and modification time of the file it was built from
+    void save(const std::string& path, const SnapshotSource& source) const;
+
+    // Map a saved table; throws std::runtime_error if it is missing or unreadable
+    static JobCandidateTable load(const std::string& path);
+
+private:
+    // Stored as a snapshot section, so its layout is part of the format
+    struct Table {
+        uint32_t region;   // Name id in names_
+        uint32_t category; // Name id in names_
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    void buildIndex();
+
+    // Point the views at the vectors of a table under construction
+    void viewOwned();
+
+    // Sections as read by every accessor: into the mapping after load(), into the owned vectors
+    // below while building
+    SnapshotView<uint32_t> speed_tiers_;
+    SnapshotView<Table> tables_;
+    SnapshotView<Candidate> candidates_;
+    SnapshotView<uint32_t> tier_times_; // speed_tiers_.size() per candidate
+
+    std::vector<uint32_t> owned_speed_tiers_;
+    std::vector<Table> owned_tables_;
+    std::vector<Candidate> owned_candidates_;
+    std::vector<uint32_t> owned_tier_times_;
+    std::unique_ptr<GraphSnapshot::Reader> mapping_;
+
+    SnapshotSource address_source_;
+    StringPool names_; // Region and category names; small, so copied out of the mapping
+    std::map<std::pair<std::string, std::string>, size_t> index_; // (region, category) -> table
+};
+
+} // namespace RoutingServer
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RoutingEngine.h"
+#include "JsonWriter.h"
 #include <crow.h>
 #include <string>
 #include <vector>
@@ -10,20 +11,33 @@ namespace RoutingServer {
 // Class for building JSON responses
 class JsonBuilder {
 public:
-    // Build a JSON response for a successful route calculation
-    static crow::json::wvalue buildRouteResponse(
+    // Write the JSON response for a successful route calculation
+    static void writeRouteResponse(
+        JsonWriter& writer,
         const RoutingResult& result,
         const std::vector<RoutePoint>& route_points
     );
     
-    // Build a lite JSON response without path array (for metadata-only requests)
-    static crow::json::wvalue buildLiteRouteResponse(const RoutingResult& result);
+    // Write the route with the path as polyline-encoded columns (see RouteCodec)
+    static void writeColumnarRouteResponse(
+        JsonWriter& writer,
+        const RoutingResult& result,
+        const std::vector<RoutePoint>& route_points
+    );
+    
+    // Write a lite JSON response without path array (for metadata-only requests),
+    // with the token for fetching the geometry later if one is given
+    static void writeLiteRouteResponse(JsonWriter& writer, const RoutingResult& result,
+                                       const std::string& route_token = "");
+    
+    // Write a JSON error response
+    static void writeErrorResponse(JsonWriter& writer, const std::string& error_message);
     
     // Build a JSON error response
     static crow::json::wvalue buildErrorResponse(const std::string& error_message);
     
-    // Compress JSON string using gzip
-    static std::vector<unsigned char> compressGzip(const std::string& json_string);
+    // Counters of a cache for the health endpoint
+    static crow::json::wvalue buildCacheStats(const CacheStats& stats);
 };
 
 } // namespace RoutingServer 
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ResponseEncoder.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RoutingServer {
+
+// Streaming JSON writer. Text accumulates in a per-thread scratch buffer that is handed to the
+// encoder whenever it grows past FLUSH_THRESHOLD, so no document tree or full-size copy is built.
+// Only one writer may be alive per thread, since they share the scratch buffer.
+class JsonWriter {
+public:
+    explicit JsonWriter(ResponseEncoder& encoder);
+    ~JsonWriter();
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    // Object key; must be followed by a value or a nested container
+    JsonWriter& key(const char* name);
+
+    JsonWriter& value(bool v);
+    JsonWriter& value(int v);
+    JsonWriter& value(unsigned v);
+    JsonWriter& value(uint64_t v);
+    JsonWriter& value(double v);
+    JsonWriter& value(const char* v);
+    JsonWriter& value(const std::string& v);
+    JsonWriter& null();
+
+    // Insert pre-serialized JSON as a value
+    JsonWriter& raw(const std::string& json);
+
+    template <typename T>
+    JsonWriter& field(const char* name, const T& v) {
+        return key(name).value(v);
+    }
+
+    // Push buffered text into the encoder
+    void flush();
+
+private:
+    void separate();
+    void appendEscaped(const char* data, size_t size);
+    void maybeFlush();
+
+    static constexpr size_t FLUSH_THRESHOLD = 32768;
+
+    ResponseEncoder& encoder_;
+    std::string& buffer_;
+    std::vector<bool> first_in_scope_; // One entry per open container
+    bool after_key_ = false;
+};
+
+} // namespace RoutingServer
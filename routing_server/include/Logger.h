@@ -1,22 +1,115 @@
 #pragma once
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <sstream>
-#include <iomanip>
-#include <ctime>
+#include <string>
+#include <thread>
+
+// Log statements below this level are compiled out (0 = debug, 1 = info, 2 = warn, 3 = error)
+#ifndef ROUTING_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define ROUTING_LOG_MIN_LEVEL 1
+#else
+#define ROUTING_LOG_MIN_LEVEL 0
+#endif
+#endif
 
 namespace RoutingServer {
 
-// Get current time as string for logging
-inline std::string current_time_string() {
-    auto t = std::time(nullptr);
-    auto tm = *std::localtime(&t);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%H:%M:%S");
-    return oss.str();
-}
+enum class LogLevel : int {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+};
+
+// Asynchronous logger: request threads push formatted messages into a lock-free ring buffer
+// and a background thread writes them to stdout. A full buffer drops messages instead of blocking.
+class Logger {
+public:
+    static Logger& instance();
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Runtime threshold from ROUTING_LOG_LEVEL (debug, info, warn, error; default info)
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= min_level_.load(std::memory_order_relaxed);
+    }
+
+    void setMinLevel(LogLevel level) { min_level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+    // Queue a message; never blocks
+    void write(LogLevel level, const std::string& message);
+
+    // Block until everything queued so far has been written
+    void flush();
+
+    // Messages dropped because the ring buffer was full
+    uint64_t droppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    Logger();
+
+    // Messages longer than this are truncated
+    static constexpr size_t MAX_MESSAGE_LENGTH = 480;
+    static constexpr size_t RING_CAPACITY = 4096; // Must be a power of two
+
+    struct Entry {
+        std::atomic<uint64_t> sequence;
+        std::chrono::system_clock::time_point time;
+        LogLevel level;
+        uint16_t length;
+        char text[MAX_MESSAGE_LENGTH];
+    };
+
+    // Pop and print everything currently queued; returns false if the buffer was empty
+    bool drain();
+    void drainLoop();
+    // True if drain() has something to print
+    bool pending() const;
+    // Wake the drain thread if it is parked
+    void wake();
+
+    std::unique_ptr<Entry[]> ring_;
+    alignas(64) std::atomic<uint64_t> enqueue_position_{0};
+    alignas(64) std::atomic<uint64_t> dequeue_position_{0};
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t reported_dropped_ = 0;
+    std::atomic<int> min_level_{static_cast<int>(LogLevel::Info)};
+    std::atomic<bool> stopping_{false};
+    // The drain thread parks on idle_cv_ when the buffer is empty; writers only take idle_mutex_
+    // to wake it when parked_ is set
+    std::atomic<bool> parked_{false};
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::thread drain_thread_;
+};
+
+// Stream-style logging macros. The message is only formatted if the level is enabled, and
+// levels below ROUTING_LOG_MIN_LEVEL reduce to dead code.
+#define ROUTING_LOG_AT(level, msg)                                                              \
+    do {                                                                                        \
+        if (static_cast<int>(level) >= ROUTING_LOG_MIN_LEVEL &&                                 \
+            RoutingServer::Logger::instance().enabled(level)) {                                 \
+            std::ostringstream routing_log_stream_;                                             \
+            routing_log_stream_ << msg;                                                         \
+            RoutingServer::Logger::instance().write(level, routing_log_stream_.str());          \
+        }                                                                                       \
+    } while (0)
 
-// Stream-style logging macro
-#define LOG(msg) std::cout << "[" << RoutingServer::current_time_string() << "] " << msg << std::endl
+#define LOG_DEBUG(msg) ROUTING_LOG_AT(RoutingServer::LogLevel::Debug, msg)
+#define LOG_INFO(msg) ROUTING_LOG_AT(RoutingServer::LogLevel::Info, msg)
+#define LOG_WARN(msg) ROUTING_LOG_AT(RoutingServer::LogLevel::Warn, msg)
+#define LOG_ERROR(msg) ROUTING_LOG_AT(RoutingServer::LogLevel::Error, msg)
+#define LOG(msg) LOG_INFO(msg)
 
-} // namespace RoutingServer 
\ No newline at end of file
+} // namespace RoutingServer
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace RoutingServer {
+
+// Memory reporting helper (Linux-specific)
+struct MemoryStats {
+    uint64_t rss_kb = 0;      // Resident Set Size in KB
+    uint64_t peak_rss_kb = 0; // Peak RSS in KB (VmHWM)
+    
+    static MemoryStats get_current() {
+        MemoryStats stats;
+#ifdef __linux__
+        std::ifstream status_file("/proc/self/status");
+        if (status_file.is_open()) {
+            std::string line;
+            while (std::getline(status_file, line)) {
+                if (line.substr(0, 6) == "VmRSS:") {
+                    std::istringstream iss(line.substr(6));
+                    iss >> stats.rss_kb;
+                } else if (line.substr(0, 6) == "VmHWM:") {
+                    std::istringstream iss(line.substr(6));
+                    iss >> stats.peak_rss_kb;
+                }
+            }
+        }
+#endif
+        return stats;
+    }
+    
+    std::string format() const {
+        std::ostringstream oss;
+        if (rss_kb > 0) {
+            if (rss_kb >= 1024 * 1024) {
+                oss << std::fixed << std::setprecision(1) << (rss_kb / (1024.0 * 1024.0)) << " GB";
+            } else if (rss_kb >= 1024) {
+                oss << std::fixed << std::setprecision(1) << (rss_kb / 1024.0) << " MB";
+            } else {
+                oss << rss_kb << " KB";
+            }
+        } else {
+            oss << "N/A";
+        }
+        return oss.str();
+    }
+    
+    std::string format_peak() const {
+        std::ostringstream oss;
+        if (peak_rss_kb > 0) {
+            if (peak_rss_kb >= 1024 * 1024) {
+                oss << std::fixed << std::setprecision(1) << (peak_rss_kb / (1024.0 * 1024.0)) << " GB";
+            } else if (peak_rss_kb >= 1024) {
+                oss << std::fixed << std::setprecision(1) << (peak_rss_kb / 1024.0) << " MB";
+            } else {
+                oss << peak_rss_kb << " KB";
+            }
+        } else {
+            oss << "N/A";
+        }
+        return oss.str();
+    }
+};
+
+} // namespace RoutingServer
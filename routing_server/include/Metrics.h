@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RoutingServer {
+
+// Stages of a request whose latencies are tracked
+enum class MetricStage : unsigned {
+    Snap,        // Coordinate to graph node
+    ChQuery,     // CH/CCH search up to the distance
+    PathUnpack,  // Shortcuts expanded into arcs and nodes
+    ProcessPath, // processPathIntoPoints
+    JsonBuild,   // Serialization of a JSON response, compression excluded
+    Compress,    // Response compression
+    Count,
+};
+
+// Latency distribution with log-linear buckets: exact below 8 µs, then 8 buckets per power
+// of two, so every recorded value is within 12.5% of its bucket's bounds (up to ~71 minutes)
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKETS = 8;
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr unsigned MAX_EXPONENT = 32;
+    static constexpr unsigned BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    static unsigned bucketIndex(uint64_t micros);
+
+    // Exclusive upper bound of a bucket in µs
+    static uint64_t bucketLimit(unsigned index);
+
+    // Merged counts of all shards at one point in time
+    struct Snapshot {
+        std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKET_COUNT, 0);
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+
+        // Upper bound in µs of the bucket holding the given quantile (0 if empty)
+        uint64_t quantile(double q) const;
+
+        // Values below limit_us; exact when the limit is a power of two
+        uint64_t countBelow(uint64_t limit_us) const;
+    };
+};
+
+// Process-wide request metrics. Recording is a handful of relaxed atomic adds on a shard of the
+// calling thread, so request threads never contend on a lock or a shared cache line.
+class Metrics {
+public:
+    static Metrics& instance();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void record(MetricStage stage, long long micros);
+
+    LatencyHistogram::Snapshot snapshot(MetricStage stage) const;
+
+    // Histograms of all stages in the Prometheus text format
+    void writeStageHistograms(std::string& out) const;
+
+private:
+    Metrics() = default;
+
+    // Request threads get shards round robin; more threads than shards just share
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct StageCounters {
+        std::atomic<uint64_t> buckets[LatencyHistogram::BUCKET_COUNT] = {};
+        std::atomic<uint64_t> sum_us{0};
+    };
+
+    struct alignas(64) Shard {
+        StageCounters stages[static_cast<size_t>(MetricStage::Count)];
+    };
+
+    Shard& localShard();
+
+    Shard shards_[SHARD_COUNT];
+    std::atomic<size_t> next_shard_{0};
+};
+
+const char* metricStageName(MetricStage stage);
+
+// Writer for the Prometheus text exposition format (version 0.0.4)
+class PrometheusWriter {
+public:
+    explicit PrometheusWriter(std::string& out) : out_(out) {}
+
+    // HELP and TYPE lines introducing a metric family; type is "counter", "gauge", ...
+    void family(const char* name, const char* type, const char* help);
+
+    // One sample; labels is the inner part of the braces, e.g. region="default" (may be empty)
+    void sample(const char* name, const std::string& labels, double value);
+    void sample(const char* name, const std::string& labels, uint64_t value);
+
+    // Label with its value escaped, e.g. label("region", name)
+    static std::string label(const char* key, const std::string& value);
+
+private:
+    void writeName(const char* name, const std::string& labels);
+
+    std::string& out_;
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <routingkit/contraction_hierarchy.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace RoutingServer {
+
+// Downward arcs of a CH laid out for PHAST one-to-all searches. Nodes are renumbered into slots
+// by decreasing rank and every slot lists the arcs entering it from higher ranked nodes, so the
+// sweep reads its arcs and writes its distances front to back and only ever reads the distance
+// of a lower slot, which is already final.
+class PhastSweep {
+public:
+    explicit PhastSweep(const RoutingKit::ContractionHierarchy& ch);
+
+    // Slot of a CH rank (ch.rank[node] for an input node)
+    unsigned slot(unsigned rank) const { return node_count_ - 1 - rank; }
+
+    unsigned nodeCount() const { return node_count_; }
+
+    size_t memoryBytes() const { return first_in_.capacity() * sizeof(unsigned) + arcs_.capacity() * sizeof(DownArc); }
+
+private:
+    friend class PhastQuery;
+
+    // Tail and weight side by side, the sweep needs both for every arc
+    struct DownArc {
+        unsigned source; // Slot of the higher ranked tail, below the slot the arc is stored at
+        unsigned weight;
+    };
+
+    unsigned node_count_;
+    std::vector<unsigned> first_in_; // Arcs of slot s are [first_in_[s], first_in_[s + 1])
+    std::vector<DownArc> arcs_;
+};
+
+// One-to-all distances from a single source: an upward Dijkstra search on the CH followed by
+// one linear sweep over a PhastSweep of the same CH. Reusable; holds one distance per node.
+class PhastQuery {
+public:
+    // Distances from source, which starts at source_distance. Distances below bound are exact;
+    // the others are at least bound (RoutingKit::inf_weight if the slot is unreachable).
+    void run(const RoutingKit::ContractionHierarchy& ch, const PhastSweep& sweep,
+             unsigned source, unsigned source_distance, unsigned bound);
+
+    // Distance of a slot after run()
+    unsigned distance(unsigned slot) const { return distance_[slot]; }
+
+    size_t memoryBytes() const { return distance_.capacity() * sizeof(unsigned); }
+
+private:
+    std::vector<unsigned> distance_; // Indexed by slot
+    std::vector<std::pair<unsigned, unsigned>> heap_; // (distance, rank), stale entries skipped
+};
+
+} // namespace RoutingServer
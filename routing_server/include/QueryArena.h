@@ -0,0 +1,107 @@
+#pragma once
+
+#include "PhastSweep.h"
+#include "ShortcutTotals.h"
+#include <routingkit/contraction_hierarchy.h>
+#include <routingkit/customizable_contraction_hierarchy.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace RoutingServer {
+
+// Fixed set of reusable query slots shared by all request threads.
+// Slots are claimed with a compare-and-swap on a per-slot flag, so acquire and release never lock.
+// If every slot is busy the caller spins briefly and then falls back to a temporary slot.
+class QueryArena {
+public:
+    // Queries held by one slot; each one is created on first use so unused metrics cost no memory
+    class Slot {
+    public:
+        // Query for one of the (at most two) plain CHs, rebound if the CH at that index changed
+        RoutingKit::ContractionHierarchyQuery& chQuery(unsigned index, const RoutingKit::ContractionHierarchy& ch);
+
+        // Query for a CCH metric, reset to the given metric
+        RoutingKit::CustomizableContractionHierarchyQuery& cchQuery(const RoutingKit::CustomizableContractionHierarchyMetric& metric);
+
+        // Totals-only search, sized for the node count on first use
+        ShortcutTotalsQuery& totalsQuery(unsigned node_count);
+        
+        // One-to-all search, sized for the node count on first use
+        PhastQuery& phastQuery(unsigned node_count);
+
+        // Estimated bytes held by the queries of this slot
+        size_t memoryBytes() const { return memory_bytes_.load(std::memory_order_relaxed); }
+
+    private:
+        friend class QueryArena;
+
+        std::unique_ptr<RoutingKit::ContractionHierarchyQuery> ch_queries_[2];
+        const RoutingKit::ContractionHierarchy* chs_[2] = {nullptr, nullptr};
+        std::unique_ptr<RoutingKit::CustomizableContractionHierarchyQuery> cch_query_;
+        std::unique_ptr<ShortcutTotalsQuery> totals_query_;
+        std::unique_ptr<PhastQuery> phast_query_;
+        std::atomic<size_t> memory_bytes_{0};
+        std::atomic<bool> in_use_{false};
+    };
+
+    // Exclusive use of a slot, released on destruction
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept : slot_(other.slot_), temporary_(std::move(other.temporary_)) { other.slot_ = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        Slot& operator*() const { return *slot_; }
+        Slot* operator->() const { return slot_; }
+
+    private:
+        friend class QueryArena;
+        Lease(Slot* slot, std::unique_ptr<Slot> temporary) : slot_(slot), temporary_(std::move(temporary)) {}
+
+        Slot* slot_;
+        std::unique_ptr<Slot> temporary_; // Set for fallback slots that are not part of the arena
+    };
+
+    struct Stats {
+        size_t slot_count = 0;
+        size_t slots_in_use = 0;
+        uint64_t hits = 0;                  // Acquired a slot on the first scan
+        uint64_t waits = 0;                 // Found every slot busy and had to retry
+        uint64_t temporary_allocations = 0; // Gave up waiting and built throwaway queries
+        size_t memory_bytes = 0;            // Estimated bytes held by all slots
+    };
+
+    explicit QueryArena(unsigned slot_count);
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    Lease acquire();
+
+    Stats stats() const;
+
+    unsigned slotCount() const { return slot_count_; }
+
+private:
+    bool tryClaim(unsigned index);
+
+    // Slot the calling thread used last in this arena; starting the scan there keeps a thread on
+    // warm memory. Kept per arena, as a thread serves the engines of several regions.
+    unsigned& preferredSlot() const;
+
+    // Scans before the caller falls back to a temporary slot
+    static constexpr unsigned MAX_ACQUIRE_ROUNDS = 64;
+
+    const uint64_t id_; // Unique among all arenas of the process, never reused
+    const unsigned slot_count_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> waits_{0};
+    std::atomic<uint64_t> temporary_allocations_{0};
+};
+
+} // namespace RoutingServer
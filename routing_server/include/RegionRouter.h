@@ -0,0 +1,127 @@
+#pragma once
+
+#include "EngineHolder.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace RoutingServer {
+
+// Latitude/longitude rectangle covered by a region's graph
+struct RegionBounds {
+    double min_lat;
+    double min_lon;
+    double max_lat;
+    double max_lon;
+
+    bool contains(double lat, double lon) const {
+        return lat >= min_lat && lat <= max_lat && lon >= min_lon && lon <= max_lon;
+    }
+    double area() const { return (max_lat - min_lat) * (max_lon - min_lon); }
+};
+
+struct RegionConfig {
+    std::string name; // e.g. a NUTS code
+    EngineConfig engine;
+    std::optional<RegionBounds> bounds; // No bounds: the region covers every coordinate
+    bool preload = false;               // Load at startup instead of on first use
+};
+
+// Routing engines of several regions (OSM extracts), each loaded on first use and
+// evicted least recently used first once more than max_loaded regions are in memory.
+// A request goes to the smallest region whose bounds contain all of its coordinates.
+// Evicted engines stay alive until the requests still holding them finish, and are then
+// destroyed on a background thread, so no request waits for a reload or the memory release.
+// A cold load runs on the request that needs the region: it and every other request for that
+// region wait until the engine is built (seconds from a current snapshot and address store,
+// up to the full graph and CH build without them). Preload regions to keep that off requests.
+class RegionRouter {
+public:
+    struct RegionStatus {
+        std::string name;
+        std::optional<RegionBounds> bounds;
+        bool loaded = false;
+        uint64_t loads = 0;
+        EngineHolder::ReloadStatus reload;           // Of the loaded engine only
+        std::shared_ptr<const EngineHolder::Current> current; // Null if not loaded
+    };
+
+    // Regions from a JSON file: {"max_loaded_regions": n, "regions": [{"name": ..., "osm_file": ...,
+    // "bbox": [min_lat, min_lon, max_lat, max_lon], ...}]}; throws std::runtime_error if invalid
+    static std::vector<RegionConfig> loadConfig(const std::string& file, size_t& max_loaded);
+
+    // Lazily loaded regions (0 max_loaded means no limit); preload regions are built right away
+    RegionRouter(std::vector<RegionConfig> regions, size_t max_loaded);
+
+    // Single region covering everything, with an engine that is already built
+    RegionRouter(EngineConfig config, std::shared_ptr<RoutingEngine> engine);
+    ~RegionRouter();
+
+    RegionRouter(const RegionRouter&) = delete;
+    RegionRouter& operator=(const RegionRouter&) = delete;
+
+    size_t size() const { return regions_.size(); }
+    bool sharded() const { return sharded_; } // Configured from a region file
+    const std::string& name(size_t index) const { return regions_[index]->config.name; }
+
+    // Smallest region containing all points (the first region for no points)
+    std::optional<size_t> find(const std::vector<std::pair<double, double>>& points) const;
+    std::optional<size_t> findByName(const std::string& name) const;
+
+    // Engine of a region, built first if it is not loaded; throws if building fails
+    std::shared_ptr<const EngineHolder::Current> acquire(size_t index);
+
+    // Engine of a region if it is loaded, without loading or touching the LRU order
+    std::shared_ptr<const EngineHolder::Current> peek(size_t index) const;
+
+    // Start a reload of every loaded region; returns how many were started
+    size_t startReload();
+
+    std::vector<RegionStatus> status() const;
+
+    // Installed on the holder of every region (with nullptr to remove it)
+    void setReloadListener(std::function<void()> listener);
+
+private:
+    struct Region {
+        RegionConfig config;
+        std::mutex load_mutex; // Serializes loading and eviction of this region
+        std::shared_ptr<EngineHolder> holder; // Read with atomic_load
+        std::atomic<uint64_t> last_used{0};
+        std::atomic<uint64_t> loads{0};
+    };
+
+    void evictIfNeeded(size_t keep_index);
+
+    // Holder whose destruction is handed to the release thread, wherever its last reference goes
+    std::shared_ptr<EngineHolder> makeHolder(EngineConfig config, std::shared_ptr<RoutingEngine> engine);
+    void release(EngineHolder* holder);
+    void releaseLoop();
+    // Drop every loaded holder and join the release thread once they are destroyed
+    void shutdown();
+
+    std::vector<std::unique_ptr<Region>> regions_;
+    size_t max_loaded_;
+    bool sharded_;
+    std::atomic<uint64_t> clock_{0};
+
+    mutable std::mutex listener_mutex_;
+    std::function<void()> listener_;
+
+    std::mutex release_mutex_; // Guards release_queue_ and release_stop_
+    std::condition_variable release_cv_;
+    std::vector<EngineHolder*> release_queue_;
+    bool release_stop_ = false;
+    std::thread release_thread_;
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <zlib.h>
+
+namespace RoutingServer {
+
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Deflate,
+    Zstd, // Only negotiated when built with ROUTING_HAVE_ZSTD
+};
+
+// Pick the best supported encoding for an Accept-Encoding header.
+// A missing header yields gzip, which existing clients rely on.
+ContentEncoding negotiateContentEncoding(const std::string& accept_encoding, bool header_present);
+
+// Content-Encoding header value (empty for identity)
+const char* contentEncodingName(ContentEncoding encoding);
+
+// Incrementally compresses a response body. Falls back to identity if the compressor
+// cannot be initialized, so encoding() is what actually ends up in the body. A compressor
+// error after that throws std::runtime_error from write() or finish(), which fails the request
+// with a 500 instead of sending a truncated body.
+class ResponseEncoder {
+public:
+    explicit ResponseEncoder(ContentEncoding encoding);
+    ~ResponseEncoder();
+
+    ResponseEncoder(const ResponseEncoder&) = delete;
+    ResponseEncoder& operator=(const ResponseEncoder&) = delete;
+
+    void write(const char* data, size_t size);
+
+    // Finish the stream and hand out the encoded body
+    std::string finish();
+
+    ContentEncoding encoding() const { return encoding_; }
+
+    // Uncompressed bytes written so far
+    size_t inputSize() const { return input_size_; }
+
+    // Microseconds spent in the compressor so far (0 for identity)
+    long long compressTimeUs() const { return compress_time_ns_ / 1000; }
+
+private:
+    void deflateChunk(const char* data, size_t size, int flush);
+
+    ContentEncoding encoding_;
+    std::string output_;
+    size_t input_size_ = 0;
+    long long compress_time_ns_ = 0;
+    z_stream zs_;
+    bool zs_initialized_ = false;
+    struct ZstdState;
+    std::unique_ptr<ZstdState> zstd_;
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ShardedLruCache.h"
+#include <crow.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace RoutingServer {
+
+// Cache of finished route responses (already encoded and compressed), bounded by bytes.
+// Keys hold the request coordinates quantized to 1e-7 degrees rather than the snapped nodes,
+// because responses include the walking segments from the exact coordinates to the nodes.
+class RouteCache {
+public:
+    struct Key {
+        uint64_t engine_instance = 0;     // So responses of a replaced or evicted engine never match
+        uint8_t endpoint = 0;             // Distinguishes shortest_path from complete_job_route
+        std::array<uint64_t, 3> points{}; // Quantized coordinates (unused ones stay 0)
+        uint32_t max_speed_kmh = 0;       // 0 means no limit
+        uint64_t speed_multiplier_bits = 0;
+        uint8_t metric = 0;
+        uint8_t format = 0;
+        uint8_t encoding = 0;
+        bool include_path = true;
+
+        bool operator==(const Key& other) const {
+            return engine_instance == other.engine_instance && endpoint == other.endpoint && points == other.points && max_speed_kmh == other.max_speed_kmh &&
+                   speed_multiplier_bits == other.speed_multiplier_bits && metric == other.metric &&
+                   format == other.format && encoding == other.encoding && include_path == other.include_path;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    // ROUTE_CACHE_BYTES, default 256 MB; 0 disables the cache
+    static size_t defaultCapacityBytes();
+
+    explicit RouteCache(size_t capacity_bytes);
+
+    bool enabled() const { return cache_.enabled(); }
+
+    static uint64_t quantize(double latitude, double longitude);
+    static uint64_t doubleBits(double value);
+
+    // Copy of the cached response for the key, if present
+    std::optional<crow::response> lookup(const Key& key);
+
+    // Remember a response (only 200 responses are kept)
+    void store(const Key& key, const crow::response& response);
+
+    // Drop everything, e.g. after the graph was reloaded
+    void clear() { cache_.clear(); }
+
+    CacheStats stats() const { return cache_.stats(); }
+
+private:
+    struct Entry {
+        int code;
+        std::string body;
+        std::vector<std::pair<std::string, std::string>> headers;
+    };
+
+    ShardedLruCache<Key, std::shared_ptr<const Entry>, KeyHash> cache_;
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "RoutingEngine.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace RoutingServer {
+
+// Encoding of the path in route responses
+enum class RouteFormat {
+    Json,     // One object per point (default)
+    Columnar, // JSON with polyline-encoded columns
+    Binary,   // Compact little-endian binary with varint columns
+};
+
+// Parse the format parameter ("json", "columnar", "binary"); nullopt if unknown
+std::optional<RouteFormat> parseRouteFormat(const std::string& format_param);
+
+// Inputs of a route, handed out as a token with metadata-only responses so that the geometry
+// can be fetched later from /api/v1/route_geometry
+struct RouteToken {
+    std::vector<std::pair<double, double>> points; // from, to or from, via, to
+    RoutingMetric metric = RoutingMetric::TravelTime;
+    uint32_t max_speed_kmh = 0; // 0 means no limit
+    double speed_multiplier = 1.0;
+    std::string region; // Region parameter of the request, empty if none
+};
+
+// Compact route encodings. Every column is delta encoded point to point:
+// coordinates at 1e-6 degrees, cumulative time in ms and cumulative distance in m.
+// Speeds are run-length encoded as (speed, count) pairs, and walking flags as alternating
+// run lengths starting with a non-walking run.
+class RouteCodec {
+public:
+    static constexpr double COORDINATE_PRECISION = 1e6;
+    static constexpr uint32_t BINARY_MAGIC = 0x31425452; // "RTB1"
+    static constexpr uint8_t BINARY_VERSION = 1;
+
+    // Google encoded polyline of the coordinates, at COORDINATE_PRECISION
+    static std::string encodePolyline(const std::vector<RoutePoint>& points);
+
+    // Same character encoding as polylines, applied to other integer columns
+    static std::string encodeTimeDeltas(const std::vector<RoutePoint>& points);
+    static std::string encodeDistanceDeltas(const std::vector<RoutePoint>& points);
+    static std::string encodeSpeedRuns(const std::vector<RoutePoint>& points);
+    static std::string encodeWalkingRuns(const std::vector<RoutePoint>& points);
+
+    // Binary route: header (magic, version, flags, travel time, distance, point count) followed by
+    // LEB128 varint columns in the order lat, lon, time, distance, speed runs, walking runs
+    static std::string encodeBinary(const RoutingResult& result, const std::vector<RoutePoint>& points);
+
+    // Route token as URL-safe base64 (no padding) of: version, metric, point count, region length
+    // and bytes, varint speed cap, speed multiplier bits, then zigzag varint coordinates at 1e-7
+    // degrees (the route cache quantization, so a token finds the response of its request)
+    static constexpr uint8_t TOKEN_VERSION = 1;
+    static std::string encodeRouteToken(const RouteToken& token);
+
+    // nullopt if the token is malformed or of another version
+    static std::optional<RouteToken> decodeRouteToken(const std::string& token);
+
+private:
+    static void appendPolylineValue(std::string& out, int64_t value);
+    static void appendVarint(std::string& out, uint64_t value);
+    static bool readVarint(const std::string& in, size_t& pos, uint64_t& value);
+    static uint64_t zigZag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+
+    // Integer columns shared by both encodings
+    static std::vector<int64_t> coordinateDeltas(const std::vector<RoutePoint>& points, bool latitude);
+    static std::vector<int64_t> timeDeltas(const std::vector<RoutePoint>& points);
+    static std::vector<int64_t> distanceDeltas(const std::vector<RoutePoint>& points);
+    static std::vector<int64_t> speedRuns(const std::vector<RoutePoint>& points);
+    static std::vector<int64_t> walkingRuns(const std::vector<RoutePoint>& points);
+};
+
+} // namespace RoutingServer
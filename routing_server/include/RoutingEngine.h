@@ -3,9 +3,19 @@
 #include <routingkit/osm_graph_builder.h>
 #include <routingkit/osm_profile.h>
 #include <routingkit/contraction_hierarchy.h>
+#include <routingkit/customizable_contraction_hierarchy.h>
 #include <routingkit/inverse_vector.h>
 #include <routingkit/geo_position_to_node.h>
 #include <crow/json.h>
+#include "AddressStore.h"
+#include "SamplingGrid.h"
+#include "ShardedLruCache.h"
+#include "QueryArena.h"
+#include "ShortcutTotals.h"
+#include "PhastSweep.h"
+#include "WorkerPool.h"
+#include "RoutingProfile.h"
+#include "JobCandidateTable.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -14,12 +24,26 @@
 #include <optional>
 #include <functional>
 #include <mutex>
+#include <list>
+#include <map>
 #include <queue>
 #include <thread>
 #include <cstdlib>
 
 namespace RoutingServer {
 
+// Metric a route is optimized for
+enum class RoutingMetric {
+    TravelTime,  // Fastest route (travel time CH)
+    GeoDistance  // Shortest route (geo distance CH)
+};
+
+// How much of a route a query produces
+enum class RouteDetail {
+    Path,  // Node and arc path, for the route geometry
+    Totals // Total time and distance only; node_path stays empty and arc_path may too
+};
+
 // Results from a routing query
 struct RoutingResult {
     unsigned source_node;
@@ -40,6 +64,49 @@ struct RoutingResult {
     double end_lon = 0.0;
 };
 
+// Coordinate snapped to its nearest routing node
+struct SnappedPoint {
+    double latitude;
+    double longitude;
+    unsigned node;
+    double walking_distance_m; // Distance from the coordinate to the node
+};
+
+// Results of a from -> via -> to job route
+struct JobRouteResult {
+    RoutingResult leg1; // from -> via
+    RoutingResult leg2; // via -> to
+    bool success = false;
+    unsigned failed_leg = 0; // 1 or 2 if a leg has no route, 0 otherwise
+    unsigned total_travel_time_ms = 0;
+    unsigned total_geo_distance_m = 0;
+};
+
+// Results from a many-to-many query
+struct MatrixResult {
+    unsigned source_count = 0;
+    unsigned target_count = 0;
+    // Row-major source x target values: milliseconds for TravelTime, meters for GeoDistance,
+    // walking to and from the snapped nodes included; RoutingKit::inf_weight if unreachable
+    std::vector<unsigned> values;
+    std::vector<bool> source_snapped;
+    std::vector<bool> target_snapped;
+    long long query_time_us = 0;
+    
+    unsigned at(unsigned source, unsigned target) const { return values[source * target_count + target]; }
+};
+
+// Addresses reachable from a coordinate within a travel time budget
+struct ReachableResult {
+    bool source_snapped = false;
+    size_t reachable_count = 0; // Reachable addresses before sampling
+    // Addresses by increasing travel time; a uniform sample without replacement if more than the
+    // requested count are reachable
+    std::vector<Address> addresses;
+    std::vector<unsigned> travel_times_ms; // Per address, walking to and from the nodes included
+    long long query_time_us = 0;
+};
+
 // Point on the route with travel time and distance
 struct RoutePoint {
     float latitude;
@@ -51,56 +118,44 @@ struct RoutePoint {
     bool is_walking_segment; // True if this is a walking segment to/from exact coordinates
 };
 
-// Address information
-struct Address {
-    unsigned id;
-    double latitude;
-    double longitude;
-    std::string street;
-    std::string housenumber;
-    std::string postcode;
-    std::string city;
-    
-    // Convert to JSON representation
-    crow::json::wvalue toJson() const {
-        crow::json::wvalue json;
-        json["id"] = id;
-        json["lat"] = latitude;
-        json["lon"] = longitude;
-        json["street"] = street;
-        json["house_number"] = housenumber;
-        json["postcode"] = postcode;
-        json["city"] = city;
-        return json;
-    }
-};
-
-// Custom routing profile functions
-bool is_osm_way_used_by_custom_profile(uint64_t osm_way_id, const RoutingKit::TagMap& tags, 
-                                       std::function<void(const std::string&)> log_message = nullptr);
-
-unsigned get_custom_profile_speed(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
-                                  std::function<void(const std::string&)> log_message = nullptr);
-
-RoutingKit::OSMWayDirectionCategory get_custom_profile_direction_category(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
-                                                                          std::function<void(const std::string&)> log_message = nullptr);
-
 // Main routing engine class
 class RoutingEngine {
 public:
     // Initialize with OSM data file
     // Optionally provide path to pre-built contraction hierarchy file (for geo distance)
-    explicit RoutingEngine(const std::string& osm_file, const std::string& ch_geo_file = "");
+    // and to a graph snapshot file and travel time CH file (derived from the OSM file name if empty)
+    explicit RoutingEngine(const std::string& osm_file, const std::string& ch_geo_file = "",
+                           const std::string& snapshot_file = "", const std::string& ch_time_file = "");
     
     // Load addresses from CSV file
     bool loadAddressesFromCSV(const std::string& csv_file);
     
+    // Load categorized places (extract_categorized_places output) for category filtered sampling.
+    // Each place is attached to its nearest address within max_address_distance_m; others are dropped.
+    // Must be called after loadAddressesFromCSV.
+    bool loadPlacesFromCSV(const std::string& places_file, float max_address_distance_m = 250.0f);
+    
+    // Categories with at least one place attached to an address
+    std::vector<std::string> getPlaceCategories() const;
+    bool hasPlaceCategory(const std::string& category) const { return category_grids_.count(category) > 0; }
+    
+    // Load a precomputed job candidate table (osm_utils_cpp precompute_job_candidates output).
+    // Its address ids must refer to the loaded address file, so this fails unless the table was
+    // built from a file of the same size and modification time. Must be called after loadAddressesFromCSV.
+    bool loadJobCandidates(const std::string& job_candidates_file);
+    
+    // Loaded job candidate table, nullptr if none
+    const JobCandidateTable* getJobCandidates() const { return job_candidates_.get(); }
+    
     // Find nearest node to given coordinates
     unsigned findNearestNode(double latitude, double longitude, unsigned max_radius = 1000) const;
     
     // Find nearest address to given coordinates
     Address findNearestAddress(double latitude, double longitude, float max_radius = 1000.0f) const;
     
+    // Address with the given id (returns nullopt if out of range)
+    std::optional<Address> getAddress(unsigned address_id) const;
+    
     // Get closest address to a coordinate (returns nullopt if none found)
     std::optional<Address> getClosestAddress(double latitude, double longitude) const;
     
@@ -113,11 +168,61 @@ public:
                                       std::optional<unsigned> seed = std::nullopt) const;
     
     // Compute shortest path between two nodes
-    RoutingResult computeShortestPath(unsigned from_node, unsigned to_node) const;
+    // With max_speed_kmh the travel time respects the cap; if a CCH speed tier matches,
+    // the route itself is also the fastest one for that cap
+    // RouteDetail::Totals skips unpacking the CH path when the search can sum the totals itself
+    // (no speed cap); otherwise it unpacks the arcs but not the nodes
+    RoutingResult computeShortestPath(unsigned from_node, unsigned to_node,
+                                      RoutingMetric metric = RoutingMetric::TravelTime,
+                                      std::optional<unsigned> max_speed_kmh = std::nullopt,
+                                      RouteDetail detail = RouteDetail::Path) const;
     
     // Compute shortest path between two coordinates (includes walking segments)
     RoutingResult computeShortestPathFromCoordinates(double from_lat, double from_lon, 
-                                                     double to_lat, double to_lon) const;
+                                                     double to_lat, double to_lon,
+                                                     RoutingMetric metric = RoutingMetric::TravelTime,
+                                                     std::optional<unsigned> max_speed_kmh = std::nullopt,
+                                                     RouteDetail detail = RouteDetail::Path) const;
+    
+    // Snap a coordinate to the nearest routing node (nullopt if none within range)
+    std::optional<SnappedPoint> snapCoordinate(double latitude, double longitude) const;
+    
+    // Snap many coordinates at once (in parallel on the worker pool for large batches)
+    std::vector<std::optional<SnappedPoint>> snapCoordinates(const std::vector<std::pair<double, double>>& coordinates) const;
+    
+    // Hit counters of the coordinate -> node and coordinate -> address caches
+    using SnapCache = ShardedLruCache<uint64_t, unsigned>;
+    CacheStats getSnapCacheStats() const { return snap_cache_->stats(); }
+    CacheStats getClosestAddressCacheStats() const { return closest_address_cache_->stats(); }
+    
+    // Compute a route between two already snapped coordinates (includes walking segments)
+    RoutingResult computeShortestPathBetweenSnapped(const SnappedPoint& from, const SnappedPoint& to,
+                                                    RoutingMetric metric = RoutingMetric::TravelTime,
+                                                    std::optional<unsigned> max_speed_kmh = std::nullopt,
+                                                    RouteDetail detail = RouteDetail::Path) const;
+    
+    // Compute both legs of a job route; each coordinate is snapped once and the second
+    // leg runs on the worker pool while the calling thread computes the first
+    JobRouteResult computeJobRoute(double from_lat, double from_lon, double via_lat, double via_lon,
+                                   double to_lat, double to_lon,
+                                   RoutingMetric metric = RoutingMetric::TravelTime,
+                                   std::optional<unsigned> max_speed_kmh = std::nullopt,
+                                   RouteDetail detail = RouteDetail::Path) const;
+    
+    // Compute travel times (or distances) from every source to every target with one
+    // one-to-many CH search per source over the pinned targets
+    MatrixResult computeMatrix(const std::vector<std::pair<double, double>>& sources,
+                               const std::vector<std::pair<double, double>>& targets,
+                               RoutingMetric metric = RoutingMetric::TravelTime) const;
+    
+    // Addresses reachable from a coordinate within max_time_ms on the travel time CH, from one
+    // PHAST search (upward search plus downward sweep) instead of a query per address.
+    // At most max_count addresses are returned, drawn with the seed if more are reachable.
+    ReachableResult computeReachableAddresses(double latitude, double longitude, unsigned max_time_ms,
+                                              unsigned max_count, unsigned seed) const;
+    
+    // Whether computeReachableAddresses is available (PHAST sweep built and addresses loaded)
+    bool hasReachability() const { return phast_time_ != nullptr && !phast_addresses_.empty(); }
     
     // Recalculate total travel time with maximum speed limit applied
     unsigned recalculateTotalTravelTime(const RoutingResult& result, unsigned max_speed_kmh) const;
@@ -141,6 +246,9 @@ public:
     // Get address count
     unsigned getAddressCount() const;
     
+    // Get usage counters of the shared query arena
+    QueryArena::Stats getQueryArenaStats() const;
+    
     // Get bounding box of all addresses
     struct AddressBbox {
         double min_lat;
@@ -168,11 +276,89 @@ public:
     std::optional<Address> getUniformRandomAddressInAnnulus(double center_lat, double center_lon, 
                                                              float min_distance_km, float max_distance_km,
                                                              unsigned seed) const;
+    
+    // Draw count independent uniformly random addresses in an annulus (with replacement).
+    // With a category only addresses attached to places of that category are drawn.
+    // Returns an empty vector if the annulus holds no (matching) address.
+    std::vector<Address> getUniformRandomAddressesInAnnulus(double center_lat, double center_lon,
+                                                            float min_distance_km, float max_distance_km,
+                                                            unsigned seed, unsigned count,
+                                                            const std::string& category = "") const;
 
     // Helper to check if timing logs are enabled
     static bool isTimingEnabled();
+    
+    // Number of Crow request threads (CROW_THREADS, default: hardware concurrency)
+    static unsigned requestThreadCount();
 
 private:
+    // Parse the OSM file with the custom profile into graph_ and way_speed_
+    void loadGraphFromPbf(const std::string& osm_file);
+    
+    // Fill arc_speed_ from graph_.way and way_speed_
+    void buildArcSpeeds();
+    
+    // Per-arc travel time in milliseconds from geo_distance and arc speeds (finite for every arc)
+    // Speeds are capped at max_speed_kmh if given
+    std::vector<unsigned> computeArcTravelTimes(std::optional<unsigned> max_speed_kmh = std::nullopt) const;
+    
+    // Build the customizable CH and customize one metric per speed tier (ROUTING_CCH=1)
+    void initCustomizableHierarchy(const std::string& order_file);
+    
+    // CCH metric customized for a speed cap
+    struct CchSpeedTier {
+        unsigned max_speed_kmh;
+        std::vector<unsigned> weights; // Referenced by metric, must outlive it
+        std::unique_ptr<RoutingKit::CustomizableContractionHierarchyMetric> metric;
+    };
+    
+    // Tier closest to the requested speed cap (nullptr if CCH mode is off)
+    const CchSpeedTier* findSpeedTier(unsigned max_speed_kmh) const;
+    
+    // Load a CH from disk, or build it from the given arc weights and save it
+    std::unique_ptr<RoutingKit::ContractionHierarchy> loadOrBuildContractionHierarchy(
+        const std::string& ch_file_path, const std::string& metric_name,
+        const std::function<std::vector<unsigned>()>& compute_weights,
+        const std::vector<unsigned>* given_rank = nullptr) const;
+    
+    // Restore the graph and CH from a snapshot (returns false if missing, stale or unreadable)
+    bool loadGraphSnapshot(const std::string& snapshot_file, const std::string& osm_file);
+    
+    // Write the graph and CH to a snapshot for the next startup
+    void saveGraphSnapshot(const std::string& snapshot_file, const std::string& osm_file) const;
+    
+    // Fill address_nodes_ and address_key_order_ after addresses are loaded
+    void precomputeAddressNodes();
+    
+    // Nearest routing node of a coordinate: exact address coordinates use the precomputed
+    // address nodes, other coordinates go through the snap cache before the geometric lookup
+    unsigned snapNode(double latitude, double longitude) const;
+    
+    // Coordinate quantized to the address store's 1e-7 degree fixed point, packed into one key
+    static uint64_t coordinateKey(double latitude, double longitude);
+    
+    // Address whose stored coordinate equals the key, if any
+    std::optional<unsigned> findAddressAtKey(uint64_t key) const;
+    
+    // Fill ch_time_totals_ and ch_geo_totals_ (SHORTCUT_TOTALS=0 disables them)
+    void buildShortcutTotals();
+    
+    // Fill phast_time_ (PHAST=0 disables it, and with it /api/v1/reachable)
+    void buildPhastSweep();
+    
+    // Fill phast_addresses_ from address_nodes_ once both the sweep and the addresses exist
+    void buildPhastAddresses();
+    
+    // Query object for the CH of a metric, owned by an arena slot
+    RoutingKit::ContractionHierarchyQuery& chQuery(QueryArena::Slot& slot, RoutingMetric metric) const;
+    
+    // Time needed to walk a distance at walking speed
+    static unsigned walkingTimeMs(double distance_m) { return static_cast<unsigned>(distance_m * 1000.0 / WALKING_SPEED_MPS); }
+    
+    // Sorted ids of the seeded random sample of number (< address count) addresses.
+    // Recent samples are cached so later pages of the same sample are cheap.
+    std::shared_ptr<const std::vector<unsigned>> sampleAddressIds(unsigned number, unsigned seed) const;
+    
     // Generate a point in an annulus
     std::pair<double, double> generateAnnulusPoint(double center_lat, double center_lon, 
                                                  float r_min, float r_max, 
@@ -184,41 +370,72 @@ private:
     // Convert degrees to radians
     static constexpr double toRadians(double degrees) { return degrees * M_PI / 180.0; }
     
-    // Query pool management for ContractionHierarchyQuery reuse
-    class QueryPool {
-    public:
-        explicit QueryPool(RoutingKit::ContractionHierarchy& ch, unsigned pool_size);
-        ~QueryPool();
-        
-        // Acquire a query from the pool (returns nullptr if pool exhausted)
-        RoutingKit::ContractionHierarchyQuery* acquire();
-        
-        // Release a query back to the pool
-        void release(RoutingKit::ContractionHierarchyQuery* query);
-        
-    private:
-        RoutingKit::ContractionHierarchy& ch_;
-        std::vector<std::unique_ptr<RoutingKit::ContractionHierarchyQuery>> queries_;
-        std::queue<RoutingKit::ContractionHierarchyQuery*> available_;
-        std::mutex mutex_;
-    };
-    
     // Custom routing graph data
     RoutingKit::OSMRoutingGraph graph_;
     std::vector<unsigned> way_speed_;
-    std::unique_ptr<RoutingKit::ContractionHierarchy> ch_;
+    std::vector<uint16_t> arc_speed_; // Speed of every arc in km/h, saturated at 65535
+    std::vector<unsigned> tail_;
+    std::unique_ptr<RoutingKit::ContractionHierarchy> ch_time_;
     std::unique_ptr<RoutingKit::ContractionHierarchy> ch_geo_;
+    std::unique_ptr<ShortcutTotals> ch_time_totals_; // Length of every travel time CH arc
+    std::unique_ptr<ShortcutTotals> ch_geo_totals_;  // Uncapped travel time of every geo CH arc
+    std::unique_ptr<PhastSweep> phast_time_;         // Downward arcs of the travel time CH by slot
     std::unique_ptr<RoutingKit::GeoPositionToNode> pos_to_node_;
     
-    // Query pool for reusing ContractionHierarchyQuery objects
-    std::unique_ptr<QueryPool> query_pool_;
+    // Customizable CH with per speed tier metrics, sorted by speed
+    std::unique_ptr<RoutingKit::CustomizableContractionHierarchy> cch_;
+    std::vector<std::unique_ptr<CchSpeedTier>> cch_tiers_;
     
-    // Address data
-    std::vector<Address> addresses_;
+    // Worker threads for parallel route legs (ROUTING_WORKER_THREADS, 0 disables)
+    std::unique_ptr<WorkerPool> worker_pool_;
+    
+    // Reusable query slots shared by all request and worker threads
+    std::unique_ptr<QueryArena> query_arena_;
+    
+    // Address data (the spatial index keeps its own float copy of the coordinates)
+    AddressStore addresses_;
+    std::optional<SnapshotSource> addresses_source_; // Address file the ids of addresses_ refer to
     std::unique_ptr<RoutingKit::GeoPositionToNode> addr_index_;
+    std::unique_ptr<SamplingGrid> address_grid_;
+    
+    // Nearest routing node of every address (invalid_id if none within range), and address ids
+    // sorted by coordinate key so exact address coordinates snap without a geometric lookup
+    std::vector<unsigned> address_nodes_;
+    std::vector<unsigned> address_key_order_;
+    
+    // Snapped addresses sorted by the PHAST slot of their node, so filtering by the distances of
+    // a sweep reads them front to back as well
+    struct PhastAddress {
+        unsigned slot;
+        unsigned address;
+        unsigned walking_time_ms; // Walk between the address and its node
+    };
+    std::vector<PhastAddress> phast_addresses_;
+    
+    // Quantized coordinate -> nearest node / nearest address (SNAP_CACHE_SIZE entries each)
+    std::unique_ptr<SnapCache> snap_cache_;
+    std::unique_ptr<SnapCache> closest_address_cache_;
+    std::map<std::string, std::unique_ptr<SamplingGrid>> category_grids_;
+    std::unique_ptr<JobCandidateTable> job_candidates_;
+    
+    // Recently used address samples, most recent first
+    struct CachedSample {
+        unsigned number;
+        unsigned seed;
+        std::shared_ptr<const std::vector<unsigned>> ids;
+    };
+    static constexpr size_t SAMPLE_CACHE_ENTRIES = 16;
+    static constexpr size_t SAMPLE_CACHE_MAX_IDS = 16 * 1024 * 1024;
+    mutable std::mutex sample_cache_mutex_;
+    mutable std::list<CachedSample> sample_cache_;
+    mutable size_t sample_cache_ids_ = 0;
     
     // Static earth-related constants
     static constexpr float METER_PER_DEGREE = 111111.0f; // Approximation at equator
+    static constexpr double WALKING_SPEED_MPS = 1.67; // 6 km/h
+    
+    // Speed cap for the travel time of shortest (geo distance) routes, effectively unlimited
+    static constexpr unsigned SHORTEST_ROUTE_SPEED_CAP_KMH = 300;
 };
 
 } // namespace RoutingServer 
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <routingkit/osm_graph_builder.h>
+#include <routingkit/osm_profile.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace RoutingServer {
+
+// Custom routing profile: which OSM ways are routed, at what speed and in which direction.
+// The server and the offline graph export (osm_utils_cpp export_routing_graph) both build their
+// graph with it; bump GraphSnapshot::PROFILE_VERSION whenever a change alters that graph.
+bool is_osm_way_used_by_custom_profile(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
+                                       std::function<void(const std::string&)> log_message = nullptr);
+
+unsigned get_custom_profile_speed(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
+                                  std::function<void(const std::string&)> log_message = nullptr);
+
+RoutingKit::OSMWayDirectionCategory get_custom_profile_direction_category(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
+                                                                          std::function<void(const std::string&)> log_message = nullptr);
+
+// Routing graph of the custom profile with the speed of every routing way (indexed by graph.way)
+struct ProfileGraph {
+    RoutingKit::OSMRoutingGraph graph;
+    std::vector<unsigned> way_speed;
+};
+
+// Read a PBF file twice (ID mapping, then graph) and evaluate the profile once per way
+ProfileGraph loadProfileGraphFromPbf(const std::string& osm_file,
+                                     const std::function<void(const std::string&)>& log_message);
+
+} // namespace RoutingServer
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "AddressStore.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace RoutingServer {
+
+// Index for drawing uniformly random addresses from a ring (annulus) around a point.
+// Addresses are bucketed into a uniform lat/lon grid. For a ring, cells entirely inside it are
+// only counted and cells crossed by its boundary are scanned. Each row of the ring's bounding
+// box finds its inside and boundary cells by bisection, so preparing a ring costs
+// O(rows * log columns + boundary cells + addresses in boundary cells) and each draw
+// O(log rows) rather than anything proportional to the area of the ring.
+class SamplingGrid {
+public:
+    // Grid over the given address ids (may repeat); addresses must outlive the grid
+    SamplingGrid(const AddressStore& addresses, std::vector<unsigned> ids);
+
+    // Grid over all addresses
+    explicit SamplingGrid(const AddressStore& addresses);
+
+    size_t size() const { return ids_.size(); }
+
+    // Addresses of one ring, prepared for any number of draws
+    class Ring {
+    public:
+        size_t size() const { return inside_count_ + boundary_ids_.size(); }
+
+        // Uniformly random address id from the ring (with replacement); size() must be > 0
+        unsigned draw(std::mt19937& gen) const;
+
+    private:
+        friend class SamplingGrid;
+
+        const SamplingGrid* grid_ = nullptr;
+        std::vector<uint32_t> inside_begins_; // Runs of ids_ entirely inside the ring, one per row side
+        std::vector<uint64_t> inside_ends_;   // Cumulative point counts of the runs
+        uint64_t inside_count_ = 0;
+        std::vector<unsigned> boundary_ids_;  // Ring members found in boundary cells
+    };
+
+    // Addresses at great-circle distance in [min_distance_m, max_distance_m] from the center
+    Ring ring(double center_lat, double center_lon, double min_distance_m, double max_distance_m) const;
+
+private:
+    void build(std::vector<unsigned> ids);
+
+    // Average number of addresses per non-empty cell the grid size aims for
+    static constexpr double TARGET_POINTS_PER_CELL = 32.0;
+
+    const AddressStore& addresses_;
+    double min_lat_ = 0.0;
+    double min_lon_ = 0.0;
+    double cell_lat_ = 1.0; // Cell height in degrees
+    double cell_lon_ = 1.0; // Cell width in degrees
+    uint32_t rows_ = 0;
+    uint32_t cols_ = 0;
+    std::vector<uint32_t> cell_start_; // rows_ * cols_ + 1 offsets into ids_
+    std::vector<unsigned> ids_;        // Address ids grouped by cell
+};
+
+} // namespace RoutingServer
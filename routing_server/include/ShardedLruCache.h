@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace RoutingServer {
+
+// Counters of a ShardedLruCache; cost and capacity are in the cache's cost unit
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t cost = 0;
+    size_t capacity = 0;
+};
+
+// Thread-safe LRU cache split into independently locked shards.
+// Every entry has a cost (1 by default, or e.g. its size in bytes); each shard evicts its least
+// recently used entries once its share of the total capacity is exceeded. A capacity of 0
+// disables the cache: get() always misses and put() does nothing.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLruCache {
+public:
+    using Stats = CacheStats;
+
+    explicit ShardedLruCache(size_t capacity, size_t shard_count = 16)
+        : capacity_(capacity), shard_capacity_(capacity / std::max<size_t>(1, shard_count)) {
+        shards_.reserve(shard_count);
+        for (size_t i = 0; i < std::max<size_t>(1, shard_count); ++i) {
+            shards_.push_back(std::make_unique<Shard>());
+        }
+        if (capacity_ > 0 && shard_capacity_ == 0) {
+            shard_capacity_ = 1;
+        }
+    }
+
+    ShardedLruCache(const ShardedLruCache&) = delete;
+    ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+    bool enabled() const { return capacity_ > 0; }
+
+    std::optional<Value> get(const Key& key) {
+        if (!enabled()) {
+            return std::nullopt;
+        }
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second->value;
+    }
+
+    void put(const Key& key, Value value, size_t cost = 1) {
+        if (!enabled() || cost > shard_capacity_) {
+            return;
+        }
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.cost -= it->second->cost;
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+        }
+        shard.entries.push_front(Entry{key, std::move(value), cost});
+        shard.index.emplace(key, shard.entries.begin());
+        shard.cost += cost;
+        while (shard.cost > shard_capacity_) {
+            const Entry& oldest = shard.entries.back();
+            shard.cost -= oldest.cost;
+            shard.index.erase(oldest.key);
+            shard.entries.pop_back();
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void clear() {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->entries.clear();
+            shard->index.clear();
+            shard->cost = 0;
+        }
+    }
+
+    Stats stats() const {
+        Stats stats;
+        stats.hits = hits_.load(std::memory_order_relaxed);
+        stats.misses = misses_.load(std::memory_order_relaxed);
+        stats.evictions = evictions_.load(std::memory_order_relaxed);
+        stats.capacity = capacity_;
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            stats.entries += shard->entries.size();
+            stats.cost += shard->cost;
+        }
+        return stats;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        size_t cost;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; // Most recently used first
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+        size_t cost = 0;
+    };
+
+    Shard& shardFor(const Key& key) {
+        // Mix the hash so the shard does not correlate with the bucket inside the shard
+        uint64_t hash = static_cast<uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ULL;
+        return *shards_[(hash >> 32) % shards_.size()];
+    }
+
+    size_t capacity_;
+    size_t shard_capacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+} // namespace RoutingServer
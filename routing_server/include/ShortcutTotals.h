@@ -0,0 +1,66 @@
+#pragma once
+
+#include <routingkit/contraction_hierarchy.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace RoutingServer {
+
+// Sum of a second per-arc value (e.g. the length on the travel time CH) over the input arcs
+// behind every CH arc, shortcuts included. With it the totals of a route follow from the
+// up-down path of the CH search, without unpacking the shortcuts into input arcs.
+class ShortcutTotals {
+public:
+    // arc_values holds one value per input arc of the graph the CH was built from; sums wrap at 2^32
+    ShortcutTotals(const RoutingKit::ContractionHierarchy& ch, const std::vector<unsigned>& arc_values);
+
+    unsigned forward(unsigned arc) const { return forward_[arc]; }
+    unsigned backward(unsigned arc) const { return backward_[arc]; }
+
+    size_t memoryBytes() const { return (forward_.capacity() + backward_.capacity()) * sizeof(unsigned); }
+
+private:
+    std::vector<unsigned> forward_;
+    std::vector<unsigned> backward_;
+};
+
+// Bidirectional upward search with stall-on-demand that carries the ShortcutTotals sum of every
+// tentative path along with its distance, so it reports both totals of the shortest route but
+// never its arcs. Among several shortest routes it may pick a different one than
+// RoutingKit's query. Reusable; holds four values per node.
+class ShortcutTotalsQuery {
+public:
+    struct Result {
+        unsigned distance; // CH weight of the route; RoutingKit::inf_weight if there is none
+        unsigned total;    // Sum of the ShortcutTotals values along the route
+    };
+
+    Result run(const RoutingKit::ContractionHierarchy& ch, const ShortcutTotals& totals,
+               unsigned source, unsigned target);
+
+    size_t memoryBytes() const;
+
+private:
+    // Tentative distances and totals of one search direction, indexed by rank
+    struct Search {
+        std::vector<unsigned> distance;
+        std::vector<unsigned> total;
+        std::vector<unsigned> reached; // Ranks with a finite distance, reset after each run
+        std::vector<std::pair<unsigned, unsigned>> heap; // (distance, rank), stale entries skipped
+
+        void reach(unsigned rank, unsigned new_distance, unsigned new_total);
+        void clear();
+    };
+
+    // Settle the closest node of search; best is updated where it meets other
+    void step(Search& search, const Search& other, const RoutingKit::ContractionHierarchy::Side& up,
+              const RoutingKit::ContractionHierarchy::Side& down, bool forward_side,
+              const ShortcutTotals& totals, Result& best);
+
+    Search forward_;
+    Search backward_;
+};
+
+} // namespace RoutingServer
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace RoutingServer {
+
+// Fixed-size thread pool with a bounded task queue.
+// When the queue is full, submit() runs the task on the calling thread instead of blocking,
+// so a burst of requests degrades to sequential work rather than queueing without limit.
+class WorkerPool {
+public:
+    WorkerPool(unsigned thread_count, size_t max_queued_tasks)
+        : max_queued_tasks_(max_queued_tasks) {
+        threads_.reserve(thread_count);
+        for (unsigned i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        condition_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    template <typename F>
+    std::future<typename std::invoke_result<F>::type> submit(F&& task) {
+        using Result = typename std::invoke_result<F>::type;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!stopping_ && !threads_.empty() && tasks_.size() < max_queued_tasks_) {
+                tasks_.emplace([packaged]() { (*packaged)(); });
+                queued = true;
+            }
+        }
+
+        if (queued) {
+            condition_.notify_one();
+        } else {
+            (*packaged)();
+        }
+        return future;
+    }
+
+    unsigned threadCount() const { return static_cast<unsigned>(threads_.size()); }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                if (stopping_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    const size_t max_queued_tasks_;
+    std::vector<std::thread> threads_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_ = false;
+};
+
+} // namespace RoutingServer
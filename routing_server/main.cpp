@@ -1,5 +1,6 @@
 #include "include/RoutingEngine.h"
 #include "include/ApiHandlers.h"
+#include "include/RegionRouter.h"
 #include "include/Logger.h"
 #include <crow.h>
 #include <memory>
@@ -12,18 +13,26 @@ using namespace RoutingServer;
 int main(int argc, char* argv[]) {
 	LOG("Starting routing server...");
 	
+	// Region sharded mode: the regions file takes the place of the command line arguments
+	const char* regions_config_env = std::getenv("REGIONS_CONFIG");
+	bool sharded = regions_config_env != nullptr && regions_config_env[0] != '\0';
+	
 	// Check command line arguments
-	if (argc < 2 || argc > 4) {
+	if (sharded ? argc != 1 : (argc < 2 || argc > 4)) {
 		LOG("Usage: " << argv[0] << " <osm_file> [addresses_csv_file] [ch_geo_file]");
 		LOG("  osm_file: Path to the OSM data file in PBF format");
 		LOG("  addresses_csv_file: Optional path to a CSV file with address data");
 		LOG("  ch_geo_file: Optional path to pre-built contraction hierarchy file");
+		LOG("   or: REGIONS_CONFIG=<regions_json> " << argv[0] << " (no arguments)");
 		return 1;
 	}
 	
 	// Get OSM file path from arguments
-	std::string osm_file = argv[1];
-	LOG("Using OSM data from " << osm_file);
+	std::string osm_file;
+	if (!sharded) {
+		osm_file = argv[1];
+		LOG("Using OSM data from " << osm_file);
+	}
 	
 	// Get optional addresses file
 	std::string addresses_file;
@@ -43,31 +52,60 @@ int main(int argc, char* argv[]) {
 		LOG("Using CH file from argument: " << ch_geo_file);
 	}
 	
+	// Get optional travel time CH file (from env var, otherwise derived from the OSM file name)
+	std::string ch_time_file;
+	const char* ch_time_file_env = std::getenv("CH_TIME_FILE");
+	if (ch_time_file_env != nullptr) {
+		ch_time_file = ch_time_file_env;
+		LOG("Using travel time CH file from environment: " << ch_time_file);
+	}
+	
+	// Get optional graph snapshot file (from env var, otherwise derived from the OSM file name)
+	std::string snapshot_file;
+	const char* snapshot_file_env = std::getenv("GRAPH_SNAPSHOT_FILE");
+	if (snapshot_file_env != nullptr) {
+		snapshot_file = snapshot_file_env;
+		LOG("Using graph snapshot file from environment: " << snapshot_file);
+	}
+	
 	try {
-		// Initialize the routing engine
-		LOG("Initializing routing engine...");
-		LOG("Starting RoutingEngine constructor with file: " << osm_file);
-		if (!ch_geo_file.empty()) {
-			LOG("CH file specified: " << ch_geo_file);
-		}
-		auto engine = std::make_shared<RoutingEngine>(osm_file, ch_geo_file);
-		LOG("RoutingEngine constructor completed successfully");
-		LOG("Routing engine initialized with " << engine->getNodeCount() << " nodes and " 
-			<< engine->getArcCount() << " arcs");
-		
-		// Load addresses if provided
-		if (!addresses_file.empty()) {
-			LOG("Loading addresses...");
-			if (engine->loadAddressesFromCSV(addresses_file)) {
-				LOG("Loaded " << engine->getAddressCount() << " addresses");
-			} else {
-				LOG("Failed to load addresses from " << addresses_file);
+		std::shared_ptr<RegionRouter> regions;
+		if (sharded) {
+			// Regions are loaded on first use (or at startup with "preload")
+			LOG("Using region config " << regions_config_env);
+			size_t max_loaded = 0;
+			auto region_configs = RegionRouter::loadConfig(regions_config_env, max_loaded);
+			regions = std::make_shared<RegionRouter>(std::move(region_configs), max_loaded);
+		} else {
+			// Initialize the routing engine
+			LOG("Initializing routing engine...");
+			EngineConfig config;
+			config.osm_file = osm_file;
+			config.ch_geo_file = ch_geo_file;
+			config.snapshot_file = snapshot_file;
+			config.ch_time_file = ch_time_file;
+			config.addresses_file = addresses_file;
+			
+			// Optional categorized places for category filtered annulus sampling
+			const char* places_file_env = std::getenv("PLACES_FILE");
+			if (places_file_env != nullptr) {
+				config.places_file = places_file_env;
+			}
+			
+			// Optional precomputed job candidates for /api/v1/job_candidates
+			const char* job_candidates_file_env = std::getenv("JOB_CANDIDATES_FILE");
+			if (job_candidates_file_env != nullptr) {
+				config.job_candidates_file = job_candidates_file_env;
 			}
+			
+			// One region covering everything; /admin/reload rebuilds it from the same files
+			auto engine = EngineHolder::build(config, false);
+			regions = std::make_shared<RegionRouter>(config, std::move(engine));
 		}
 		
 		// Create API handlers
 		LOG("Creating API handlers...");
-		ApiHandlers api_handlers(engine);
+		ApiHandlers api_handlers(regions);
 		
 		// Create and configure the Crow app
 		LOG("Setting up Crow application...");
@@ -78,13 +116,17 @@ int main(int argc, char* argv[]) {
 		api_handlers.registerRoutes(app);
 		
 		// Start the server
-		LOG("Starting HTTP server on port 8080...");
-		app.port(8080).run();
+		// Request threads match the query arena sizing in the engine
+		unsigned request_threads = RoutingEngine::requestThreadCount();
+		LOG("Starting HTTP server on port 8080 with " << request_threads << " threads...");
+		app.port(8080).concurrency(static_cast<std::uint16_t>(request_threads)).run();
 	} catch (const std::exception& e) {
-		LOG("Error: " << e.what());
+		LOG_ERROR(e.what());
+		Logger::instance().flush();
 		return 1;
 	} catch (...) {
-		LOG("Unknown error occurred");
+		LOG_ERROR("Unknown error occurred");
+		Logger::instance().flush();
 		return 1;
 	}
 	
@@ -0,0 +1,442 @@
+#include "../include/AddressLoader.h"
+#include "../include/GraphSnapshot.h"
+#include "../include/Logger.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace RoutingServer {
+
+namespace {
+
+// Inflated bytes handed to one parse task for gzipped input
+constexpr size_t GZIP_BLOCK_SIZE = 16 * 1024 * 1024;
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline const char* skipSpace(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+inline const char* tokenEnd(const char* p, const char* end) {
+    while (p < end && !isSpace(*p)) ++p;
+    return p;
+}
+
+// strtod on a bounded token; false if the token is not a number
+bool parseCoordinate(const char* begin, const char* end, double& value) {
+    char buffer[64];
+    size_t length = std::min(static_cast<size_t>(end - begin), sizeof(buffer) - 1);
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char* parsed_end = nullptr;
+    errno = 0;
+    value = std::strtod(buffer, &parsed_end);
+    return parsed_end != buffer && errno != ERANGE;
+}
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) == 0) {
+            if (st.st_size > 0) {
+                size_ = static_cast<size_t>(st.st_size);
+                void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    data_ = static_cast<const char*>(mapped);
+                    // Advice values are not flags, so each one is its own call
+                    ::madvise(mapped, size_, MADV_SEQUENTIAL);
+                    ::madvise(mapped, size_, MADV_WILLNEED);
+                } else {
+                    size_ = 0;
+                }
+            }
+            // An empty file is opened without a mapping
+            opened_ = st.st_size == 0 || data_ != nullptr;
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool opened() const { return opened_; }
+    const char* data() const { return data_; }
+    size_t size() const { return data_ != nullptr ? size_ : 0; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool opened_ = false;
+};
+
+// Length of the header line if the data starts with one (first character is not a digit)
+size_t headerLength(const char* data, size_t size) {
+    if (size == 0 || std::isdigit(static_cast<unsigned char>(data[0]))) {
+        return 0;
+    }
+    const char* newline = static_cast<const char*>(std::memchr(data, '\n', size));
+    size_t length = newline != nullptr ? static_cast<size_t>(newline - data) + 1 : size;
+    LOG("Skipping header: " << std::string(data, length - (newline != nullptr ? 1 : 0)));
+    return length;
+}
+
+struct PoolSections {
+    SnapshotSection ids;
+    SnapshotSection offsets;
+    SnapshotSection data;
+};
+
+// Section ids per text field, in AddressStore::Field order
+const PoolSections POOL_SECTIONS[AddressStore::FIELD_COUNT] = {
+    {SnapshotSection::AddressStreetIds, SnapshotSection::AddressStreetOffsets, SnapshotSection::AddressStreetData},
+    {SnapshotSection::AddressHouseNumberIds, SnapshotSection::AddressHouseNumberOffsets, SnapshotSection::AddressHouseNumberData},
+    {SnapshotSection::AddressPostcodeIds, SnapshotSection::AddressPostcodeOffsets, SnapshotSection::AddressPostcodeData},
+    {SnapshotSection::AddressCityIds, SnapshotSection::AddressCityOffsets, SnapshotSection::AddressCityData},
+};
+
+// Next field of a comma separated line starting at p, unquoting "..." fields with "" escapes.
+// Returns the position after the separator, or nullptr at the end of the line.
+const char* nextCsvField(const char* p, const char* end, std::string& field) {
+    field.clear();
+    if (p < end && *p == '"') {
+        ++p;
+        while (p < end) {
+            if (*p == '"') {
+                if (p + 1 < end && p[1] == '"') {
+                    field += '"';
+                    p += 2;
+                    continue;
+                }
+                ++p;
+                break;
+            }
+            field += *p++;
+        }
+    }
+    const char* separator = static_cast<const char*>(std::memchr(p, ',', end - p));
+    field.append(p, separator != nullptr ? separator : end);
+    return separator != nullptr ? separator + 1 : nullptr;
+}
+
+} // namespace
+
+unsigned AddressLoader::defaultThreadCount() {
+    unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+    const char* threads_env = std::getenv("ADDRESS_LOAD_THREADS");
+    if (threads_env != nullptr) {
+        try {
+            thread_count = std::max(1u, static_cast<unsigned>(std::stoul(threads_env)));
+        } catch (...) {
+            LOG_WARN("Invalid ADDRESS_LOAD_THREADS, using default " << thread_count);
+        }
+    }
+    return thread_count;
+}
+
+void AddressLoader::parseChunk(const char* begin, const char* end, AddressStore& addresses) {
+    // Same layout as the extract script: "id lon lat" separated by whitespace, then tab separated
+    // street, housenumber, postcode and city (leading whitespace of each field is skipped)
+    const char* line = begin;
+    while (line < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+
+        const char* p = skipSpace(line, line_end);
+        const char* id_end = tokenEnd(p, line_end);
+        const char* lon_begin = skipSpace(id_end, line_end);
+        const char* lon_end = tokenEnd(lon_begin, line_end);
+        const char* lat_begin = skipSpace(lon_end, line_end);
+        const char* lat_end = tokenEnd(lat_begin, line_end);
+
+        // Coordinates outside the valid range would not fit the store's fixed point columns
+        double longitude, latitude;
+        if (id_end > p && lon_end > lon_begin && lat_end > lat_begin &&
+            parseCoordinate(lon_begin, lon_end, longitude) && parseCoordinate(lat_begin, lat_end, latitude) &&
+            std::fabs(longitude) <= 180.0 && std::fabs(latitude) <= 90.0) {
+            p = lat_end;
+            std::string_view fields[AddressStore::FIELD_COUNT];
+            for (int field = 0; field < AddressStore::City; ++field) {
+                p = skipSpace(p, line_end);
+                const char* field_end = static_cast<const char*>(std::memchr(p, '\t', line_end - p));
+                if (field_end == nullptr) {
+                    field_end = line_end;
+                }
+                fields[field] = std::string_view(p, field_end - p);
+                p = field_end < line_end ? field_end + 1 : line_end;
+            }
+            p = skipSpace(p, line_end);
+            fields[AddressStore::City] = std::string_view(p, line_end - p);
+
+            addresses.add(latitude, longitude, fields[AddressStore::Street], fields[AddressStore::HouseNumber],
+                          fields[AddressStore::Postcode], fields[AddressStore::City]);
+        }
+
+        line = line_end + 1;
+    }
+}
+
+std::optional<AddressStore> AddressLoader::loadCsv(const std::string& csv_file, unsigned thread_count) {
+    thread_count = std::max(1u, thread_count);
+    AddressStore addresses;
+
+    if (csv_file.size() >= 3 && csv_file.compare(csv_file.size() - 3, 3, ".gz") == 0) {
+        gzFile gz = gzopen(csv_file.c_str(), "rb");
+        if (gz == nullptr) {
+            LOG_ERROR("Failed to open gzipped address file: " << csv_file);
+            return std::nullopt;
+        }
+        gzbuffer(gz, 1 << 20);
+
+        // Inflate block by block on this thread while earlier blocks are parsed on the others.
+        // A block ends at its last newline; the remainder is carried into the next block.
+        std::deque<std::future<AddressStore>> pending;
+        std::string carry;
+        bool first_block = true;
+        bool read_error = false;
+        while (true) {
+            auto block = std::make_shared<std::string>(std::move(carry));
+            size_t offset = block->size();
+            block->resize(offset + GZIP_BLOCK_SIZE);
+            int read = gzread(gz, &(*block)[offset], static_cast<unsigned>(GZIP_BLOCK_SIZE));
+            if (read < 0) {
+                read_error = true;
+                break;
+            }
+            block->resize(offset + static_cast<size_t>(read));
+            bool done = read == 0;
+
+            size_t parse_end = block->size();
+            if (!done) {
+                size_t last_newline = block->rfind('\n');
+                parse_end = last_newline == std::string::npos ? 0 : last_newline + 1;
+            }
+            carry.assign(*block, parse_end, std::string::npos);
+
+            size_t parse_begin = 0;
+            if (first_block && parse_end > 0) {
+                parse_begin = headerLength(block->data(), parse_end);
+                first_block = false;
+            }
+            if (parse_end > parse_begin) {
+                if (pending.size() >= thread_count) {
+                    addresses.append(pending.front().get());
+                    pending.pop_front();
+                }
+                pending.push_back(std::async(std::launch::async, [block, parse_begin, parse_end]() {
+                    AddressStore part;
+                    parseChunk(block->data() + parse_begin, block->data() + parse_end, part);
+                    return part;
+                }));
+            }
+            if (done) {
+                break;
+            }
+        }
+        gzclose(gz);
+        for (auto& part : pending) {
+            addresses.append(part.get());
+        }
+        if (read_error) {
+            LOG_ERROR("Failed to decompress address file: " << csv_file);
+            return std::nullopt;
+        }
+    } else {
+        MappedFile file(csv_file);
+        if (!file.opened()) {
+            LOG_ERROR("Failed to open address file: " << csv_file);
+            return std::nullopt;
+        }
+        const char* data = file.data();
+        size_t size = file.size();
+        size_t begin = headerLength(data, size);
+
+        // Split at newlines into one chunk per thread
+        std::vector<size_t> boundaries = {begin};
+        for (unsigned i = 1; i < thread_count; ++i) {
+            size_t split = std::max(boundaries.back(), begin + (size - begin) * i / thread_count);
+            const char* newline = split < size ? static_cast<const char*>(std::memchr(data + split, '\n', size - split)) : nullptr;
+            boundaries.push_back(newline != nullptr ? static_cast<size_t>(newline - data) + 1 : size);
+        }
+        boundaries.push_back(size);
+
+        std::vector<AddressStore> parts(thread_count);
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < thread_count; ++i) {
+            if (boundaries[i + 1] > boundaries[i]) {
+                threads.emplace_back([&, i]() { parseChunk(data + boundaries[i], data + boundaries[i + 1], parts[i]); });
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        size_t total = 0;
+        for (const auto& part : parts) {
+            total += part.size();
+        }
+        addresses.reserve(total);
+        for (auto& part : parts) {
+            addresses.append(std::move(part));
+        }
+    }
+
+    addresses.freeze();
+    LOG("Parsed " << addresses.size() << " addresses using " << thread_count << " threads");
+    return addresses;
+}
+
+std::optional<std::vector<Place>> AddressLoader::loadPlaces(const std::string& places_file) {
+    // gzread passes uncompressed files through unchanged
+    gzFile gz = gzopen(places_file.c_str(), "rb");
+    if (gz == nullptr) {
+        LOG_ERROR("Failed to open places file: " << places_file);
+        return std::nullopt;
+    }
+    gzbuffer(gz, 1 << 20);
+
+    // Columns: id,category,lat,lon,x_mercator,y_mercator,region,... (the header line is skipped)
+    std::vector<Place> places;
+    std::string line, field;
+    char buffer[1 << 16];
+    bool first_line = true;
+    while (gzgets(gz, buffer, sizeof(buffer)) != nullptr) {
+        line += buffer;
+        if (line.back() != '\n' && !gzeof(gz)) {
+            continue; // Longer than the buffer
+        }
+        if (!line.empty() && line.back() == '\n') {
+            line.pop_back();
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        const char* p = line.data();
+        const char* end = p + line.size();
+        Place place;
+        double coordinates[2];
+        bool valid = !first_line;
+        for (int column = 0; valid && column <= 6; ++column) {
+            if (p == nullptr) {
+                valid = false;
+                break;
+            }
+            p = nextCsvField(p, end, field);
+            if (column == 1) {
+                place.category = field;
+            } else if (column == 2 || column == 3) {
+                valid = parseCoordinate(field.data(), field.data() + field.size(), coordinates[column - 2]);
+            } else if (column == 6) {
+                place.region = field;
+            }
+        }
+        if (valid) {
+            place.latitude = coordinates[0];
+            place.longitude = coordinates[1];
+            places.push_back(std::move(place));
+        }
+        first_line = false;
+        line.clear();
+    }
+    bool failed = !gzeof(gz);
+    gzclose(gz);
+    if (failed) {
+        LOG_ERROR("Failed to read places file: " << places_file);
+        return std::nullopt;
+    }
+    LOG("Parsed " << places.size() << " places from " << places_file);
+    return places;
+}
+
+std::optional<AddressStore> AddressLoader::loadStore(const std::string& store_file, const std::string& csv_file) {
+    if (!std::filesystem::exists(store_file)) {
+        LOG("Address store not found: " << store_file << ", parsing address file");
+        return std::nullopt;
+    }
+
+    try {
+        GraphSnapshot::Reader reader(store_file);
+
+        // Stale once the CSV it was built from changes; a missing CSV is fine
+        auto source = SnapshotSource::fromFile(csv_file);
+        if (source.has_value() && !(*source == reader.source())) {
+            LOG("Address store is stale (address file changed since it was written): " << store_file);
+            return std::nullopt;
+        }
+
+        std::array<std::vector<uint32_t>, AddressStore::FIELD_COUNT> ids;
+        std::array<StringPool, AddressStore::FIELD_COUNT> pools;
+        for (int field = 0; field < AddressStore::FIELD_COUNT; ++field) {
+            const PoolSections& sections = POOL_SECTIONS[field];
+            ids[field] = reader.readVector<uint32_t>(sections.ids);
+            pools[field] = StringPool::fromColumns(reader.readVector<uint64_t>(sections.offsets),
+                                                   reader.readVector<char>(sections.data));
+        }
+        AddressStore addresses = AddressStore::fromColumns(
+            reader.readVector<int32_t>(SnapshotSection::AddressLatitude),
+            reader.readVector<int32_t>(SnapshotSection::AddressLongitude), std::move(ids), std::move(pools));
+        LOG("Loaded " << addresses.size() << " addresses from store: " << store_file);
+        return addresses;
+    } catch (const std::exception& e) {
+        LOG("Address store not used (" << store_file << "): " << e.what());
+        return std::nullopt;
+    }
+}
+
+void AddressLoader::saveStore(const std::string& store_file, const std::string& csv_file, const AddressStore& addresses) {
+    auto source = SnapshotSource::fromFile(csv_file);
+    if (!source.has_value()) {
+        LOG_WARN("Cannot stat address file, not writing address store");
+        return;
+    }
+
+    try {
+        GraphSnapshot::Writer writer(store_file, *source);
+        writer.addVector(SnapshotSection::AddressLatitude, addresses.latitudeColumn());
+        writer.addVector(SnapshotSection::AddressLongitude, addresses.longitudeColumn());
+        for (int field = 0; field < AddressStore::FIELD_COUNT; ++field) {
+            const PoolSections& sections = POOL_SECTIONS[field];
+            const StringPool& pool = addresses.pool(static_cast<AddressStore::Field>(field));
+            writer.addVector(sections.ids, addresses.idColumn(static_cast<AddressStore::Field>(field)));
+            writer.addVector(sections.offsets, pool.ends());
+            writer.addVector(sections.data, pool.data());
+        }
+        writer.finish();
+        LOG("Address store saved to: " << store_file);
+    } catch (const std::exception& e) {
+        LOG_WARN("Failed to save address store: " << e.what());
+    }
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,137 @@
+#include "../include/AddressStore.h"
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+namespace RoutingServer {
+
+uint32_t StringPool::intern(std::string_view value) {
+    size_t hash = std::hash<std::string_view>()(value);
+    auto range = lookup_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (get(it->second) == value) {
+            return it->second;
+        }
+    }
+
+    uint32_t id = static_cast<uint32_t>(ends_.size());
+    data_.insert(data_.end(), value.begin(), value.end());
+    ends_.push_back(data_.size());
+    lookup_.emplace(hash, id);
+    return id;
+}
+
+void StringPool::freeze() {
+    std::unordered_multimap<size_t, uint32_t>().swap(lookup_);
+    ends_.shrink_to_fit();
+    data_.shrink_to_fit();
+}
+
+StringPool StringPool::fromColumns(std::vector<uint64_t> ends, std::vector<char> data) {
+    uint64_t previous = 0;
+    for (uint64_t end : ends) {
+        if (end < previous) {
+            throw std::runtime_error("String pool offsets are not sorted");
+        }
+        previous = end;
+    }
+    if (previous > data.size()) {
+        throw std::runtime_error("String pool offsets exceed its data");
+    }
+
+    StringPool pool;
+    pool.ends_ = std::move(ends);
+    pool.data_ = std::move(data);
+    return pool;
+}
+
+Address AddressStore::get(size_t index) const {
+    Address address;
+    address.id = static_cast<unsigned>(index);
+    address.latitude = latitude(index);
+    address.longitude = longitude(index);
+    address.street = std::string(text(index, Street));
+    address.housenumber = std::string(text(index, HouseNumber));
+    address.postcode = std::string(text(index, Postcode));
+    address.city = std::string(text(index, City));
+    return address;
+}
+
+void AddressStore::reserve(size_t count) {
+    latitudes_.reserve(count);
+    longitudes_.reserve(count);
+    for (auto& ids : ids_) {
+        ids.reserve(count);
+    }
+}
+
+void AddressStore::add(double latitude, double longitude, std::string_view street, std::string_view housenumber,
+                       std::string_view postcode, std::string_view city) {
+    latitudes_.push_back(static_cast<int32_t>(std::lround(latitude * COORDINATE_SCALE)));
+    longitudes_.push_back(static_cast<int32_t>(std::lround(longitude * COORDINATE_SCALE)));
+    ids_[Street].push_back(pools_[Street].intern(street));
+    ids_[HouseNumber].push_back(pools_[HouseNumber].intern(housenumber));
+    ids_[Postcode].push_back(pools_[Postcode].intern(postcode));
+    ids_[City].push_back(pools_[City].intern(city));
+}
+
+void AddressStore::append(AddressStore&& other) {
+    latitudes_.insert(latitudes_.end(), other.latitudes_.begin(), other.latitudes_.end());
+    longitudes_.insert(longitudes_.end(), other.longitudes_.begin(), other.longitudes_.end());
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        // Pools hold far fewer strings than there are addresses, so remap per pool entry
+        const StringPool& other_pool = other.pools_[field];
+        std::vector<uint32_t> remap(other_pool.size());
+        for (uint32_t id = 0; id < remap.size(); ++id) {
+            remap[id] = pools_[field].intern(other_pool.get(id));
+        }
+        for (uint32_t id : other.ids_[field]) {
+            ids_[field].push_back(remap[id]);
+        }
+    }
+    other = AddressStore();
+}
+
+void AddressStore::freeze() {
+    latitudes_.shrink_to_fit();
+    longitudes_.shrink_to_fit();
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        ids_[field].shrink_to_fit();
+        pools_[field].freeze();
+    }
+}
+
+size_t AddressStore::memoryBytes() const {
+    size_t bytes = (latitudes_.capacity() + longitudes_.capacity()) * sizeof(int32_t);
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        bytes += ids_[field].capacity() * sizeof(uint32_t) + pools_[field].memoryBytes();
+    }
+    return bytes;
+}
+
+AddressStore AddressStore::fromColumns(std::vector<int32_t> latitudes, std::vector<int32_t> longitudes,
+                                       std::array<std::vector<uint32_t>, FIELD_COUNT> ids,
+                                       std::array<StringPool, FIELD_COUNT> pools) {
+    if (latitudes.size() != longitudes.size()) {
+        throw std::runtime_error("Address coordinate columns differ in length");
+    }
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        if (ids[field].size() != latitudes.size()) {
+            throw std::runtime_error("Address text column differs in length");
+        }
+        for (uint32_t id : ids[field]) {
+            if (id >= pools[field].size()) {
+                throw std::runtime_error("Address text id out of range");
+            }
+        }
+    }
+
+    AddressStore store;
+    store.latitudes_ = std::move(latitudes);
+    store.longitudes_ = std::move(longitudes);
+    store.ids_ = std::move(ids);
+    store.pools_ = std::move(pools);
+    return store;
+}
+
+} // namespace RoutingServer
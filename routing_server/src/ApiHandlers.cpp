@@ -1,15 +1,36 @@
 #include "../include/ApiHandlers.h"
 #include "../include/JsonBuilder.h"
+#include "../include/RouteCodec.h"
 #include "../include/Logger.h"
+#include "../include/MemoryStats.h"
+#include "../include/Metrics.h"
 #include "../include/RoutingEngine.h"
 #include <routingkit/timer.h>
 #include <sstream>
 #include <cstdlib>
+#include <limits>
+#include <random>
 
 namespace RoutingServer {
 
-ApiHandlers::ApiHandlers(std::shared_ptr<RoutingEngine> engine)
-    : engine_(std::move(engine)) {
+ApiHandlers::ApiHandlers(std::shared_ptr<RegionRouter> regions)
+    : regions_(std::move(regions)), route_cache_(RouteCache::defaultCapacityBytes()) {
+    LOG("Route cache capacity: " << route_cache_.stats().capacity / (1024 * 1024) << " MB");
+    
+    const char* admin_token_env = std::getenv("ADMIN_TOKEN");
+    if (admin_token_env != nullptr) {
+        admin_token_ = admin_token_env;
+    }
+    if (admin_token_.empty()) {
+        LOG("ADMIN_TOKEN not set, admin endpoints are disabled");
+    }
+    
+    // Entries of a replaced engine can no longer match (the key has the engine instance), free them
+    regions_->setReloadListener([this]() { invalidateRouteCache(); });
+}
+
+ApiHandlers::~ApiHandlers() {
+    regions_->setReloadListener(nullptr);
 }
 
 void ApiHandlers::registerRoutes(crow::SimpleApp& app) {
@@ -34,6 +55,13 @@ void ApiHandlers::registerRoutes(crow::SimpleApp& app) {
             return this->handleHealthCheck(req);
         });
         
+    // Register the Prometheus metrics endpoint
+    CROW_ROUTE(app, "/metrics")
+        .methods(crow::HTTPMethod::GET)
+        ([this](const crow::request& req) {
+            return this->handleMetrics(req);
+        });
+        
     // Register the address bbox endpoint
     CROW_ROUTE(app, "/api/v1/bbox")
         .methods(crow::HTTPMethod::GET)
@@ -62,6 +90,20 @@ void ApiHandlers::registerRoutes(crow::SimpleApp& app) {
             return this->handleUniformRandomAddressInAnnulus(req);
         });
         
+    // Register the precomputed job candidates endpoint
+    CROW_ROUTE(app, "/api/v1/job_candidates")
+        .methods(crow::HTTPMethod::GET)
+        ([this](const crow::request& req) {
+            return this->handleJobCandidates(req);
+        });
+        
+    // Register the reachable addresses endpoint
+    CROW_ROUTE(app, "/api/v1/reachable")
+        .methods(crow::HTTPMethod::GET)
+        ([this](const crow::request& req) {
+            return this->handleReachable(req);
+        });
+        
     // Register the complete job route endpoint
     CROW_ROUTE(app, "/api/v1/complete_job_route")
         .methods(crow::HTTPMethod::GET)
@@ -69,156 +111,173 @@ void ApiHandlers::registerRoutes(crow::SimpleApp& app) {
             return this->handleCompleteJobRoute(req);
         });
         
+    // Register the route geometry endpoint (path of a metadata-only route by its token)
+    CROW_ROUTE(app, "/api/v1/route_geometry")
+        .methods(crow::HTTPMethod::GET)
+        ([this](const crow::request& req) {
+            return this->handleRouteGeometry(req);
+        });
+        
+    // Register the batch complete job route endpoint
+    CROW_ROUTE(app, "/api/v1/complete_job_route/batch")
+        .methods(crow::HTTPMethod::POST)
+        ([this](const crow::request& req) {
+            return this->handleCompleteJobRouteBatch(req);
+        });
+        
+    // Register the many-to-many matrix endpoint
+    CROW_ROUTE(app, "/api/v1/matrix")
+        .methods(crow::HTTPMethod::POST)
+        ([this](const crow::request& req) {
+            return this->handleMatrix(req);
+        });
+        
+    // Register the admin engine reload endpoint (POST starts a reload, GET reports its status)
+    CROW_ROUTE(app, "/admin/reload")
+        .methods(crow::HTTPMethod::GET, crow::HTTPMethod::POST)
+        ([this](const crow::request& req) {
+            return this->handleAdminReload(req);
+        });
+        
     LOG("API routes registered");
 }
 
 crow::response ApiHandlers::handleShortestPath(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received request: " + req.url);
+    LOG_DEBUG("Received request: " + req.url);
     
     // Parse coordinates from request
     double from_lat, from_lon, to_lat, to_lon;
     if (!parseCoordinates(req, from_lat, from_lon, to_lat, to_lon)) {
-        auto error_json = JsonBuilder::buildErrorResponse(
-            "Invalid or missing coordinates. Format: /api/v1/shortest_path?from=latitude,longitude&to=latitude,longitude"
-        );
-        // Get serialized JSON string by creating a temporary response
-        crow::response temp_resp(error_json);
-        std::string error_string = temp_resp.body;
-        auto compressed = JsonBuilder::compressGzip(error_string);
-        
-        crow::response resp;
-        if (!compressed.empty()) {
-            resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-            resp.add_header("Content-Encoding", "gzip");
-        } else {
-            resp.body = error_string;
-        }
-        resp.add_header("Content-Type", "application/json");
-        resp.code = 400;
-        
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return resp;
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "Invalid or missing coordinates. Format: /api/v1/shortest_path?from=latitude,longitude&to=latitude,longitude", 400);
     }
     
-    LOG("Routing from (" << from_lat << "," << from_lon << ") to (" << to_lat << "," << to_lon << ")");
+    LOG_DEBUG("Routing from (" << from_lat << "," << from_lon << ") to (" << to_lat << "," << to_lon << ")");
     
-    // Compute the shortest path with walking segments
-    LOG("Computing route with walking segments...");
-    long long compute_start = RoutingKit::get_micro_time();
-    RoutingResult result = engine_->computeShortestPathFromCoordinates(from_lat, from_lon, to_lat, to_lon);
-    long long compute_end = RoutingKit::get_micro_time();
-    if (RoutingEngine::isTimingEnabled()) {
-        LOG("[TIMING] computeShortestPathFromCoordinates: " << (compute_end - compute_start) / 1000.0 << " ms");
+    // Optional path encoding (json, columnar or binary)
+    std::optional<RouteFormat> format = parseRouteFormat(req.url_params.get("format") ? req.url_params.get("format") : "");
+    if (!format.has_value()) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "Invalid format. Use json, columnar or binary", 400);
     }
     
-    LOG("Route computed in " << result.query_time_us << " microseconds");
-    LOG("Path length: " << result.node_path.size() << " nodes, travel time: " << result.total_travel_time_ms << " ms");
+    RouteToken route;
+    route.points = {{from_lat, from_lon}, {to_lat, to_lon}};
     
-    if (!result.success) {
-        auto error_json = JsonBuilder::buildErrorResponse(
-            "No route found between coordinates"
-        );
-        // Get serialized JSON string by creating a temporary response
-        crow::response temp_resp(error_json);
-        std::string error_string = temp_resp.body;
-        auto compressed = JsonBuilder::compressGzip(error_string);
-        
-        crow::response resp;
-        if (!compressed.empty()) {
-            resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-            resp.add_header("Content-Encoding", "gzip");
-        } else {
-            resp.body = error_string;
+    // Check for optional max_speed parameter
+    std::string max_speed_param = req.url_params.get("max_speed") ? req.url_params.get("max_speed") : "";
+    if (!max_speed_param.empty()) {
+        try {
+            unsigned max_speed = std::stoul(max_speed_param);
+            if (max_speed > 0) {
+                route.max_speed_kmh = max_speed;
+                LOG_DEBUG("Applying maximum speed limit: " << max_speed << " km/h");
+            }
+        } catch (const std::exception& e) {
+            LOG_WARN("Invalid max_speed parameter: " << e.what());
         }
-        resp.add_header("Content-Type", "application/json");
-        resp.code = 404;
-        
-        long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return resp;
     }
     
+    route.metric = parseMetric(req.url_params.get("metric") ? req.url_params.get("metric") : "");
+    route.region = req.url_params.get("region") ? req.url_params.get("region") : "";
+    
     // Check for optional include_path parameter (default: true, set to 0 to skip path array)
     bool include_path = true;
     std::string include_path_param = req.url_params.get("include_path") ? req.url_params.get("include_path") : "";
     if (!include_path_param.empty()) {
         if (include_path_param == "0" || include_path_param == "false") {
             include_path = false;
-            LOG("include_path=0: returning metadata-only response");
+            LOG_DEBUG("include_path=0: returning metadata-only response");
         }
     }
     
-    // Check for optional max_speed parameter
+    return respondShortestPath(req, route, *format, include_path, start_time);
+}
+
+crow::response ApiHandlers::respondShortestPath(const crow::request& req, const RouteToken& route,
+                                                RouteFormat format, bool include_path, long long start_time) {
+    const auto& [from_lat, from_lon] = route.points[0];
+    const auto& [to_lat, to_lon] = route.points[1];
     std::optional<unsigned> max_speed_kmh;
-    std::string max_speed_param = req.url_params.get("max_speed") ? req.url_params.get("max_speed") : "";
-    if (!max_speed_param.empty()) {
-        try {
-            unsigned max_speed = std::stoul(max_speed_param);
-            if (max_speed > 0) {
-                max_speed_kmh = max_speed;
-                LOG("Applying maximum speed limit: " << max_speed << " km/h");
-            }
-        } catch (const std::exception& e) {
-            LOG("Invalid max_speed parameter: " << e.what());
-        }
+    if (route.max_speed_kmh > 0) {
+        max_speed_kmh = route.max_speed_kmh;
     }
     
-    // If max speed was applied, recalculate the total travel time
-    RoutingResult modified_result = result;
-    if (max_speed_kmh.has_value()) {
-        modified_result.total_travel_time_ms = engine_->recalculateTotalTravelTime(result, max_speed_kmh.value());
-        LOG("Total travel time with max speed " << max_speed_kmh.value() << " km/h: " << modified_result.total_travel_time_ms << " ms");
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(route.region, route.points, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
+    
+    // Repeated requests are answered from the route cache
+    RouteCache::Key cache_key;
+    cache_key.engine_instance = current->instance;
+    cache_key.endpoint = 0;
+    cache_key.points = {RouteCache::quantize(from_lat, from_lon), RouteCache::quantize(to_lat, to_lon), 0};
+    cache_key.max_speed_kmh = route.max_speed_kmh;
+    cache_key.metric = static_cast<uint8_t>(route.metric);
+    cache_key.format = static_cast<uint8_t>(format);
+    cache_key.encoding = static_cast<uint8_t>(negotiateEncoding(req));
+    cache_key.include_path = include_path;
+    if (auto cached = route_cache_.lookup(cache_key)) {
+        cached->add_header("X-Route-Cache", "hit");
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (cached: " << cached->body.size() << " bytes)");
+        return std::move(*cached);
     }
     
-    // Build JSON response (with or without path)
-    LOG("Sending response");
-    long long json_start = RoutingKit::get_micro_time();
-    crow::json::wvalue json_response;
-    std::vector<RoutePoint> route_points;
+    // Compute the shortest path with walking segments (travel time already respects max_speed);
+    // metadata-only requests skip unpacking the path where possible
+    LOG_DEBUG("Computing route with walking segments...");
+    long long compute_start = RoutingKit::get_micro_time();
+    RoutingResult result = engine.computeShortestPathFromCoordinates(from_lat, from_lon, to_lat, to_lon, route.metric, max_speed_kmh,
+                                                                     include_path ? RouteDetail::Path : RouteDetail::Totals);
+    long long compute_end = RoutingKit::get_micro_time();
+    if (RoutingEngine::isTimingEnabled()) {
+        LOG("[TIMING] computeShortestPathFromCoordinates: " << (compute_end - compute_start) / 1000.0 << " ms");
+    }
+    
+    LOG_DEBUG("Route computed in " << result.query_time_us << " microseconds");
+    LOG_DEBUG("Path length: " << result.node_path.size() << " nodes, travel time: " << result.total_travel_time_ms << " ms");
     
+    if (!result.success) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "No route found between coordinates", 404);
+    }
+    
+    // Stream the response (with or without path)
+    LOG_DEBUG("Sending response");
+    std::vector<RoutePoint> route_points;
     if (include_path) {
         // Process the path into points with coordinates and travel times
         long long process_start = RoutingKit::get_micro_time();
-        route_points = engine_->processPathIntoPoints(modified_result, max_speed_kmh);
+        route_points = engine.processPathIntoPoints(result, max_speed_kmh);
         long long process_end = RoutingKit::get_micro_time();
         if (RoutingEngine::isTimingEnabled()) {
             LOG("[TIMING] processPathIntoPoints: " << (process_end - process_start) / 1000.0 << " ms");
         }
-        json_response = JsonBuilder::buildRouteResponse(modified_result, route_points);
-    } else {
-        json_response = JsonBuilder::buildLiteRouteResponse(modified_result);
     }
     
+    long long json_start = RoutingKit::get_micro_time();
+    size_t json_size = 0;
+    crow::response resp = buildRouteResponse(req, result, include_path ? &route_points : nullptr, format, &json_size,
+                                             include_path ? "" : RouteCodec::encodeRouteToken(route));
     long long json_end = RoutingKit::get_micro_time();
     if (RoutingEngine::isTimingEnabled()) {
-        LOG("[TIMING] JsonBuilder::buildRouteResponse: " << (json_end - json_start) / 1000.0 << " ms");
+        LOG("[TIMING] buildRouteResponse: " << (json_end - json_start) / 1000.0 << " ms");
     }
     
-    // Convert JSON to string and compress with gzip
-    // Get serialized JSON string by creating a temporary response
-    crow::response temp_resp(json_response);
-    std::string json_string = temp_resp.body;
-    auto compressed = JsonBuilder::compressGzip(json_string);
-    
-    if (compressed.empty()) {
-        LOG("Warning: gzip compression failed, sending uncompressed response");
-        long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
-        crow::response resp(json_response);
-        resp.add_header("Content-Type", "application/json");
-        return resp;
-    }
-    
-    // Create response with compressed data
-    crow::response resp;
-    resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-    resp.add_header("Content-Type", "application/json");
-    resp.add_header("Content-Encoding", "gzip");
+    route_cache_.store(cache_key, resp);
+    resp.add_header("X-Route-Cache", "miss");
     
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (compressed: " << compressed.size() << " bytes, original: " << json_string.size() << " bytes)");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (encoded: " << resp.body.size() << " bytes, original: " << json_size << " bytes)");
     return resp;
 }
 
@@ -231,7 +290,7 @@ bool ApiHandlers::parseCoordinates(const crow::request& req,
     
     // Check if parameters are provided
     if (from_param.empty() || to_param.empty()) {
-        LOG("Error: Missing 'from' or 'to' parameters");
+        LOG_WARN("Missing 'from' or 'to' parameters");
         return false;
     }
     
@@ -239,7 +298,7 @@ bool ApiHandlers::parseCoordinates(const crow::request& req,
         // Parse from coordinates
         size_t comma_pos = from_param.find(',');
         if (comma_pos == std::string::npos) {
-            LOG("Error: Invalid 'from' format");
+            LOG_WARN("Invalid 'from' format");
             return false;
         }
         from_lat = std::stod(from_param.substr(0, comma_pos));
@@ -248,7 +307,7 @@ bool ApiHandlers::parseCoordinates(const crow::request& req,
         // Parse to coordinates
         comma_pos = to_param.find(',');
         if (comma_pos == std::string::npos) {
-            LOG("Error: Invalid 'to' format");
+            LOG_WARN("Invalid 'to' format");
             return false;
         }
         to_lat = std::stod(to_param.substr(0, comma_pos));
@@ -256,11 +315,23 @@ bool ApiHandlers::parseCoordinates(const crow::request& req,
         
         return true;
     } catch (const std::exception& e) {
-        LOG("Error parsing coordinates: " << e.what());
+        LOG_WARN("Error parsing coordinates: " << e.what());
         return false;
     }
 }
 
+RoutingMetric ApiHandlers::parseMetric(const std::string& metric_param) {
+    // metric=time (fastest route, default) or metric=distance (shortest route)
+    if (metric_param == "distance") {
+        LOG_DEBUG("Routing on geo distance");
+        return RoutingMetric::GeoDistance;
+    }
+    if (!metric_param.empty() && metric_param != "time") {
+        LOG_WARN("Invalid metric parameter: " << metric_param << ", using default 'time'");
+    }
+    return RoutingMetric::TravelTime;
+}
+
 bool ApiHandlers::parseCoordinate(const std::string& param, double& lat, double& lon) {
     if (param.empty()) {
         return false;
@@ -270,48 +341,301 @@ bool ApiHandlers::parseCoordinate(const std::string& param, double& lat, double&
         // Parse coordinates
         size_t comma_pos = param.find(',');
         if (comma_pos == std::string::npos) {
-            LOG("Error: Invalid coordinate format");
+            LOG_WARN("Invalid coordinate format");
             return false;
         }
         lat = std::stod(param.substr(0, comma_pos));
         lon = std::stod(param.substr(comma_pos + 1));
         return true;
     } catch (const std::exception& e) {
-        LOG("Error parsing coordinates: " << e.what());
+        LOG_WARN("Error parsing coordinates: " << e.what());
+        return false;
+    }
+}
+
+bool ApiHandlers::parseJsonCoordinate(const crow::json::rvalue& value, double& lat, double& lon) {
+    const size_t lat_index = 0, lon_index = 1;
+    if (value.t() != crow::json::type::List || value.size() != 2 ||
+        value[lat_index].t() != crow::json::type::Number || value[lon_index].t() != crow::json::type::Number) {
+        return false;
+    }
+    lat = value[lat_index].d();
+    lon = value[lon_index].d();
+    return true;
+}
+
+bool ApiHandlers::parseJsonCoordinateList(const crow::json::rvalue& value,
+                                          std::vector<std::pair<double, double>>& coordinates) {
+    if (value.t() != crow::json::type::List) {
         return false;
     }
+    coordinates.clear();
+    coordinates.reserve(value.size());
+    for (const auto& item : value) {
+        double lat, lon;
+        if (!parseJsonCoordinate(item, lat, lon)) {
+            return false;
+        }
+        coordinates.emplace_back(lat, lon);
+    }
+    return true;
+}
+
+ContentEncoding ApiHandlers::negotiateEncoding(const crow::request& req) {
+    auto accept_encoding = req.headers.find("Accept-Encoding");
+    bool header_present = accept_encoding != req.headers.end();
+    return negotiateContentEncoding(header_present ? accept_encoding->second : "", header_present);
+}
+
+// Split the time spent writing a JSON body into serialization and compression
+void ApiHandlers::recordEncodingTimes(const ResponseEncoder& encoder, long long total_us) {
+    long long compress_us = encoder.compressTimeUs();
+    Metrics::instance().record(MetricStage::JsonBuild, total_us - compress_us);
+    if (encoder.encoding() != ContentEncoding::Identity) {
+        Metrics::instance().record(MetricStage::Compress, compress_us);
+    }
+}
+
+crow::response ApiHandlers::buildJsonResponse(const crow::request& req,
+                                              const std::function<void(JsonWriter&)>& write_body,
+                                              int code, size_t* json_size) {
+    ContentEncoding encoding = negotiateEncoding(req);
+    
+    long long start_time = RoutingKit::get_micro_time();
+    ResponseEncoder encoder(encoding);
+    {
+        JsonWriter writer(encoder);
+        write_body(writer);
+    }
+    if (json_size != nullptr) {
+        *json_size = encoder.inputSize();
+    }
+    
+    crow::response resp;
+    resp.code = code;
+    if (encoder.encoding() != ContentEncoding::Identity) {
+        resp.add_header("Content-Encoding", contentEncodingName(encoder.encoding()));
+    } else if (encoding != ContentEncoding::Identity) {
+        LOG_WARN(contentEncodingName(encoding) << " compression failed, sending uncompressed response");
+    }
+    resp.body = encoder.finish();
+    recordEncodingTimes(encoder, RoutingKit::get_micro_time() - start_time);
+    resp.add_header("Content-Type", "application/json");
+    resp.add_header("Vary", "Accept-Encoding");
+    return resp;
+}
+
+crow::response ApiHandlers::buildEncodedResponse(const crow::request& req, const std::string& body,
+                                                 const char* content_type, int code) {
+    ContentEncoding encoding = negotiateEncoding(req);
+    
+    ResponseEncoder encoder(encoding);
+    encoder.write(body.data(), body.size());
+    
+    crow::response resp;
+    resp.code = code;
+    if (encoder.encoding() != ContentEncoding::Identity) {
+        resp.add_header("Content-Encoding", contentEncodingName(encoder.encoding()));
+    }
+    resp.body = encoder.finish();
+    if (encoder.encoding() != ContentEncoding::Identity) {
+        Metrics::instance().record(MetricStage::Compress, encoder.compressTimeUs());
+    }
+    resp.add_header("Content-Type", content_type);
+    resp.add_header("Vary", "Accept-Encoding");
+    return resp;
+}
+
+crow::response ApiHandlers::buildRouteResponse(const crow::request& req, const RoutingResult& result,
+                                               const std::vector<RoutePoint>* route_points,
+                                               RouteFormat format, size_t* body_size,
+                                               const std::string& route_token) {
+    if (route_points == nullptr) {
+        return buildJsonResponse(req, [&](JsonWriter& writer) {
+            JsonBuilder::writeLiteRouteResponse(writer, result, route_token);
+        }, 200, body_size);
+    }
+    if (format == RouteFormat::Binary) {
+        std::string body = RouteCodec::encodeBinary(result, *route_points);
+        if (body_size != nullptr) {
+            *body_size = body.size();
+        }
+        return buildEncodedResponse(req, body, "application/octet-stream");
+    }
+    return buildJsonResponse(req, [&](JsonWriter& writer) {
+        if (format == RouteFormat::Columnar) {
+            JsonBuilder::writeColumnarRouteResponse(writer, result, *route_points);
+        } else {
+            JsonBuilder::writeRouteResponse(writer, result, *route_points);
+        }
+    }, 200, body_size);
+}
+
+crow::response ApiHandlers::buildJsonResponse(const crow::request& req, const crow::json::wvalue& json, int code) {
+    std::string json_string = json.dump();
+    return buildJsonResponse(req, [&](JsonWriter& writer) { writer.raw(json_string); }, code);
+}
+
+crow::response ApiHandlers::buildJsonErrorResponse(const crow::request& req, const std::string& error_message, int code) {
+    return buildJsonResponse(req, [&](JsonWriter& writer) {
+        JsonBuilder::writeErrorResponse(writer, error_message);
+    }, code);
 }
 
 crow::response ApiHandlers::handleHealthCheck(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received health check request: " + req.url);
+    LOG_DEBUG("Received health check request: " + req.url);
+    
+    // Engine details of the region named by the region parameter (default: the first region),
+    // only if it is loaded; health checks never load a region
+    std::optional<size_t> region_index = 0;
+    if (req.url_params.get("region")) {
+        region_index = regions_->findByName(req.url_params.get("region"));
+        if (!region_index) {
+            return buildJsonErrorResponse(req, std::string("Unknown region: ") + req.url_params.get("region"), 400);
+        }
+    }
+    std::shared_ptr<const EngineHolder::Current> current = regions_->peek(*region_index);
     
     crow::json::wvalue response;
     response["status"] = "ok";
-    response["engine_initialized"] = true;
-    response["node_count"] = engine_->getNodeCount();
-    response["arc_count"] = engine_->getArcCount();
-    response["address_count"] = engine_->getAddressCount();
+    response["engine_initialized"] = current != nullptr;
+    if (current) {
+        RoutingEngine& engine = *current->engine;
+        response["engine_generation"] = current->generation;
+        response["node_count"] = engine.getNodeCount();
+        response["arc_count"] = engine.getArcCount();
+        response["address_count"] = engine.getAddressCount();
+        
+        QueryArena::Stats arena_stats = engine.getQueryArenaStats();
+        crow::json::wvalue arena_json;
+        arena_json["slots"] = arena_stats.slot_count;
+        arena_json["slots_in_use"] = arena_stats.slots_in_use;
+        arena_json["hits"] = arena_stats.hits;
+        arena_json["waits"] = arena_stats.waits;
+        arena_json["temporary_allocations"] = arena_stats.temporary_allocations;
+        arena_json["memory_bytes"] = arena_stats.memory_bytes;
+        response["query_arena"] = std::move(arena_json);
+        response["snap_cache"] = JsonBuilder::buildCacheStats(engine.getSnapCacheStats());
+        response["closest_address_cache"] = JsonBuilder::buildCacheStats(engine.getClosestAddressCacheStats());
+    }
+    if (regions_->sharded()) {
+        crow::json::wvalue::list regions_json;
+        for (const auto& region : regions_->status()) {
+            crow::json::wvalue region_json;
+            region_json["name"] = region.name;
+            region_json["loaded"] = region.loaded;
+            region_json["loads"] = region.loads;
+            if (region.bounds) {
+                region_json["bbox"] = crow::json::wvalue::list{region.bounds->min_lat, region.bounds->min_lon,
+                                                               region.bounds->max_lat, region.bounds->max_lon};
+            }
+            if (region.current) {
+                region_json["engine_generation"] = region.current->generation;
+                region_json["node_count"] = region.current->engine->getNodeCount();
+                region_json["address_count"] = region.current->engine->getAddressCount();
+            }
+            regions_json.push_back(std::move(region_json));
+        }
+        response["regions"] = std::move(regions_json);
+    }
+    response["route_cache"] = JsonBuilder::buildCacheStats(route_cache_.stats());
     
-    LOG("Sending health check response");
+    LOG_DEBUG("Sending health check response");
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return crow::response(200, response);
 }
 
-crow::response ApiHandlers::handleClosestAddress(const crow::request& req) {
-    long long start_time = RoutingKit::get_micro_time();
-    LOG("Received request: " + req.url);
+crow::response ApiHandlers::handleMetrics(const crow::request& /*req*/) {
+    std::string body;
+    Metrics::instance().writeStageHistograms(body);
+    PrometheusWriter writer(body);
+    
+    // Per-region values only for loaded regions; scraping never loads one
+    std::vector<RegionRouter::RegionStatus> regions = regions_->status();
+    std::vector<std::pair<std::string, const RoutingEngine*>> engines;
+    for (const auto& region : regions) {
+        if (region.current) {
+            engines.emplace_back(PrometheusWriter::label("region", region.name), region.current->engine.get());
+        }
+    }
     
-    // Check if addresses are loaded
-    if (engine_->getAddressCount() == 0) {
-        auto error_response = JsonBuilder::buildErrorResponse(
-            "No addresses loaded. Start server with address CSV file."
-        );
-        long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return crow::response(404, error_response);
+    writer.family("routing_region_loaded", "gauge", "Whether the region's engine is in memory");
+    for (const auto& region : regions) {
+        writer.sample("routing_region_loaded", PrometheusWriter::label("region", region.name), uint64_t{region.loaded});
+    }
+    
+    std::vector<std::pair<std::string, QueryArena::Stats>> arenas;
+    for (const auto& [region_label, engine] : engines) {
+        arenas.emplace_back(region_label, engine->getQueryArenaStats());
+    }
+    auto write_arena = [&](const char* name, const char* type, const char* help, auto field) {
+        writer.family(name, type, help);
+        for (const auto& [region_label, stats] : arenas) {
+            writer.sample(name, region_label, static_cast<uint64_t>(field(stats)));
+        }
+    };
+    write_arena("routing_query_pool_slots", "gauge", "Query slots in the pool",
+                [](const QueryArena::Stats& stats) { return stats.slot_count; });
+    write_arena("routing_query_pool_slots_in_use", "gauge", "Query slots leased right now",
+                [](const QueryArena::Stats& stats) { return stats.slots_in_use; });
+    write_arena("routing_query_pool_hits_total", "counter", "Leases that found a free slot on the first scan",
+                [](const QueryArena::Stats& stats) { return stats.hits; });
+    write_arena("routing_query_pool_waits_total", "counter", "Leases that found every slot busy and retried",
+                [](const QueryArena::Stats& stats) { return stats.waits; });
+    write_arena("routing_query_pool_temporary_allocations_total", "counter",
+                "Leases that gave up waiting and built throwaway queries",
+                [](const QueryArena::Stats& stats) { return stats.temporary_allocations; });
+    write_arena("routing_query_pool_memory_bytes", "gauge", "Estimated bytes held by the query slots",
+                [](const QueryArena::Stats& stats) { return stats.memory_bytes; });
+    
+    // The route cache is shared by all regions, the other caches belong to one engine
+    std::vector<std::pair<std::string, CacheStats>> caches;
+    caches.emplace_back(PrometheusWriter::label("cache", "route"), route_cache_.stats());
+    for (const auto& [region_label, engine] : engines) {
+        caches.emplace_back(PrometheusWriter::label("cache", "snap") + "," + region_label, engine->getSnapCacheStats());
+        caches.emplace_back(PrometheusWriter::label("cache", "closest_address") + "," + region_label,
+                            engine->getClosestAddressCacheStats());
     }
+    auto write_cache = [&](const char* name, const char* type, const char* help, auto field) {
+        writer.family(name, type, help);
+        for (const auto& [cache_label, stats] : caches) {
+            writer.sample(name, cache_label, static_cast<uint64_t>(field(stats)));
+        }
+    };
+    write_cache("routing_cache_hits_total", "counter", "Cache lookups that found an entry",
+                [](const CacheStats& stats) { return stats.hits; });
+    write_cache("routing_cache_misses_total", "counter", "Cache lookups that found no entry",
+                [](const CacheStats& stats) { return stats.misses; });
+    write_cache("routing_cache_evictions_total", "counter", "Entries evicted to stay within capacity",
+                [](const CacheStats& stats) { return stats.evictions; });
+    write_cache("routing_cache_entries", "gauge", "Entries in the cache",
+                [](const CacheStats& stats) { return stats.entries; });
+    write_cache("routing_cache_cost", "gauge", "Summed cost of the entries (bytes for the route cache)",
+                [](const CacheStats& stats) { return stats.cost; });
+    write_cache("routing_cache_capacity", "gauge", "Cost the cache may hold",
+                [](const CacheStats& stats) { return stats.capacity; });
+    writer.family("routing_cache_hit_ratio", "gauge", "Hits per lookup since startup");
+    for (const auto& [cache_label, stats] : caches) {
+        uint64_t lookups = stats.hits + stats.misses;
+        writer.sample("routing_cache_hit_ratio", cache_label, lookups > 0 ? static_cast<double>(stats.hits) / lookups : 0.0);
+    }
+    
+    MemoryStats memory = MemoryStats::get_current();
+    writer.family("process_resident_memory_bytes", "gauge", "Resident set size");
+    writer.sample("process_resident_memory_bytes", "", memory.rss_kb * 1024);
+    writer.family("routing_peak_resident_memory_bytes", "gauge", "Peak resident set size");
+    writer.sample("routing_peak_resident_memory_bytes", "", memory.peak_rss_kb * 1024);
+    
+    crow::response resp(200, body);
+    resp.add_header("Content-Type", "text/plain; version=0.0.4");
+    return resp;
+}
+
+crow::response ApiHandlers::handleClosestAddress(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received request: " + req.url);
     
     // Parse location parameter
     std::string location_param = req.url_params.get("location") ? req.url_params.get("location") : "";
@@ -322,93 +646,135 @@ crow::response ApiHandlers::handleClosestAddress(const crow::request& req) {
             "Invalid or missing location parameter. Format: /api/v1/closest_address?location=latitude,longitude"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(400, error_response);
     }
     
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {{lat, lon}}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
+    
+    // Check if addresses are loaded
+    if (engine.getAddressCount() == 0) {
+        auto error_response = JsonBuilder::buildErrorResponse(
+            "No addresses loaded. Start server with address CSV file."
+        );
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return crow::response(404, error_response);
+    }
+    
     // Get the closest address
-    LOG("Finding closest address to (" << lat << "," << lon << ")...");
-    auto address = engine_->getClosestAddress(lat, lon);
+    LOG_DEBUG("Finding closest address to (" << lat << "," << lon << ")...");
+    auto address = engine.getClosestAddress(lat, lon);
     
     if (!address) {
         auto error_response = JsonBuilder::buildErrorResponse(
             "No address found"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(404, error_response);
     }
     
     // Build and return the JSON response
-    LOG("Sending response");
+    LOG_DEBUG("Sending response");
     auto success_response = address->toJson();
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return crow::response(success_response);
 }
 
 crow::response ApiHandlers::handleAddressBbox(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received address bbox request: " + req.url);
+    LOG_DEBUG("Received address bbox request: " + req.url);
+    
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
     
     // Check if addresses are loaded
-    if (engine_->getAddressCount() == 0) {
+    if (engine.getAddressCount() == 0) {
         auto error_response = JsonBuilder::buildErrorResponse(
             "No addresses loaded. Start server with address CSV file."
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(404, error_response);
     }
     
     // Get the bounding box
-    auto bbox = engine_->getAddressBbox();
+    auto bbox = engine.getAddressBbox();
     
     if (!bbox) {
         auto error_response = JsonBuilder::buildErrorResponse(
             "Failed to calculate address bounding box"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(500, error_response);
     }
     
     // Build and return the JSON response
-    LOG("Sending bbox response");
+    LOG_DEBUG("Sending bbox response");
     auto success_response = bbox->toJson();
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return crow::response(success_response);
 }
 
 crow::response ApiHandlers::handleNumAddresses(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received num addresses request: " + req.url);
+    LOG_DEBUG("Received num addresses request: " + req.url);
+    
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
     
     // Get the number of addresses
-    unsigned address_count = engine_->getAddressCount();
+    unsigned address_count = engine.getAddressCount();
     
     // Build and return the JSON response
     crow::json::wvalue response;
     response["count"] = address_count;
     
-    LOG("Sending num addresses response: " << address_count);
+    LOG_DEBUG("Sending num addresses response: " << address_count);
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return crow::response(response);
 }
 
 crow::response ApiHandlers::handleAddressSample(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received address sample request: " + req.url);
+    LOG_DEBUG("Received address sample request: " + req.url);
+    
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
     
     // Check if addresses are loaded
-    if (engine_->getAddressCount() == 0) {
+    if (engine.getAddressCount() == 0) {
         auto error_response = JsonBuilder::buildErrorResponse(
             "No addresses loaded. Start server with address CSV file."
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(404, error_response);
     }
     
@@ -430,11 +796,11 @@ crow::response ApiHandlers::handleAddressSample(const crow::request& req) {
             "Invalid parameter format. All parameters must be valid unsigned integers."
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(400, error_response);
     }
     
-    LOG("Address sample parameters: number=" << number << ", seed=" << seed 
+    LOG_DEBUG("Address sample parameters: number=" << number << ", seed=" << seed 
         << ", page_size=" << page_size << ", page_num=" << page_num);
     
     // Validate parameters
@@ -443,7 +809,7 @@ crow::response ApiHandlers::handleAddressSample(const crow::request& req) {
             "page_size must be greater than 0"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(400, error_response);
     }
     
@@ -452,12 +818,12 @@ crow::response ApiHandlers::handleAddressSample(const crow::request& req) {
             "number must be greater than 0"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(400, error_response);
     }
     
     // Get the address sample
-    auto addresses = engine_->getAddressSample(number, seed, page_size, page_num);
+    auto addresses = engine.getAddressSample(number, seed, page_size, page_num);
     
     // Build JSON response
     crow::json::wvalue response;
@@ -473,25 +839,15 @@ crow::response ApiHandlers::handleAddressSample(const crow::request& req) {
     response["pagination"]["total_requested"] = number;
     response["pagination"]["returned"] = addresses.size();
     
-    LOG("Sending address sample response with " << addresses.size() << " addresses");
+    LOG_DEBUG("Sending address sample response with " << addresses.size() << " addresses");
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return crow::response(response);
 }
 
 crow::response ApiHandlers::handleUniformRandomAddressInAnnulus(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received uniform random address in annulus request: " + req.url);
-    
-    // Check if addresses are loaded
-    if (engine_->getAddressCount() == 0) {
-        auto error_response = JsonBuilder::buildErrorResponse(
-            "No addresses loaded. Start server with address CSV file."
-        );
-        long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return crow::response(404, error_response);
-    }
+    LOG_DEBUG("Received uniform random address in annulus request: " + req.url);
     
     // Parse query parameters
     std::string lat_param = req.url_params.get("lat") ? req.url_params.get("lat") : "";
@@ -515,7 +871,7 @@ crow::response ApiHandlers::handleUniformRandomAddressInAnnulus(const crow::requ
             "Invalid parameter format. Required: lat, lon, min_distance, max_distance (all numeric). Optional: seed (numeric)"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(400, error_response);
     }
     
@@ -525,36 +881,274 @@ crow::response ApiHandlers::handleUniformRandomAddressInAnnulus(const crow::requ
             "Missing required parameters. Format: /api/v1/uniformRandomAddressInAnnulus?lat=X&lon=Y&min_distance=Z&max_distance=W&seed=S"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(400, error_response);
     }
     
-    LOG("Uniform random address in annulus: center=(" << lat << "," << lon 
-        << "), min_dist=" << min_distance << "km, max_dist=" << max_distance << "km, seed=" << seed);
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {{lat, lon}}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
     
-    // Get a uniform random address in the annulus
-    auto address = engine_->getUniformRandomAddressInAnnulus(lat, lon, min_distance, max_distance, seed);
+    // Check if addresses are loaded
+    if (engine.getAddressCount() == 0) {
+        auto error_response = JsonBuilder::buildErrorResponse(
+            "No addresses loaded. Start server with address CSV file."
+        );
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return crow::response(404, error_response);
+    }
     
-    if (!address) {
+    // Optional batch size and place category
+    std::string count_param = req.url_params.get("count") ? req.url_params.get("count") : "";
+    std::string category = req.url_params.get("category") ? req.url_params.get("category") : "";
+    unsigned count = 1;
+    if (!count_param.empty()) {
+        try {
+            count = std::stoul(count_param);
+        } catch (const std::exception& e) {
+            count = 0;
+        }
+        if (count == 0 || count > MAX_ANNULUS_SAMPLE_COUNT) {
+            auto error_response = JsonBuilder::buildErrorResponse(
+                "count must be between 1 and " + std::to_string(MAX_ANNULUS_SAMPLE_COUNT)
+            );
+            long long end_time = RoutingKit::get_micro_time();
+            LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+            return crow::response(400, error_response);
+        }
+    }
+    if (!category.empty() && !engine.hasPlaceCategory(category)) {
+        auto error_response = JsonBuilder::buildErrorResponse(
+            "Unknown place category: " + category + ". Start the server with PLACES_FILE to enable categories."
+        );
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return crow::response(400, error_response);
+    }
+    
+    LOG_DEBUG("Uniform random address in annulus: center=(" << lat << "," << lon 
+        << "), min_dist=" << min_distance << "km, max_dist=" << max_distance << "km, seed=" << seed
+        << ", count=" << count << (category.empty() ? "" : ", category=" + category));
+    
+    // Get uniform random addresses in the annulus
+    auto addresses = engine.getUniformRandomAddressesInAnnulus(lat, lon, min_distance, max_distance, seed, count, category);
+    
+    if (addresses.empty()) {
         auto error_response = JsonBuilder::buildErrorResponse(
             "No address found in the specified annulus"
         );
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
         return crow::response(404, error_response);
     }
     
-    // Build and return the JSON response
-    LOG("Sending uniform random address response");
-    auto success_response = address->toJson();
+    // Build and return the JSON response: a single address, or a list when count was given
+    LOG_DEBUG("Sending uniform random address response");
+    crow::json::wvalue success_response;
+    if (count_param.empty()) {
+        success_response = addresses.front().toJson();
+    } else {
+        success_response["addresses"] = crow::json::wvalue::list();
+        for (size_t i = 0; i < addresses.size(); ++i) {
+            success_response["addresses"][i] = addresses[i].toJson();
+        }
+    }
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return crow::response(success_response);
 }
 
+crow::response ApiHandlers::handleJobCandidates(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received job candidates request: " + req.url);
+    
+    // nuts_region, because region selects the routing region
+    std::string nuts_region = req.url_params.get("nuts_region") ? req.url_params.get("nuts_region") : "";
+    std::string category = req.url_params.get("category") ? req.url_params.get("category") : "";
+    std::string min_distance_param = req.url_params.get("min_distance") ? req.url_params.get("min_distance") : "0";
+    std::string max_distance_param = req.url_params.get("max_distance") ? req.url_params.get("max_distance") : "";
+    std::string count_param = req.url_params.get("count") ? req.url_params.get("count") : "1";
+    std::string seed_param = req.url_params.get("seed") ? req.url_params.get("seed") : "42";
+    std::string max_speed_param = req.url_params.get("max_speed") ? req.url_params.get("max_speed") : "";
+    
+    if (nuts_region.empty() || category.empty()) {
+        return buildJsonErrorResponse(req,
+            "Missing required parameters. Format: /api/v1/job_candidates?nuts_region=R&category=C"
+            "&min_distance=X&max_distance=Y&count=N&seed=S&max_speed=V", 400);
+    }
+    
+    // Distances in km like the annulus endpoint
+    double min_distance_km, max_distance_km;
+    unsigned count, seed;
+    std::optional<unsigned> max_speed_kmh;
+    try {
+        min_distance_km = std::stod(min_distance_param);
+        max_distance_km = max_distance_param.empty() ? -1.0 : std::stod(max_distance_param);
+        count = std::stoul(count_param);
+        seed = std::stoul(seed_param);
+        if (!max_speed_param.empty()) {
+            max_speed_kmh = std::stoul(max_speed_param);
+        }
+    } catch (const std::exception& e) {
+        return buildJsonErrorResponse(req,
+            "Invalid parameter format. min_distance, max_distance (km), count, seed and max_speed (km/h) are numeric", 400);
+    }
+    if (count == 0 || count > MAX_JOB_CANDIDATE_COUNT) {
+        return buildJsonErrorResponse(req, "count must be between 1 and " + std::to_string(MAX_JOB_CANDIDATE_COUNT), 400);
+    }
+    
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    const RoutingEngine& engine = *current->engine;
+    const JobCandidateTable* table = engine.getJobCandidates();
+    if (table == nullptr) {
+        return buildJsonErrorResponse(req,
+            "No job candidates loaded. Start the server with JOB_CANDIDATES_FILE and the address file it was built from.", 404);
+    }
+    if (max_speed_kmh && table->speedTiers().empty()) {
+        return buildJsonErrorResponse(req, "The job candidate table has no speed tiers", 400);
+    }
+    
+    auto to_meters = [](double km) {
+        return km < 0.0 ? std::numeric_limits<uint32_t>::max()
+                        : static_cast<uint32_t>(std::min(km * 1000.0, double(std::numeric_limits<uint32_t>::max())));
+    };
+    auto range = table->find(nuts_region, category, to_meters(std::max(min_distance_km, 0.0)), to_meters(max_distance_km));
+    if (!range) {
+        return buildJsonErrorResponse(req, "No job candidates for region " + nuts_region + " and category " + category, 404);
+    }
+    if (range->size() == 0) {
+        return buildJsonErrorResponse(req, "No job candidates in the specified distance range", 404);
+    }
+    
+    // Uniform draws with replacement; each one is a single index into the sorted table
+    std::optional<size_t> tier;
+    if (max_speed_kmh) {
+        tier = table->tierFor(*max_speed_kmh);
+    }
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> pick(range->begin, range->end - 1);
+    crow::json::wvalue::list candidates;
+    for (unsigned i = 0; i < count; ++i) {
+        size_t index = pick(gen);
+        const JobCandidateTable::Candidate& candidate = table->candidate(index);
+        // The engine only loads tables built from its own address file, so the ids are its addresses
+        std::optional<Address> pickup = engine.getAddress(candidate.pickup_address);
+        std::optional<Address> delivery = engine.getAddress(candidate.delivery_address);
+        if (!pickup || !delivery) {
+            return buildJsonErrorResponse(req, "Job candidate refers to an unknown address", 500);
+        }
+        crow::json::wvalue json;
+        json["pickup"] = pickup->toJson();
+        json["delivery"] = delivery->toJson();
+        json["distance_m"] = candidate.distance_m;
+        if (tier) {
+            json["travel_time_ms"] = table->tierTime(index, *tier);
+            json["speed_tier_kmh"] = table->speedTiers()[*tier];
+        } else {
+            json["travel_time_ms"] = candidate.travel_time_ms;
+        }
+        candidates.push_back(std::move(json));
+    }
+    
+    crow::json::wvalue response;
+    response["success"] = true;
+    response["candidates"] = std::move(candidates);
+    response["available"] = range->size();
+    
+    crow::response resp = buildJsonResponse(req, response);
+    long long end_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    return resp;
+}
+
+crow::response ApiHandlers::handleReachable(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received reachable request: " + req.url);
+    
+    std::string from_param = req.url_params.get("from") ? req.url_params.get("from") : "";
+    std::string max_time_param = req.url_params.get("max_time") ? req.url_params.get("max_time") : "";
+    std::string count_param = req.url_params.get("count") ? req.url_params.get("count") : "";
+    std::string seed_param = req.url_params.get("seed") ? req.url_params.get("seed") : "42";
+    
+    double from_lat, from_lon;
+    if (!parseCoordinate(from_param, from_lat, from_lon) || max_time_param.empty()) {
+        return buildJsonErrorResponse(req,
+            "Missing required parameters. Format: /api/v1/reachable?from=lat,lon&max_time=T&count=N&seed=S", 400);
+    }
+    
+    // Budget in seconds like the travel times of route responses
+    double max_time_seconds;
+    unsigned count = MAX_REACHABLE_COUNT;
+    unsigned seed;
+    try {
+        max_time_seconds = std::stod(max_time_param);
+        if (!count_param.empty()) {
+            count = std::stoul(count_param);
+        }
+        seed = std::stoul(seed_param);
+    } catch (const std::exception& e) {
+        return buildJsonErrorResponse(req, "Invalid parameter format. max_time (seconds), count and seed are numeric", 400);
+    }
+    if (!(max_time_seconds >= 0.0) || max_time_seconds > 86400.0) {
+        return buildJsonErrorResponse(req, "max_time must be between 0 and 86400 seconds", 400);
+    }
+    if (count == 0 || count > MAX_REACHABLE_COUNT) {
+        return buildJsonErrorResponse(req, "count must be between 1 and " + std::to_string(MAX_REACHABLE_COUNT), 400);
+    }
+    
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, {{from_lat, from_lon}}, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    const RoutingEngine& engine = *current->engine;
+    if (engine.getAddressCount() == 0) {
+        return buildJsonErrorResponse(req, "No addresses loaded. Start server with address CSV file.", 404);
+    }
+    if (!engine.hasReachability()) {
+        return buildJsonErrorResponse(req, "Reachability is disabled (PHAST=0)", 503);
+    }
+    
+    unsigned max_time_ms = static_cast<unsigned>(std::lround(max_time_seconds * 1000.0));
+    ReachableResult reachable = engine.computeReachableAddresses(from_lat, from_lon, max_time_ms, count, seed);
+    if (!reachable.source_snapped) {
+        return buildJsonErrorResponse(req, "No routing node near the from coordinate", 404);
+    }
+    
+    crow::json::wvalue::list addresses;
+    for (size_t i = 0; i < reachable.addresses.size(); ++i) {
+        crow::json::wvalue json = reachable.addresses[i].toJson();
+        json["travel_time_seconds"] = reachable.travel_times_ms[i] / 1000.0;
+        addresses.push_back(std::move(json));
+    }
+    
+    crow::json::wvalue response;
+    response["success"] = true;
+    response["reachable_count"] = reachable.reachable_count;
+    response["sampled"] = reachable.reachable_count > reachable.addresses.size();
+    response["addresses"] = std::move(addresses);
+    response["query_time_us"] = reachable.query_time_us;
+    
+    crow::response resp = buildJsonResponse(req, response);
+    long long end_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    return resp;
+}
+
 crow::response ApiHandlers::handleCompleteJobRoute(const crow::request& req) {
     long long start_time = RoutingKit::get_micro_time();
-    LOG("Received complete job route request: " + req.url);
+    LOG_DEBUG("Received complete job route request: " + req.url);
     
     // Parse coordinates from request
     std::string from_param = req.url_params.get("from") ? req.url_params.get("from") : "";
@@ -566,29 +1160,20 @@ crow::response ApiHandlers::handleCompleteJobRoute(const crow::request& req) {
     if (!parseCoordinate(from_param, from_lat, from_lon) ||
         !parseCoordinate(via_param, via_lat, via_lon) ||
         !parseCoordinate(to_param, to_lat, to_lon)) {
-        auto error_json = JsonBuilder::buildErrorResponse(
-            "Invalid or missing coordinates. Format: /api/v1/complete_job_route?from=latitude,longitude&via=latitude,longitude&to=latitude,longitude"
-        );
-        crow::response temp_resp(error_json);
-        std::string error_string = temp_resp.body;
-        auto compressed = JsonBuilder::compressGzip(error_string);
-        
-        crow::response resp;
-        if (!compressed.empty()) {
-            resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-            resp.add_header("Content-Encoding", "gzip");
-        } else {
-            resp.body = error_string;
-        }
-        resp.add_header("Content-Type", "application/json");
-        resp.code = 400;
-        
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return resp;
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "Invalid or missing coordinates. Format: /api/v1/complete_job_route?from=latitude,longitude&via=latitude,longitude&to=latitude,longitude", 400);
     }
     
-    LOG("Routing from (" << from_lat << "," << from_lon << ") via (" << via_lat << "," << via_lon << ") to (" << to_lat << "," << to_lon << ")");
+    LOG_DEBUG("Routing from (" << from_lat << "," << from_lon << ") via (" << via_lat << "," << via_lon << ") to (" << to_lat << "," << to_lon << ")");
+    
+    // Optional path encoding (json, columnar or binary)
+    std::optional<RouteFormat> format = parseRouteFormat(req.url_params.get("format") ? req.url_params.get("format") : "");
+    if (!format.has_value()) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "Invalid format. Use json, columnar or binary", 400);
+    }
     
     // Parse optional parameters
     bool include_path = true;
@@ -596,130 +1181,125 @@ crow::response ApiHandlers::handleCompleteJobRoute(const crow::request& req) {
     if (!include_path_param.empty()) {
         if (include_path_param == "0" || include_path_param == "false") {
             include_path = false;
-            LOG("include_path=0: returning metadata-only response");
+            LOG_DEBUG("include_path=0: returning metadata-only response");
         }
     }
     
-    std::optional<unsigned> max_speed_kmh;
+    RouteToken route;
+    route.points = {{from_lat, from_lon}, {via_lat, via_lon}, {to_lat, to_lon}};
+    
     std::string max_speed_param = req.url_params.get("max_speed") ? req.url_params.get("max_speed") : "";
     if (!max_speed_param.empty()) {
         try {
             unsigned max_speed = std::stoul(max_speed_param);
             if (max_speed > 0) {
-                max_speed_kmh = max_speed;
-                LOG("Applying maximum speed limit: " << max_speed << " km/h");
+                route.max_speed_kmh = max_speed;
+                LOG_DEBUG("Applying maximum speed limit: " << max_speed << " km/h");
             }
         } catch (const std::exception& e) {
-            LOG("Invalid max_speed parameter: " << e.what());
+            LOG_WARN("Invalid max_speed parameter: " << e.what());
         }
     }
     
-    double speed_multiplier = 1.0;
     std::string speed_multiplier_param = req.url_params.get("speed_multiplier") ? req.url_params.get("speed_multiplier") : "";
     if (!speed_multiplier_param.empty()) {
         try {
-            speed_multiplier = std::stod(speed_multiplier_param);
+            double speed_multiplier = std::stod(speed_multiplier_param);
             if (speed_multiplier <= 0.0) {
-                LOG("Invalid speed_multiplier (must be > 0), using default 1.0");
-                speed_multiplier = 1.0;
+                LOG_WARN("Invalid speed_multiplier (must be > 0), using default 1.0");
             } else {
-                LOG("Applying speed multiplier: " << speed_multiplier);
+                route.speed_multiplier = speed_multiplier;
+                LOG_DEBUG("Applying speed multiplier: " << speed_multiplier);
             }
         } catch (const std::exception& e) {
-            LOG("Invalid speed_multiplier parameter: " << e.what() << ", using default 1.0");
+            LOG_WARN("Invalid speed_multiplier parameter: " << e.what() << ", using default 1.0");
         }
     }
     
-    // Compute first leg: from -> via
-    LOG("Computing first leg (from -> via)...");
-    long long leg1_start = RoutingKit::get_micro_time();
-    RoutingResult leg1_result = engine_->computeShortestPathFromCoordinates(from_lat, from_lon, via_lat, via_lon);
-    long long leg1_end = RoutingKit::get_micro_time();
-    if (RoutingEngine::isTimingEnabled()) {
-        LOG("[TIMING] leg1 computeShortestPathFromCoordinates: " << (leg1_end - leg1_start) / 1000.0 << " ms");
+    route.metric = parseMetric(req.url_params.get("metric") ? req.url_params.get("metric") : "");
+    route.region = req.url_params.get("region") ? req.url_params.get("region") : "";
+    
+    return respondJobRoute(req, route, *format, include_path, start_time);
+}
+
+crow::response ApiHandlers::respondJobRoute(const crow::request& req, const RouteToken& route,
+                                            RouteFormat format, bool include_path, long long start_time) {
+    const auto& [from_lat, from_lon] = route.points[0];
+    const auto& [via_lat, via_lon] = route.points[1];
+    const auto& [to_lat, to_lon] = route.points[2];
+    const RoutingMetric metric = route.metric;
+    const double speed_multiplier = route.speed_multiplier;
+    std::optional<unsigned> max_speed_kmh;
+    if (route.max_speed_kmh > 0) {
+        max_speed_kmh = route.max_speed_kmh;
     }
     
-    if (!leg1_result.success) {
-        auto error_json = JsonBuilder::buildErrorResponse(
-            "No route found from start to pickup location"
-        );
-        crow::response temp_resp(error_json);
-        std::string error_string = temp_resp.body;
-        auto compressed = JsonBuilder::compressGzip(error_string);
-        
-        crow::response resp;
-        if (!compressed.empty()) {
-            resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-            resp.add_header("Content-Encoding", "gzip");
-        } else {
-            resp.body = error_string;
-        }
-        resp.add_header("Content-Type", "application/json");
-        resp.code = 404;
-        
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(route.region, route.points, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
+    
+    // Repeated requests are answered from the route cache
+    RouteCache::Key cache_key;
+    cache_key.engine_instance = current->instance;
+    cache_key.endpoint = 1;
+    cache_key.points = {RouteCache::quantize(from_lat, from_lon), RouteCache::quantize(via_lat, via_lon),
+                        RouteCache::quantize(to_lat, to_lon)};
+    cache_key.max_speed_kmh = max_speed_kmh.value_or(0);
+    cache_key.speed_multiplier_bits = RouteCache::doubleBits(speed_multiplier);
+    cache_key.metric = static_cast<uint8_t>(metric);
+    cache_key.format = static_cast<uint8_t>(format);
+    cache_key.encoding = static_cast<uint8_t>(negotiateEncoding(req));
+    cache_key.include_path = include_path;
+    if (auto cached = route_cache_.lookup(cache_key)) {
+        cached->add_header("X-Route-Cache", "hit");
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return resp;
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (cached: " << cached->body.size() << " bytes)");
+        return std::move(*cached);
     }
     
-    // Compute second leg: via -> to
-    LOG("Computing second leg (via -> to)...");
-    long long leg2_start = RoutingKit::get_micro_time();
-    RoutingResult leg2_result = engine_->computeShortestPathFromCoordinates(via_lat, via_lon, to_lat, to_lon);
-    long long leg2_end = RoutingKit::get_micro_time();
+    // Compute both legs: from -> via and via -> to (snapped once, computed in parallel);
+    // metadata-only requests skip unpacking the paths where possible
+    LOG_DEBUG("Computing job route legs (from -> via -> to)...");
+    long long legs_start = RoutingKit::get_micro_time();
+    JobRouteResult job_result = engine.computeJobRoute(from_lat, from_lon, via_lat, via_lon, to_lat, to_lon, metric, max_speed_kmh,
+                                                      include_path ? RouteDetail::Path : RouteDetail::Totals);
+    long long legs_end = RoutingKit::get_micro_time();
     if (RoutingEngine::isTimingEnabled()) {
-        LOG("[TIMING] leg2 computeShortestPathFromCoordinates: " << (leg2_end - leg2_start) / 1000.0 << " ms");
+        LOG("[TIMING] computeJobRoute: " << (legs_end - legs_start) / 1000.0 << " ms");
     }
     
-    if (!leg2_result.success) {
-        auto error_json = JsonBuilder::buildErrorResponse(
-            "No route found from pickup to delivery location"
-        );
-        crow::response temp_resp(error_json);
-        std::string error_string = temp_resp.body;
-        auto compressed = JsonBuilder::compressGzip(error_string);
-        
-        crow::response resp;
-        if (!compressed.empty()) {
-            resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-            resp.add_header("Content-Encoding", "gzip");
-        } else {
-            resp.body = error_string;
-        }
-        resp.add_header("Content-Type", "application/json");
-        resp.code = 404;
-        
+    if (!job_result.success) {
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
-        return resp;
-    }
-    
-    // Apply max speed to both legs if provided
-    if (max_speed_kmh.has_value()) {
-        leg1_result.total_travel_time_ms = engine_->recalculateTotalTravelTime(leg1_result, max_speed_kmh.value());
-        leg2_result.total_travel_time_ms = engine_->recalculateTotalTravelTime(leg2_result, max_speed_kmh.value());
-        LOG("Total travel time leg1 with max speed: " << leg1_result.total_travel_time_ms << " ms");
-        LOG("Total travel time leg2 with max speed: " << leg2_result.total_travel_time_ms << " ms");
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req,
+            job_result.failed_leg == 2 ? "No route found from pickup to delivery location"
+                                       : "No route found from start to pickup location",
+            404);
     }
+    const RoutingResult& leg1_result = job_result.leg1;
+    const RoutingResult& leg2_result = job_result.leg2;
     
-    // Combine the two legs
+    // Combine the two legs (leg travel times already respect max_speed)
     RoutingResult combined_result;
     combined_result.success = true;
-    combined_result.total_geo_distance_m = leg1_result.total_geo_distance_m + leg2_result.total_geo_distance_m;
-    combined_result.total_travel_time_ms = leg1_result.total_travel_time_ms + leg2_result.total_travel_time_ms;
+    combined_result.total_geo_distance_m = job_result.total_geo_distance_m;
+    combined_result.total_travel_time_ms = job_result.total_travel_time_ms;
     
     // Apply speed multiplier to total travel time
     combined_result.total_travel_time_ms = static_cast<unsigned>(combined_result.total_travel_time_ms * speed_multiplier);
     
     // Build response
-    LOG("Building response");
-    long long json_start = RoutingKit::get_micro_time();
-    crow::json::wvalue json_response;
+    LOG_DEBUG("Building response");
+    std::vector<RoutePoint> combined_points;
     
     if (include_path) {
         // Process both legs into points
-        std::vector<RoutePoint> leg1_points = engine_->processPathIntoPoints(leg1_result, max_speed_kmh);
-        std::vector<RoutePoint> leg2_points = engine_->processPathIntoPoints(leg2_result, max_speed_kmh);
+        std::vector<RoutePoint> leg1_points = engine.processPathIntoPoints(leg1_result, max_speed_kmh);
+        std::vector<RoutePoint> leg2_points = engine.processPathIntoPoints(leg2_result, max_speed_kmh);
         
         // Get final cumulative time and distance from leg1 (before multiplier)
         unsigned leg1_final_time_ms = 0;
@@ -730,7 +1310,6 @@ crow::response ApiHandlers::handleCompleteJobRoute(const crow::request& req) {
         }
         
         // Concatenate: leg1 points + leg2 points with offset
-        std::vector<RoutePoint> combined_points;
         combined_points.reserve(leg1_points.size() + leg2_points.size());
         
         // Add all leg1 points with speed multiplier applied
@@ -751,54 +1330,321 @@ crow::response ApiHandlers::handleCompleteJobRoute(const crow::request& req) {
             offset_point.distance_m = leg1_final_distance_m + point.distance_m;
             combined_points.push_back(offset_point);
         }
-        
-        // Update combined_result with modified total time (already has multiplier applied)
-        json_response = JsonBuilder::buildRouteResponse(combined_result, combined_points);
-    } else {
-        json_response = JsonBuilder::buildLiteRouteResponse(combined_result);
     }
     
+    // Stream the response (combined_result already has the multiplier applied)
+    long long json_start = RoutingKit::get_micro_time();
+    size_t json_size = 0;
+    crow::response resp = buildRouteResponse(req, combined_result, include_path ? &combined_points : nullptr, format, &json_size,
+                                             include_path ? "" : RouteCodec::encodeRouteToken(route));
     long long json_end = RoutingKit::get_micro_time();
     if (RoutingEngine::isTimingEnabled()) {
-        LOG("[TIMING] JsonBuilder::buildRouteResponse: " << (json_end - json_start) / 1000.0 << " ms");
+        LOG("[TIMING] buildRouteResponse: " << (json_end - json_start) / 1000.0 << " ms");
     }
     
-    // Extract metadata values before compressing
-    double travel_time_seconds = combined_result.total_travel_time_ms / 1000.0;
-    unsigned total_distance_meters = combined_result.total_geo_distance_m;
-    bool success = combined_result.success;
+    // Add metadata headers for app server to read without decompressing
+    resp.add_header("X-Travel-Time-Seconds", std::to_string(combined_result.total_travel_time_ms / 1000.0));
+    resp.add_header("X-Total-Distance-Meters", std::to_string(combined_result.total_geo_distance_m));
+    resp.add_header("X-Success", combined_result.success ? "true" : "false");
+    
+    route_cache_.store(cache_key, resp);
+    resp.add_header("X-Route-Cache", "miss");
     
-    // Convert JSON to string and compress with gzip
-    crow::response temp_resp(json_response);
-    std::string json_string = temp_resp.body;
-    auto compressed = JsonBuilder::compressGzip(json_string);
+    long long end_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (encoded: " << resp.body.size() << " bytes, original: " << json_size << " bytes)");
+    return resp;
+}
+
+crow::response ApiHandlers::handleRouteGeometry(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received route geometry request: " + req.url);
     
-    if (compressed.empty()) {
-        LOG("Warning: gzip compression failed, sending uncompressed response");
+    std::optional<RouteToken> route;
+    if (req.url_params.get("token")) {
+        route = RouteCodec::decodeRouteToken(req.url_params.get("token"));
+    }
+    if (!route.has_value()) {
         long long end_time = RoutingKit::get_micro_time();
-        LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
-        crow::response resp(json_response);
-        resp.add_header("Content-Type", "application/json");
-        // Add metadata headers even for uncompressed response
-        resp.add_header("X-Travel-Time-Seconds", std::to_string(travel_time_seconds));
-        resp.add_header("X-Total-Distance-Meters", std::to_string(total_distance_meters));
-        resp.add_header("X-Success", success ? "true" : "false");
-        return resp;
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "Invalid or missing route token. Format: /api/v1/route_geometry?token=<route_token>", 400);
     }
     
-    // Create response with compressed data
-    crow::response resp;
-    resp.body = std::string(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-    resp.add_header("Content-Type", "application/json");
-    resp.add_header("Content-Encoding", "gzip");
-    // Add metadata headers for app server to read without decompressing
-    resp.add_header("X-Travel-Time-Seconds", std::to_string(travel_time_seconds));
-    resp.add_header("X-Total-Distance-Meters", std::to_string(total_distance_meters));
-    resp.add_header("X-Success", success ? "true" : "false");
+    std::optional<RouteFormat> format = parseRouteFormat(req.url_params.get("format") ? req.url_params.get("format") : "");
+    if (!format.has_value()) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req, "Invalid format. Use json, columnar or binary", 400);
+    }
+    
+    // Same response (and cache entry) as the original request with the path included
+    if (route->points.size() == 2) {
+        return respondShortestPath(req, *route, *format, true, start_time);
+    }
+    return respondJobRoute(req, *route, *format, true, start_time);
+}
+
+crow::response ApiHandlers::handleMatrix(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received matrix request: " + req.url);
+    
+    // Body: {"sources": [[lat, lon], ...], "targets": [[lat, lon], ...], "metric": "time"|"distance", "speed_multiplier": x}
+    auto body = crow::json::load(req.body);
+    std::vector<std::pair<double, double>> sources, targets;
+    if (!body || !body.has("sources") || !body.has("targets") ||
+        !parseJsonCoordinateList(body["sources"], sources) ||
+        !parseJsonCoordinateList(body["targets"], targets) ||
+        sources.empty() || targets.empty()) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req,
+            "Invalid body. Format: {\"sources\": [[lat, lon], ...], \"targets\": [[lat, lon], ...]}",
+            400);
+    }
+    
+    if (sources.size() * targets.size() > MAX_MATRIX_CELLS) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req,
+            "Matrix too large: at most " + std::to_string(MAX_MATRIX_CELLS) + " cells per request",
+            400);
+    }
+    
+    // All sources and targets must lie in one region
+    std::vector<std::pair<double, double>> points = sources;
+    points.insert(points.end(), targets.begin(), targets.end());
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, points, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
+    
+    RoutingMetric metric = parseMetric(body.has("metric") && body["metric"].t() == crow::json::type::String
+                                           ? std::string(body["metric"].s()) : "");
+    double speed_multiplier = 1.0;
+    if (body.has("speed_multiplier") && body["speed_multiplier"].t() == crow::json::type::Number &&
+        body["speed_multiplier"].d() > 0.0) {
+        speed_multiplier = body["speed_multiplier"].d();
+    }
     
+    LOG_DEBUG("Computing " << sources.size() << "x" << targets.size() << " matrix");
+    MatrixResult matrix = engine.computeMatrix(sources, targets, metric);
+    
+    // Rows of seconds (time) or meters (distance); null marks unreachable or unsnapped cells
+    crow::json::wvalue::list rows;
+    for (unsigned i = 0; i < matrix.source_count; ++i) {
+        crow::json::wvalue::list row;
+        for (unsigned j = 0; j < matrix.target_count; ++j) {
+            unsigned value = matrix.at(i, j);
+            if (value == RoutingKit::inf_weight) {
+                row.push_back(crow::json::wvalue(nullptr));
+            } else if (metric == RoutingMetric::TravelTime) {
+                row.push_back(value * speed_multiplier / 1000.0);
+            } else {
+                row.push_back(value);
+            }
+        }
+        rows.push_back(std::move(row));
+    }
+    
+    crow::json::wvalue::list sources_snapped, targets_snapped;
+    for (bool snapped : matrix.source_snapped) {
+        sources_snapped.push_back(snapped);
+    }
+    for (bool snapped : matrix.target_snapped) {
+        targets_snapped.push_back(snapped);
+    }
+    
+    crow::json::wvalue response;
+    response["success"] = true;
+    response[metric == RoutingMetric::TravelTime ? "durations_seconds" : "distances_meters"] = std::move(rows);
+    response["sources_snapped"] = std::move(sources_snapped);
+    response["targets_snapped"] = std::move(targets_snapped);
+    response["query_time_us"] = matrix.query_time_us;
+    
+    crow::response resp = buildJsonResponse(req, response);
     long long end_time = RoutingKit::get_micro_time();
-    LOG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (compressed: " << compressed.size() << " bytes, original: " << json_string.size() << " bytes)");
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
     return resp;
 }
 
-} // namespace RoutingServer 
\ No newline at end of file
+crow::response ApiHandlers::handleCompleteJobRouteBatch(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received batch complete job route request: " + req.url);
+    
+    // Body: {"jobs": [{"from": [lat, lon], "via": [lat, lon], "to": [lat, lon]}, ...],
+    //        "max_speed": n, "speed_multiplier": x, "metric": "time"|"distance"}
+    auto body = crow::json::load(req.body);
+    if (!body || !body.has("jobs") || body["jobs"].t() != crow::json::type::List || body["jobs"].size() == 0) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req,
+            "Invalid body. Format: {\"jobs\": [{\"from\": [lat, lon], \"via\": [lat, lon], \"to\": [lat, lon]}, ...]}",
+            400);
+    }
+    if (body["jobs"].size() > MAX_BATCH_JOBS) {
+        long long end_time = RoutingKit::get_micro_time();
+        LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (error)");
+        return buildJsonErrorResponse(req,
+            "Too many jobs: at most " + std::to_string(MAX_BATCH_JOBS) + " per request",
+            400);
+    }
+    
+    std::optional<unsigned> max_speed_kmh;
+    if (body.has("max_speed") && body["max_speed"].t() == crow::json::type::Number && body["max_speed"].d() >= 1.0) {
+        max_speed_kmh = static_cast<unsigned>(body["max_speed"].d());
+    }
+    double speed_multiplier = 1.0;
+    if (body.has("speed_multiplier") && body["speed_multiplier"].t() == crow::json::type::Number &&
+        body["speed_multiplier"].d() > 0.0) {
+        speed_multiplier = body["speed_multiplier"].d();
+    }
+    RoutingMetric metric = parseMetric(body.has("metric") && body["metric"].t() == crow::json::type::String
+                                           ? std::string(body["metric"].s()) : "");
+    
+    // All valid jobs must lie in one region (invalid ones are reported per job below)
+    std::vector<std::pair<double, double>> points;
+    for (const auto& job : body["jobs"]) {
+        double lat, lon;
+        for (const char* key : {"from", "via", "to"}) {
+            if (job.t() == crow::json::type::Object && job.has(key) && parseJsonCoordinate(job[key], lat, lon)) {
+                points.emplace_back(lat, lon);
+            }
+        }
+    }
+    std::string region_error;
+    int region_error_code = 400;
+    std::shared_ptr<const EngineHolder::Current> current = acquireEngine(req, points, region_error, region_error_code);
+    if (!current) {
+        return buildJsonErrorResponse(req, region_error, region_error_code);
+    }
+    RoutingEngine& engine = *current->engine;
+    
+    crow::json::wvalue::list results;
+    for (const auto& job : body["jobs"]) {
+        double from_lat, from_lon, via_lat, via_lon, to_lat, to_lon;
+        crow::json::wvalue job_json;
+        if (job.t() != crow::json::type::Object || !job.has("from") || !job.has("via") || !job.has("to") ||
+            !parseJsonCoordinate(job["from"], from_lat, from_lon) ||
+            !parseJsonCoordinate(job["via"], via_lat, via_lon) ||
+            !parseJsonCoordinate(job["to"], to_lat, to_lon)) {
+            job_json["success"] = false;
+            job_json["error"] = "Invalid coordinates";
+            results.push_back(std::move(job_json));
+            continue;
+        }
+        
+        JobRouteResult job_result = engine.computeJobRoute(from_lat, from_lon, via_lat, via_lon, to_lat, to_lon, metric, max_speed_kmh,
+                                                           RouteDetail::Totals);
+        
+        if (!job_result.success) {
+            job_json["success"] = false;
+            job_json["error"] = job_result.failed_leg == 2 ? "No route found from pickup to delivery location"
+                                                           : "No route found from start to pickup location";
+            results.push_back(std::move(job_json));
+            continue;
+        }
+        
+        unsigned total_time_ms = static_cast<unsigned>(job_result.total_travel_time_ms * speed_multiplier);
+        job_json["success"] = true;
+        job_json["travel_time_seconds"] = total_time_ms / 1000.0;
+        job_json["total_distance_meters"] = job_result.total_geo_distance_m;
+        results.push_back(std::move(job_json));
+    }
+    
+    crow::json::wvalue response;
+    response["success"] = true;
+    response["results"] = std::move(results);
+    
+    crow::response resp = buildJsonResponse(req, response);
+    long long end_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms (" << body["jobs"].size() << " jobs)");
+    return resp;
+}
+
+std::shared_ptr<const EngineHolder::Current> ApiHandlers::acquireEngine(
+    const crow::request& req, const std::vector<std::pair<double, double>>& points,
+    std::string& error_message, int& error_code) {
+    return acquireEngine(req.url_params.get("region") ? req.url_params.get("region") : "", points, error_message, error_code);
+}
+
+std::shared_ptr<const EngineHolder::Current> ApiHandlers::acquireEngine(
+    const std::string& region, const std::vector<std::pair<double, double>>& points,
+    std::string& error_message, int& error_code) {
+    std::optional<size_t> index;
+    if (!region.empty()) {
+        index = regions_->findByName(region);
+        if (!index) {
+            error_message = "Unknown region: " + region;
+            error_code = 400;
+            return nullptr;
+        }
+    } else {
+        index = regions_->find(points);
+        if (!index) {
+            error_message = "No configured region contains all coordinates of the request";
+            error_code = 400;
+            return nullptr;
+        }
+    }
+    try {
+        return regions_->acquire(*index);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to load region " << regions_->name(*index) << ": " << e.what());
+        error_message = "Region " + regions_->name(*index) + " is unavailable";
+        error_code = 503;
+        return nullptr;
+    }
+}
+
+crow::response ApiHandlers::handleAdminReload(const crow::request& req) {
+    long long start_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Received admin reload request: " + req.url);
+    
+    if (admin_token_.empty()) {
+        return buildJsonErrorResponse(req, "Admin endpoints are disabled. Set ADMIN_TOKEN to enable them.", 403);
+    }
+    if (req.get_header_value("X-Admin-Token") != admin_token_) {
+        LOG_WARN("Admin reload request with missing or wrong X-Admin-Token");
+        return buildJsonErrorResponse(req, "Missing or invalid X-Admin-Token header", 401);
+    }
+    
+    int code = 200;
+    if (req.method == crow::HTTPMethod::POST) {
+        size_t started = regions_->startReload();
+        LOG("Engine reload started for " << started << " regions");
+        code = started > 0 ? 202 : 409;
+    }
+    
+    // Only loaded regions are reloaded; the others load the current files on first use anyway
+    crow::json::wvalue response;
+    bool in_progress = false;
+    crow::json::wvalue::list regions_json;
+    for (const auto& region : regions_->status()) {
+        crow::json::wvalue region_json;
+        region_json["name"] = region.name;
+        region_json["loaded"] = region.loaded;
+        if (region.loaded) {
+            in_progress = in_progress || region.reload.in_progress;
+            region_json["in_progress"] = region.reload.in_progress;
+            region_json["generation"] = region.reload.generation;
+            region_json["reloads"] = region.reload.reloads;
+            region_json["failures"] = region.reload.failures;
+            region_json["last_duration_ms"] = region.reload.last_duration_ms;
+            region_json["last_error"] = region.reload.last_error;
+        }
+        regions_json.push_back(std::move(region_json));
+    }
+    response["in_progress"] = in_progress;
+    response["regions"] = std::move(regions_json);
+    if (code == 409) {
+        response["error"] = "No loaded region could start a reload (already in progress)";
+    }
+    
+    long long end_time = RoutingKit::get_micro_time();
+    LOG_DEBUG("Request completed in " << (end_time - start_time) / 1000.0 << " ms");
+    return crow::response(code, response);
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,145 @@
+#include "../include/ArcCostKernels.h"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace RoutingServer {
+
+void ArcCostKernels::WeightStats::merge(const WeightStats& other) {
+    min_ms = std::min(min_ms, other.min_ms);
+    max_ms = std::max(max_ms, other.max_ms);
+    capped_count += other.capped_count;
+    zero_count += other.zero_count;
+}
+
+namespace {
+
+// One arc of computeWeights
+inline uint32_t arcWeight(uint32_t distance_m, unsigned speed_kmh, unsigned max_time_ms) {
+    if (speed_kmh == 0) {
+        return max_time_ms;
+    }
+    double time = static_cast<double>(distance_m) * 3600.0 / static_cast<double>(speed_kmh);
+    return static_cast<uint32_t>(std::min(time, static_cast<double>(max_time_ms)));
+}
+
+} // namespace
+
+ArcCostKernels::WeightStats ArcCostKernels::computeWeights(const uint32_t* distance_m, const uint16_t* speed_kmh,
+                                                           size_t count, unsigned cap_kmh, unsigned max_time_ms,
+                                                           uint32_t* weights) {
+    const unsigned cap = std::min(cap_kmh, NO_SPEED_CAP);
+    WeightStats stats;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Four arcs per step. Distances are split into (d >> 1, d & 1) because SSE2 only converts
+    // signed 32-bit integers; weights stay below 2^31, so signed comparisons work for them too.
+    const __m128i cap_vector = _mm_set1_epi32(static_cast<int32_t>(cap));
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max_time_vector = _mm_set1_epi32(static_cast<int32_t>(max_time_ms));
+    const __m128d max_time_double = _mm_set1_pd(static_cast<double>(max_time_ms));
+    const __m128d seconds_per_hour = _mm_set1_pd(3600.0);
+    const __m128d two_seconds_per_hour = _mm_set1_pd(7200.0);
+    __m128i min_vector = _mm_set1_epi32(INT32_MAX);
+    __m128i max_vector = zero;
+    // Minus the counts (compare masks are -1); a lane sees a quarter of the arcs, and arc ids
+    // are 32-bit, so the lanes cannot overflow
+    __m128i capped_vector = zero;
+    __m128i zero_vector = zero;
+    for (; i + 4 <= count; i += 4) {
+        __m128i distance = _mm_loadu_si128(reinterpret_cast<const __m128i*>(distance_m + i));
+        __m128i speed = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(speed_kmh + i)), zero);
+        __m128i above_cap = _mm_cmpgt_epi32(speed, cap_vector);
+        speed = _mm_or_si128(_mm_andnot_si128(above_cap, speed), _mm_and_si128(above_cap, cap_vector));
+        __m128i no_speed = _mm_cmpeq_epi32(speed, zero);
+        __m128i divisor = _mm_or_si128(speed, _mm_and_si128(no_speed, one));
+
+        __m128i half = _mm_srli_epi32(distance, 1);
+        __m128i odd = _mm_and_si128(distance, one);
+        __m128d time_low = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(half), two_seconds_per_hour),
+                                      _mm_mul_pd(_mm_cvtepi32_pd(odd), seconds_per_hour));
+        __m128d time_high = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(half, half)), two_seconds_per_hour),
+                                       _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(odd, odd)), seconds_per_hour));
+        time_low = _mm_min_pd(_mm_div_pd(time_low, _mm_cvtepi32_pd(divisor)), max_time_double);
+        time_high = _mm_min_pd(_mm_div_pd(time_high, _mm_cvtepi32_pd(_mm_unpackhi_epi64(divisor, divisor))), max_time_double);
+        __m128i weight = _mm_unpacklo_epi64(_mm_cvttpd_epi32(time_low), _mm_cvttpd_epi32(time_high));
+        weight = _mm_or_si128(_mm_andnot_si128(no_speed, weight), _mm_and_si128(no_speed, max_time_vector));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(weights + i), weight);
+
+        __m128i is_zero = _mm_cmpeq_epi32(weight, zero);
+        __m128i nonzero_weight = _mm_or_si128(_mm_andnot_si128(is_zero, weight), _mm_and_si128(is_zero, _mm_set1_epi32(INT32_MAX)));
+        __m128i smaller = _mm_cmpgt_epi32(min_vector, nonzero_weight);
+        min_vector = _mm_or_si128(_mm_andnot_si128(smaller, min_vector), _mm_and_si128(smaller, nonzero_weight));
+        __m128i larger = _mm_cmpgt_epi32(weight, max_vector);
+        max_vector = _mm_or_si128(_mm_andnot_si128(larger, max_vector), _mm_and_si128(larger, weight));
+        capped_vector = _mm_add_epi32(capped_vector, _mm_cmpeq_epi32(weight, max_time_vector));
+        zero_vector = _mm_add_epi32(zero_vector, is_zero);
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), min_vector);
+    for (int32_t lane : lanes) {
+        if (lane != INT32_MAX) {
+            stats.min_ms = std::min(stats.min_ms, static_cast<unsigned>(lane));
+        }
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), max_vector);
+    for (int32_t lane : lanes) {
+        stats.max_ms = std::max(stats.max_ms, static_cast<unsigned>(lane));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), capped_vector);
+    stats.capped_count += static_cast<size_t>(-(static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3]));
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), zero_vector);
+    stats.zero_count += static_cast<size_t>(-(static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3]));
+#endif
+    for (; i < count; ++i) {
+        uint32_t weight = arcWeight(distance_m[i], std::min(static_cast<unsigned>(speed_kmh[i]), cap), max_time_ms);
+        weights[i] = weight;
+        if (weight == 0) {
+            ++stats.zero_count;
+        } else {
+            stats.min_ms = std::min(stats.min_ms, weight);
+        }
+        stats.max_ms = std::max(stats.max_ms, weight);
+        stats.capped_count += weight == max_time_ms;
+    }
+    return stats;
+}
+
+void ArcCostKernels::pathTimes(const unsigned* arcs, size_t count, const uint32_t* distance_m,
+                               const uint16_t* speed_kmh, unsigned cap_kmh, uint32_t* time_ms,
+                               uint16_t* effective_speed_kmh) {
+    const unsigned cap = std::min(cap_kmh, NO_SPEED_CAP);
+    for (size_t i = 0; i < count; ++i) {
+        unsigned arc = arcs[i];
+        unsigned speed = std::min(static_cast<unsigned>(speed_kmh[arc]), cap);
+        double time = static_cast<double>(distance_m[arc]) * 3600.0 / static_cast<double>(speed == 0 ? 1 : speed);
+        time_ms[i] = speed == 0 ? 0 : static_cast<uint32_t>(static_cast<uint64_t>(time));
+        if (effective_speed_kmh != nullptr) {
+            effective_speed_kmh[i] = static_cast<uint16_t>(speed);
+        }
+    }
+}
+
+uint32_t ArcCostKernels::pathTotal(const unsigned* arcs, size_t count, const uint32_t* distance_m,
+                                   const uint16_t* speed_kmh, unsigned cap_kmh) {
+    const unsigned cap = std::min(cap_kmh, NO_SPEED_CAP);
+    uint32_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned arc = arcs[i];
+        unsigned speed = std::min(static_cast<unsigned>(speed_kmh[arc]), cap);
+        double time = static_cast<double>(distance_m[arc]) * 3600.0 / static_cast<double>(speed == 0 ? 1 : speed);
+        total += speed == 0 ? 0 : static_cast<uint32_t>(static_cast<uint64_t>(time));
+    }
+    return total;
+}
+
+void ArcCostKernels::prefixSums(const uint32_t* values, size_t count, uint32_t start, uint32_t* out) {
+    out[0] = start;
+    for (size_t i = 0; i < count; ++i) {
+        out[i + 1] = out[i] + values[i];
+    }
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,135 @@
+#include "../include/EngineHolder.h"
+#include "../include/Logger.h"
+#include <routingkit/timer.h>
+#include <stdexcept>
+
+namespace RoutingServer {
+
+std::shared_ptr<RoutingEngine> EngineHolder::build(const EngineConfig& config, bool require_addresses) {
+    LOG("Starting RoutingEngine constructor with file: " << config.osm_file);
+    if (!config.ch_geo_file.empty()) {
+        LOG("CH file specified: " << config.ch_geo_file);
+    }
+    auto engine = std::make_shared<RoutingEngine>(config.osm_file, config.ch_geo_file, config.snapshot_file,
+                                                  config.ch_time_file);
+    LOG("RoutingEngine constructor completed successfully");
+    LOG("Routing engine initialized with " << engine->getNodeCount() << " nodes and "
+        << engine->getArcCount() << " arcs");
+
+    // Load addresses if provided
+    if (!config.addresses_file.empty()) {
+        LOG("Loading addresses...");
+        if (engine->loadAddressesFromCSV(config.addresses_file)) {
+            LOG("Loaded " << engine->getAddressCount() << " addresses");
+        } else if (require_addresses) {
+            throw std::runtime_error("Failed to load addresses from " + config.addresses_file);
+        } else {
+            LOG("Failed to load addresses from " << config.addresses_file);
+        }
+
+        // Optional categorized places for category filtered annulus sampling
+        if (!config.places_file.empty()) {
+            LOG("Loading places from " << config.places_file);
+            engine->loadPlacesFromCSV(config.places_file);
+        }
+        
+        // Optional precomputed job candidates; they refer to the loaded addresses by id
+        if (!config.job_candidates_file.empty()) {
+            LOG("Loading job candidates from " << config.job_candidates_file);
+            engine->loadJobCandidates(config.job_candidates_file);
+        }
+    } else if (!config.job_candidates_file.empty()) {
+        LOG_ERROR("Job candidates (JOB_CANDIDATES_FILE or job_candidates_file) need an address file, not loading " << config.job_candidates_file);
+    }
+    return engine;
+}
+
+uint64_t EngineHolder::nextInstance() {
+    static std::atomic<uint64_t> next_instance{0};
+    return next_instance.fetch_add(1, std::memory_order_relaxed);
+}
+
+EngineHolder::EngineHolder(EngineConfig config, std::shared_ptr<RoutingEngine> engine)
+    : config_(std::move(config)),
+      current_(std::make_shared<const Current>(Current{std::move(engine), 0, nextInstance()})) {
+}
+
+EngineHolder::~EngineHolder() {
+    std::thread reload_thread;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reload_thread = std::move(reload_thread_);
+    }
+    // A running reload finishes first (building an engine cannot be interrupted)
+    if (reload_thread.joinable()) {
+        reload_thread.join();
+    }
+}
+
+bool EngineHolder::startReload() {
+    if (reloading_.exchange(true)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The previous reload thread is done with its work (reloading_ was false), so this returns right away
+    if (reload_thread_.joinable()) {
+        reload_thread_.join();
+    }
+    status_.in_progress = true;
+    reload_thread_ = std::thread(&EngineHolder::reload, this);
+    return true;
+}
+
+void EngineHolder::reload() {
+    LOG("Reloading routing engine...");
+    long long start_time = RoutingKit::get_micro_time();
+    std::shared_ptr<RoutingEngine> engine;
+    std::string error;
+    try {
+        engine = build(config_, true);
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "Unknown error";
+    }
+    double duration_ms = (RoutingKit::get_micro_time() - start_time) / 1000.0;
+
+    uint64_t generation = 0;
+    if (engine) {
+        generation = std::atomic_load(&current_)->generation + 1;
+        // Requests that loaded the previous Current keep its engine alive until they finish
+        std::atomic_store(&current_, std::make_shared<const Current>(Current{std::move(engine), generation, nextInstance()}));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.in_progress = false;
+        status_.last_duration_ms = duration_ms;
+        if (generation != 0) {
+            status_.generation = generation;
+            ++status_.reloads;
+            status_.last_error.clear();
+            LOG("Routing engine reloaded in " << duration_ms << " ms (generation " << generation << ")");
+            if (listener_) {
+                listener_();
+            }
+        } else {
+            ++status_.failures;
+            status_.last_error = error;
+            LOG_ERROR("Routing engine reload failed, keeping the current engine: " << error);
+        }
+    }
+    reloading_.store(false);
+}
+
+EngineHolder::ReloadStatus EngineHolder::status() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return status_;
+}
+
+void EngineHolder::setReloadListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    listener_ = std::move(listener);
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,210 @@
+#include "../include/GraphSnapshot.h"
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <istream>
+#include <streambuf>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace RoutingServer {
+
+namespace {
+
+struct FileHeader {
+    uint64_t magic;
+    uint32_t format_version;
+    uint32_t profile_version;
+    uint64_t source_file_size;
+    int64_t source_modification_time;
+    uint64_t reserved[2];
+};
+
+struct SectionHeader {
+    uint32_t section;
+    uint32_t element_size;
+    uint64_t size;
+};
+
+constexpr uint64_t SECTION_ALIGNMENT = 8;
+
+// Read-only stream over a memory region, used to hand mapped sections to RoutingKit loaders
+class MemoryStreamBuffer : public std::streambuf {
+public:
+    MemoryStreamBuffer(const char* data, size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+
+} // namespace
+
+std::optional<SnapshotSource> SnapshotSource::fromFile(const std::string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+    SnapshotSource source;
+    source.file_size = static_cast<uint64_t>(st.st_size);
+    source.modification_time = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return source;
+}
+
+// Writer implementation
+GraphSnapshot::Writer::Writer(const std::string& path, const SnapshotSource& source)
+    : path_(path), temp_path_(path + ".tmp") {
+    std::filesystem::path path_obj(path);
+    if (path_obj.has_parent_path()) {
+        std::filesystem::create_directories(path_obj.parent_path());
+    }
+
+    out_.open(temp_path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Failed to open snapshot file for writing: " + temp_path_);
+    }
+
+    FileHeader header{};
+    header.magic = MAGIC;
+    header.format_version = FORMAT_VERSION;
+    header.profile_version = PROFILE_VERSION;
+    header.source_file_size = source.file_size;
+    header.source_modification_time = source.modification_time;
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+GraphSnapshot::Writer::~Writer() {
+    if (!finished_) {
+        out_.close();
+        std::remove(temp_path_.c_str());
+    }
+}
+
+void GraphSnapshot::Writer::beginSection(SnapshotSection section, uint32_t element_size) {
+    SectionHeader header{static_cast<uint32_t>(section), element_size, 0};
+    section_start_ = out_.tellp();
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void GraphSnapshot::Writer::endSection() {
+    std::streampos section_end = out_.tellp();
+    uint64_t size = static_cast<uint64_t>(section_end - section_start_) - sizeof(SectionHeader);
+
+    // Patch the section size now that the payload is written
+    out_.seekp(section_start_ + static_cast<std::streamoff>(offsetof(SectionHeader, size)));
+    out_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out_.seekp(section_end);
+
+    static const char padding[SECTION_ALIGNMENT] = {};
+    uint64_t remainder = size % SECTION_ALIGNMENT;
+    if (remainder != 0) {
+        out_.write(padding, SECTION_ALIGNMENT - remainder);
+    }
+    if (!out_) {
+        throw std::runtime_error("Failed to write snapshot section to: " + temp_path_);
+    }
+}
+
+void GraphSnapshot::Writer::addContractionHierarchy(SnapshotSection section, const RoutingKit::ContractionHierarchy& ch) {
+    beginSection(section, 1);
+    ch.save(out_);
+    endSection();
+}
+
+void GraphSnapshot::Writer::finish() {
+    out_.flush();
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Failed to finalize snapshot file: " + temp_path_);
+    }
+    std::filesystem::rename(temp_path_, path_);
+    finished_ = true;
+}
+
+// Reader implementation
+GraphSnapshot::Reader::Reader(const std::string& path, Access access) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open snapshot file: " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        ::close(fd);
+        throw std::runtime_error("Snapshot file too small: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to mmap snapshot file: " + path);
+    }
+    data_ = static_cast<const char*>(mapped);
+    // Advice values are not flags, so each one is its own call; failures only cost read-ahead
+    if (access == Access::CopyOut) {
+        ::madvise(mapped, size_, MADV_SEQUENTIAL);
+    }
+    ::madvise(mapped, size_, MADV_WILLNEED);
+
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (header.magic != MAGIC) {
+        ::munmap(mapped, size_);
+        throw std::runtime_error("Not a graph snapshot file: " + path);
+    }
+    if (header.format_version != FORMAT_VERSION || header.profile_version != PROFILE_VERSION) {
+        ::munmap(mapped, size_);
+        throw std::runtime_error("Incompatible snapshot version (format " + std::to_string(header.format_version) +
+                                 ", profile " + std::to_string(header.profile_version) + ")");
+    }
+    source_.file_size = header.source_file_size;
+    source_.modification_time = header.source_modification_time;
+
+    // Index the sections
+    uint64_t offset = sizeof(FileHeader);
+    while (offset + sizeof(SectionHeader) <= size_) {
+        SectionHeader section;
+        std::memcpy(&section, data_ + offset, sizeof(section));
+        offset += sizeof(SectionHeader);
+        if (section.size > size_ - offset) {
+            ::munmap(mapped, size_);
+            throw std::runtime_error("Truncated snapshot section " + std::to_string(section.section) + " in: " + path);
+        }
+        sections_[section.section] = SectionEntry{offset, section.size, section.element_size};
+        offset += (section.size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+}
+
+GraphSnapshot::Reader::~Reader() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+bool GraphSnapshot::Reader::hasSection(SnapshotSection section) const {
+    return sections_.count(static_cast<uint32_t>(section)) > 0;
+}
+
+const GraphSnapshot::Reader::SectionEntry& GraphSnapshot::Reader::findSection(SnapshotSection section,
+                                                                              uint32_t element_size) const {
+    auto it = sections_.find(static_cast<uint32_t>(section));
+    if (it == sections_.end()) {
+        throw std::runtime_error("Snapshot section missing: " + std::to_string(static_cast<uint32_t>(section)));
+    }
+    if (it->second.element_size != element_size || it->second.size % element_size != 0) {
+        throw std::runtime_error("Snapshot section has unexpected element size: " +
+                                 std::to_string(static_cast<uint32_t>(section)));
+    }
+    return it->second;
+}
+
+RoutingKit::ContractionHierarchy GraphSnapshot::Reader::readContractionHierarchy(SnapshotSection section) const {
+    const SectionEntry& entry = findSection(section, 1);
+    MemoryStreamBuffer buffer(data_ + entry.offset, entry.size);
+    std::istream in(&buffer);
+    return RoutingKit::ContractionHierarchy::load(in);
+}
+
+} // namespace RoutingServer
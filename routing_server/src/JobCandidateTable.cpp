@@ -0,0 +1,157 @@
+#include "../include/JobCandidateTable.h"
+#include "../include/ArcCostKernels.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+
+namespace RoutingServer {
+
+void JobCandidateTable::setSpeedTiers(std::vector<uint32_t> speed_tiers_kmh) {
+    if (!candidates_.empty() || mapping_) {
+        throw std::logic_error("Speed tiers must be set before tables are added");
+    }
+    std::sort(speed_tiers_kmh.begin(), speed_tiers_kmh.end());
+    speed_tiers_kmh.erase(std::unique(speed_tiers_kmh.begin(), speed_tiers_kmh.end()), speed_tiers_kmh.end());
+    owned_speed_tiers_ = std::move(speed_tiers_kmh);
+    viewOwned();
+}
+
+void JobCandidateTable::addTable(const std::string& region, const std::string& category,
+                                 std::vector<Candidate> candidates, const std::vector<uint32_t>& tier_times_ms) {
+    if (mapping_) {
+        throw std::logic_error("A loaded job candidate table is read-only");
+    }
+    if (tier_times_ms.size() != candidates.size() * speed_tiers_.size()) {
+        throw std::invalid_argument("Expected " + std::to_string(speed_tiers_.size()) + " tier times per candidate");
+    }
+    if (index_.count({region, category}) > 0) {
+        throw std::invalid_argument("Duplicate job candidate table: " + region + "/" + category);
+    }
+
+    std::vector<size_t> order(candidates.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&candidates](size_t a, size_t b) {
+        return candidates[a].distance_m < candidates[b].distance_m;
+    });
+
+    Table table;
+    table.region = names_.intern(region);
+    table.category = names_.intern(category);
+    table.begin = owned_candidates_.size();
+    table.end = owned_candidates_.size() + candidates.size();
+    size_t tier_count = speed_tiers_.size();
+    for (size_t index : order) {
+        owned_candidates_.push_back(candidates[index]);
+        owned_tier_times_.insert(owned_tier_times_.end(), tier_times_ms.begin() + index * tier_count,
+                                 tier_times_ms.begin() + (index + 1) * tier_count);
+    }
+    index_.emplace(std::make_pair(region, category), owned_tables_.size());
+    owned_tables_.push_back(table);
+    viewOwned();
+}
+
+void JobCandidateTable::viewOwned() {
+    speed_tiers_ = SnapshotView<uint32_t>{owned_speed_tiers_.data(), owned_speed_tiers_.size()};
+    tables_ = SnapshotView<Table>{owned_tables_.data(), owned_tables_.size()};
+    candidates_ = SnapshotView<Candidate>{owned_candidates_.data(), owned_candidates_.size()};
+    tier_times_ = SnapshotView<uint32_t>{owned_tier_times_.data(), owned_tier_times_.size()};
+}
+
+std::optional<JobCandidateTable::Range> JobCandidateTable::find(const std::string& region, const std::string& category,
+                                                                uint32_t min_distance_m, uint32_t max_distance_m) const {
+    auto it = index_.find({region, category});
+    if (it == index_.end()) {
+        return std::nullopt;
+    }
+    const Table& table = tables_[it->second];
+    auto first = candidates_.begin() + table.begin;
+    auto last = candidates_.begin() + table.end;
+    auto lower = std::lower_bound(first, last, min_distance_m,
+                                  [](const Candidate& candidate, uint32_t value) { return candidate.distance_m < value; });
+    auto upper = std::upper_bound(lower, last, max_distance_m,
+                                  [](uint32_t value, const Candidate& candidate) { return value < candidate.distance_m; });
+    Range range;
+    range.begin = static_cast<size_t>(lower - candidates_.begin());
+    range.end = static_cast<size_t>(upper - candidates_.begin());
+    return range;
+}
+
+size_t JobCandidateTable::tierFor(unsigned max_speed_kmh) const {
+    return ArcCostKernels::nearestSpeedTier(speed_tiers_.size(), max_speed_kmh,
+                                            [this](size_t tier) { return speed_tiers_[tier]; });
+}
+
+size_t JobCandidateTable::memoryBytes() const {
+    return owned_candidates_.capacity() * sizeof(Candidate) + owned_tier_times_.capacity() * sizeof(uint32_t) +
+           owned_tables_.capacity() * sizeof(Table) + owned_speed_tiers_.capacity() * sizeof(uint32_t) +
+           names_.memoryBytes();
+}
+
+size_t JobCandidateTable::mappedBytes() const {
+    if (!mapping_) {
+        return 0;
+    }
+    return candidates_.size() * sizeof(Candidate) + tier_times_.size() * sizeof(uint32_t) +
+           tables_.size() * sizeof(Table) + speed_tiers_.size() * sizeof(uint32_t);
+}
+
+void JobCandidateTable::save(const std::string& path, const SnapshotSource& source) const {
+    GraphSnapshot::Writer writer(path, source);
+    auto vector_of = [](const auto& view) { return std::vector<std::decay_t<decltype(view[0])>>(view.begin(), view.end()); };
+    writer.addVector(SnapshotSection::JobSpeedTiers, vector_of(speed_tiers_));
+    writer.addVector(SnapshotSection::JobTables, vector_of(tables_));
+    writer.addVector(SnapshotSection::JobNameOffsets, names_.ends());
+    writer.addVector(SnapshotSection::JobNameData, names_.data());
+    writer.addVector(SnapshotSection::JobCandidates, vector_of(candidates_));
+    writer.addVector(SnapshotSection::JobTierTimes, vector_of(tier_times_));
+    writer.addVector(SnapshotSection::JobAddressSource, std::vector<SnapshotSource>{address_source_});
+    writer.finish();
+}
+
+JobCandidateTable JobCandidateTable::load(const std::string& path) {
+    JobCandidateTable table;
+    table.mapping_ = std::make_unique<GraphSnapshot::Reader>(path, GraphSnapshot::Reader::Access::Serve);
+    const GraphSnapshot::Reader& reader = *table.mapping_;
+    table.speed_tiers_ = reader.view<uint32_t>(SnapshotSection::JobSpeedTiers);
+    table.tables_ = reader.view<Table>(SnapshotSection::JobTables);
+    table.candidates_ = reader.view<Candidate>(SnapshotSection::JobCandidates);
+    table.tier_times_ = reader.view<uint32_t>(SnapshotSection::JobTierTimes);
+    table.names_ = StringPool::fromColumns(reader.readVector<uint64_t>(SnapshotSection::JobNameOffsets),
+                                           reader.readVector<char>(SnapshotSection::JobNameData));
+    std::vector<SnapshotSource> address_source = reader.readVector<SnapshotSource>(SnapshotSection::JobAddressSource);
+    if (address_source.size() != 1) {
+        throw std::runtime_error("invalid address source section");
+    }
+    table.address_source_ = address_source[0];
+
+    if (table.tier_times_.size() != table.candidates_.size() * table.speed_tiers_.size()) {
+        throw std::runtime_error("inconsistent section sizes");
+    }
+    table.buildIndex();
+    return table;
+}
+
+void JobCandidateTable::buildIndex() {
+    index_.clear();
+    uint64_t previous_end = 0;
+    for (size_t i = 0; i < tables_.size(); ++i) {
+        const Table& table = tables_[i];
+        if (table.region >= names_.size() || table.category >= names_.size() || table.begin != previous_end ||
+            table.end < table.begin || table.end > candidates_.size()) {
+            throw std::runtime_error("invalid job candidate table entry");
+        }
+        // find() binary searches the distances
+        if (!std::is_sorted(candidates_.begin() + table.begin, candidates_.begin() + table.end,
+                            [](const Candidate& a, const Candidate& b) { return a.distance_m < b.distance_m; })) {
+            throw std::runtime_error("job candidates are not sorted by distance");
+        }
+        previous_end = table.end;
+        index_.emplace(std::make_pair(std::string(names_.get(table.region)), std::string(names_.get(table.category))), i);
+    }
+    if (previous_end != candidates_.size()) {
+        throw std::runtime_error("job candidate tables do not cover all candidates");
+    }
+}
+
+} // namespace RoutingServer
@@ -1,48 +1,82 @@
 #include "../include/JsonBuilder.h"
-#include <iostream>
-#include <zlib.h>
-#include <sstream>
-#include <cstring>
+#include "../include/RouteCodec.h"
 
 namespace RoutingServer {
 
-crow::json::wvalue JsonBuilder::buildRouteResponse(
+void JsonBuilder::writeRouteResponse(
+    JsonWriter& writer,
     const RoutingResult& result,
     const std::vector<RoutePoint>& route_points
 ) {
-    crow::json::wvalue response;
+    writer.beginObject();
     
     // Add basic info about the route
-    response["success"] = result.success;
-    response["travel_time_seconds"] = result.total_travel_time_ms / 1000.0; // Convert to seconds
-    response["total_distance_meters"] = result.total_geo_distance_m; // Distance in meters
+    writer.field("success", result.success);
+    writer.field("travel_time_seconds", result.total_travel_time_ms / 1000.0); // Convert to seconds
+    writer.field("total_distance_meters", result.total_geo_distance_m); // Distance in meters
     
     // Add route points as array of coordinates with cumulative times and distances
-    crow::json::wvalue::list path_list;
+    writer.key("path").beginArray();
     for (const auto& point : route_points) {
-        crow::json::wvalue point_obj;
-        crow::json::wvalue coord_obj;
-        coord_obj["lat"] = static_cast<double>(point.latitude);
-        coord_obj["lon"] = static_cast<double>(point.longitude);
-        point_obj["coordinates"] = std::move(coord_obj);
-        point_obj["cumulative_time_seconds"] = point.time_ms / 1000.0; // Convert to seconds
-        point_obj["cumulative_distance_meters"] = point.distance_m; // Distance in meters
-        point_obj["max_speed_kmh"] = point.max_speed_kmh; // Maximum speed on arc leading to this point
-        point_obj["is_walking_segment"] = point.is_walking_segment; // Whether this is a walking segment
-        path_list.push_back(std::move(point_obj));
+        writer.beginObject();
+        writer.key("coordinates").beginObject();
+        writer.field("lat", static_cast<double>(point.latitude));
+        writer.field("lon", static_cast<double>(point.longitude));
+        writer.endObject();
+        writer.field("cumulative_time_seconds", point.time_ms / 1000.0); // Convert to seconds
+        writer.field("cumulative_distance_meters", point.distance_m); // Distance in meters
+        writer.field("max_speed_kmh", point.max_speed_kmh); // Maximum speed on arc leading to this point
+        writer.field("is_walking_segment", point.is_walking_segment); // Whether this is a walking segment
+        writer.endObject();
     }
-    response["path"] = std::move(path_list);
+    writer.endArray();
     
-    return response;
+    writer.endObject();
 }
 
-crow::json::wvalue JsonBuilder::buildLiteRouteResponse(const RoutingResult& result) {
-    crow::json::wvalue response;
-    response["success"] = result.success;
-    response["travel_time_seconds"] = result.total_travel_time_ms / 1000.0; // Convert to seconds
-    response["total_distance_meters"] = result.total_geo_distance_m; // Distance in meters
+void JsonBuilder::writeColumnarRouteResponse(
+    JsonWriter& writer,
+    const RoutingResult& result,
+    const std::vector<RoutePoint>& route_points
+) {
+    writer.beginObject();
+    writer.field("success", result.success);
+    writer.field("travel_time_seconds", result.total_travel_time_ms / 1000.0); // Convert to seconds
+    writer.field("total_distance_meters", result.total_geo_distance_m); // Distance in meters
+    
+    // Columns share the point order; each is delta or run-length encoded with polyline characters
+    writer.key("path").beginObject();
+    writer.field("format", "columnar");
+    writer.field("point_count", static_cast<unsigned>(route_points.size()));
+    writer.field("precision", 6);
+    writer.field("polyline", RouteCodec::encodePolyline(route_points));
+    writer.field("time_ms_deltas", RouteCodec::encodeTimeDeltas(route_points));
+    writer.field("distance_m_deltas", RouteCodec::encodeDistanceDeltas(route_points));
+    writer.field("max_speed_kmh_runs", RouteCodec::encodeSpeedRuns(route_points));
+    writer.field("walking_runs", RouteCodec::encodeWalkingRuns(route_points));
+    writer.endObject();
+    
+    writer.endObject();
+}
+
+void JsonBuilder::writeLiteRouteResponse(JsonWriter& writer, const RoutingResult& result,
+                                         const std::string& route_token) {
+    writer.beginObject();
+    writer.field("success", result.success);
+    writer.field("travel_time_seconds", result.total_travel_time_ms / 1000.0); // Convert to seconds
+    writer.field("total_distance_meters", result.total_geo_distance_m); // Distance in meters
+    if (!route_token.empty()) {
+        writer.field("route_token", route_token); // For /api/v1/route_geometry
+    }
     // No path array - metadata only
-    return response;
+    writer.endObject();
+}
+
+void JsonBuilder::writeErrorResponse(JsonWriter& writer, const std::string& error_message) {
+    writer.beginObject();
+    writer.field("error", error_message);
+    writer.field("success", false);
+    writer.endObject();
 }
 
 crow::json::wvalue JsonBuilder::buildErrorResponse(const std::string& error_message) {
@@ -52,47 +86,17 @@ crow::json::wvalue JsonBuilder::buildErrorResponse(const std::string& error_mess
     return response;
 }
 
-std::vector<unsigned char> JsonBuilder::compressGzip(const std::string& json_string) {
-    std::vector<unsigned char> compressed;
-    
-    z_stream zs;
-    memset(&zs, 0, sizeof(zs));
-    
-    // Initialize zlib stream for gzip compression
-    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-                     15 + 16, // windowBits: 15 for deflate, +16 for gzip header
-                     8,       // memLevel
-                     Z_DEFAULT_STRATEGY) != Z_OK) {
-        return compressed; // Return empty on error
-    }
-    
-    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(json_string.data()));
-    zs.avail_in = static_cast<uInt>(json_string.size());
-    
-    // Compress in chunks
-    int ret;
-    unsigned char buffer[16384]; // 16KB buffer
-    
-    do {
-        zs.next_out = buffer;
-        zs.avail_out = sizeof(buffer);
-        
-        ret = deflate(&zs, Z_FINISH);
-        
-        // Append compressed data to result vector
-        size_t compressed_size = sizeof(buffer) - zs.avail_out;
-        if (compressed_size > 0) {
-            compressed.insert(compressed.end(), buffer, buffer + compressed_size);
-        }
-    } while (ret == Z_OK);
-    
-    deflateEnd(&zs);
-    
-    if (ret != Z_STREAM_END) {
-        compressed.clear(); // Return empty on error
-    }
-    
-    return compressed;
+crow::json::wvalue JsonBuilder::buildCacheStats(const CacheStats& stats) {
+    crow::json::wvalue json;
+    json["hits"] = stats.hits;
+    json["misses"] = stats.misses;
+    json["evictions"] = stats.evictions;
+    json["entries"] = stats.entries;
+    json["cost"] = stats.cost;
+    json["capacity"] = stats.capacity;
+    uint64_t lookups = stats.hits + stats.misses;
+    json["hit_rate"] = lookups > 0 ? static_cast<double>(stats.hits) / lookups : 0.0;
+    return json;
 }
 
-} // namespace RoutingServer 
\ No newline at end of file
+} // namespace RoutingServer
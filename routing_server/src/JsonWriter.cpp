@@ -0,0 +1,177 @@
+#include "../include/JsonWriter.h"
+#include <cmath>
+#include <cstdio>
+
+namespace RoutingServer {
+
+namespace {
+
+// Reused across requests on the same thread to keep its capacity
+std::string& scratchBuffer() {
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+
+} // namespace
+
+JsonWriter::JsonWriter(ResponseEncoder& encoder) : encoder_(encoder), buffer_(scratchBuffer()) {}
+
+JsonWriter::~JsonWriter() {
+    flush();
+}
+
+void JsonWriter::flush() {
+    if (!buffer_.empty()) {
+        encoder_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+}
+
+void JsonWriter::maybeFlush() {
+    if (buffer_.size() >= FLUSH_THRESHOLD) {
+        flush();
+    }
+}
+
+void JsonWriter::separate() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    if (!first_in_scope_.empty()) {
+        if (!first_in_scope_.back()) {
+            buffer_ += ',';
+        }
+        first_in_scope_.back() = false;
+    }
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separate();
+    buffer_ += '{';
+    first_in_scope_.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    buffer_ += '}';
+    first_in_scope_.pop_back();
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separate();
+    buffer_ += '[';
+    first_in_scope_.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    buffer_ += ']';
+    first_in_scope_.pop_back();
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+    separate();
+    buffer_ += '"';
+    appendEscaped(name, std::char_traits<char>::length(name));
+    buffer_ += "\":";
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool v) {
+    separate();
+    buffer_ += v ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int v) {
+    separate();
+    buffer_ += std::to_string(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned v) {
+    separate();
+    buffer_ += std::to_string(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(uint64_t v) {
+    separate();
+    buffer_ += std::to_string(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double v) {
+    separate();
+    if (!std::isfinite(v)) {
+        buffer_ += "null";
+        return *this;
+    }
+    char number[32];
+    int length = std::snprintf(number, sizeof(number), "%.15g", v);
+    buffer_.append(number, static_cast<size_t>(length));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* v) {
+    separate();
+    buffer_ += '"';
+    appendEscaped(v, std::char_traits<char>::length(v));
+    buffer_ += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const std::string& v) {
+    separate();
+    buffer_ += '"';
+    appendEscaped(v.data(), v.size());
+    buffer_ += '"';
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separate();
+    buffer_ += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(const std::string& json) {
+    separate();
+    buffer_ += json;
+    maybeFlush();
+    return *this;
+}
+
+void JsonWriter::appendEscaped(const char* data, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        switch (c) {
+            case '"': buffer_ += "\\\""; break;
+            case '\\': buffer_ += "\\\\"; break;
+            case '\n': buffer_ += "\\n"; break;
+            case '\r': buffer_ += "\\r"; break;
+            case '\t': buffer_ += "\\t"; break;
+            case '\b': buffer_ += "\\b"; break;
+            case '\f': buffer_ += "\\f"; break;
+            default:
+                if (c < 0x20) {
+                    buffer_ += "\\u00";
+                    buffer_ += hex[c >> 4];
+                    buffer_ += hex[c & 0xf];
+                } else {
+                    buffer_ += static_cast<char>(c);
+                }
+        }
+    }
+}
+
+} // namespace RoutingServer
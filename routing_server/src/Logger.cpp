@@ -0,0 +1,183 @@
+#include "../include/Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace RoutingServer {
+
+namespace {
+
+const char* levelTag(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "[DEBUG] ";
+        case LogLevel::Info: return "";
+        case LogLevel::Warn: return "[WARN] ";
+        case LogLevel::Error: return "[ERROR] ";
+    }
+    return "";
+}
+
+LogLevel levelFromEnv() {
+    const char* level_env = std::getenv("ROUTING_LOG_LEVEL");
+    if (level_env == nullptr) {
+        return LogLevel::Info;
+    }
+    std::string level(level_env);
+    if (level == "debug") return LogLevel::Debug;
+    if (level == "warn") return LogLevel::Warn;
+    if (level == "error") return LogLevel::Error;
+    return LogLevel::Info;
+}
+
+constexpr std::chrono::milliseconds FLUSH_POLL_INTERVAL(1);
+
+} // namespace
+
+Logger& Logger::instance() {
+    // Never destroyed, so threads that log during static destruction still find a live logger
+    static Logger* logger = [] {
+        Logger* created = new Logger();
+        std::atexit([] { Logger::instance().flush(); });
+        return created;
+    }();
+    return *logger;
+}
+
+Logger::Logger() : ring_(std::make_unique<Entry[]>(RING_CAPACITY)) {
+    static_assert((RING_CAPACITY & (RING_CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+    for (size_t i = 0; i < RING_CAPACITY; ++i) {
+        ring_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    min_level_.store(static_cast<int>(levelFromEnv()), std::memory_order_relaxed);
+    drain_thread_ = std::thread([this]() { drainLoop(); });
+}
+
+Logger::~Logger() {
+    stopping_.store(true, std::memory_order_seq_cst);
+    wake();
+    if (drain_thread_.joinable()) {
+        drain_thread_.join();
+    }
+}
+
+void Logger::write(LogLevel level, const std::string& message) {
+    // Bounded multi-producer queue: claim a position, fill the entry, then publish its sequence
+    uint64_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Entry* entry;
+    while (true) {
+        entry = &ring_[position & (RING_CAPACITY - 1)];
+        uint64_t sequence = entry->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+        if (diff == 0) {
+            if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = enqueue_position_.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->time = std::chrono::system_clock::now();
+    entry->level = level;
+    size_t length = std::min(message.size(), MAX_MESSAGE_LENGTH);
+    std::memcpy(entry->text, message.data(), length);
+    if (length < message.size()) {
+        std::memcpy(entry->text + length - 3, "...", 3);
+    }
+    entry->length = static_cast<uint16_t>(length);
+    entry->sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in drainLoop: either the drain thread sees this entry before parking,
+    // or this sees parked_ and wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_relaxed)) {
+        wake();
+    }
+}
+
+void Logger::wake() {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    parked_.store(false, std::memory_order_relaxed);
+    idle_cv_.notify_one();
+}
+
+bool Logger::pending() const {
+    uint64_t position = dequeue_position_.load(std::memory_order_relaxed);
+    return ring_[position & (RING_CAPACITY - 1)].sequence.load(std::memory_order_acquire) == position + 1 ||
+           dropped_.load(std::memory_order_relaxed) != reported_dropped_;
+}
+
+bool Logger::drain() {
+    uint64_t position = dequeue_position_.load(std::memory_order_relaxed);
+    std::string batch;
+    while (true) {
+        Entry& entry = ring_[position & (RING_CAPACITY - 1)];
+        if (entry.sequence.load(std::memory_order_acquire) != position + 1) {
+            break;
+        }
+
+        std::time_t time = std::chrono::system_clock::to_time_t(entry.time);
+        std::tm tm;
+        localtime_r(&time, &tm);
+        char time_buffer[16];
+        std::strftime(time_buffer, sizeof(time_buffer), "%H:%M:%S", &tm);
+
+        batch += '[';
+        batch += time_buffer;
+        batch += "] ";
+        batch += levelTag(entry.level);
+        batch.append(entry.text, entry.length);
+        batch += '\n';
+
+        entry.sequence.store(position + RING_CAPACITY, std::memory_order_release);
+        ++position;
+    }
+
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+        batch += "[logger] dropped " + std::to_string(dropped - reported_dropped_) + " messages (ring buffer full)\n";
+        reported_dropped_ = dropped;
+    }
+
+    if (batch.empty()) {
+        return false;
+    }
+    std::fwrite(batch.data(), 1, batch.size(), stdout);
+    std::fflush(stdout);
+    // Published only once the batch is out, so flush() never returns before its messages are written
+    dequeue_position_.store(position, std::memory_order_release);
+    return true;
+}
+
+void Logger::drainLoop() {
+    while (!stopping_.load(std::memory_order_acquire)) {
+        if (drain()) {
+            continue;
+        }
+        // Park until a writer publishes an entry; announce it first, then look once more
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        parked_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (pending() || stopping_.load(std::memory_order_relaxed)) {
+            parked_.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        idle_cv_.wait(lock, [this]() { return !parked_.load(std::memory_order_relaxed); });
+    }
+    drain();
+}
+
+void Logger::flush() {
+    uint64_t target = enqueue_position_.load(std::memory_order_acquire);
+    while (dequeue_position_.load(std::memory_order_acquire) < target && drain_thread_.joinable() &&
+           !stopping_.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(FLUSH_POLL_INTERVAL);
+    }
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,198 @@
+#include "../include/Metrics.h"
+#include <cmath>
+#include <cstdio>
+
+namespace RoutingServer {
+
+namespace {
+
+// Histogram bucket bounds exported to Prometheus: powers of two from 16 µs to ~33 s
+constexpr unsigned EXPORTED_MIN_EXPONENT = 4;
+constexpr unsigned EXPORTED_MAX_EXPONENT = 25;
+
+constexpr double EXPORTED_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+std::string formatDouble(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+} // namespace
+
+unsigned LatencyHistogram::bucketIndex(uint64_t micros) {
+    if (micros < SUB_BUCKETS) {
+        return static_cast<unsigned>(micros);
+    }
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(micros));
+    if (exponent >= MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    unsigned sub_bucket = static_cast<unsigned>(micros >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketLimit(unsigned index) {
+    if (index < SUB_BUCKETS) {
+        return index + 1;
+    }
+    unsigned exponent = (index - SUB_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS;
+    unsigned sub_bucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    return static_cast<uint64_t>(SUB_BUCKETS + sub_bucket + 1) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * count));
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucketLimit(i);
+        }
+    }
+    return bucketLimit(BUCKET_COUNT - 1);
+}
+
+uint64_t LatencyHistogram::Snapshot::countBelow(uint64_t limit_us) const {
+    uint64_t below = 0;
+    for (unsigned i = 0; i < BUCKET_COUNT && bucketLimit(i) <= limit_us; ++i) {
+        below += counts[i];
+    }
+    return below;
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Shard& Metrics::localShard() {
+    thread_local size_t shard = next_shard_.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return shards_[shard];
+}
+
+void Metrics::record(MetricStage stage, long long micros) {
+    uint64_t value = micros > 0 ? static_cast<uint64_t>(micros) : 0;
+    StageCounters& counters = localShard().stages[static_cast<size_t>(stage)];
+    counters.buckets[LatencyHistogram::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    counters.sum_us.fetch_add(value, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot Metrics::snapshot(MetricStage stage) const {
+    LatencyHistogram::Snapshot result;
+    for (const Shard& shard : shards_) {
+        const StageCounters& counters = shard.stages[static_cast<size_t>(stage)];
+        for (unsigned i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            uint64_t count = counters.buckets[i].load(std::memory_order_relaxed);
+            result.counts[i] += count;
+            result.count += count;
+        }
+        result.sum_us += counters.sum_us.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void Metrics::writeStageHistograms(std::string& out) const {
+    std::vector<LatencyHistogram::Snapshot> snapshots;
+    for (size_t stage = 0; stage < static_cast<size_t>(MetricStage::Count); ++stage) {
+        snapshots.push_back(snapshot(static_cast<MetricStage>(stage)));
+    }
+
+    PrometheusWriter writer(out);
+    writer.family("routing_stage_duration_seconds", "histogram", "Latency of each request stage");
+    for (size_t stage = 0; stage < snapshots.size(); ++stage) {
+        const LatencyHistogram::Snapshot& snapshot = snapshots[stage];
+        std::string stage_label = PrometheusWriter::label("stage", metricStageName(static_cast<MetricStage>(stage)));
+        for (unsigned exponent = EXPORTED_MIN_EXPONENT; exponent <= EXPORTED_MAX_EXPONENT; ++exponent) {
+            uint64_t limit_us = uint64_t{1} << exponent;
+            writer.sample("routing_stage_duration_seconds_bucket",
+                          stage_label + ",le=\"" + formatDouble(limit_us / 1e6) + "\"", snapshot.countBelow(limit_us));
+        }
+        writer.sample("routing_stage_duration_seconds_bucket", stage_label + ",le=\"+Inf\"", snapshot.count);
+        writer.sample("routing_stage_duration_seconds_sum", stage_label, snapshot.sum_us / 1e6);
+        writer.sample("routing_stage_duration_seconds_count", stage_label, snapshot.count);
+    }
+
+    // Quantiles at the histogram's full resolution; since startup, not over a window
+    writer.family("routing_stage_duration_quantile_seconds", "gauge",
+                  "Upper bound of the bucket holding each latency quantile since startup");
+    for (size_t stage = 0; stage < snapshots.size(); ++stage) {
+        std::string stage_label = PrometheusWriter::label("stage", metricStageName(static_cast<MetricStage>(stage)));
+        for (double q : EXPORTED_QUANTILES) {
+            writer.sample("routing_stage_duration_quantile_seconds",
+                          stage_label + ",quantile=\"" + formatDouble(q) + "\"", snapshots[stage].quantile(q) / 1e6);
+        }
+    }
+}
+
+const char* metricStageName(MetricStage stage) {
+    switch (stage) {
+        case MetricStage::Snap: return "snap";
+        case MetricStage::ChQuery: return "ch_query";
+        case MetricStage::PathUnpack: return "path_unpack";
+        case MetricStage::ProcessPath: return "process_path";
+        case MetricStage::JsonBuild: return "json_build";
+        case MetricStage::Compress: return "compress";
+        case MetricStage::Count: break;
+    }
+    return "";
+}
+
+void PrometheusWriter::family(const char* name, const char* type, const char* help) {
+    out_ += "# HELP ";
+    out_ += name;
+    out_ += ' ';
+    out_ += help;
+    out_ += "\n# TYPE ";
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += '\n';
+}
+
+void PrometheusWriter::writeName(const char* name, const std::string& labels) {
+    out_ += name;
+    if (!labels.empty()) {
+        out_ += '{';
+        out_ += labels;
+        out_ += '}';
+    }
+    out_ += ' ';
+}
+
+void PrometheusWriter::sample(const char* name, const std::string& labels, double value) {
+    writeName(name, labels);
+    out_ += formatDouble(value);
+    out_ += '\n';
+}
+
+void PrometheusWriter::sample(const char* name, const std::string& labels, uint64_t value) {
+    writeName(name, labels);
+    out_ += std::to_string(value);
+    out_ += '\n';
+}
+
+std::string PrometheusWriter::label(const char* key, const std::string& value) {
+    std::string result = key;
+    result += "=\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else {
+            result += c;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,68 @@
+#include "../include/PhastSweep.h"
+#include <routingkit/constants.h>
+#include <algorithm>
+#include <functional>
+
+namespace RoutingServer {
+
+PhastSweep::PhastSweep(const RoutingKit::ContractionHierarchy& ch)
+    : node_count_(ch.node_count()), first_in_(ch.node_count() + 1), arcs_(ch.backward.head.size()) {
+    // A backward arc stored at rank x with head y stands for a path y -> x of the input graph,
+    // with y ranked above x: exactly the arcs the downward sweep relaxes into x
+    unsigned arc_count = 0;
+    for (unsigned s = 0; s < node_count_; ++s) {
+        const unsigned rank = node_count_ - 1 - s;
+        first_in_[s] = arc_count;
+        for (unsigned arc = ch.backward.first_out[rank]; arc < ch.backward.first_out[rank + 1]; ++arc) {
+            arcs_[arc_count++] = DownArc{slot(ch.backward.head[arc]), ch.backward.weight[arc]};
+        }
+        // Ascending sources keep the reads of one slot moving in one direction
+        std::sort(arcs_.begin() + first_in_[s], arcs_.begin() + arc_count,
+                  [](const DownArc& a, const DownArc& b) { return a.source < b.source; });
+    }
+    first_in_[node_count_] = arc_count;
+}
+
+void PhastQuery::run(const RoutingKit::ContractionHierarchy& ch, const PhastSweep& sweep,
+                     unsigned source, unsigned source_distance, unsigned bound) {
+    const unsigned node_count = sweep.nodeCount();
+    distance_.assign(node_count, RoutingKit::inf_weight);
+    heap_.clear();
+
+    // Upward search: distances of the source's upward closure, nothing at or beyond the bound
+    const unsigned source_rank = ch.rank[source];
+    distance_[sweep.slot(source_rank)] = source_distance;
+    heap_.emplace_back(source_distance, source_rank);
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<>());
+        auto [distance, rank] = heap_.back();
+        heap_.pop_back();
+        if (distance != distance_[sweep.slot(rank)] || distance >= bound) {
+            continue; // Superseded by a shorter entry, or too far to matter below the bound
+        }
+        for (unsigned arc = ch.forward.first_out[rank]; arc < ch.forward.first_out[rank + 1]; ++arc) {
+            unsigned head = ch.forward.head[arc];
+            unsigned new_distance = distance + ch.forward.weight[arc];
+            if (new_distance < distance_[sweep.slot(head)]) {
+                distance_[sweep.slot(head)] = new_distance;
+                heap_.emplace_back(new_distance, head);
+                std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+            }
+        }
+    }
+
+    // Downward sweep in slot order. Weights stay below inf_weight, so a sum never wraps and an
+    // unreachable source never lowers a distance.
+    const PhastSweep::DownArc* arcs = sweep.arcs_.data();
+    const unsigned* first_in = sweep.first_in_.data();
+    unsigned* distances = distance_.data();
+    for (unsigned s = 0; s < node_count; ++s) {
+        unsigned best = distances[s];
+        for (unsigned arc = first_in[s]; arc < first_in[s + 1]; ++arc) {
+            best = std::min(best, distances[arcs[arc].source] + arcs[arc].weight);
+        }
+        distances[s] = best;
+    }
+}
+
+} // namespace RoutingServer
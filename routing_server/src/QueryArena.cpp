@@ -0,0 +1,146 @@
+#include "../include/QueryArena.h"
+#include <thread>
+
+namespace RoutingServer {
+
+namespace {
+
+// Rough per-node footprint of a query: tentative distances, predecessors, timestamps and heap
+// entries for both search directions
+constexpr size_t ESTIMATED_QUERY_BYTES_PER_NODE = 48;
+
+// Distances and totals of both directions of a ShortcutTotalsQuery
+constexpr size_t ESTIMATED_TOTALS_QUERY_BYTES_PER_NODE = 16;
+
+// Distance per node of a PhastQuery
+constexpr size_t ESTIMATED_PHAST_QUERY_BYTES_PER_NODE = 4;
+
+// Preferred slots of the arenas this thread used most recently (arena ids start at 1)
+struct PreferredSlot {
+    uint64_t arena_id = 0;
+    unsigned slot = 0;
+};
+constexpr size_t MAX_PREFERRED_SLOTS = 8;
+thread_local PreferredSlot preferred_slots[MAX_PREFERRED_SLOTS];
+thread_local size_t next_preferred_entry = 0;
+
+uint64_t nextArenaId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+RoutingKit::ContractionHierarchyQuery& QueryArena::Slot::chQuery(unsigned index, const RoutingKit::ContractionHierarchy& ch) {
+    if (ch_queries_[index] == nullptr) {
+        ch_queries_[index] = std::make_unique<RoutingKit::ContractionHierarchyQuery>(ch);
+        memory_bytes_.fetch_add(static_cast<size_t>(ch.node_count()) * ESTIMATED_QUERY_BYTES_PER_NODE,
+                                std::memory_order_relaxed);
+    } else if (chs_[index] != &ch) {
+        ch_queries_[index]->reset(ch);
+    }
+    chs_[index] = &ch;
+    return *ch_queries_[index];
+}
+
+RoutingKit::CustomizableContractionHierarchyQuery& QueryArena::Slot::cchQuery(
+    const RoutingKit::CustomizableContractionHierarchyMetric& metric) {
+    if (cch_query_ == nullptr) {
+        cch_query_ = std::make_unique<RoutingKit::CustomizableContractionHierarchyQuery>(metric);
+        memory_bytes_.fetch_add(static_cast<size_t>(metric.cch->node_count()) * ESTIMATED_QUERY_BYTES_PER_NODE,
+                                std::memory_order_relaxed);
+    } else {
+        cch_query_->reset(metric);
+    }
+    return *cch_query_;
+}
+
+ShortcutTotalsQuery& QueryArena::Slot::totalsQuery(unsigned node_count) {
+    if (totals_query_ == nullptr) {
+        totals_query_ = std::make_unique<ShortcutTotalsQuery>();
+        memory_bytes_.fetch_add(static_cast<size_t>(node_count) * ESTIMATED_TOTALS_QUERY_BYTES_PER_NODE,
+                                std::memory_order_relaxed);
+    }
+    return *totals_query_;
+}
+
+PhastQuery& QueryArena::Slot::phastQuery(unsigned node_count) {
+    if (phast_query_ == nullptr) {
+        phast_query_ = std::make_unique<PhastQuery>();
+        memory_bytes_.fetch_add(static_cast<size_t>(node_count) * ESTIMATED_PHAST_QUERY_BYTES_PER_NODE,
+                                std::memory_order_relaxed);
+    }
+    return *phast_query_;
+}
+
+QueryArena::Lease::~Lease() {
+    if (slot_ != nullptr && temporary_ == nullptr) {
+        slot_->in_use_.store(false, std::memory_order_release);
+    }
+}
+
+QueryArena::QueryArena(unsigned slot_count)
+    : id_(nextArenaId()), slot_count_(slot_count), slots_(std::make_unique<Slot[]>(slot_count)) {}
+
+unsigned& QueryArena::preferredSlot() const {
+    for (PreferredSlot& entry : preferred_slots) {
+        if (entry.arena_id == id_) {
+            return entry.slot;
+        }
+    }
+    // Replace the entry claimed longest ago
+    PreferredSlot& entry = preferred_slots[next_preferred_entry++ % MAX_PREFERRED_SLOTS];
+    entry = PreferredSlot{id_, 0};
+    return entry.slot;
+}
+
+bool QueryArena::tryClaim(unsigned index) {
+    bool expected = false;
+    return !slots_[index].in_use_.load(std::memory_order_relaxed) &&
+           slots_[index].in_use_.compare_exchange_strong(expected, true, std::memory_order_acquire);
+}
+
+QueryArena::Lease QueryArena::acquire() {
+    if (slot_count_ > 0) {
+        unsigned& preferred_slot = preferredSlot();
+        for (unsigned round = 0; round < MAX_ACQUIRE_ROUNDS; ++round) {
+            for (unsigned i = 0; i < slot_count_; ++i) {
+                unsigned index = (preferred_slot + i) % slot_count_;
+                if (tryClaim(index)) {
+                    if (round == 0) {
+                        hits_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    preferred_slot = index;
+                    return Lease(&slots_[index], nullptr);
+                }
+            }
+            if (round == 0) {
+                waits_.fetch_add(1, std::memory_order_relaxed);
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Every slot stayed busy (or the arena is empty): build queries just for this request
+    temporary_allocations_.fetch_add(1, std::memory_order_relaxed);
+    auto temporary = std::make_unique<Slot>();
+    Slot* slot = temporary.get();
+    return Lease(slot, std::move(temporary));
+}
+
+QueryArena::Stats QueryArena::stats() const {
+    Stats stats;
+    stats.slot_count = slot_count_;
+    for (unsigned i = 0; i < slot_count_; ++i) {
+        if (slots_[i].in_use_.load(std::memory_order_relaxed)) {
+            ++stats.slots_in_use;
+        }
+        stats.memory_bytes += slots_[i].memoryBytes();
+    }
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.waits = waits_.load(std::memory_order_relaxed);
+    stats.temporary_allocations = temporary_allocations_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,339 @@
+#include "../include/RegionRouter.h"
+#include "../include/Logger.h"
+#include <routingkit/timer.h>
+#include <crow/json.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace RoutingServer {
+
+namespace {
+
+// Optional string member; relative paths are taken relative to the config file
+std::string pathMember(const crow::json::rvalue& region, const char* key, const std::filesystem::path& base) {
+    if (!region.has(key)) {
+        return "";
+    }
+    if (region[key].t() != crow::json::type::String) {
+        throw std::runtime_error(std::string("Region field ") + key + " must be a string");
+    }
+    std::filesystem::path path = std::string(region[key].s());
+    if (path.empty() || path.is_absolute()) {
+        return path.string();
+    }
+    return (base / path).string();
+}
+
+} // namespace
+
+std::vector<RegionConfig> RegionRouter::loadConfig(const std::string& file, size_t& max_loaded) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("Cannot open region config " + file);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    auto json = crow::json::load(buffer.str());
+    if (!json || !json.has("regions") || json["regions"].t() != crow::json::type::List) {
+        throw std::runtime_error("Region config " + file + " must be an object with a \"regions\" list");
+    }
+
+    max_loaded = 0;
+    if (json.has("max_loaded_regions")) {
+        max_loaded = static_cast<size_t>(json["max_loaded_regions"].u());
+    }
+    const char* max_loaded_env = std::getenv("MAX_LOADED_REGIONS");
+    if (max_loaded_env != nullptr) {
+        try {
+            max_loaded = std::stoul(max_loaded_env);
+        } catch (...) {
+            LOG_WARN("Invalid MAX_LOADED_REGIONS, using " << max_loaded);
+        }
+    }
+
+    std::filesystem::path base = std::filesystem::path(file).parent_path();
+    std::vector<RegionConfig> regions;
+    for (const auto& region : json["regions"]) {
+        RegionConfig config;
+        if (!region.has("name") || region["name"].t() != crow::json::type::String) {
+            throw std::runtime_error("Every region needs a name");
+        }
+        config.name = std::string(region["name"].s());
+        config.engine.osm_file = pathMember(region, "osm_file", base);
+        if (config.engine.osm_file.empty()) {
+            throw std::runtime_error("Region " + config.name + " has no osm_file");
+        }
+        config.engine.ch_geo_file = pathMember(region, "ch_geo_file", base);
+        config.engine.ch_time_file = pathMember(region, "ch_time_file", base);
+        config.engine.snapshot_file = pathMember(region, "snapshot_file", base);
+        config.engine.addresses_file = pathMember(region, "addresses_file", base);
+        config.engine.places_file = pathMember(region, "places_file", base);
+        config.engine.job_candidates_file = pathMember(region, "job_candidates_file", base);
+        if (region.has("bbox")) {
+            const auto& bbox = region["bbox"];
+            if (bbox.t() != crow::json::type::List || bbox.size() != 4) {
+                throw std::runtime_error("Region " + config.name + ": bbox must be [min_lat, min_lon, max_lat, max_lon]");
+            }
+            double values[4];
+            for (size_t i = 0; i < 4; ++i) {
+                if (bbox[i].t() != crow::json::type::Number) {
+                    throw std::runtime_error("Region " + config.name + ": bbox values must be numbers");
+                }
+                values[i] = bbox[i].d();
+            }
+            config.bounds = RegionBounds{values[0], values[1], values[2], values[3]};
+            if (config.bounds->min_lat > config.bounds->max_lat || config.bounds->min_lon > config.bounds->max_lon) {
+                throw std::runtime_error("Region " + config.name + ": bbox minimum exceeds maximum");
+            }
+        }
+        config.preload = region.has("preload") && region["preload"].t() == crow::json::type::True;
+        for (const auto& other : regions) {
+            if (other.name == config.name) {
+                throw std::runtime_error("Duplicate region name " + config.name);
+            }
+        }
+        regions.push_back(std::move(config));
+    }
+    if (regions.empty()) {
+        throw std::runtime_error("Region config " + file + " has no regions");
+    }
+    return regions;
+}
+
+RegionRouter::RegionRouter(std::vector<RegionConfig> regions, size_t max_loaded) : max_loaded_(max_loaded), sharded_(true) {
+    release_thread_ = std::thread(&RegionRouter::releaseLoop, this);
+    for (auto& config : regions) {
+        auto region = std::make_unique<Region>();
+        region->config = std::move(config);
+        regions_.push_back(std::move(region));
+    }
+    LOG("Configured " << regions_.size() << " regions"
+        << (max_loaded_ > 0 ? ", at most " + std::to_string(max_loaded_) + " loaded at a time" : ""));
+    try {
+        for (size_t i = 0; i < regions_.size(); ++i) {
+            if (regions_[i]->config.preload) {
+                acquire(i);
+            }
+        }
+    } catch (...) {
+        // The destructor does not run for a constructor that throws
+        shutdown();
+        throw;
+    }
+}
+
+RegionRouter::RegionRouter(EngineConfig config, std::shared_ptr<RoutingEngine> engine) : max_loaded_(0), sharded_(false) {
+    auto region = std::make_unique<Region>();
+    region->config.name = "default";
+    region->config.engine = config;
+    region->holder = makeHolder(std::move(config), std::move(engine));
+    region->loads = 1;
+    regions_.push_back(std::move(region));
+    release_thread_ = std::thread(&RegionRouter::releaseLoop, this);
+}
+
+RegionRouter::~RegionRouter() {
+    shutdown();
+}
+
+void RegionRouter::shutdown() {
+    for (auto& region : regions_) {
+        std::atomic_store(&region->holder, std::shared_ptr<EngineHolder>());
+    }
+    {
+        std::lock_guard<std::mutex> lock(release_mutex_);
+        release_stop_ = true;
+    }
+    release_cv_.notify_one();
+    release_thread_.join();
+}
+
+std::shared_ptr<EngineHolder> RegionRouter::makeHolder(EngineConfig config, std::shared_ptr<RoutingEngine> engine) {
+    return std::shared_ptr<EngineHolder>(new EngineHolder(std::move(config), std::move(engine)),
+                                         [this](EngineHolder* holder) { release(holder); });
+}
+
+void RegionRouter::release(EngineHolder* holder) {
+    {
+        std::lock_guard<std::mutex> lock(release_mutex_);
+        if (!release_stop_) {
+            release_queue_.push_back(holder);
+            holder = nullptr;
+        }
+    }
+    if (holder != nullptr) {
+        delete holder;
+        return;
+    }
+    release_cv_.notify_one();
+}
+
+void RegionRouter::releaseLoop() {
+    std::unique_lock<std::mutex> lock(release_mutex_);
+    while (true) {
+        release_cv_.wait(lock, [this]() { return release_stop_ || !release_queue_.empty(); });
+        if (release_queue_.empty()) {
+            return;
+        }
+        std::vector<EngineHolder*> holders;
+        holders.swap(release_queue_);
+        lock.unlock();
+        // Waits for a running reload and frees the engine unless a request still holds it
+        for (EngineHolder* holder : holders) {
+            delete holder;
+        }
+        lock.lock();
+    }
+}
+
+std::optional<size_t> RegionRouter::find(const std::vector<std::pair<double, double>>& points) const {
+    if (points.empty()) {
+        return 0;
+    }
+    std::optional<size_t> best;
+    double best_area = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < regions_.size(); ++i) {
+        const auto& bounds = regions_[i]->config.bounds;
+        double area = bounds ? bounds->area() : std::numeric_limits<double>::max();
+        if (area >= best_area) {
+            continue;
+        }
+        bool covers = true;
+        for (const auto& point : points) {
+            if (bounds && !bounds->contains(point.first, point.second)) {
+                covers = false;
+                break;
+            }
+        }
+        if (covers) {
+            best = i;
+            best_area = area;
+        }
+    }
+    return best;
+}
+
+std::optional<size_t> RegionRouter::findByName(const std::string& name) const {
+    for (size_t i = 0; i < regions_.size(); ++i) {
+        if (regions_[i]->config.name == name) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+std::shared_ptr<const EngineHolder::Current> RegionRouter::acquire(size_t index) {
+    Region& region = *regions_[index];
+    region.last_used.store(clock_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (auto holder = std::atomic_load(&region.holder)) {
+        return holder->current();
+    }
+
+    std::shared_ptr<EngineHolder> holder;
+    {
+        // Requests for a region that is being loaded wait here for that load
+        std::lock_guard<std::mutex> lock(region.load_mutex);
+        holder = std::atomic_load(&region.holder);
+        if (!holder) {
+            LOG("Loading region " << region.config.name << "...");
+            long long start_time = RoutingKit::get_micro_time();
+            auto engine = EngineHolder::build(region.config.engine, true);
+            holder = makeHolder(region.config.engine, std::move(engine));
+            {
+                std::lock_guard<std::mutex> listener_lock(listener_mutex_);
+                holder->setReloadListener(listener_);
+            }
+            std::atomic_store(&region.holder, holder);
+            region.loads.fetch_add(1, std::memory_order_relaxed);
+            LOG("Region " << region.config.name << " loaded in "
+                << (RoutingKit::get_micro_time() - start_time) / 1000.0 << " ms");
+        }
+    }
+    evictIfNeeded(index);
+    return holder->current();
+}
+
+std::shared_ptr<const EngineHolder::Current> RegionRouter::peek(size_t index) const {
+    auto holder = std::atomic_load(&regions_[index]->holder);
+    return holder ? holder->current() : nullptr;
+}
+
+void RegionRouter::evictIfNeeded(size_t keep_index) {
+    if (max_loaded_ == 0) {
+        return;
+    }
+    while (true) {
+        size_t loaded = 0;
+        std::optional<size_t> oldest;
+        for (size_t i = 0; i < regions_.size(); ++i) {
+            auto holder = std::atomic_load(&regions_[i]->holder);
+            if (!holder) {
+                continue;
+            }
+            ++loaded;
+            // Evicting a reloading holder would throw away the engine being built
+            if (i == keep_index || holder->status().in_progress) {
+                continue;
+            }
+            if (!oldest || regions_[i]->last_used.load(std::memory_order_relaxed) <
+                               regions_[*oldest]->last_used.load(std::memory_order_relaxed)) {
+                oldest = i;
+            }
+        }
+        if (loaded <= max_loaded_ || !oldest) {
+            return;
+        }
+        Region& region = *regions_[*oldest];
+        std::unique_lock<std::mutex> lock(region.load_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        LOG("Evicting region " << region.config.name << " (" << loaded << " regions loaded, limit " << max_loaded_ << ")");
+        std::atomic_store(&region.holder, std::shared_ptr<EngineHolder>());
+    }
+}
+
+size_t RegionRouter::startReload() {
+    size_t started = 0;
+    for (auto& region : regions_) {
+        if (auto holder = std::atomic_load(&region->holder)) {
+            if (holder->startReload()) {
+                ++started;
+            }
+        }
+    }
+    return started;
+}
+
+std::vector<RegionRouter::RegionStatus> RegionRouter::status() const {
+    std::vector<RegionStatus> result;
+    for (const auto& region : regions_) {
+        RegionStatus status;
+        status.name = region->config.name;
+        status.bounds = region->config.bounds;
+        status.loads = region->loads.load(std::memory_order_relaxed);
+        if (auto holder = std::atomic_load(&region->holder)) {
+            status.loaded = true;
+            status.reload = holder->status();
+            status.current = holder->current();
+        }
+        result.push_back(std::move(status));
+    }
+    return result;
+}
+
+void RegionRouter::setReloadListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(listener_mutex_);
+    listener_ = std::move(listener);
+    for (auto& region : regions_) {
+        if (auto holder = std::atomic_load(&region->holder)) {
+            holder->setReloadListener(listener_);
+        }
+    }
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,236 @@
+#include "../include/ResponseEncoder.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#ifdef ROUTING_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace RoutingServer {
+
+namespace {
+
+constexpr size_t OUTPUT_CHUNK = 16384;
+
+std::string trim(const std::string& value) {
+    size_t begin = 0;
+    size_t end = value.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(value[begin]))) ++begin;
+    while (end > begin && std::isspace(static_cast<unsigned char>(value[end - 1]))) --end;
+    return value.substr(begin, end - begin);
+}
+
+// Adds the lifetime of the timer to a nanosecond total
+class CompressTimer {
+public:
+    explicit CompressTimer(long long& total_ns) : total_ns_(total_ns), start_(std::chrono::steady_clock::now()) {}
+    ~CompressTimer() {
+        total_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    long long& total_ns_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#ifdef ROUTING_HAVE_ZSTD
+// A failed call makes no progress, so the compress loops would spin on it forever
+size_t checkZstd(size_t result) {
+    if (ZSTD_isError(result)) {
+        throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(result));
+    }
+    return result;
+}
+#endif
+
+} // namespace
+
+#ifdef ROUTING_HAVE_ZSTD
+struct ResponseEncoder::ZstdState {
+    ZSTD_CCtx* context = nullptr;
+    ~ZstdState() { ZSTD_freeCCtx(context); }
+};
+#else
+struct ResponseEncoder::ZstdState {};
+#endif
+
+ContentEncoding negotiateContentEncoding(const std::string& accept_encoding, bool header_present) {
+    if (!header_present) {
+        return ContentEncoding::Gzip;
+    }
+
+    // Quality per supported encoding; -1 means not mentioned
+    double gzip_q = -1, deflate_q = -1, zstd_q = -1, identity_q = -1, wildcard_q = -1;
+    size_t start = 0;
+    while (start <= accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', start);
+        if (end == std::string::npos) end = accept_encoding.size();
+        std::string token = accept_encoding.substr(start, end - start);
+        start = end + 1;
+
+        double q = 1.0;
+        size_t semicolon = token.find(';');
+        if (semicolon != std::string::npos) {
+            std::string params = trim(token.substr(semicolon + 1));
+            if (params.size() > 2 && (params[0] == 'q' || params[0] == 'Q') && params[1] == '=') {
+                q = std::atof(params.c_str() + 2);
+            }
+            token = token.substr(0, semicolon);
+        }
+        token = trim(token);
+        std::transform(token.begin(), token.end(), token.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (token == "gzip" || token == "x-gzip") gzip_q = q;
+        else if (token == "deflate") deflate_q = q;
+        else if (token == "zstd") zstd_q = q;
+        else if (token == "identity") identity_q = q;
+        else if (token == "*") wildcard_q = q;
+    }
+
+    auto quality = [&](double q) { return q >= 0 ? q : wildcard_q; };
+
+    // Highest quality wins; ties go to the first entry in this list
+    std::vector<std::pair<ContentEncoding, double>> candidates;
+#ifdef ROUTING_HAVE_ZSTD
+    candidates.emplace_back(ContentEncoding::Zstd, quality(zstd_q));
+#else
+    (void)zstd_q;
+#endif
+    candidates.emplace_back(ContentEncoding::Gzip, quality(gzip_q));
+    candidates.emplace_back(ContentEncoding::Deflate, quality(deflate_q));
+    // Identity is acceptable unless explicitly refused
+    candidates.emplace_back(ContentEncoding::Identity, identity_q >= 0 ? identity_q : 0.001);
+
+    ContentEncoding best = ContentEncoding::Identity;
+    double best_q = 0;
+    for (const auto& candidate : candidates) {
+        if (candidate.second > best_q) {
+            best = candidate.first;
+            best_q = candidate.second;
+        }
+    }
+    return best;
+}
+
+const char* contentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Deflate: return "deflate";
+        case ContentEncoding::Zstd: return "zstd";
+        case ContentEncoding::Identity: return "";
+    }
+    return "";
+}
+
+ResponseEncoder::ResponseEncoder(ContentEncoding encoding) : encoding_(encoding) {
+    std::memset(&zs_, 0, sizeof(zs_));
+    if (encoding_ == ContentEncoding::Gzip || encoding_ == ContentEncoding::Deflate) {
+        // windowBits: 15 for zlib-wrapped deflate, +16 for a gzip header
+        int window_bits = encoding_ == ContentEncoding::Gzip ? 15 + 16 : 15;
+        zs_initialized_ = deflateInit2(&zs_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8,
+                                       Z_DEFAULT_STRATEGY) == Z_OK;
+        if (!zs_initialized_) {
+            encoding_ = ContentEncoding::Identity;
+        }
+    } else if (encoding_ == ContentEncoding::Zstd) {
+#ifdef ROUTING_HAVE_ZSTD
+        zstd_ = std::make_unique<ZstdState>();
+        zstd_->context = ZSTD_createCCtx();
+        if (zstd_->context == nullptr) {
+            zstd_.reset();
+            encoding_ = ContentEncoding::Identity;
+        }
+#else
+        encoding_ = ContentEncoding::Identity;
+#endif
+    }
+}
+
+ResponseEncoder::~ResponseEncoder() {
+    if (zs_initialized_) {
+        deflateEnd(&zs_);
+    }
+}
+
+void ResponseEncoder::deflateChunk(const char* data, size_t size, int flush) {
+    zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs_.avail_in = static_cast<uInt>(size);
+    int ret;
+    do {
+        size_t offset = output_.size();
+        output_.resize(offset + OUTPUT_CHUNK);
+        zs_.next_out = reinterpret_cast<Bytef*>(&output_[offset]);
+        zs_.avail_out = OUTPUT_CHUNK;
+        ret = deflate(&zs_, flush);
+        output_.resize(offset + OUTPUT_CHUNK - zs_.avail_out);
+        // Z_BUF_ERROR only means no progress was possible, which is not fatal
+        if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) {
+            throw std::runtime_error(std::string("deflate compression failed: ") +
+                                     (zs_.msg != nullptr ? zs_.msg : std::to_string(ret).c_str()));
+        }
+    } while (ret == Z_OK && (zs_.avail_out == 0 || (flush == Z_FINISH)));
+    // A finished stream without its trailer would be a truncated body
+    if (flush == Z_FINISH && ret != Z_STREAM_END) {
+        throw std::runtime_error("deflate compression did not finish the stream (" + std::to_string(ret) + ")");
+    }
+}
+
+void ResponseEncoder::write(const char* data, size_t size) {
+    input_size_ += size;
+    if (encoding_ == ContentEncoding::Identity) {
+        output_.append(data, size);
+        return;
+    }
+    CompressTimer timer(compress_time_ns_);
+    switch (encoding_) {
+        case ContentEncoding::Identity:
+            break;
+        case ContentEncoding::Gzip:
+        case ContentEncoding::Deflate:
+            deflateChunk(data, size, Z_NO_FLUSH);
+            break;
+        case ContentEncoding::Zstd: {
+#ifdef ROUTING_HAVE_ZSTD
+            ZSTD_inBuffer input{data, size, 0};
+            while (input.pos < input.size) {
+                size_t offset = output_.size();
+                output_.resize(offset + OUTPUT_CHUNK);
+                ZSTD_outBuffer out{&output_[offset], OUTPUT_CHUNK, 0};
+                size_t result = ZSTD_compressStream2(zstd_->context, &out, &input, ZSTD_e_continue);
+                output_.resize(offset + out.pos);
+                checkZstd(result);
+            }
+#endif
+            break;
+        }
+    }
+}
+
+std::string ResponseEncoder::finish() {
+    if (encoding_ == ContentEncoding::Gzip || encoding_ == ContentEncoding::Deflate) {
+        CompressTimer timer(compress_time_ns_);
+        deflateChunk(nullptr, 0, Z_FINISH);
+    } else if (encoding_ == ContentEncoding::Zstd) {
+#ifdef ROUTING_HAVE_ZSTD
+        CompressTimer timer(compress_time_ns_);
+        ZSTD_inBuffer input{nullptr, 0, 0};
+        size_t remaining;
+        do {
+            size_t offset = output_.size();
+            output_.resize(offset + OUTPUT_CHUNK);
+            ZSTD_outBuffer out{&output_[offset], OUTPUT_CHUNK, 0};
+            remaining = ZSTD_compressStream2(zstd_->context, &out, &input, ZSTD_e_end);
+            output_.resize(offset + out.pos);
+            checkZstd(remaining);
+        } while (remaining != 0);
+#endif
+    }
+    return std::move(output_);
+}
+
+} // namespace RoutingServer
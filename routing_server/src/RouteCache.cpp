@@ -0,0 +1,89 @@
+#include "../include/RouteCache.h"
+#include "../include/Logger.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace RoutingServer {
+
+namespace {
+
+inline void hashCombine(uint64_t& seed, uint64_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+// Bookkeeping per entry on top of body and headers (list node, index entry, key)
+constexpr size_t ENTRY_OVERHEAD_BYTES = 256;
+
+} // namespace
+
+size_t RouteCache::KeyHash::operator()(const Key& key) const {
+    uint64_t seed = key.engine_instance;
+    hashCombine(seed, key.endpoint);
+    for (uint64_t point : key.points) {
+        hashCombine(seed, point);
+    }
+    hashCombine(seed, key.max_speed_kmh);
+    hashCombine(seed, key.speed_multiplier_bits);
+    hashCombine(seed, (static_cast<uint64_t>(key.metric) << 24) | (static_cast<uint64_t>(key.format) << 16) |
+                          (static_cast<uint64_t>(key.encoding) << 8) | (key.include_path ? 1 : 0));
+    return static_cast<size_t>(seed);
+}
+
+size_t RouteCache::defaultCapacityBytes() {
+    size_t capacity = 256u * 1024 * 1024;
+    const char* capacity_env = std::getenv("ROUTE_CACHE_BYTES");
+    if (capacity_env != nullptr) {
+        try {
+            capacity = std::stoull(capacity_env);
+        } catch (...) {
+            LOG_WARN("Invalid ROUTE_CACHE_BYTES, using default " << capacity);
+        }
+    }
+    return capacity;
+}
+
+RouteCache::RouteCache(size_t capacity_bytes) : cache_(capacity_bytes) {
+}
+
+uint64_t RouteCache::quantize(double latitude, double longitude) {
+    auto fixed = [](double degrees) { return static_cast<uint32_t>(static_cast<int32_t>(std::lround(degrees * 1e7))); };
+    return (static_cast<uint64_t>(fixed(latitude)) << 32) | fixed(longitude);
+}
+
+uint64_t RouteCache::doubleBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+std::optional<crow::response> RouteCache::lookup(const Key& key) {
+    auto entry = cache_.get(key);
+    if (!entry) {
+        return std::nullopt;
+    }
+    crow::response response;
+    response.code = (*entry)->code;
+    response.body = (*entry)->body;
+    for (const auto& header : (*entry)->headers) {
+        response.add_header(header.first, header.second);
+    }
+    return response;
+}
+
+void RouteCache::store(const Key& key, const crow::response& response) {
+    if (!enabled() || response.code != 200) {
+        return;
+    }
+    auto entry = std::make_shared<Entry>();
+    entry->code = response.code;
+    entry->body = response.body;
+    size_t cost = ENTRY_OVERHEAD_BYTES + entry->body.size();
+    for (const auto& header : response.headers) {
+        entry->headers.emplace_back(header.first, header.second);
+        cost += header.first.size() + header.second.size();
+    }
+    cache_.put(key, std::move(entry), cost);
+}
+
+} // namespace RoutingServer
@@ -0,0 +1,321 @@
+#include "../include/RouteCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace RoutingServer {
+
+std::optional<RouteFormat> parseRouteFormat(const std::string& format_param) {
+    if (format_param.empty() || format_param == "json") {
+        return RouteFormat::Json;
+    }
+    if (format_param == "columnar") {
+        return RouteFormat::Columnar;
+    }
+    if (format_param == "binary") {
+        return RouteFormat::Binary;
+    }
+    return std::nullopt;
+}
+
+void RouteCodec::appendPolylineValue(std::string& out, int64_t value) {
+    uint64_t remaining = zigZag(value);
+    while (remaining >= 0x20) {
+        out += static_cast<char>((0x20 | (remaining & 0x1f)) + 63);
+        remaining >>= 5;
+    }
+    out += static_cast<char>(remaining + 63);
+}
+
+namespace {
+
+const char BASE64_URL_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+std::string encodeBase64Url(const std::string& bytes) {
+    std::string out;
+    out.reserve((bytes.size() * 4 + 2) / 3);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (unsigned char byte : bytes) {
+        buffer = (buffer << 8) | byte;
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            out += BASE64_URL_ALPHABET[(buffer >> bits) & 0x3f];
+        }
+    }
+    if (bits > 0) {
+        out += BASE64_URL_ALPHABET[(buffer << (6 - bits)) & 0x3f];
+    }
+    return out;
+}
+
+std::optional<std::string> decodeBase64Url(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() * 3 / 4);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : text) {
+        const char* position = c != '\0' ? std::strchr(BASE64_URL_ALPHABET, c) : nullptr;
+        if (position == nullptr) {
+            return std::nullopt;
+        }
+        buffer = (buffer << 6) | static_cast<uint32_t>(position - BASE64_URL_ALPHABET);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out += static_cast<char>((buffer >> bits) & 0xff);
+        }
+    }
+    return out;
+}
+
+int64_t toFixed(double degrees) { return std::llround(degrees * 1e7); }
+
+} // namespace
+
+void RouteCodec::appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool RouteCodec::readVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<int64_t> RouteCodec::coordinateDeltas(const std::vector<RoutePoint>& points, bool latitude) {
+    std::vector<int64_t> deltas;
+    deltas.reserve(points.size());
+    int64_t previous = 0;
+    for (const auto& point : points) {
+        double degrees = latitude ? point.latitude : point.longitude;
+        int64_t current = std::llround(degrees * COORDINATE_PRECISION);
+        deltas.push_back(current - previous);
+        previous = current;
+    }
+    return deltas;
+}
+
+std::vector<int64_t> RouteCodec::timeDeltas(const std::vector<RoutePoint>& points) {
+    std::vector<int64_t> deltas;
+    deltas.reserve(points.size());
+    int64_t previous = 0;
+    for (const auto& point : points) {
+        deltas.push_back(static_cast<int64_t>(point.time_ms) - previous);
+        previous = point.time_ms;
+    }
+    return deltas;
+}
+
+std::vector<int64_t> RouteCodec::distanceDeltas(const std::vector<RoutePoint>& points) {
+    std::vector<int64_t> deltas;
+    deltas.reserve(points.size());
+    int64_t previous = 0;
+    for (const auto& point : points) {
+        deltas.push_back(static_cast<int64_t>(point.distance_m) - previous);
+        previous = point.distance_m;
+    }
+    return deltas;
+}
+
+std::vector<int64_t> RouteCodec::speedRuns(const std::vector<RoutePoint>& points) {
+    std::vector<int64_t> runs;
+    for (size_t i = 0; i < points.size();) {
+        size_t end = i + 1;
+        while (end < points.size() && points[end].max_speed_kmh == points[i].max_speed_kmh) {
+            ++end;
+        }
+        runs.push_back(points[i].max_speed_kmh);
+        runs.push_back(static_cast<int64_t>(end - i));
+        i = end;
+    }
+    return runs;
+}
+
+std::vector<int64_t> RouteCodec::walkingRuns(const std::vector<RoutePoint>& points) {
+    std::vector<int64_t> runs;
+    bool walking = false;
+    int64_t length = 0;
+    for (const auto& point : points) {
+        if (point.is_walking_segment != walking) {
+            runs.push_back(length);
+            walking = point.is_walking_segment;
+            length = 0;
+        }
+        ++length;
+    }
+    if (length > 0) {
+        runs.push_back(length);
+    }
+    return runs;
+}
+
+std::string RouteCodec::encodePolyline(const std::vector<RoutePoint>& points) {
+    std::vector<int64_t> lat_deltas = coordinateDeltas(points, true);
+    std::vector<int64_t> lon_deltas = coordinateDeltas(points, false);
+    std::string out;
+    out.reserve(points.size() * 8);
+    for (size_t i = 0; i < points.size(); ++i) {
+        appendPolylineValue(out, lat_deltas[i]);
+        appendPolylineValue(out, lon_deltas[i]);
+    }
+    return out;
+}
+
+namespace {
+
+template <typename Append>
+std::string encodeColumn(const std::vector<int64_t>& values, Append append) {
+    std::string out;
+    out.reserve(values.size() * 2);
+    for (int64_t value : values) {
+        append(out, value);
+    }
+    return out;
+}
+
+} // namespace
+
+std::string RouteCodec::encodeTimeDeltas(const std::vector<RoutePoint>& points) {
+    return encodeColumn(timeDeltas(points), appendPolylineValue);
+}
+
+std::string RouteCodec::encodeDistanceDeltas(const std::vector<RoutePoint>& points) {
+    return encodeColumn(distanceDeltas(points), appendPolylineValue);
+}
+
+std::string RouteCodec::encodeSpeedRuns(const std::vector<RoutePoint>& points) {
+    return encodeColumn(speedRuns(points), appendPolylineValue);
+}
+
+std::string RouteCodec::encodeWalkingRuns(const std::vector<RoutePoint>& points) {
+    return encodeColumn(walkingRuns(points), appendPolylineValue);
+}
+
+std::string RouteCodec::encodeBinary(const RoutingResult& result, const std::vector<RoutePoint>& points) {
+    std::string out;
+    out.reserve(24 + points.size() * 6);
+
+    auto append_u32 = [&out](uint32_t value) {
+        char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                         static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+        out.append(bytes, 4);
+    };
+    append_u32(BINARY_MAGIC);
+    out += static_cast<char>(BINARY_VERSION);
+    out += static_cast<char>(result.success ? 1 : 0); // Flags: bit 0 = success
+    out.append(2, '\0');                              // Reserved
+    append_u32(result.total_travel_time_ms);
+    append_u32(result.total_geo_distance_m);
+    append_u32(static_cast<uint32_t>(points.size()));
+
+    auto append_signed_column = [&out](const std::vector<int64_t>& values) {
+        for (int64_t value : values) {
+            appendVarint(out, zigZag(value));
+        }
+    };
+    auto append_runs = [&out](const std::vector<int64_t>& values, size_t values_per_run) {
+        appendVarint(out, values.size() / values_per_run);
+        for (int64_t value : values) {
+            appendVarint(out, static_cast<uint64_t>(value));
+        }
+    };
+    append_signed_column(coordinateDeltas(points, true));
+    append_signed_column(coordinateDeltas(points, false));
+    append_signed_column(timeDeltas(points));
+    append_signed_column(distanceDeltas(points));
+    append_runs(speedRuns(points), 2);
+    append_runs(walkingRuns(points), 1);
+    return out;
+}
+
+std::string RouteCodec::encodeRouteToken(const RouteToken& token) {
+    std::string bytes;
+    bytes += static_cast<char>(TOKEN_VERSION);
+    bytes += static_cast<char>(token.metric);
+    bytes += static_cast<char>(token.points.size());
+    bytes += static_cast<char>(std::min<size_t>(token.region.size(), 255));
+    bytes.append(token.region, 0, 255);
+    appendVarint(bytes, token.max_speed_kmh);
+    uint64_t multiplier_bits;
+    std::memcpy(&multiplier_bits, &token.speed_multiplier, sizeof(multiplier_bits));
+    for (int i = 0; i < 8; ++i) {
+        bytes += static_cast<char>((multiplier_bits >> (8 * i)) & 0xff);
+    }
+    for (const auto& point : token.points) {
+        appendVarint(bytes, zigZag(toFixed(point.first)));
+        appendVarint(bytes, zigZag(toFixed(point.second)));
+    }
+    return encodeBase64Url(bytes);
+}
+
+std::optional<RouteToken> RouteCodec::decodeRouteToken(const std::string& token) {
+    std::optional<std::string> decoded = decodeBase64Url(token);
+    if (!decoded || decoded->size() < 4 || static_cast<uint8_t>((*decoded)[0]) != TOKEN_VERSION) {
+        return std::nullopt;
+    }
+    const std::string& bytes = *decoded;
+    RouteToken result;
+    uint8_t metric = static_cast<uint8_t>(bytes[1]);
+    if (metric > static_cast<uint8_t>(RoutingMetric::GeoDistance)) {
+        return std::nullopt;
+    }
+    result.metric = static_cast<RoutingMetric>(metric);
+    size_t point_count = static_cast<uint8_t>(bytes[2]);
+    if (point_count != 2 && point_count != 3) {
+        return std::nullopt;
+    }
+    size_t region_size = static_cast<uint8_t>(bytes[3]);
+    size_t pos = 4;
+    if (bytes.size() < pos + region_size) {
+        return std::nullopt;
+    }
+    result.region = bytes.substr(pos, region_size);
+    pos += region_size;
+
+    uint64_t max_speed;
+    if (!readVarint(bytes, pos, max_speed) || max_speed > UINT32_MAX || bytes.size() < pos + 8) {
+        return std::nullopt;
+    }
+    result.max_speed_kmh = static_cast<uint32_t>(max_speed);
+    uint64_t multiplier_bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        multiplier_bits |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[pos++])) << (8 * i);
+    }
+    std::memcpy(&result.speed_multiplier, &multiplier_bits, sizeof(multiplier_bits));
+    if (!(result.speed_multiplier > 0.0) || !std::isfinite(result.speed_multiplier)) {
+        return std::nullopt;
+    }
+
+    for (size_t i = 0; i < point_count; ++i) {
+        uint64_t lat, lon;
+        if (!readVarint(bytes, pos, lat) || !readVarint(bytes, pos, lon)) {
+            return std::nullopt;
+        }
+        // Undo the zigzag encoding
+        auto degrees = [](uint64_t value) {
+            return static_cast<double>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1)) / 1e7;
+        };
+        result.points.emplace_back(degrees(lat), degrees(lon));
+        if (std::abs(result.points.back().first) > 90.0 || std::abs(result.points.back().second) > 180.0) {
+            return std::nullopt;
+        }
+    }
+    if (pos != bytes.size()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+} // namespace RoutingServer
@@ -1,12 +1,20 @@
 #include "../include/RoutingEngine.h"
 #include "../include/Logger.h"
+#include "../include/GraphSnapshot.h"
+#include "../include/AddressLoader.h"
+#include "../include/ArcCostKernels.h"
+#include "../include/MemoryStats.h"
+#include "../include/Metrics.h"
 #include <routingkit/timer.h>
+#include <routingkit/nested_dissection.h>
+#include <routingkit/vector_io.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <cstring>
-#include <set>
+#include <unordered_set>
+#include <unordered_map>
 #include <limits>
 #include <numeric>
 #include <filesystem>
@@ -14,779 +22,973 @@
 
 namespace RoutingServer {
 
-// Memory reporting helper (Linux-specific)
-struct MemoryStats {
-    uint64_t rss_kb = 0;      // Resident Set Size in KB
-    uint64_t peak_rss_kb = 0; // Peak RSS in KB (VmHWM)
-    
-    static MemoryStats get_current() {
-        MemoryStats stats;
-#ifdef __linux__
-        std::ifstream status_file("/proc/self/status");
-        if (status_file.is_open()) {
-            std::string line;
-            while (std::getline(status_file, line)) {
-                if (line.substr(0, 6) == "VmRSS:") {
-                    std::istringstream iss(line.substr(6));
-                    iss >> stats.rss_kb;
-                } else if (line.substr(0, 6) == "VmHWM:") {
-                    std::istringstream iss(line.substr(6));
-                    iss >> stats.peak_rss_kb;
-                }
-            }
+namespace {
+
+// Run body(begin, end) for consecutive chunks of [0, count), one thread per chunk and at least
+// min_chunk_size items per chunk
+template <typename Body>
+void forEachChunk(size_t count, size_t min_chunk_size, Body&& body) {
+    unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk_size = std::max(min_chunk_size, (count + thread_count - 1) / thread_count);
+    size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+    std::vector<std::thread> threads;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        size_t begin = chunk * chunk_size;
+        size_t end = std::min(begin + chunk_size, count);
+        threads.emplace_back([&body, begin, end]() { body(begin, end); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+RoutingEngine::RoutingEngine(const std::string& osm_file, const std::string& ch_geo_file,
+                             const std::string& snapshot_file, const std::string& ch_time_file) {
+    LOG("Loading OSM routing graph with custom profile...");
+    
+    // Determine CH file paths: use provided path, or derive from OSM file name
+    std::string ch_file_path = ch_geo_file;
+    if (ch_file_path.empty()) {
+        // Derive CH filename from OSM filename by replacing extension
+        std::filesystem::path osm_path(osm_file);
+        std::filesystem::path ch_path = osm_path;
+        ch_path.replace_extension(".ch_geo.bin");
+        ch_file_path = ch_path.string();
+        LOG("Auto-derived CH file path: " << ch_file_path);
+    }
+    std::string ch_time_file_path = ch_time_file;
+    if (ch_time_file_path.empty()) {
+        std::filesystem::path ch_time_path(osm_file);
+        ch_time_path.replace_extension(".ch_time.bin");
+        ch_time_file_path = ch_time_path.string();
+        LOG("Auto-derived travel time CH file path: " << ch_time_file_path);
+    }
+    
+    // Determine snapshot file path the same way (GRAPH_SNAPSHOT=0 disables snapshots)
+    std::string snapshot_path = snapshot_file;
+    if (snapshot_path.empty()) {
+        std::filesystem::path snapshot_path_obj(osm_file);
+        snapshot_path_obj.replace_extension(".graph_snapshot.bin");
+        snapshot_path = snapshot_path_obj.string();
+        LOG("Auto-derived graph snapshot path: " << snapshot_path);
+    }
+    const char* snapshot_env = std::getenv("GRAPH_SNAPSHOT");
+    bool snapshot_enabled = snapshot_env == nullptr || std::string(snapshot_env) != "0";
+    
+    MemoryStats mem_before = MemoryStats::get_current();
+    LOG("Memory before loading: RSS=" << mem_before.format() << ", Peak=" << mem_before.format_peak());
+    
+    bool snapshot_outdated = true;
+    if (snapshot_enabled && loadGraphSnapshot(snapshot_path, osm_file)) {
+        // Snapshots written before the travel time CH existed, or exported without contraction
+        // hierarchies, get the missing ones built and are rewritten complete
+        snapshot_outdated = ch_geo_ == nullptr || ch_time_ == nullptr;
+    } else {
+        loadGraphFromPbf(osm_file);
+        
+        // Build the tail array from the first_out array
+        LOG("Building tail array...");
+        tail_ = RoutingKit::invert_inverse_vector(graph_.first_out);
+        LOG("Tail array built successfully");
+    }
+    buildArcSpeeds();
+    
+    try {
+        if (ch_geo_ == nullptr) {
+            ch_geo_ = loadOrBuildContractionHierarchy(ch_file_path, "geo distance",
+                [this]() { return graph_.geo_distance; });
         }
-#endif
-        return stats;
-    }
-    
-    std::string format() const {
-        std::ostringstream oss;
-        if (rss_kb > 0) {
-            if (rss_kb >= 1024 * 1024) {
-                oss << std::fixed << std::setprecision(1) << (rss_kb / (1024.0 * 1024.0)) << " GB";
-            } else if (rss_kb >= 1024) {
-                oss << std::fixed << std::setprecision(1) << (rss_kb / 1024.0) << " MB";
-            } else {
-                oss << rss_kb << " KB";
-            }
-        } else {
-            oss << "N/A";
+        
+        if (ch_time_ == nullptr) {
+            // CH_TIME_BUILD_MODE=geo_order contracts in the geo CH's node order, which skips the
+            // priority queue and needs considerably less memory than a full build
+            const char* build_mode_env = std::getenv("CH_TIME_BUILD_MODE");
+            bool reuse_geo_order = build_mode_env != nullptr && std::string(build_mode_env) == "geo_order";
+            ch_time_ = loadOrBuildContractionHierarchy(ch_time_file_path, "travel time",
+                [this]() { return computeArcTravelTimes(); },
+                reuse_geo_order ? &ch_geo_->rank : nullptr);
         }
-        return oss.str();
-    }
-    
-    std::string format_peak() const {
-        std::ostringstream oss;
-        if (peak_rss_kb > 0) {
-            if (peak_rss_kb >= 1024 * 1024) {
-                oss << std::fixed << std::setprecision(1) << (peak_rss_kb / (1024.0 * 1024.0)) << " GB";
-            } else if (peak_rss_kb >= 1024) {
-                oss << std::fixed << std::setprecision(1) << (peak_rss_kb / 1024.0) << " MB";
-            } else {
-                oss << peak_rss_kb << " KB";
-            }
+        LOG("Contraction hierarchies ready");
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error building contraction hierarchies: " << e.what());
+        throw;
+    } catch (...) {
+        LOG_ERROR("Unknown error building contraction hierarchies");
+        throw;
+    }
+    
+    buildShortcutTotals();
+    buildPhastSweep();
+    
+    if (snapshot_enabled && snapshot_outdated) {
+        saveGraphSnapshot(snapshot_path, osm_file);
+    }
+    
+    // Routing reads arc_speed_; the way ids and speeds are only needed for writing snapshots
+    graph_.way = std::vector<unsigned>();
+    way_speed_ = std::vector<unsigned>();
+    
+    // Optional customizable CH for routes that depend on the vehicle speed cap
+    const char* cch_env = std::getenv("ROUTING_CCH");
+    if (cch_env != nullptr && std::string(cch_env) == "1") {
+        std::string cch_order_path;
+        const char* cch_order_env = std::getenv("CCH_ORDER_FILE");
+        if (cch_order_env != nullptr && *cch_order_env != '\0') {
+            cch_order_path = cch_order_env;
         } else {
-            oss << "N/A";
+            std::filesystem::path cch_order_path_obj(osm_file);
+            cch_order_path_obj.replace_extension(".cch_order.bin");
+            cch_order_path = cch_order_path_obj.string();
         }
-        return oss.str();
+        initCustomizableHierarchy(cch_order_path);
     }
-};
-
-// Helper to check if string ends with a suffix (replacement for C++20's ends_with)
-inline bool ends_with(const std::string& str, const std::string& suffix) {
-    return str.size() >= suffix.size() && 
-           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
-}
-
-// Custom profile implementation - allows access to all road types
-bool is_osm_way_used_by_custom_profile(uint64_t osm_way_id, const RoutingKit::TagMap& tags, 
-                                       std::function<void(const std::string&)> log_message) {
-    // Log highway types for analysis (static set to avoid duplicates)
-    static std::set<std::string> highway_types_seen;
-    static std::set<std::string> other_tags_seen;
-    
-    const char* highway_value = tags["highway"];
-    if (highway_value != nullptr) {
-        std::string highway_str(highway_value);
-        if (highway_types_seen.insert(highway_str).second) {
-            if (log_message) {
-                log_message("Found highway type: " + highway_str);
-            }
+    
+    // Create the geo position mapping
+    pos_to_node_ = std::make_unique<RoutingKit::GeoPositionToNode>(
+        graph_.latitude, graph_.longitude
+    );
+    
+    MemoryStats mem_final = MemoryStats::get_current();
+    LOG("Routing engine initialization complete");
+    LOG("Final memory: RSS=" << mem_final.format() << ", Peak=" << mem_final.format_peak());
+    
+    // Worker pool for parallel route legs
+    unsigned worker_threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    const char* worker_threads_env = std::getenv("ROUTING_WORKER_THREADS");
+    if (worker_threads_env != nullptr) {
+        try {
+            worker_threads = std::min(64u, static_cast<unsigned>(std::stoul(worker_threads_env)));
+        } catch (...) {
+            LOG_WARN("Invalid ROUTING_WORKER_THREADS, using default " << worker_threads);
         }
     }
+    if (worker_threads > 0) {
+        worker_pool_ = std::make_unique<WorkerPool>(worker_threads, 4 * worker_threads);
+        LOG("Worker pool initialized with " << worker_threads << " threads");
+    } else {
+        LOG("Worker pool disabled, route legs run sequentially");
+    }
     
-    // Also log other relevant tags
-    const char* railway_value = tags["railway"];
-    if (railway_value != nullptr) {
-        std::string tag_str = "railway=" + std::string(railway_value);
-        if (other_tags_seen.insert(tag_str).second) {
-            if (log_message) {
-                log_message("Found tag: " + tag_str);
-            }
+    // One query slot per thread that can route concurrently: Crow request threads plus route workers.
+    // Slots allocate their queries lazily, so a metric that is never requested costs nothing.
+    unsigned slot_count = requestThreadCount() + (worker_pool_ != nullptr ? worker_pool_->threadCount() : 0);
+    const char* pool_size_env = std::getenv("CH_QUERY_POOL_SIZE");
+    if (pool_size_env != nullptr) {
+        try {
+            slot_count = std::min(256u, static_cast<unsigned>(std::stoul(pool_size_env)));
+        } catch (...) {
+            LOG_WARN("Invalid CH_QUERY_POOL_SIZE, using default " << slot_count);
         }
     }
+    if (slot_count == 0) {
+        LOG("Query arena disabled - queries will be created on-demand (slower but avoids OOM)");
+    } else {
+        LOG("Query arena initialized with " << slot_count << " slots");
+    }
+    query_arena_ = std::make_unique<QueryArena>(slot_count);
     
-    const char* public_transport_value = tags["public_transport"];
-    if (public_transport_value != nullptr) {
-        std::string tag_str = "public_transport=" + std::string(public_transport_value);
-        if (other_tags_seen.insert(tag_str).second) {
-            if (log_message) {
-                log_message("Found tag: " + tag_str);
-            }
+    // Caches for coordinates that are snapped over and over (SNAP_CACHE_SIZE entries each, 0 disables)
+    size_t snap_cache_size = 262144;
+    const char* snap_cache_env = std::getenv("SNAP_CACHE_SIZE");
+    if (snap_cache_env != nullptr) {
+        try {
+            snap_cache_size = std::stoul(snap_cache_env);
+        } catch (...) {
+            LOG_WARN("Invalid SNAP_CACHE_SIZE, using default " << snap_cache_size);
         }
     }
+    snap_cache_ = std::make_unique<SnapCache>(snap_cache_size);
+    closest_address_cache_ = std::make_unique<SnapCache>(snap_cache_size);
+    LOG("Snap caches initialized with " << snap_cache_size << " entries each");
+}
 
-    // Include all roads that cars, bicycles, or pedestrians can use
-    if (RoutingKit::is_osm_way_used_by_cars(osm_way_id, tags, log_message)) {
-        return true;
+void RoutingEngine::loadGraphFromPbf(const std::string& osm_file) {
+    ProfileGraph loaded = loadProfileGraphFromPbf(osm_file, [](const std::string& msg) { LOG(msg); });
+    graph_ = std::move(loaded.graph);
+    way_speed_ = std::move(loaded.way_speed);
+}
+
+void RoutingEngine::buildArcSpeeds() {
+    arc_speed_.resize(graph_.arc_count());
+    forEachChunk(graph_.arc_count(), 1 << 16, [this](size_t begin, size_t end) {
+        for (size_t arc_id = begin; arc_id < end; ++arc_id) {
+            arc_speed_[arc_id] = static_cast<uint16_t>(
+                std::min(way_speed_[graph_.way[arc_id]], ArcCostKernels::NO_SPEED_CAP));
+        }
+    });
+}
+
+void RoutingEngine::buildShortcutTotals() {
+    const char* totals_env = std::getenv("SHORTCUT_TOTALS");
+    if (totals_env != nullptr && std::string(totals_env) == "0") {
+        LOG("Shortcut totals disabled, metadata-only routes unpack their paths");
+        return;
     }
     
-    if (RoutingKit::is_osm_way_used_by_bicycles(osm_way_id, tags, log_message)) {
-        return true;
+    long long start_time = RoutingKit::get_micro_time();
+    ch_time_totals_ = std::make_unique<ShortcutTotals>(*ch_time_, graph_.geo_distance);
+    
+    // Times as recalculateTotalTravelTime derives them for shortest routes
+    std::vector<unsigned> arcs(graph_.arc_count());
+    std::iota(arcs.begin(), arcs.end(), 0u);
+    std::vector<unsigned> arc_times(graph_.arc_count());
+    ArcCostKernels::pathTimes(arcs.data(), arcs.size(), graph_.geo_distance.data(), arc_speed_.data(),
+                              SHORTEST_ROUTE_SPEED_CAP_KMH, arc_times.data(), nullptr);
+    ch_geo_totals_ = std::make_unique<ShortcutTotals>(*ch_geo_, arc_times);
+    
+    LOG("Shortcut totals built in " << (RoutingKit::get_micro_time() - start_time) / 1000.0 << " ms ("
+        << (ch_time_totals_->memoryBytes() + ch_geo_totals_->memoryBytes()) / (1024 * 1024) << " MB)");
+}
+
+void RoutingEngine::buildPhastSweep() {
+    const char* phast_env = std::getenv("PHAST");
+    if (phast_env != nullptr && std::string(phast_env) == "0") {
+        LOG("PHAST sweep disabled, /api/v1/reachable is unavailable");
+        return;
     }
     
-    if (RoutingKit::is_osm_way_used_by_pedestrians(osm_way_id, tags, log_message)) {
-        return true;
+    long long start_time = RoutingKit::get_micro_time();
+    phast_time_ = std::make_unique<PhastSweep>(*ch_time_);
+    LOG("PHAST sweep built in " << (RoutingKit::get_micro_time() - start_time) / 1000.0 << " ms ("
+        << phast_time_->memoryBytes() / (1024 * 1024) << " MB)");
+}
+
+void RoutingEngine::buildPhastAddresses() {
+    phast_addresses_.clear();
+    if (!phast_time_) {
+        return;
+    }
+    phast_addresses_.reserve(addresses_.size());
+    for (unsigned id = 0; id < address_nodes_.size(); ++id) {
+        unsigned node = address_nodes_[id];
+        if (node == RoutingKit::invalid_id) {
+            continue;
+        }
+        double node_lat, node_lon;
+        getNodeCoordinates(node, node_lat, node_lon);
+        double walking_distance_m = haversineDistance(addresses_.latitude(id), addresses_.longitude(id), node_lat, node_lon);
+        phast_addresses_.push_back(PhastAddress{phast_time_->slot(ch_time_->rank[node]), id, walkingTimeMs(walking_distance_m)});
     }
+    std::sort(phast_addresses_.begin(), phast_addresses_.end(),
+              [](const PhastAddress& a, const PhastAddress& b) { return a.slot != b.slot ? a.slot < b.slot : a.address < b.address; });
+}
+
+std::vector<unsigned> RoutingEngine::computeArcTravelTimes(std::optional<unsigned> max_speed_kmh) const {
+    std::vector<unsigned> travel_time(graph_.arc_count());
+    LOG("Processing " << graph_.arc_count() << " arcs for travel time calculation...");
     
-    // Include ALL possible highway types from OSM documentation
-    if (highway_value != nullptr) {
-        std::string highway_str(highway_value);
-        
-        // Main road types
-        if (highway_str == "motorway" || highway_str == "trunk" || highway_str == "primary" ||
-            highway_str == "secondary" || highway_str == "tertiary" || highway_str == "unclassified" ||
-            highway_str == "residential") {
-            return true;
+    // time_ms = distance_m / (speed_kmh / 3.6) * 1000 = distance_m * 3600 / speed_kmh
+    // Same rounding as recalculateTotalTravelTime, so CH distances match path re-walks.
+    // Each thread computes the weights and statistics of its chunk in one sweep.
+    unsigned cap_kmh = max_speed_kmh.value_or(ArcCostKernels::NO_SPEED_CAP);
+    ArcCostKernels::WeightStats stats;
+    std::mutex stats_mutex;
+    forEachChunk(graph_.arc_count(), 1 << 16, [&](size_t begin, size_t end) {
+        ArcCostKernels::WeightStats chunk_stats = ArcCostKernels::computeWeights(
+            graph_.geo_distance.data() + begin, arc_speed_.data() + begin, end - begin, cap_kmh, ArcCostKernels::MAX_ARC_TIME_MS,
+            travel_time.data() + begin);
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats.merge(chunk_stats);
+    });
+    
+    LOG("Travel time statistics: min=" << stats.min_ms << "ms, max=" << stats.max_ms << "ms, capped_count=" << stats.capped_count << ", zero_count=" << stats.zero_count);
+    return travel_time;
+}
+
+void RoutingEngine::initCustomizableHierarchy(const std::string& order_file) {
+    LOG("Initializing customizable contraction hierarchy...");
+    
+    // The nested dissection order is metric independent, so it is computed once and cached
+    std::vector<unsigned> order;
+    if (std::filesystem::exists(order_file)) {
+        LOG("Loading CCH order from: " << order_file);
+        order = RoutingKit::load_vector<unsigned>(order_file);
+        if (order.size() != graph_.node_count()) {
+            LOG("CCH order has " << order.size() << " nodes but graph has " << graph_.node_count() << ", recomputing");
+            order.clear();
         }
-        
-        // Link roads
-        if (highway_str == "motorway_link" || highway_str == "trunk_link" || highway_str == "primary_link" ||
-            highway_str == "secondary_link" || highway_str == "tertiary_link") {
-            return true;
+    }
+    if (order.empty()) {
+        LOG("Computing nested dissection order...");
+        long long order_start = RoutingKit::get_micro_time();
+        order = RoutingKit::compute_nested_node_dissection_order_using_inertial_flow(
+            graph_.node_count(), tail_, graph_.head, graph_.latitude, graph_.longitude,
+            [](const std::string& msg) { LOG(msg); }
+        );
+        long long order_end = RoutingKit::get_micro_time();
+        LOG("Nested dissection order computed in " << (order_end - order_start) / 1000.0 << " ms");
+        try {
+            RoutingKit::save_vector(order_file, order);
+            LOG("CCH order saved to: " << order_file);
+        } catch (const std::exception& e) {
+            LOG_WARN("Failed to save CCH order: " << e.what());
         }
-        
-        // Special road types
-        if (highway_str == "living_street" || highway_str == "service" || highway_str == "pedestrian" ||
-            highway_str == "track" || highway_str == "bus_guideway" || highway_str == "busway" ||
-            highway_str == "raceway" || highway_str == "road" || highway_str == "construction" ||
-            highway_str == "escape") {
-            return true;
+    }
+    
+    cch_ = std::make_unique<RoutingKit::CustomizableContractionHierarchy>(
+        order, tail_, graph_.head, [](const std::string& msg) { LOG(msg); }
+    );
+    
+    // Default tiers are the road speeds of the vehicle upgrades; CCH_SPEED_TIERS overrides them
+    std::vector<unsigned> speeds = {15, 18, 20, 25, 45, 70, 75, 80, 85, 90, 105, 110, 120};
+    const char* tiers_env = std::getenv("CCH_SPEED_TIERS");
+    if (tiers_env != nullptr && *tiers_env != '\0') {
+        std::vector<unsigned> parsed;
+        std::istringstream tiers_stream(tiers_env);
+        std::string token;
+        while (std::getline(tiers_stream, token, ',')) {
+            try {
+                unsigned speed = static_cast<unsigned>(std::stoul(token));
+                if (speed > 0) {
+                    parsed.push_back(speed);
+                }
+            } catch (...) {
+                LOG_WARN("Invalid CCH_SPEED_TIERS entry: " << token);
+            }
         }
-        
-        // Paths
-        if (highway_str == "path" || highway_str == "footway" || highway_str == "cycleway" ||
-            highway_str == "bridleway" || highway_str == "steps" || highway_str == "corridor") {
-            return true;
+        if (!parsed.empty()) {
+            speeds = parsed;
         }
-        
-        // Other highway features mentioned in documentation
-        if (highway_str == "bus_stop" || highway_str == "crossing" || highway_str == "emergency_access_point" ||
-            highway_str == "give_way" || highway_str == "mini_roundabout" || highway_str == "motorway_junction" ||
-            highway_str == "passing_place" || highway_str == "platform" || highway_str == "rest_area" ||
-            highway_str == "services" || highway_str == "speed_camera" || highway_str == "stop" ||
-            highway_str == "street_lamp" || highway_str == "traffic_signals" || highway_str == "turning_circle" ||
-            highway_str == "turning_loop") {
-            return true;
+    }
+    std::sort(speeds.begin(), speeds.end());
+    speeds.erase(std::unique(speeds.begin(), speeds.end()), speeds.end());
+    
+    RoutingKit::CustomizableContractionHierarchyParallelization parallel_customization(*cch_);
+    unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned speed : speeds) {
+        long long customize_start = RoutingKit::get_micro_time();
+        auto tier = std::make_unique<CchSpeedTier>();
+        tier->max_speed_kmh = speed;
+        tier->weights = computeArcTravelTimes(speed);
+        tier->metric = std::make_unique<RoutingKit::CustomizableContractionHierarchyMetric>(*cch_, tier->weights.data());
+        parallel_customization.customize(*tier->metric, thread_count);
+        long long customize_end = RoutingKit::get_micro_time();
+        LOG("Customized CCH metric for max_speed=" << speed << " km/h in " << (customize_end - customize_start) / 1000.0 << " ms");
+        cch_tiers_.push_back(std::move(tier));
+    }
+    
+    MemoryStats mem_after_cch = MemoryStats::get_current();
+    LOG("Customizable contraction hierarchy ready with " << cch_tiers_.size() << " speed tiers");
+    LOG("Memory after CCH customization: RSS=" << mem_after_cch.format() << ", Peak=" << mem_after_cch.format_peak());
+}
+
+const RoutingEngine::CchSpeedTier* RoutingEngine::findSpeedTier(unsigned max_speed_kmh) const {
+    if (cch_tiers_.empty()) {
+        return nullptr;
+    }
+    size_t tier = ArcCostKernels::nearestSpeedTier(cch_tiers_.size(), max_speed_kmh,
+                                                   [this](size_t index) { return cch_tiers_[index]->max_speed_kmh; });
+    return cch_tiers_[tier].get();
+}
+
+std::unique_ptr<RoutingKit::ContractionHierarchy> RoutingEngine::loadOrBuildContractionHierarchy(
+    const std::string& ch_file_path, const std::string& metric_name,
+    const std::function<std::vector<unsigned>()>& compute_weights,
+    const std::vector<unsigned>* given_rank) const {
+    std::unique_ptr<RoutingKit::ContractionHierarchy> ch;
+    
+    // Try to load pre-built CH, or build it if not available
+    if (std::filesystem::exists(ch_file_path)) {
+        LOG("Loading pre-built " << metric_name << " contraction hierarchy from: " << ch_file_path);
+        MemoryStats mem_before_ch_load = MemoryStats::get_current();
+        try {
+            ch = std::make_unique<RoutingKit::ContractionHierarchy>(
+                RoutingKit::ContractionHierarchy::load_file(ch_file_path)
+            );
+        } catch (const std::exception& e) {
+            LOG_WARN("Failed to load contraction hierarchy " << ch_file_path << ": " << e.what() << ", rebuilding");
         }
-        
-        // Lifecycle states
-        if (highway_str == "proposed" || highway_str == "planned" || highway_str == "abandoned" ||
-            highway_str == "disused" || highway_str == "razed") {
-            return true;
+        // The CH file is not tied to the graph it was built for: one left over from an earlier
+        // export or OSM file would route on the wrong nodes, so it is rebuilt (and overwritten)
+        if (ch != nullptr && ch->node_count() != graph_.node_count()) {
+            LOG_WARN("Contraction hierarchy " << ch_file_path << " has " << ch->node_count() << " nodes but the graph has "
+                     << graph_.node_count() << ", rebuilding");
+            ch.reset();
         }
-        
-        // Additional types that might exist
-        if (highway_str == "via_ferrata" || highway_str == "elevator" || highway_str == "escalator") {
-            return true;
+        if (ch != nullptr) {
+            MemoryStats mem_after_ch_load = MemoryStats::get_current();
+            LOG("Contraction hierarchy loaded successfully");
+            LOG("Memory before CH load: RSS=" << mem_before_ch_load.format() << ", Peak=" << mem_before_ch_load.format_peak());
+            LOG("Memory after CH load: RSS=" << mem_after_ch_load.format() << ", Peak=" << mem_after_ch_load.format_peak());
+            return ch;
         }
+    } else {
+        LOG("CH file not found: " << ch_file_path << ", building instead...");
     }
     
-    // Also include railway platforms and other transport infrastructure
-    const char* railway_value_check = tags["railway"];
-    if (railway_value_check != nullptr && strcmp(railway_value_check, "platform") == 0) {
-        return true;
+    LOG("Building contraction hierarchy for " << metric_name << "...");
+    MemoryStats mem_before_ch_build = MemoryStats::get_current();
+    if (given_rank != nullptr) {
+        LOG("Contracting in the given node order");
+        ch = std::make_unique<RoutingKit::ContractionHierarchy>(
+            RoutingKit::ContractionHierarchy::build_given_rank(
+                *given_rank, tail_, graph_.head, compute_weights()
+            )
+        );
+    } else {
+        ch = std::make_unique<RoutingKit::ContractionHierarchy>(
+            RoutingKit::ContractionHierarchy::build(
+                graph_.node_count(),
+                tail_, graph_.head,
+                compute_weights()
+            )
+        );
     }
+    MemoryStats mem_after_ch_build = MemoryStats::get_current();
+    LOG("Contraction hierarchy for " << metric_name << " built successfully");
+    LOG("Memory before CH build: RSS=" << mem_before_ch_build.format() << ", Peak=" << mem_before_ch_build.format_peak());
+    LOG("Memory after CH build: RSS=" << mem_after_ch_build.format() << ", Peak=" << mem_after_ch_build.format_peak());
     
-    // Include public transport platforms
-    const char* public_transport_value_check = tags["public_transport"];
-    if (public_transport_value_check != nullptr && strcmp(public_transport_value_check, "platform") == 0) {
-        return true;
+    // Save the CH to disk for future use
+    LOG("Saving contraction hierarchy to: " << ch_file_path);
+    try {
+        // Ensure parent directory exists
+        std::filesystem::path ch_path_obj(ch_file_path);
+        if (ch_path_obj.has_parent_path()) {
+            std::filesystem::create_directories(ch_path_obj.parent_path());
+        }
+        ch->save_file(ch_file_path);
+        LOG("Contraction hierarchy saved successfully");
+    } catch (const std::exception& e) {
+        LOG_WARN("Failed to save contraction hierarchy: " << e.what());
+        // Don't fail the entire initialization if saving fails
     }
-    
-    return false;
+    return ch;
 }
 
-unsigned get_custom_profile_speed(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
-                                  std::function<void(const std::string&)> log_message) {
-    // First try to get the standard speed from OSM maxspeed tags
-    unsigned standard_speed = RoutingKit::get_osm_way_speed(osm_way_id, tags, log_message);
-    
-    // For non-car infrastructure, apply conservative speed limits
-    const char* highway_value = tags["highway"];
-    if (highway_value != nullptr) {
-        std::string highway_str(highway_value);
-        
-        // Very slow infrastructure (walking pace)
-        if (highway_str == "steps" || highway_str == "via_ferrata" || highway_str == "elevator" ||
-            highway_str == "escalator") {
-            return 5u; // 5 km/h
-        }
-        
-        // Pedestrian and shared infrastructure (slow)
-        if (highway_str == "path" || highway_str == "footway" || highway_str == "cycleway" || 
-            highway_str == "pedestrian" || highway_str == "platform" || highway_str == "corridor") {
-            return std::min(standard_speed, 20u); // Max 20 km/h
-        }
-        
-        // Service roads and tracks (moderate)
-        if (highway_str == "service" || highway_str == "living_street" || highway_str == "track" ||
-            highway_str == "bridleway") {
-            return std::min(standard_speed, 30u); // Max 30 km/h
-        }
-        
-        // Construction and lifecycle states (conservative)
-        if (highway_str == "construction" || highway_str == "proposed" || highway_str == "planned") {
-            return std::min(standard_speed, 30u); // Max 30 km/h
-        }
-        
-        // Abandoned/disused (very slow)
-        if (highway_str == "abandoned" || highway_str == "disused" || highway_str == "razed") {
-            return 10u; // 10 km/h
-        }
+bool RoutingEngine::loadGraphSnapshot(const std::string& snapshot_file, const std::string& osm_file) {
+    if (!std::filesystem::exists(snapshot_file)) {
+        LOG("Graph snapshot not found: " << snapshot_file << ", loading from OSM file");
+        return false;
+    }
+    
+    try {
+        long long load_start = RoutingKit::get_micro_time();
+        GraphSnapshot::Reader reader(snapshot_file);
         
-        // Residential areas
-        if (highway_str == "residential" || highway_str == "unclassified") {
-            return std::min(standard_speed, 50u); // Max 50 km/h
+        // A snapshot is stale once the OSM file it was built from changes; a missing OSM file is fine
+        auto source = SnapshotSource::fromFile(osm_file);
+        if (source.has_value() && !(*source == reader.source())) {
+            LOG("Graph snapshot is stale (OSM file changed since it was written): " << snapshot_file);
+            return false;
         }
         
-        // Special purpose roads
-        if (highway_str == "bus_guideway" || highway_str == "busway") {
-            return std::min(standard_speed, 60u); // Max 60 km/h
+        LOG("Loading graph snapshot from: " << snapshot_file);
+        graph_.first_out = reader.readVector<unsigned>(SnapshotSection::FirstOut);
+        graph_.head = reader.readVector<unsigned>(SnapshotSection::Head);
+        graph_.geo_distance = reader.readVector<unsigned>(SnapshotSection::GeoDistance);
+        graph_.way = reader.readVector<unsigned>(SnapshotSection::Way);
+        graph_.latitude = reader.readVector<float>(SnapshotSection::Latitude);
+        graph_.longitude = reader.readVector<float>(SnapshotSection::Longitude);
+        way_speed_ = reader.readVector<unsigned>(SnapshotSection::WaySpeed);
+        tail_ = reader.readVector<unsigned>(SnapshotSection::Tail);
+        // Exported snapshots (export_routing_graph --ch none) carry only the graph arrays
+        if (reader.hasSection(SnapshotSection::GeoContractionHierarchy)) {
+            ch_geo_ = std::make_unique<RoutingKit::ContractionHierarchy>(
+                reader.readContractionHierarchy(SnapshotSection::GeoContractionHierarchy)
+            );
         }
-        
-        // Racing tracks (but still reasonable for routing)
-        if (highway_str == "raceway") {
-            return std::min(standard_speed, 80u); // Max 80 km/h
+        if (reader.hasSection(SnapshotSection::TimeContractionHierarchy)) {
+            ch_time_ = std::make_unique<RoutingKit::ContractionHierarchy>(
+                reader.readContractionHierarchy(SnapshotSection::TimeContractionHierarchy)
+            );
         }
         
-        // Emergency and escape roads
-        if (highway_str == "escape" || highway_str == "emergency_access_point") {
-            return std::min(standard_speed, 40u); // Max 40 km/h
+        // The arrays are indexed by each other without further checks (buildArcSpeeds, the CHs,
+        // snapping), so a snapshot that disagrees with itself falls back to the PBF here
+        const size_t node_count = graph_.first_out.empty() ? 0 : graph_.first_out.size() - 1;
+        const size_t arc_count = graph_.head.size();
+        if (graph_.first_out.empty() || graph_.first_out.back() != arc_count ||
+            tail_.size() != arc_count || graph_.geo_distance.size() != arc_count || graph_.way.size() != arc_count ||
+            graph_.latitude.size() != node_count || graph_.longitude.size() != node_count ||
+            (ch_geo_ != nullptr && ch_geo_->node_count() != node_count) ||
+            (ch_time_ != nullptr && ch_time_->node_count() != node_count)) {
+            throw std::runtime_error("inconsistent section sizes");
         }
-        
-        // Highway features (usually not routable, but just in case)
-        if (highway_str == "bus_stop" || highway_str == "crossing" || highway_str == "give_way" ||
-            highway_str == "mini_roundabout" || highway_str == "motorway_junction" || 
-            highway_str == "passing_place" || highway_str == "rest_area" || highway_str == "services" ||
-            highway_str == "speed_camera" || highway_str == "stop" || highway_str == "street_lamp" ||
-            highway_str == "traffic_signals" || highway_str == "turning_circle" || highway_str == "turning_loop") {
-            return 10u; // 10 km/h (these are usually point features anyway)
+        auto out_of_range = [](const std::vector<unsigned>& ids, size_t limit) {
+            return std::any_of(ids.begin(), ids.end(), [limit](unsigned id) { return id >= limit; });
+        };
+        if (!std::is_sorted(graph_.first_out.begin(), graph_.first_out.end()) || out_of_range(graph_.head, node_count) ||
+            out_of_range(tail_, node_count) || out_of_range(graph_.way, way_speed_.size())) {
+            throw std::runtime_error("inconsistent section contents");
         }
         
-        // Unknown road type (for "road" and any others)
-        if (highway_str == "road") {
-            return std::min(standard_speed, 50u); // Max 50 km/h
-        }
-    }
-    
-    // Handle railway and public transport platforms
-    const char* railway_value = tags["railway"];
-    const char* public_transport_value = tags["public_transport"];
-    if ((railway_value != nullptr && strcmp(railway_value, "platform") == 0) ||
-        (public_transport_value != nullptr && strcmp(public_transport_value, "platform") == 0)) {
-        return 10u; // Very slow walking speed on platforms
+        long long load_end = RoutingKit::get_micro_time();
+        MemoryStats mem_after_snapshot = MemoryStats::get_current();
+        LOG("Graph snapshot loaded in " << (load_end - load_start) / 1000.0 << " ms: " << graph_.node_count()
+            << " nodes, " << graph_.arc_count() << " arcs");
+        LOG("Memory after snapshot load: RSS=" << mem_after_snapshot.format() << ", Peak=" << mem_after_snapshot.format_peak());
+        return true;
+    } catch (const std::exception& e) {
+        LOG_WARN("Failed to load graph snapshot " << snapshot_file << ": " << e.what() << ", loading from OSM file");
+        graph_ = RoutingKit::OSMRoutingGraph();
+        way_speed_.clear();
+        tail_.clear();
+        ch_geo_.reset();
+        ch_time_.reset();
+        return false;
     }
-    
-    return standard_speed;
 }
 
-RoutingKit::OSMWayDirectionCategory get_custom_profile_direction_category(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
-                                                                          std::function<void(const std::string&)> log_message) {
-    // For most pedestrian and cycling infrastructure, allow bidirectional access unless explicitly restricted
-    const char* highway_value = tags["highway"];
-    if (highway_value != nullptr && (
-        strcmp(highway_value, "path") == 0 ||
-        strcmp(highway_value, "footway") == 0 ||
-        strcmp(highway_value, "cycleway") == 0 ||
-        strcmp(highway_value, "pedestrian") == 0 ||
-        strcmp(highway_value, "bridleway") == 0)) {
-        
-        // Check for explicit oneway restrictions
-        const char* oneway_value = tags["oneway"];
-        if (oneway_value != nullptr) {
-            if (strcmp(oneway_value, "yes") == 0 || strcmp(oneway_value, "true") == 0 || strcmp(oneway_value, "1") == 0) {
-                return RoutingKit::OSMWayDirectionCategory::only_open_forwards;
-            } else if (strcmp(oneway_value, "-1") == 0 || strcmp(oneway_value, "reverse") == 0) {
-                return RoutingKit::OSMWayDirectionCategory::only_open_backwards;
-            }
-        }
-        
-        // Default to bidirectional for pedestrian/cycling infrastructure
-        return RoutingKit::OSMWayDirectionCategory::open_in_both;
+void RoutingEngine::saveGraphSnapshot(const std::string& snapshot_file, const std::string& osm_file) const {
+    auto source = SnapshotSource::fromFile(osm_file);
+    if (!source.has_value()) {
+        LOG_WARN("Cannot stat OSM file, not writing graph snapshot");
+        return;
     }
     
-    // For car roads and other infrastructure, use the standard car direction logic
-    return RoutingKit::get_osm_car_direction_category(osm_way_id, tags, log_message);
+    LOG("Saving graph snapshot to: " << snapshot_file);
+    try {
+        GraphSnapshot::Writer writer(snapshot_file, *source);
+        writer.addVector(SnapshotSection::FirstOut, graph_.first_out);
+        writer.addVector(SnapshotSection::Head, graph_.head);
+        writer.addVector(SnapshotSection::GeoDistance, graph_.geo_distance);
+        writer.addVector(SnapshotSection::Way, graph_.way);
+        writer.addVector(SnapshotSection::Latitude, graph_.latitude);
+        writer.addVector(SnapshotSection::Longitude, graph_.longitude);
+        writer.addVector(SnapshotSection::WaySpeed, way_speed_);
+        writer.addVector(SnapshotSection::Tail, tail_);
+        writer.addContractionHierarchy(SnapshotSection::GeoContractionHierarchy, *ch_geo_);
+        writer.addContractionHierarchy(SnapshotSection::TimeContractionHierarchy, *ch_time_);
+        writer.finish();
+        LOG("Graph snapshot saved successfully");
+    } catch (const std::exception& e) {
+        LOG_WARN("Failed to save graph snapshot: " << e.what());
+        // Don't fail the entire initialization if saving fails
+    }
 }
 
-// Helper method to process a line from the address CSV
-static void processAddressLine(const std::string& line, std::vector<Address>& addresses, 
-                       std::vector<float>& lat_vec, std::vector<float>& lon_vec) {
-    if (line.empty()) {
-        return;
-    }
-    
-    std::istringstream ss(line);
-    std::string id, lon, lat, street, housenumber, postcode, city;
-    
-    // Parse whitespace-separated values (OSM extract format)
-    // First read the numeric fields
-    if (!(ss >> id >> lon >> lat)) {
-        return; // Must have at least id, lon, lat
+bool RoutingEngine::isTimingEnabled() {
+    static bool cached = false;
+    static bool enabled = false;
+    if (!cached) {
+        const char* timing_env = std::getenv("ROUTING_TIMING");
+        enabled = (timing_env != nullptr && std::string(timing_env) == "1");
+        cached = true;
     }
-    
-    // Now read the string fields, which might be missing
-    std::getline(ss >> std::ws, street, '\t');    // Read until tab or end
-    std::getline(ss >> std::ws, housenumber, '\t');
-    std::getline(ss >> std::ws, postcode, '\t');
-    std::getline(ss >> std::ws, city);
-    
-    // Create address object
-    Address addr;
-    addr.id = addresses.size();
-    
-    // Handle the numeric fields carefully to avoid stod exceptions
-    try {
-        addr.longitude = std::stod(lon);
-        addr.latitude = std::stod(lat);
-    } catch (const std::exception&) {
-        return; // Skip this address if coordinates aren't valid numbers
+    return enabled;
+}
+
+unsigned RoutingEngine::requestThreadCount() {
+    unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+    const char* threads_env = std::getenv("CROW_THREADS");
+    if (threads_env != nullptr) {
+        try {
+            thread_count = std::max(1u, std::min(256u, static_cast<unsigned>(std::stoul(threads_env))));
+        } catch (...) {
+            LOG_WARN("Invalid CROW_THREADS, using default " << thread_count);
+        }
     }
-    
-    // Set string fields (empty strings are OK)
-    addr.street = street;
-    addr.housenumber = housenumber;
-    addr.postcode = postcode;
-    addr.city = city;
-    
-    // Add to the vectors for spatial indexing
-    lat_vec.push_back(static_cast<float>(addr.latitude));
-    lon_vec.push_back(static_cast<float>(addr.longitude));
-    
-    // Add to the addresses vector
-    addresses.push_back(addr);
+    return thread_count;
 }
 
-RoutingEngine::RoutingEngine(const std::string& osm_file, const std::string& ch_geo_file) {
-    LOG("Loading OSM routing graph with custom profile...");
+unsigned RoutingEngine::findNearestNode(double latitude, double longitude, unsigned max_radius) const {
+    auto node = pos_to_node_->find_nearest_neighbor_within_radius(latitude, longitude, max_radius);
+    return node.id;
+}
+
+RoutingResult RoutingEngine::computeShortestPath(unsigned from_node, unsigned to_node,
+                                                RoutingMetric metric,
+                                                std::optional<unsigned> max_speed_kmh,
+                                                RouteDetail detail) const {
+    RoutingResult result;
+    result.source_node = from_node;
+    result.target_node = to_node;
+    result.success = false;
     
-    // Determine CH file path: use provided path, or derive from OSM file name
-    std::string ch_file_path = ch_geo_file;
-    if (ch_file_path.empty()) {
-        // Derive CH filename from OSM filename by replacing extension
-        std::filesystem::path osm_path(osm_file);
-        std::filesystem::path ch_path = osm_path;
-        ch_path.replace_extension(".ch_geo.bin");
-        ch_file_path = ch_path.string();
-        LOG("Auto-derived CH file path: " << ch_file_path);
+    // Check if both nodes are valid
+    if (!isValidNode(from_node) || !isValidNode(to_node)) {
+        LOG_WARN("Invalid nodes: from=" << from_node << " (valid: " << isValidNode(from_node) << "), to=" << to_node << " (valid: " << isValidNode(to_node) << ")");
+        result.total_travel_time_ms = RoutingKit::inf_weight;
+        result.total_geo_distance_m = RoutingKit::inf_weight;
+        return result;
     }
     
-    MemoryStats mem_before = MemoryStats::get_current();
-    LOG("Memory before loading: RSS=" << mem_before.format() << ", Peak=" << mem_before.format_peak());
-    
-    // Load the ID mapping with our custom profile
-    auto mapping = RoutingKit::load_osm_id_mapping_from_pbf(
-        osm_file,
-        nullptr, // No special routing nodes
-        [](uint64_t osm_way_id, const RoutingKit::TagMap& tags) {
-            return is_osm_way_used_by_custom_profile(osm_way_id, tags);
-        },
-        [](const std::string& msg) { LOG(msg); }
-    );
-    
-    MemoryStats mem_after_mapping = MemoryStats::get_current();
-    LOG("ID mapping loaded, " << mapping.is_routing_way.population_count() << " routing ways found");
-    LOG("Memory after ID mapping: RSS=" << mem_after_mapping.format() << ", Peak=" << mem_after_mapping.format_peak());
-    
-    // Prepare speed storage
-    unsigned routing_way_count = mapping.is_routing_way.population_count();
-    way_speed_.resize(routing_way_count);
-    
-    // Load the routing graph with custom callbacks
-    graph_ = RoutingKit::load_osm_routing_graph_from_pbf(
-        osm_file,
-        mapping,
-        [this](uint64_t osm_way_id, unsigned routing_way_id, const RoutingKit::TagMap& way_tags) {
-            // Store the speed for this way
-            way_speed_[routing_way_id] = get_custom_profile_speed(osm_way_id, way_tags);
-            return get_custom_profile_direction_category(osm_way_id, way_tags);
-        },
-        nullptr, // No turn restrictions for now
-        [](const std::string& msg) { LOG(msg); }
-    );
-    
-    LOG("Routing graph loaded with " << graph_.node_count() << " nodes and " << graph_.arc_count() << " arcs");
+    // Special case: if source and target are the same node, return a successful single-node route
+    if (from_node == to_node) {
+        LOG_DEBUG("Same source and target node: " << from_node << ", returning single-node route");
+        result.total_travel_time_ms = 0;
+        result.total_geo_distance_m = 0;
+        result.node_path = {from_node};
+        result.arc_path = {}; // No arcs for single node
+        result.query_time_us = 0;
+        result.success = true;
+        return result;
+    }
     
-    MemoryStats mem_after_graph = MemoryStats::get_current();
-    LOG("Memory after graph loading: RSS=" << mem_after_graph.format() << ", Peak=" << mem_after_graph.format_peak());
+    const bool by_time = metric == RoutingMetric::TravelTime;
+    const CchSpeedTier* speed_tier = nullptr;
+    if (by_time && max_speed_kmh.has_value()) {
+        speed_tier = findSpeedTier(max_speed_kmh.value());
+    }
     
-    // Build travel time array from geo_distance and way speeds
-    std::vector<unsigned> travel_time(graph_.arc_count());
-    LOG("Processing " << graph_.arc_count() << " arcs for travel time calculation...");
+    unsigned distance = RoutingKit::inf_weight;
+    long long unpack_time_us = 0;
+    QueryArena::Lease lease = query_arena_->acquire();
     
-    for (unsigned arc_id = 0; arc_id < graph_.arc_count(); ++arc_id) {
-        unsigned way_id = graph_.way[arc_id];
-        unsigned speed_kmh = way_speed_[way_id];
-        unsigned distance_m = graph_.geo_distance[arc_id];
+    // Totals only and nothing to re-derive for a speed cap: the search sums both totals itself
+    const ShortcutTotals* shortcut_totals = by_time ? ch_time_totals_.get() : ch_geo_totals_.get();
+    if (detail == RouteDetail::Totals && !max_speed_kmh.has_value() && shortcut_totals != nullptr) {
+        const RoutingKit::ContractionHierarchy& ch = by_time ? *ch_time_ : *ch_geo_;
+        long long start_time = RoutingKit::get_micro_time();
+        ShortcutTotalsQuery::Result totals = lease->totalsQuery(ch.node_count()).run(ch, *shortcut_totals, from_node, to_node);
+        long long end_time = RoutingKit::get_micro_time();
+        result.query_time_us = end_time - start_time;
+        Metrics::instance().record(MetricStage::ChQuery, result.query_time_us);
         
-        // Convert to travel time in seconds, then to milliseconds
-        // time_sec = distance_m / (speed_kmh * 1000 / 3600) = distance_m * 3600 / (speed_kmh * 1000)
-        if (speed_kmh > 0 && distance_m > 0) {
-            // Calculate time in seconds first to avoid overflow
-            unsigned long long time_seconds = (static_cast<unsigned long long>(distance_m) * 3600ULL) / (static_cast<unsigned long long>(speed_kmh) * 1000ULL);
-            
-            // Cap at 24 hours (86400 seconds) per arc - anything longer is unrealistic for routing
-            const unsigned long long MAX_ARC_TIME_SECONDS = 86400ULL;  // 24 hours
-            if (time_seconds > MAX_ARC_TIME_SECONDS) {
-                time_seconds = MAX_ARC_TIME_SECONDS;
-            }
-            
-            // Convert to milliseconds
-            unsigned long long time_ms = time_seconds * 1000ULL;
-            travel_time[arc_id] = static_cast<unsigned>(time_ms);
+        result.success = totals.distance != RoutingKit::inf_weight;
+        if (!result.success) {
+            result.total_travel_time_ms = RoutingKit::inf_weight;
+            result.total_geo_distance_m = RoutingKit::inf_weight;
+        } else if (by_time) {
+            result.total_travel_time_ms = totals.distance;
+            result.total_geo_distance_m = totals.total;
         } else {
-            travel_time[arc_id] = RoutingKit::inf_weight;
+            result.total_geo_distance_m = totals.distance;
+            result.total_travel_time_ms = totals.total;
         }
+        return result;
     }
     
-    LOG("Travel time calculation completed successfully");
+    if (speed_tier != nullptr) {
+        // Route on the CCH metric customized for this speed cap; the slot's query is
+        // rebound to whichever tier the request needs
+        RoutingKit::CustomizableContractionHierarchyQuery& query = lease->cchQuery(*speed_tier->metric);
+        
+        long long start_time = RoutingKit::get_micro_time();
+        query.add_source(from_node).add_target(to_node).run();
+        long long end_time = RoutingKit::get_micro_time();
+        result.query_time_us = end_time - start_time;
+        
+        distance = query.get_distance();
+        result.arc_path = query.get_arc_path();
+        unpack_time_us = RoutingKit::get_micro_time() - end_time;
+    } else {
+        RoutingKit::ContractionHierarchyQuery& query = chQuery(*lease, metric);
+        
+        // Compute the route
+        long long start_time = RoutingKit::get_micro_time();
+        query.reset().add_source(from_node).add_target(to_node).run();
+        long long end_time = RoutingKit::get_micro_time();
+        result.query_time_us = end_time - start_time;
+        
+        distance = query.get_distance();
+        result.arc_path = query.get_arc_path();
+        unpack_time_us = RoutingKit::get_micro_time() - end_time;
+    }
+    Metrics::instance().record(MetricStage::ChQuery, result.query_time_us);
     
-    // Add statistics about travel times
-    unsigned min_time = std::numeric_limits<unsigned>::max();
-    unsigned max_time = 0;
-    unsigned inf_count = 0;
-    unsigned zero_count = 0;
+    // Check if a path was found
+    result.success = distance != RoutingKit::inf_weight && !result.arc_path.empty();
+    if (!result.success) {
+        result.total_travel_time_ms = RoutingKit::inf_weight;
+        result.total_geo_distance_m = RoutingKit::inf_weight;
+        return result;
+    }
     
-    for (unsigned arc_id = 0; arc_id < graph_.arc_count(); ++arc_id) {
-        unsigned time = travel_time[arc_id];
-        if (time == RoutingKit::inf_weight) {
-            inf_count++;
-        } else if (time == 0) {
-            zero_count++;
-        } else {
-            min_time = std::min(min_time, time);
-            max_time = std::max(max_time, time);
+    // The nodes follow from the arcs, which saves unpacking the CH path a second time
+    if (detail == RouteDetail::Path) {
+        long long nodes_start = RoutingKit::get_micro_time();
+        result.node_path.reserve(result.arc_path.size() + 1);
+        result.node_path.push_back(from_node);
+        for (unsigned arc_id : result.arc_path) {
+            result.node_path.push_back(graph_.head[arc_id]);
         }
+        unpack_time_us += RoutingKit::get_micro_time() - nodes_start;
     }
+    Metrics::instance().record(MetricStage::PathUnpack, unpack_time_us);
     
-    LOG("Travel time statistics: min=" << min_time << "ms, max=" << max_time << "ms, inf_count=" << inf_count << ", zero_count=" << zero_count);
-    
-    LOG("Building/loading contraction hierarchies...");
-    
-    try {
-        // Build the tail array from the first_out array
-        LOG("Building tail array...");
-        auto tail = RoutingKit::invert_inverse_vector(graph_.first_out);
-        LOG("Tail array built successfully");
+    if (by_time) {
+        // The CH distance is the travel time; the length is summed along the path
+        unsigned long long total_distance_m = 0;
+        for (unsigned arc_id : result.arc_path) {
+            total_distance_m += graph_.geo_distance[arc_id];
+        }
+        result.total_geo_distance_m = static_cast<unsigned>(total_distance_m);
         
-        // Try to load pre-built CH, or build it if not available
-        if (std::filesystem::exists(ch_file_path)) {
-            LOG("Loading pre-built contraction hierarchy from: " << ch_file_path);
-            MemoryStats mem_before_ch_load = MemoryStats::get_current();
-            ch_geo_ = std::make_unique<RoutingKit::ContractionHierarchy>(
-                RoutingKit::ContractionHierarchy::load_file(ch_file_path)
-            );
-            MemoryStats mem_after_ch_load = MemoryStats::get_current();
-            LOG("Contraction hierarchy loaded successfully");
-            LOG("Memory before CH load: RSS=" << mem_before_ch_load.format() << ", Peak=" << mem_before_ch_load.format_peak());
-            LOG("Memory after CH load: RSS=" << mem_after_ch_load.format() << ", Peak=" << mem_after_ch_load.format_peak());
+        bool time_matches_cap = !max_speed_kmh.has_value() ||
+                                (speed_tier != nullptr && speed_tier->max_speed_kmh == max_speed_kmh.value());
+        if (time_matches_cap) {
+            result.total_travel_time_ms = distance;
         } else {
-            LOG("CH file not found: " << ch_file_path << ", building instead...");
-            // Build contraction hierarchy for geo distance
-            LOG("Building contraction hierarchy for geo distance...");
-            MemoryStats mem_before_ch_build = MemoryStats::get_current();
-            ch_geo_ = std::make_unique<RoutingKit::ContractionHierarchy>(
-                RoutingKit::ContractionHierarchy::build(
-                    graph_.node_count(),
-                    tail, graph_.head,
-                    graph_.geo_distance
-                )
-            );
-            MemoryStats mem_after_ch_build = MemoryStats::get_current();
-            LOG("Geo distance contraction hierarchy built successfully");
-            LOG("Memory before CH build: RSS=" << mem_before_ch_build.format() << ", Peak=" << mem_before_ch_build.format_peak());
-            LOG("Memory after CH build: RSS=" << mem_after_ch_build.format() << ", Peak=" << mem_after_ch_build.format_peak());
-            
-            // Save the CH to disk for future use
-            LOG("Saving contraction hierarchy to: " << ch_file_path);
-            try {
-                // Ensure parent directory exists
-                std::filesystem::path ch_path_obj(ch_file_path);
-                if (ch_path_obj.has_parent_path()) {
-                    std::filesystem::create_directories(ch_path_obj.parent_path());
-                }
-                ch_geo_->save_file(ch_file_path);
-                LOG("Contraction hierarchy saved successfully");
-            } catch (const std::exception& e) {
-                LOG("Warning: Failed to save contraction hierarchy: " << e.what());
-                // Don't fail the entire initialization if saving fails
-            }
+            // Route came from an uncapped or approximate tier: re-derive the time for the exact cap
+            result.total_travel_time_ms = recalculateTotalTravelTime(result, max_speed_kmh.value());
         }
-        
-        // Build contraction hierarchy for travel time
-        LOG("Skipping travel time contraction hierarchy for now due to crash");
-        // TODO: Fix travel time CH building crash
-        /*
-        LOG("Building contraction hierarchy for travel time...");
-        ch_ = std::make_unique<RoutingKit::ContractionHierarchy>(
-            RoutingKit::ContractionHierarchy::build(
-                graph_.node_count(),
-                tail, graph_.head,
-                travel_time
-            )
-        );
-        LOG("Travel time contraction hierarchy built successfully");
-        */
-        
-        LOG("Contraction hierarchies built");
-    } catch (const std::exception& e) {
-        LOG("Error building contraction hierarchies: " << e.what());
-        throw;
-    } catch (...) {
-        LOG("Unknown error building contraction hierarchies");
-        throw;
+    } else {
+        // Shortest route: derive the time from the path
+        result.total_geo_distance_m = distance;
+        result.total_travel_time_ms = recalculateTotalTravelTime(result, max_speed_kmh.value_or(SHORTEST_ROUTE_SPEED_CAP_KMH));
     }
     
-    // Create the geo position mapping
-    pos_to_node_ = std::make_unique<RoutingKit::GeoPositionToNode>(
-        graph_.latitude, graph_.longitude
-    );
+    return result;
+}
+
+RoutingKit::ContractionHierarchyQuery& RoutingEngine::chQuery(QueryArena::Slot& slot, RoutingMetric metric) const {
+    // Each slot keeps one query per CH so alternating metrics doesn't reallocate them
+    if (metric == RoutingMetric::TravelTime) {
+        return slot.chQuery(1, *ch_time_);
+    }
+    return slot.chQuery(0, *ch_geo_);
+}
+
+MatrixResult RoutingEngine::computeMatrix(const std::vector<std::pair<double, double>>& sources,
+                                          const std::vector<std::pair<double, double>>& targets,
+                                          RoutingMetric metric) const {
+    MatrixResult result;
+    result.source_count = sources.size();
+    result.target_count = targets.size();
+    result.values.assign(sources.size() * targets.size(), RoutingKit::inf_weight);
+    result.source_snapped.assign(sources.size(), false);
+    result.target_snapped.assign(targets.size(), false);
+    
+    const bool by_time = metric == RoutingMetric::TravelTime;
+    
+    // Snap every coordinate once; the walk to the node becomes the initial distance of the search
+    std::vector<std::optional<SnappedPoint>> snapped_sources = snapCoordinates(sources);
+    std::vector<std::optional<SnappedPoint>> snapped_targets = snapCoordinates(targets);
+    auto offset_of = [by_time](const SnappedPoint& point) {
+        return by_time ? walkingTimeMs(point.walking_distance_m) : static_cast<unsigned>(point.walking_distance_m);
+    };
+    
+    // Targets snapping to the same node share one pinned target; every column keeps the index of
+    // its pinned node and its own walk, so duplicates cost neither search space nor lookups
+    std::vector<unsigned> target_nodes;
+    std::vector<unsigned> pinned_columns;  // Snapped matrix columns
+    std::vector<unsigned> column_pins;     // Pinned target index of each entry of pinned_columns
+    std::vector<unsigned> column_offsets;  // Walk to the target of each entry of pinned_columns
+    std::unordered_map<unsigned, unsigned> pin_of_node;
+    pin_of_node.reserve(targets.size());
+    for (unsigned j = 0; j < targets.size(); ++j) {
+        if (snapped_targets[j].has_value()) {
+            result.target_snapped[j] = true;
+            auto [pin, inserted] = pin_of_node.emplace(snapped_targets[j]->node, static_cast<unsigned>(target_nodes.size()));
+            if (inserted) {
+                target_nodes.push_back(snapped_targets[j]->node);
+            }
+            pinned_columns.push_back(j);
+            column_pins.push_back(pin->second);
+            column_offsets.push_back(offset_of(*snapped_targets[j]));
+        }
+    }
     
-    MemoryStats mem_final = MemoryStats::get_current();
-    LOG("Routing engine initialization complete");
-    LOG("Final memory: RSS=" << mem_final.format() << ", Peak=" << mem_final.format_peak());
+    for (unsigned i = 0; i < sources.size(); ++i) {
+        result.source_snapped[i] = snapped_sources[i].has_value();
+    }
     
-    // Initialize query pool with adaptive sizing based on memory usage
-    // For very large maps, disable pooling to avoid OOM (fallback to on-demand creation)
-    unsigned pool_size = 2;
-    bool disable_pool = false;
-    const char* pool_size_env = std::getenv("CH_QUERY_POOL_SIZE");
-    if (pool_size_env != nullptr) {
-        try {
-            unsigned requested = static_cast<unsigned>(std::stoul(pool_size_env));
-            if (requested == 0) {
-                disable_pool = true;
-            } else {
-                pool_size = std::max(1u, std::min(32u, requested));
+    long long query_start = RoutingKit::get_micro_time();
+    if (!target_nodes.empty()) {
+        QueryArena::Lease lease = query_arena_->acquire();
+        RoutingKit::ContractionHierarchyQuery& query = chQuery(*lease, metric);
+        query.reset().pin_targets(target_nodes);
+        
+        for (unsigned i = 0; i < sources.size(); ++i) {
+            if (!snapped_sources[i].has_value()) {
+                continue;
+            }
+            
+            query.reset_source().add_source(snapped_sources[i]->node, offset_of(*snapped_sources[i])).run_to_pinned_targets();
+            std::vector<unsigned> distances = query.get_distances_to_targets();
+            for (size_t k = 0; k < pinned_columns.size(); ++k) {
+                unsigned distance = distances[column_pins[k]];
+                if (distance == RoutingKit::inf_weight) {
+                    continue;
+                }
+                unsigned long long value = static_cast<unsigned long long>(distance) + column_offsets[k];
+                result.values[i * result.target_count + pinned_columns[k]] =
+                    static_cast<unsigned>(std::min<unsigned long long>(value, RoutingKit::inf_weight - 1));
             }
-        } catch (...) {
-            LOG("Invalid CH_QUERY_POOL_SIZE, using adaptive default");
-        }
-    } else {
-        // Adaptive sizing: disable pool for very large maps to avoid OOM
-        // Each query object duplicates significant CH data (roughly 10-15GB for huge CHs)
-        uint64_t rss_gb = mem_final.rss_kb / (1024 * 1024);
-        if (rss_gb > 25) {
-            // Extremely large map (>25GB): disable pooling, use on-demand query creation
-            // This avoids OOM but will be slower (back to original behavior)
-            disable_pool = true;
-            LOG("Very large map detected (" << rss_gb << " GB RSS), disabling query pool to avoid OOM");
-        } else if (rss_gb > 15) {
-            // Very large map (15-25GB): use single query in pool
-            pool_size = 1;
-            LOG("Large map detected (" << rss_gb << " GB RSS), using single-query pool");
-        } else if (rss_gb > 10) {
-            // Large map (10-15GB): use small pool (2 queries)
-            pool_size = 2;
-            LOG("Medium-large map detected (" << rss_gb << " GB RSS), using small query pool");
-        } else {
-            // Smaller maps: can afford more queries
-            pool_size = std::max(2u, std::min(8u, static_cast<unsigned>(std::thread::hardware_concurrency())));
         }
     }
+    long long query_end = RoutingKit::get_micro_time();
+    result.query_time_us = query_end - query_start;
     
-    if (disable_pool) {
-        LOG("Query pool disabled - queries will be created on-demand (slower but avoids OOM)");
-        query_pool_ = nullptr;
-    } else {
-        LOG("Initializing CH query pool with size: " << pool_size);
-        query_pool_ = std::make_unique<QueryPool>(*ch_geo_, pool_size);
-        LOG("CH query pool initialized");
+    if (isTimingEnabled()) {
+        LOG("[TIMING] computeMatrix " << sources.size() << "x" << targets.size() << ": " << result.query_time_us / 1000.0 << " ms");
     }
+    return result;
 }
 
-bool RoutingEngine::isTimingEnabled() {
-    static bool cached = false;
-    static bool enabled = false;
-    if (!cached) {
-        const char* timing_env = std::getenv("ROUTING_TIMING");
-        enabled = (timing_env != nullptr && std::string(timing_env) == "1");
-        cached = true;
+ReachableResult RoutingEngine::computeReachableAddresses(double latitude, double longitude, unsigned max_time_ms,
+                                                         unsigned max_count, unsigned seed) const {
+    ReachableResult result;
+    std::optional<SnappedPoint> source = hasReachability() ? snapCoordinate(latitude, longitude) : std::nullopt;
+    if (!source.has_value()) {
+        return result;
     }
-    return enabled;
-}
-
-// QueryPool implementation
-RoutingEngine::QueryPool::QueryPool(RoutingKit::ContractionHierarchy& ch, unsigned pool_size)
-    : ch_(ch) {
-    queries_.reserve(pool_size);
-    for (unsigned i = 0; i < pool_size; ++i) {
-        queries_.push_back(std::make_unique<RoutingKit::ContractionHierarchyQuery>(ch_));
-        available_.push(queries_.back().get());
+    result.source_snapped = true;
+    
+    // Everything at or beyond the budget is equally out of reach, so the search may stop there
+    long long query_start = RoutingKit::get_micro_time();
+    QueryArena::Lease lease = query_arena_->acquire();
+    PhastQuery& query = lease->phastQuery(ch_time_->node_count());
+    unsigned bound = static_cast<unsigned>(std::min<unsigned long long>(max_time_ms + 1ull, RoutingKit::inf_weight));
+    query.run(*ch_time_, *phast_time_, source->node, walkingTimeMs(source->walking_distance_m), bound);
+    
+    std::vector<std::pair<unsigned, unsigned>> reachable;
+    for (const PhastAddress& address : phast_addresses_) {
+        unsigned distance = query.distance(address.slot);
+        if (distance <= max_time_ms && address.walking_time_ms <= max_time_ms - distance) {
+            reachable.emplace_back(address.address, distance + address.walking_time_ms);
+        }
+    }
+    result.query_time_us = RoutingKit::get_micro_time() - query_start;
+    Metrics::instance().record(MetricStage::ChQuery, result.query_time_us);
+    
+    // Partial Fisher-Yates shuffle: the first max_count entries become a uniform sample
+    result.reachable_count = reachable.size();
+    if (reachable.size() > max_count) {
+        std::mt19937 gen(seed);
+        for (size_t i = 0; i < max_count; ++i) {
+            std::uniform_int_distribution<size_t> pick(i, reachable.size() - 1);
+            std::swap(reachable[i], reachable[pick(gen)]);
+        }
+        reachable.resize(max_count);
+    }
+    std::sort(reachable.begin(), reachable.end(),
+              [](const auto& a, const auto& b) { return a.second != b.second ? a.second < b.second : a.first < b.first; });
+    result.addresses.reserve(reachable.size());
+    result.travel_times_ms.reserve(reachable.size());
+    for (const auto& [address_id, travel_time_ms] : reachable) {
+        result.addresses.push_back(addresses_.get(address_id));
+        result.travel_times_ms.push_back(travel_time_ms);
+    }
+    
+    if (isTimingEnabled()) {
+        LOG("[TIMING] computeReachableAddresses within " << max_time_ms << " ms: " << result.reachable_count
+            << " addresses in " << result.query_time_us / 1000.0 << " ms");
     }
+    return result;
 }
 
-RoutingEngine::QueryPool::~QueryPool() = default;
-
-RoutingKit::ContractionHierarchyQuery* RoutingEngine::QueryPool::acquire() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (available_.empty()) {
-        return nullptr; // Pool exhausted
-    }
-    RoutingKit::ContractionHierarchyQuery* query = available_.front();
-    available_.pop();
-    return query;
+uint64_t RoutingEngine::coordinateKey(double latitude, double longitude) {
+    auto fixed = [](double degrees) {
+        return static_cast<uint32_t>(static_cast<int32_t>(std::lround(degrees * AddressStore::COORDINATE_SCALE)));
+    };
+    return (static_cast<uint64_t>(fixed(latitude)) << 32) | fixed(longitude);
 }
 
-void RoutingEngine::QueryPool::release(RoutingKit::ContractionHierarchyQuery* query) {
-    if (query == nullptr) {
-        return;
+std::optional<unsigned> RoutingEngine::findAddressAtKey(uint64_t key) const {
+    if (address_key_order_.empty() || std::fabs(static_cast<int32_t>(key >> 32) / AddressStore::COORDINATE_SCALE) > 90.0) {
+        return std::nullopt;
+    }
+    const auto& latitudes = addresses_.latitudeColumn();
+    const auto& longitudes = addresses_.longitudeColumn();
+    auto address_key = [&](unsigned id) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(latitudes[id])) << 32) | static_cast<uint32_t>(longitudes[id]);
+    };
+    auto it = std::lower_bound(address_key_order_.begin(), address_key_order_.end(), key,
+                               [&](unsigned id, uint64_t value) { return address_key(id) < value; });
+    if (it == address_key_order_.end() || address_key(*it) != key) {
+        return std::nullopt;
     }
-    std::lock_guard<std::mutex> lock(mutex_);
-    available_.push(query);
+    return *it;
 }
 
-unsigned RoutingEngine::findNearestNode(double latitude, double longitude, unsigned max_radius) const {
-    auto node = pos_to_node_->find_nearest_neighbor_within_radius(latitude, longitude, max_radius);
-    return node.id;
+unsigned RoutingEngine::snapNode(double latitude, double longitude) const {
+    uint64_t key = coordinateKey(latitude, longitude);
+    if (auto address_id = findAddressAtKey(key)) {
+        return address_nodes_[*address_id];
+    }
+    if (auto cached = snap_cache_->get(key)) {
+        return *cached;
+    }
+    unsigned node = findNearestNode(latitude, longitude);
+    snap_cache_->put(key, node);
+    return node;
 }
 
-RoutingResult RoutingEngine::computeShortestPath(unsigned from_node, unsigned to_node) const {
-    RoutingResult result;
-    result.source_node = from_node;
-    result.target_node = to_node;
-    result.success = false;
-    
-    // Check if both nodes are valid
-    if (!isValidNode(from_node) || !isValidNode(to_node)) {
-        LOG("Invalid nodes: from=" << from_node << " (valid: " << isValidNode(from_node) << "), to=" << to_node << " (valid: " << isValidNode(to_node) << ")");
-        result.total_travel_time_ms = RoutingKit::inf_weight;
-        result.total_geo_distance_m = RoutingKit::inf_weight;
-        return result;
-    }
+std::vector<std::optional<SnappedPoint>> RoutingEngine::snapCoordinates(
+    const std::vector<std::pair<double, double>>& coordinates) const {
+    std::vector<std::optional<SnappedPoint>> result(coordinates.size());
+    auto snap_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            result[i] = snapCoordinate(coordinates[i].first, coordinates[i].second);
+        }
+    };
     
-    // Special case: if source and target are the same node, return a successful single-node route
-    if (from_node == to_node) {
-        LOG("Same source and target node: " << from_node << ", returning single-node route");
-        result.total_travel_time_ms = 0;
-        result.total_geo_distance_m = 0;
-        result.node_path = {from_node};
-        result.arc_path = {}; // No arcs for single node
-        result.query_time_us = 0;
-        result.success = true;
+    // Small batches are not worth the hand-off to the worker threads
+    constexpr size_t MIN_PARALLEL_BATCH = 256;
+    if (worker_pool_ == nullptr || coordinates.size() < MIN_PARALLEL_BATCH) {
+        snap_range(0, coordinates.size());
         return result;
     }
-    
-    // Use thread-local query object for efficient reuse without OOM
-    // Each thread gets its own query object, avoiding pool contention and memory issues
-    thread_local static std::unique_ptr<RoutingKit::ContractionHierarchyQuery> thread_local_query;
-    thread_local static const RoutingKit::ContractionHierarchy* thread_local_ch = nullptr;
-    
-    // Initialize thread-local query if needed or if CH changed
-    if (thread_local_query == nullptr || thread_local_ch != ch_geo_.get()) {
-        long long query_init_start = RoutingKit::get_micro_time();
-        if (isTimingEnabled()) {
-            LOG("Initializing thread-local query object (first use for this thread)");
-        }
-        thread_local_query = std::make_unique<RoutingKit::ContractionHierarchyQuery>(*ch_geo_);
-        thread_local_ch = ch_geo_.get();
-        long long query_init_end = RoutingKit::get_micro_time();
-        if (isTimingEnabled()) {
-            LOG("Thread-local query initialized in " << (query_init_end - query_init_start) / 1000.0 << " ms");
-        }
+    size_t chunk_count = worker_pool_->threadCount() + 1;
+    size_t chunk_size = (coordinates.size() + chunk_count - 1) / chunk_count;
+    std::vector<std::future<void>> chunks;
+    for (size_t begin = chunk_size; begin < coordinates.size(); begin += chunk_size) {
+        chunks.push_back(worker_pool_->submit([&, begin]() { snap_range(begin, std::min(begin + chunk_size, coordinates.size())); }));
     }
-    
-    // Fallback to pool if thread_local not available (shouldn't happen, but safety)
-    RoutingKit::ContractionHierarchyQuery* ch_geo_query = thread_local_query.get();
-    bool use_pool_release = false;
-    
-    if (ch_geo_query == nullptr && query_pool_ != nullptr) {
-        ch_geo_query = query_pool_->acquire();
-        use_pool_release = true;
-        if (ch_geo_query == nullptr) {
-            // Last resort: create temporary query
-            std::unique_ptr<RoutingKit::ContractionHierarchyQuery> temp_query = std::make_unique<RoutingKit::ContractionHierarchyQuery>(*ch_geo_);
-            ch_geo_query = temp_query.get();
-            long long start_time = RoutingKit::get_micro_time();
-            ch_geo_query->reset().add_source(from_node).add_target(to_node).run();
-            long long end_time = RoutingKit::get_micro_time();
-            result.query_time_us = end_time - start_time;
-            result.total_geo_distance_m = ch_geo_query->get_distance();
-            result.node_path = ch_geo_query->get_node_path();
-            result.arc_path = ch_geo_query->get_arc_path();
-            return result;
-        }
+    snap_range(0, std::min(chunk_size, coordinates.size()));
+    for (auto& chunk : chunks) {
+        chunk.get();
     }
-    
-    // Compute the route
+    return result;
+}
+
+std::optional<SnappedPoint> RoutingEngine::snapCoordinate(double latitude, double longitude) const {
     long long start_time = RoutingKit::get_micro_time();
-    ch_geo_query->reset().add_source(from_node).add_target(to_node).run();
-    long long end_time = RoutingKit::get_micro_time();
-    result.query_time_us = end_time - start_time;
-    
-    // Use geo distance for both time and distance for now
-    result.total_geo_distance_m = ch_geo_query->get_distance();
-    result.node_path = ch_geo_query->get_node_path();
-    result.arc_path = ch_geo_query->get_arc_path();
-    
-    // Release query back to pool if we used pool
-    if (use_pool_release && query_pool_ != nullptr) {
-        query_pool_->release(ch_geo_query);
-    }
-    
-    // Check if a path was found (use geo distance since we don't have travel time CH)
-    result.success = result.total_geo_distance_m != RoutingKit::inf_weight && !result.node_path.empty();
-    
-    // Calculate travel time manually based on path and speeds
-    if (result.total_geo_distance_m != RoutingKit::inf_weight && !result.arc_path.empty()) {
-        // Use a very high speed limit (effectively no limit) to get natural travel times
-        result.total_travel_time_ms = recalculateTotalTravelTime(result, 300); // 300 km/h max (effectively unlimited)
-        LOG("Calculated travel time: " << result.total_travel_time_ms << " ms for " << result.arc_path.size() << " arcs");
-    } else {
-        result.total_travel_time_ms = result.total_geo_distance_m; // Fallback
-        LOG("Using fallback travel time: " << result.total_travel_time_ms << " ms");
+    unsigned node = snapNode(latitude, longitude);
+    Metrics::instance().record(MetricStage::Snap, RoutingKit::get_micro_time() - start_time);
+    if (node == RoutingKit::invalid_id) {
+        return std::nullopt;
     }
-    
-    // No fallback needed - use computeShortestPathFromCoordinates for better handling
-    return result;
+    double node_lat, node_lon;
+    getNodeCoordinates(node, node_lat, node_lon);
+    return SnappedPoint{latitude, longitude, node, haversineDistance(latitude, longitude, node_lat, node_lon)};
 }
 
 RoutingResult RoutingEngine::computeShortestPathFromCoordinates(double from_lat, double from_lon, 
-                                                                double to_lat, double to_lon) const {
-    RoutingResult result;
-    result.success = false;
-    
+                                                                double to_lat, double to_lon,
+                                                                RoutingMetric metric,
+                                                                std::optional<unsigned> max_speed_kmh,
+                                                                RouteDetail detail) const {
     // Find nearest nodes with timing
     long long snap_start = RoutingKit::get_micro_time();
-    unsigned from_node = findNearestNode(from_lat, from_lon);
+    auto from = snapCoordinate(from_lat, from_lon);
     long long snap_mid = RoutingKit::get_micro_time();
-    unsigned to_node = findNearestNode(to_lat, to_lon);
+    auto to = snapCoordinate(to_lat, to_lon);
     long long snap_end = RoutingKit::get_micro_time();
     if (isTimingEnabled()) {
         LOG("[TIMING] findNearestNode(from): " << (snap_mid - snap_start) / 1000.0 << " ms");
         LOG("[TIMING] findNearestNode(to): " << (snap_end - snap_mid) / 1000.0 << " ms");
     }
     
-    if (from_node == RoutingKit::invalid_id || to_node == RoutingKit::invalid_id) {
-        LOG("Failed to find nodes within range");
+    if (!from.has_value() || !to.has_value()) {
+        LOG_DEBUG("Failed to find nodes within range");
+        RoutingResult result;
+        result.success = false;
         result.total_travel_time_ms = RoutingKit::inf_weight;
         result.total_geo_distance_m = RoutingKit::inf_weight;
         return result;
     }
     
-    // Get node coordinates
-    double from_node_lat, from_node_lon, to_node_lat, to_node_lon;
-    getNodeCoordinates(from_node, from_node_lat, from_node_lon);
-    getNodeCoordinates(to_node, to_node_lat, to_node_lon);
-    
-    // Calculate walking distances (in meters)
-    double start_walking_distance = haversineDistance(from_lat, from_lon, from_node_lat, from_node_lon);
-    double end_walking_distance = haversineDistance(to_lat, to_lon, to_node_lat, to_node_lon);
+    return computeShortestPathBetweenSnapped(*from, *to, metric, max_speed_kmh, detail);
+}
+
+RoutingResult RoutingEngine::computeShortestPathBetweenSnapped(const SnappedPoint& from, const SnappedPoint& to,
+                                                               RoutingMetric metric,
+                                                               std::optional<unsigned> max_speed_kmh,
+                                                               RouteDetail detail) const {
+    RoutingResult result;
+    result.success = false;
     
-    // Calculate walking times (6 km/h = 1.67 m/s)
-    unsigned start_walking_time_ms = static_cast<unsigned>(start_walking_distance * 1000.0 / 1.67); // 6 km/h walking speed
-    unsigned end_walking_time_ms = static_cast<unsigned>(end_walking_distance * 1000.0 / 1.67);
+    // Calculate walking times
+    double start_walking_distance = from.walking_distance_m;
+    double end_walking_distance = to.walking_distance_m;
+    unsigned start_walking_time_ms = walkingTimeMs(start_walking_distance);
+    unsigned end_walking_time_ms = walkingTimeMs(end_walking_distance);
     
-    result.source_node = from_node;
-    result.target_node = to_node;
+    result.source_node = from.node;
+    result.target_node = to.node;
     
     // Special case: if both coordinates map to the same node
-    if (from_node == to_node) {
-        LOG("Start and end coordinates map to same node: " << from_node);
+    if (from.node == to.node) {
+        LOG_DEBUG("Start and end coordinates map to same node: " << from.node);
         result.total_travel_time_ms = start_walking_time_ms + end_walking_time_ms;
         result.total_geo_distance_m = static_cast<unsigned>(start_walking_distance + end_walking_distance);
-        result.node_path = {from_node};
+        result.node_path = {from.node};
         result.arc_path = {};
         result.query_time_us = 0;
         result.success = true;
@@ -794,23 +996,23 @@ RoutingResult RoutingEngine::computeShortestPathFromCoordinates(double from_lat,
         // Store walking segment info for later processing
         result.start_walking_distance = start_walking_distance;
         result.end_walking_distance = end_walking_distance;
-        result.start_lat = from_lat;
-        result.start_lon = from_lon;
-        result.end_lat = to_lat;
-        result.end_lon = to_lon;
+        result.start_lat = from.latitude;
+        result.start_lon = from.longitude;
+        result.end_lat = to.latitude;
+        result.end_lon = to.longitude;
         return result;
     }
     
     // Compute route between nodes with timing
     long long compute_start = RoutingKit::get_micro_time();
-    RoutingResult node_result = computeShortestPath(from_node, to_node);
+    RoutingResult node_result = computeShortestPath(from.node, to.node, metric, max_speed_kmh, detail);
     long long compute_end = RoutingKit::get_micro_time();
     if (isTimingEnabled()) {
         LOG("[TIMING] computeShortestPath(from_node, to_node): " << (compute_end - compute_start) / 1000.0 << " ms");
     }
     
     if (!node_result.success) {
-        LOG("Failed to find route between nodes");
+        LOG_DEBUG("Failed to find route between nodes");
         return node_result;
     }
     
@@ -822,13 +1024,80 @@ RoutingResult RoutingEngine::computeShortestPathFromCoordinates(double from_lat,
     // Store walking segment info for later processing
     result.start_walking_distance = start_walking_distance;
     result.end_walking_distance = end_walking_distance;
-    result.start_lat = from_lat;
-    result.start_lon = from_lon;
-    result.end_lat = to_lat;
-    result.end_lon = to_lon;
+    result.start_lat = from.latitude;
+    result.start_lon = from.longitude;
+    result.end_lat = to.latitude;
+    result.end_lon = to.longitude;
+    
+    LOG_DEBUG("Route with walking segments: start_walk=" << start_walking_distance << "m, end_walk=" << end_walking_distance << "m");
+    
+    return result;
+}
+
+JobRouteResult RoutingEngine::computeJobRoute(double from_lat, double from_lon, double via_lat, double via_lon,
+                                              double to_lat, double to_lon,
+                                              RoutingMetric metric,
+                                              std::optional<unsigned> max_speed_kmh,
+                                              RouteDetail detail) const {
+    JobRouteResult result;
+    
+    // Snap each coordinate exactly once; via is shared by both legs
+    long long snap_start = RoutingKit::get_micro_time();
+    auto from = snapCoordinate(from_lat, from_lon);
+    auto via = snapCoordinate(via_lat, via_lon);
+    auto to = snapCoordinate(to_lat, to_lon);
+    long long snap_end = RoutingKit::get_micro_time();
+    if (isTimingEnabled()) {
+        LOG("[TIMING] computeJobRoute snapping: " << (snap_end - snap_start) / 1000.0 << " ms");
+    }
+    
+    if (!from.has_value() || !via.has_value()) {
+        LOG_DEBUG("Failed to find nodes within range for first leg");
+        result.failed_leg = 1;
+        return result;
+    }
+    if (!to.has_value()) {
+        LOG_DEBUG("Failed to find nodes within range for second leg");
+        result.failed_leg = 2;
+        return result;
+    }
+    
+    // Leg 2 runs on the pool (or inline if the pool is disabled or saturated) while this thread does leg 1
+    long long legs_start = RoutingKit::get_micro_time();
+    std::future<RoutingResult> leg2_future;
+    if (worker_pool_ != nullptr) {
+        leg2_future = worker_pool_->submit([&]() {
+            return computeShortestPathBetweenSnapped(*via, *to, metric, max_speed_kmh, detail);
+        });
+    }
+    try {
+        result.leg1 = computeShortestPathBetweenSnapped(*from, *via, metric, max_speed_kmh, detail);
+    } catch (...) {
+        // The pooled task references this frame, so it has to finish before unwinding
+        if (leg2_future.valid()) {
+            leg2_future.wait();
+        }
+        throw;
+    }
+    result.leg2 = leg2_future.valid() ? leg2_future.get()
+                                      : computeShortestPathBetweenSnapped(*via, *to, metric, max_speed_kmh, detail);
+    long long legs_end = RoutingKit::get_micro_time();
+    if (isTimingEnabled()) {
+        LOG("[TIMING] computeJobRoute legs: " << (legs_end - legs_start) / 1000.0 << " ms");
+    }
     
-    LOG("Route with walking segments: start_walk=" << start_walking_distance << "m, end_walk=" << end_walking_distance << "m");
+    if (!result.leg1.success) {
+        result.failed_leg = 1;
+        return result;
+    }
+    if (!result.leg2.success) {
+        result.failed_leg = 2;
+        return result;
+    }
     
+    result.success = true;
+    result.total_travel_time_ms = result.leg1.total_travel_time_ms + result.leg2.total_travel_time_ms;
+    result.total_geo_distance_m = result.leg1.total_geo_distance_m + result.leg2.total_geo_distance_m;
     return result;
 }
 
@@ -844,6 +1113,7 @@ void RoutingEngine::getNodeCoordinates(unsigned node_id, double& latitude, doubl
 
 std::vector<RoutePoint> RoutingEngine::processPathIntoPoints(const RoutingResult& result, 
                                                              std::optional<unsigned> max_speed_kmh) const {
+    long long start_time = RoutingKit::get_micro_time();
     std::vector<RoutePoint> route_points;
     
     if (!result.success || result.node_path.empty()) {
@@ -908,39 +1178,21 @@ std::vector<RoutePoint> RoutingEngine::processPathIntoPoints(const RoutingResult
     // Calculate cumulative travel times and distances for the route between nodes
     std::vector<unsigned> cumulative_times(result.node_path.size(), 0);
     std::vector<unsigned> cumulative_distances(result.node_path.size(), 0);
-    std::vector<unsigned> arc_speeds(result.arc_path.size());
+    std::vector<unsigned> arc_times(result.arc_path.size());
+    std::vector<uint16_t> arc_speeds(result.arc_path.size());
     
     // Start with walking time/distance if needed
     unsigned start_walking_time = has_start_walking ? static_cast<unsigned>(result.start_walking_distance * 1000.0 / 1.67) : 0;
     unsigned start_walking_dist = has_start_walking ? static_cast<unsigned>(result.start_walking_distance) : 0;
     
-    cumulative_times[0] = start_walking_time;
+    // Travel time of each arc at its speed (capped at max_speed_kmh if specified), then running sums
+    ArcCostKernels::pathTimes(result.arc_path.data(), result.arc_path.size(), graph_.geo_distance.data(),
+                              arc_speed_.data(), max_speed_kmh.value_or(ArcCostKernels::NO_SPEED_CAP),
+                              arc_times.data(), arc_speeds.data());
+    ArcCostKernels::prefixSums(arc_times.data(), arc_times.size(), start_walking_time, cumulative_times.data());
     cumulative_distances[0] = start_walking_dist;
-    
-    // Add up travel times and distances for each arc
     for (size_t i = 0; i < result.arc_path.size(); ++i) {
-        const auto arc_id = result.arc_path[i];
-        unsigned way_id = graph_.way[arc_id];
-        unsigned original_speed_kmh = way_speed_[way_id];
-        unsigned distance_m = graph_.geo_distance[arc_id];
-        
-        // Apply maximum speed limit if specified
-        unsigned effective_speed_kmh = original_speed_kmh;
-        if (max_speed_kmh.has_value()) {
-            effective_speed_kmh = std::min(original_speed_kmh, max_speed_kmh.value());
-        }
-        
-        // Store the effective speed for this arc
-        arc_speeds[i] = effective_speed_kmh;
-        
-        // Calculate travel time for this arc with effective speed
-        unsigned arc_time_ms = 0;
-        if (effective_speed_kmh > 0) {
-            arc_time_ms = (distance_m * 3600ULL * 1000ULL) / (effective_speed_kmh * 1000ULL);
-        }
-        
-        cumulative_times[i + 1] = cumulative_times[i] + arc_time_ms;
-        cumulative_distances[i + 1] = cumulative_distances[i] + distance_m;
+        cumulative_distances[i + 1] = cumulative_distances[i] + graph_.geo_distance[result.arc_path[i]];
     }
     
     // Create route points with coordinates, travel times, distances, and speeds
@@ -983,6 +1235,7 @@ std::vector<RoutePoint> RoutingEngine::processPathIntoPoints(const RoutingResult
         route_points.push_back(end_point);
     }
     
+    Metrics::instance().record(MetricStage::ProcessPath, RoutingKit::get_micro_time() - start_time);
     return route_points;
 }
 
@@ -1002,90 +1255,188 @@ unsigned RoutingEngine::getAddressCount() const {
     return addresses_.size();
 }
 
+QueryArena::Stats RoutingEngine::getQueryArenaStats() const {
+    return query_arena_->stats();
+}
+
 bool RoutingEngine::loadAddressesFromCSV(const std::string& csv_file) {
     LOG("Loading addresses from " << csv_file);
+    long long load_start = RoutingKit::get_micro_time();
     
-    addresses_.clear();
-    std::vector<float> lat_vec, lon_vec;
-    
-    if (ends_with(csv_file, ".gz")) {
-        // Handle gzipped files using zcat
-        std::string cmd = "zcat " + csv_file;
-        FILE* pipe = popen(cmd.c_str(), "r");
-        if (!pipe) {
-            LOG("Error opening pipe to zcat");
-            return false;
-        }
-        
-        char buffer[4096];
-        size_t line_count = 0;
-        
-        // Skip header if present (first line starting with non-digit)
-        if (fgets(buffer, sizeof(buffer), pipe)) {
-            std::string first_line(buffer);
-            if (!first_line.empty() && !std::isdigit(first_line[0])) {
-                LOG("Skipping header: " << first_line);
-            } else {
-                processAddressLine(first_line, addresses_, lat_vec, lon_vec);
-                line_count++;
-            }
-        }
-        
-        // Process remaining lines
-        while (fgets(buffer, sizeof(buffer), pipe)) {
-            processAddressLine(buffer, addresses_, lat_vec, lon_vec);
-            line_count++;
-        }
-        
-        pclose(pipe);
-        LOG("Processed " << line_count << " lines from gzipped file");
+    // Binary address store next to the CSV (ADDRESS_STORE_FILE overrides, ADDRESS_STORE=0 disables)
+    std::string store_path;
+    const char* store_file_env = std::getenv("ADDRESS_STORE_FILE");
+    if (store_file_env != nullptr && store_file_env[0] != '\0') {
+        store_path = store_file_env;
     } else {
-        // Regular file
-        std::ifstream in_file(csv_file);
-        if (!in_file) {
-            LOG("Failed to open address file: " << csv_file);
+        std::filesystem::path store_path_obj(csv_file);
+        store_path_obj.replace_extension(".address_store.bin");
+        store_path = store_path_obj.string();
+    }
+    const char* store_env = std::getenv("ADDRESS_STORE");
+    bool store_enabled = store_env == nullptr || std::string(store_env) != "0";
+    
+    std::optional<AddressStore> table;
+    if (store_enabled) {
+        table = AddressLoader::loadStore(store_path, csv_file);
+    }
+    if (!table) {
+        table = AddressLoader::loadCsv(csv_file, AddressLoader::defaultThreadCount());
+        if (!table) {
             return false;
         }
-        
-        std::string line;
-        size_t line_count = 0;
-        
-        // Skip header if present (first line starting with non-digit)
-        if (std::getline(in_file, line)) {
-            if (!line.empty() && !std::isdigit(line[0])) {
-                LOG("Skipping header: " << line);
-            } else {
-                processAddressLine(line, addresses_, lat_vec, lon_vec);
-                line_count++;
-            }
-        }
-        
-        // Process remaining lines
-        while (std::getline(in_file, line)) {
-            processAddressLine(line, addresses_, lat_vec, lon_vec);
-            line_count++;
+        if (store_enabled && !table->empty()) {
+            AddressLoader::saveStore(store_path, csv_file, *table);
         }
-        
-        LOG("Processed " << line_count << " lines from file");
+    }
+    
+    addresses_ = std::move(*table);
+    
+    if (isTimingEnabled()) {
+        LOG("[TIMING] Address loading: " << (RoutingKit::get_micro_time() - load_start) / 1000.0 << " ms");
     }
     
     // Build spatial index if we have addresses
     if (!addresses_.empty()) {
+        // Float coordinates are only needed while the index is built
+        std::vector<float> lat_vec(addresses_.size()), lon_vec(addresses_.size());
+        for (size_t i = 0; i < addresses_.size(); ++i) {
+            lat_vec[i] = static_cast<float>(addresses_.latitude(i));
+            lon_vec[i] = static_cast<float>(addresses_.longitude(i));
+        }
         addr_index_ = std::make_unique<RoutingKit::GeoPositionToNode>(lat_vec, lon_vec);
-        LOG("Loaded " << addresses_.size() << " addresses");
+        address_grid_ = std::make_unique<SamplingGrid>(addresses_);
+        category_grids_.clear();
+        precomputeAddressNodes();
+        addresses_source_ = SnapshotSource::fromFile(csv_file);
+        LOG("Loaded " << addresses_.size() << " addresses (" << addresses_.memoryBytes() / (1024 * 1024)
+            << " MB; " << addresses_.pool(AddressStore::Street).size() << " streets, "
+            << addresses_.pool(AddressStore::City).size() << " cities)");
         return true;
     } else {
-        LOG("No addresses loaded");
+        LOG_WARN("No addresses loaded");
+        return false;
+    }
+}
+
+void RoutingEngine::precomputeAddressNodes() {
+    long long start = RoutingKit::get_micro_time();
+    
+    // Nearest routing node of every address, split across threads (lookups are read-only)
+    address_nodes_.assign(addresses_.size(), RoutingKit::invalid_id);
+    unsigned thread_count = AddressLoader::defaultThreadCount();
+    size_t chunk_size = (addresses_.size() + thread_count - 1) / thread_count;
+    std::vector<std::thread> threads;
+    for (size_t begin = 0; begin < addresses_.size(); begin += chunk_size) {
+        size_t end = std::min(begin + chunk_size, addresses_.size());
+        threads.emplace_back([this, begin, end]() {
+            for (size_t i = begin; i < end; ++i) {
+                address_nodes_[i] = findNearestNode(addresses_.latitude(i), addresses_.longitude(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // Address ids ordered by their packed fixed point coordinate for exact lookups
+    const auto& latitudes = addresses_.latitudeColumn();
+    const auto& longitudes = addresses_.longitudeColumn();
+    auto address_key = [&](unsigned id) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(latitudes[id])) << 32) | static_cast<uint32_t>(longitudes[id]);
+    };
+    address_key_order_.resize(addresses_.size());
+    std::iota(address_key_order_.begin(), address_key_order_.end(), 0u);
+    std::sort(address_key_order_.begin(), address_key_order_.end(),
+              [&](unsigned a, unsigned b) { return address_key(a) < address_key(b); });
+    
+    buildPhastAddresses();
+    
+    snap_cache_->clear();
+    closest_address_cache_->clear();
+    
+    size_t unsnapped = std::count(address_nodes_.begin(), address_nodes_.end(), RoutingKit::invalid_id);
+    LOG("Precomputed routing nodes of " << addresses_.size() << " addresses in "
+        << (RoutingKit::get_micro_time() - start) / 1000.0 << " ms (" << unsnapped << " without a node in range)");
+}
+
+bool RoutingEngine::loadPlacesFromCSV(const std::string& places_file, float max_address_distance_m) {
+    if (addresses_.empty() || !addr_index_) {
+        LOG_WARN("Addresses must be loaded before places, ignoring " << places_file);
+        return false;
+    }
+    
+    auto places = AddressLoader::loadPlaces(places_file);
+    if (!places) {
+        return false;
+    }
+    
+    // Attach every place to its nearest address
+    std::map<std::string, std::vector<unsigned>> category_ids;
+    size_t unmatched = 0;
+    for (const auto& place : *places) {
+        auto nearest = addr_index_->find_nearest_neighbor_within_radius(
+            static_cast<float>(place.latitude), static_cast<float>(place.longitude), max_address_distance_m);
+        if (nearest.id == RoutingKit::invalid_id || nearest.id >= addresses_.size()) {
+            ++unmatched;
+            continue;
+        }
+        category_ids[place.category].push_back(nearest.id);
+    }
+    
+    category_grids_.clear();
+    for (auto& [category, ids] : category_ids) {
+        LOG("Place category " << category << ": " << ids.size() << " addresses");
+        category_grids_.emplace(category, std::make_unique<SamplingGrid>(addresses_, std::move(ids)));
+    }
+    LOG("Loaded " << places->size() - unmatched << " places in " << category_grids_.size() << " categories ("
+        << unmatched << " without an address within " << max_address_distance_m << " m)");
+    return !category_grids_.empty();
+}
+
+bool RoutingEngine::loadJobCandidates(const std::string& job_candidates_file) {
+    if (!addresses_source_.has_value()) {
+        LOG_WARN("Addresses must be loaded before job candidates, ignoring " << job_candidates_file);
+        return false;
+    }
+    try {
+        auto table = std::make_unique<JobCandidateTable>(JobCandidateTable::load(job_candidates_file));
+        // The table stores address ids, which only mean the same addresses in the same file
+        if (!(table->addressSource() == *addresses_source_)) {
+            LOG_WARN("Job candidates in " << job_candidates_file << " were built from a different address file, ignoring them");
+            return false;
+        }
+        LOG("Loaded " << table->size() << " job candidates in " << table->tableCount() << " region/category tables ("
+            << table->mappedBytes() / (1024 * 1024) << " MB mapped)");
+        job_candidates_ = std::move(table);
+        return true;
+    } catch (const std::exception& e) {
+        LOG_WARN("Failed to load job candidates from " << job_candidates_file << ": " << e.what());
         return false;
     }
 }
 
+std::vector<std::string> RoutingEngine::getPlaceCategories() const {
+    std::vector<std::string> categories;
+    for (const auto& entry : category_grids_) {
+        categories.push_back(entry.first);
+    }
+    return categories;
+}
+
+std::optional<Address> RoutingEngine::getAddress(unsigned address_id) const {
+    if (address_id >= addresses_.size()) {
+        return std::nullopt;
+    }
+    return addresses_.get(address_id);
+}
+
 Address RoutingEngine::findNearestAddress(double latitude, double longitude, float max_radius) const {
     Address result;
     
     // Check if we have addresses loaded
     if (addresses_.empty() || !addr_index_) {
-        LOG("No addresses loaded");
+        LOG_WARN("No addresses loaded");
         return result;
     }
     
@@ -1095,7 +1446,7 @@ Address RoutingEngine::findNearestAddress(double latitude, double longitude, flo
     );
     
     if (nearest.id != RoutingKit::invalid_id && nearest.id < addresses_.size()) {
-        return addresses_[nearest.id];
+        return addresses_.get(nearest.id);
     }
     
     // Return an empty address if none found
@@ -1105,20 +1456,33 @@ Address RoutingEngine::findNearestAddress(double latitude, double longitude, flo
 std::optional<Address> RoutingEngine::getClosestAddress(double latitude, double longitude) const {
     // Check if we have addresses loaded
     if (addresses_.empty() || !addr_index_) {
-        LOG("No addresses loaded");
+        LOG_WARN("No addresses loaded");
         return std::nullopt;
     }
     
-    // Use a large radius to make sure we find something
-    constexpr float MAX_SEARCH_RADIUS = 5000.0f;  // 5km radius
+    // An address coordinate is its own nearest address
+    uint64_t key = coordinateKey(latitude, longitude);
+    if (auto address_id = findAddressAtKey(key)) {
+        return addresses_.get(*address_id);
+    }
     
-    // Find the nearest address
-    auto nearest = addr_index_->find_nearest_neighbor_within_radius(
-        latitude, longitude, MAX_SEARCH_RADIUS
-    );
+    unsigned address_id;
+    if (auto cached = closest_address_cache_->get(key)) {
+        address_id = *cached;
+    } else {
+        // Use a large radius to make sure we find something
+        constexpr float MAX_SEARCH_RADIUS = 5000.0f;  // 5km radius
+        
+        // Find the nearest address
+        auto nearest = addr_index_->find_nearest_neighbor_within_radius(
+            latitude, longitude, MAX_SEARCH_RADIUS
+        );
+        address_id = nearest.id;
+        closest_address_cache_->put(key, address_id);
+    }
     
-    if (nearest.id != RoutingKit::invalid_id && nearest.id < addresses_.size()) {
-        return addresses_[nearest.id];
+    if (address_id != RoutingKit::invalid_id && address_id < addresses_.size()) {
+        return addresses_.get(address_id);
     }
     
     // Return nullopt if no address found within radius
@@ -1128,7 +1492,7 @@ std::optional<Address> RoutingEngine::getClosestAddress(double latitude, double
 Address RoutingEngine::getRandomAddress(std::optional<unsigned> seed) const {
     // Check if we have addresses loaded
     if (addresses_.empty()) {
-        LOG("No addresses loaded");
+        LOG_WARN("No addresses loaded");
         return Address();
     }
     
@@ -1145,7 +1509,7 @@ Address RoutingEngine::getRandomAddress(std::optional<unsigned> seed) const {
     std::uniform_int_distribution<unsigned> dist(0, addresses_.size() - 1);
     unsigned index = dist(gen);
     
-    return addresses_[index];
+    return addresses_.get(index);
 }
 
 Address RoutingEngine::getRandomAddressInAnnulus(double center_lat, double center_lon, 
@@ -1153,7 +1517,7 @@ Address RoutingEngine::getRandomAddressInAnnulus(double center_lat, double cente
                                                std::optional<unsigned> seed) const {
     // Check if we have addresses loaded
     if (addresses_.empty() || !addr_index_) {
-        LOG("No addresses loaded");
+        LOG_WARN("No addresses loaded");
         return Address();
     }
     
@@ -1176,7 +1540,7 @@ Address RoutingEngine::getRandomAddressInAnnulus(double center_lat, double cente
     );
     
     if (nearest.id != RoutingKit::invalid_id && nearest.id < addresses_.size()) {
-        return addresses_[nearest.id];
+        return addresses_.get(nearest.id);
     }
     
     // If no address found, try another random point (up to 5 attempts)
@@ -1188,7 +1552,7 @@ Address RoutingEngine::getRandomAddressInAnnulus(double center_lat, double cente
         );
         
         if (nearest.id != RoutingKit::invalid_id && nearest.id < addresses_.size()) {
-            return addresses_[nearest.id];
+            return addresses_.get(nearest.id);
         }
     }
     
@@ -1237,12 +1601,12 @@ double RoutingEngine::haversineDistance(double lat1, double lon1, double lat2, d
 
 unsigned RoutingEngine::recalculateTotalTravelTime(const RoutingResult& result, unsigned max_speed_kmh) const {
     if (!result.success || result.arc_path.empty()) {
-        LOG("recalculateTotalTravelTime: returning 0 due to !success or empty arc_path");
+        LOG_DEBUG("recalculateTotalTravelTime: returning 0 due to !success or empty arc_path");
         return 0;
     }
     
     unsigned total_time_ms = 0;
-    LOG("recalculateTotalTravelTime: processing " << result.arc_path.size() << " arcs with max_speed=" << max_speed_kmh);
+    LOG_DEBUG("recalculateTotalTravelTime: processing " << result.arc_path.size() << " arcs with max_speed=" << max_speed_kmh);
     
     // Add walking segment times first (these are not affected by maxSpeed)
     unsigned start_walking_time_ms = 0;
@@ -1251,109 +1615,120 @@ unsigned RoutingEngine::recalculateTotalTravelTime(const RoutingResult& result,
     if (result.start_walking_distance > 0.0) {
         start_walking_time_ms = static_cast<unsigned>(result.start_walking_distance * 1000.0 / 1.67); // 6 km/h walking speed
         total_time_ms += start_walking_time_ms;
-        LOG("Adding start walking time: " << start_walking_time_ms << "ms");
+        LOG_DEBUG("Adding start walking time: " << start_walking_time_ms << "ms");
     }
     
     if (result.end_walking_distance > 0.0) {
         end_walking_time_ms = static_cast<unsigned>(result.end_walking_distance * 1000.0 / 1.67); // 6 km/h walking speed
         total_time_ms += end_walking_time_ms;
-        LOG("Adding end walking time: " << end_walking_time_ms << "ms");
+        LOG_DEBUG("Adding end walking time: " << end_walking_time_ms << "ms");
     }
     
     // Add road segment times with maxSpeed applied
-    for (size_t i = 0; i < result.arc_path.size(); ++i) {
-        const auto arc_id = result.arc_path[i];
-        unsigned way_id = graph_.way[arc_id];
-        unsigned original_speed_kmh = way_speed_[way_id];
-        unsigned distance_m = graph_.geo_distance[arc_id];
-        
-        // Apply maximum speed limit
-        unsigned effective_speed_kmh = std::min(original_speed_kmh, max_speed_kmh);
-        
-        // Calculate travel time for this arc with effective speed
-        if (effective_speed_kmh > 0) {
-            unsigned arc_time_ms = (distance_m * 3600ULL * 1000ULL) / (effective_speed_kmh * 1000ULL);
-            total_time_ms += arc_time_ms;
-            if (i < 3) { // Log first few arcs for debugging
-                LOG("Arc " << i << ": distance=" << distance_m << "m, original_speed=" << original_speed_kmh << ", effective_speed=" << effective_speed_kmh << ", time=" << arc_time_ms << "ms");
-            }
-        } else {
-            if (i < 3) {
-                LOG("Arc " << i << ": distance=" << distance_m << "m, speed=0, skipping");
-            }
-        }
-    }
+    total_time_ms += ArcCostKernels::pathTotal(result.arc_path.data(), result.arc_path.size(), graph_.geo_distance.data(),
+                                               arc_speed_.data(), max_speed_kmh);
     
-    LOG("recalculateTotalTravelTime: total=" << total_time_ms << "ms (including walking: start=" << start_walking_time_ms << "ms, end=" << end_walking_time_ms << "ms)");
+    LOG_DEBUG("recalculateTotalTravelTime: total=" << total_time_ms << "ms (including walking: start=" << start_walking_time_ms << "ms, end=" << end_walking_time_ms << "ms)");
     return total_time_ms;
 }
 
 std::optional<RoutingEngine::AddressBbox> RoutingEngine::getAddressBbox() const {
     // Check if we have addresses loaded
     if (addresses_.empty()) {
-        LOG("No addresses loaded for bbox calculation");
+        LOG_WARN("No addresses loaded for bbox calculation");
         return std::nullopt;
     }
     
     AddressBbox bbox;
-    bbox.min_lat = addresses_[0].latitude;
-    bbox.max_lat = addresses_[0].latitude;
-    bbox.min_lon = addresses_[0].longitude;
-    bbox.max_lon = addresses_[0].longitude;
+    bbox.min_lat = addresses_.latitude(0);
+    bbox.max_lat = addresses_.latitude(0);
+    bbox.min_lon = addresses_.longitude(0);
+    bbox.max_lon = addresses_.longitude(0);
     
     // Find min/max coordinates
-    for (const auto& addr : addresses_) {
-        bbox.min_lat = std::min(bbox.min_lat, addr.latitude);
-        bbox.max_lat = std::max(bbox.max_lat, addr.latitude);
-        bbox.min_lon = std::min(bbox.min_lon, addr.longitude);
-        bbox.max_lon = std::max(bbox.max_lon, addr.longitude);
+    for (size_t i = 1; i < addresses_.size(); ++i) {
+        bbox.min_lat = std::min(bbox.min_lat, addresses_.latitude(i));
+        bbox.max_lat = std::max(bbox.max_lat, addresses_.latitude(i));
+        bbox.min_lon = std::min(bbox.min_lon, addresses_.longitude(i));
+        bbox.max_lon = std::max(bbox.max_lon, addresses_.longitude(i));
     }
     
-    LOG("Address bbox: lat[" << bbox.min_lat << ", " << bbox.max_lat << "], lon[" << bbox.min_lon << ", " << bbox.max_lon << "]");
+    LOG_DEBUG("Address bbox: lat[" << bbox.min_lat << ", " << bbox.max_lat << "], lon[" << bbox.min_lon << ", " << bbox.max_lon << "]");
     return bbox;
 }
 
+std::shared_ptr<const std::vector<unsigned>> RoutingEngine::sampleAddressIds(unsigned number, unsigned seed) const {
+    {
+        std::lock_guard<std::mutex> lock(sample_cache_mutex_);
+        for (auto it = sample_cache_.begin(); it != sample_cache_.end(); ++it) {
+            if (it->number == number && it->seed == seed) {
+                // Move to the front so the oldest entry is evicted first
+                sample_cache_.splice(sample_cache_.begin(), sample_cache_, it);
+                return sample_cache_.front().ids;
+            }
+        }
+    }
+    
+    // Robert Floyd's algorithm: a uniform k-subset of [0, n) in O(k) time and memory
+    unsigned n = static_cast<unsigned>(addresses_.size());
+    std::mt19937 gen(seed);
+    std::unordered_set<unsigned> selected;
+    selected.reserve(number);
+    for (unsigned j = n - number; j < n; ++j) {
+        unsigned t = std::uniform_int_distribution<unsigned>(0, j)(gen);
+        if (!selected.insert(t).second) {
+            selected.insert(j);
+        }
+    }
+    
+    // Sort the ids to make pagination consistent
+    auto ids = std::make_shared<std::vector<unsigned>>(selected.begin(), selected.end());
+    std::sort(ids->begin(), ids->end());
+    
+    std::lock_guard<std::mutex> lock(sample_cache_mutex_);
+    sample_cache_.push_front({number, seed, ids});
+    sample_cache_ids_ += ids->size();
+    while (sample_cache_.size() > 1 && (sample_cache_.size() > SAMPLE_CACHE_ENTRIES || sample_cache_ids_ > SAMPLE_CACHE_MAX_IDS)) {
+        sample_cache_ids_ -= sample_cache_.back().ids->size();
+        sample_cache_.pop_back();
+    }
+    return ids;
+}
+
 std::vector<Address> RoutingEngine::getAddressSample(unsigned number, unsigned seed, 
                                                      unsigned page_size, unsigned page_num) const {
     std::vector<Address> result;
     
     // Check if we have addresses loaded
     if (addresses_.empty()) {
-        LOG("No addresses loaded for sampling");
+        LOG_WARN("No addresses loaded for sampling");
         return result;
     }
     
-    // Initialize random generator with seed
-    std::mt19937 gen(seed);
-    
     // Calculate the actual sample size we need
-    unsigned start_index = page_num * page_size;
-    unsigned end_index = std::min(start_index + page_size, number);
+    uint64_t sample_size = std::min<uint64_t>(number, addresses_.size());
+    uint64_t start_index = static_cast<uint64_t>(page_num) * page_size;
+    uint64_t end_index = std::min<uint64_t>(start_index + page_size, sample_size);
     
-    if (start_index >= number) {
-        LOG("Page out of range: start_index=" << start_index << ", number=" << number);
+    if (start_index >= sample_size) {
+        LOG_WARN("Page out of range: start_index=" << start_index << ", number=" << number);
         return result;
     }
     
-    // Generate a shuffled list of indices for reproducible random sampling
-    std::vector<unsigned> indices(addresses_.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    std::shuffle(indices.begin(), indices.end(), gen);
-    
-    // Take only the number of indices we need
-    if (number < indices.size()) {
-        indices.resize(number);
-    }
-    
-    // Sort the indices to make pagination consistent
-    std::sort(indices.begin(), indices.end());
-    
-    // Extract the page we want
-    for (unsigned i = start_index; i < end_index && i < indices.size(); ++i) {
-        result.push_back(addresses_[indices[i]]);
+    result.reserve(end_index - start_index);
+    if (sample_size == addresses_.size()) {
+        // The sample is every address, in id order
+        for (uint64_t i = start_index; i < end_index; ++i) {
+            result.push_back(addresses_.get(i));
+        }
+    } else {
+        auto ids = sampleAddressIds(static_cast<unsigned>(sample_size), seed);
+        for (uint64_t i = start_index; i < end_index; ++i) {
+            result.push_back(addresses_.get((*ids)[i]));
+        }
     }
     
-    LOG("Address sample: requested=" << number << ", seed=" << seed << ", page_size=" << page_size 
+    LOG_DEBUG("Address sample: requested=" << number << ", seed=" << seed << ", page_size=" << page_size 
         << ", page_num=" << page_num << ", returned=" << result.size());
     
     return result;
@@ -1362,11 +1737,34 @@ std::vector<Address> RoutingEngine::getAddressSample(unsigned number, unsigned s
 std::optional<Address> RoutingEngine::getUniformRandomAddressInAnnulus(double center_lat, double center_lon, 
                                                                          float min_distance_km, float max_distance_km,
                                                                          unsigned seed) const {
-    // Check if we have addresses loaded
-    if (addresses_.empty() || !addr_index_) {
-        LOG("No addresses loaded for uniform annulus sampling");
+    auto addresses = getUniformRandomAddressesInAnnulus(center_lat, center_lon, min_distance_km, max_distance_km, seed, 1);
+    if (addresses.empty()) {
         return std::nullopt;
     }
+    return addresses.front();
+}
+
+std::vector<Address> RoutingEngine::getUniformRandomAddressesInAnnulus(double center_lat, double center_lon,
+                                                                      float min_distance_km, float max_distance_km,
+                                                                      unsigned seed, unsigned count,
+                                                                      const std::string& category) const {
+    std::vector<Address> result;
+    
+    // Check if we have addresses loaded
+    if (addresses_.empty() || !address_grid_) {
+        LOG_WARN("No addresses loaded for uniform annulus sampling");
+        return result;
+    }
+    
+    const SamplingGrid* grid = address_grid_.get();
+    if (!category.empty()) {
+        auto it = category_grids_.find(category);
+        if (it == category_grids_.end()) {
+            LOG_WARN("Unknown place category for annulus sampling: " << category);
+            return result;
+        }
+        grid = it->second.get();
+    }
     
     // Convert distances from kilometers to meters
     float min_distance_m = min_distance_km * 1000.0f;
@@ -1374,40 +1772,28 @@ std::optional<Address> RoutingEngine::getUniformRandomAddressInAnnulus(double ce
     
     // Validate inputs
     if (min_distance_m < 0.0f || max_distance_m <= min_distance_m) {
-        LOG("Invalid distance parameters: min_distance=" << min_distance_m << "m, max_distance=" << max_distance_m << "m");
-        return std::nullopt;
-    }
-    
-    // Find all addresses within max_distance
-    auto candidates = addr_index_->find_all_nodes_within_radius(
-        static_cast<float>(center_lat), 
-        static_cast<float>(center_lon), 
-        max_distance_m
-    );
-    
-    // Filter to only those >= min_distance
-    std::vector<unsigned> valid_indices;
-    for (const auto& candidate : candidates) {
-        if (candidate.distance >= min_distance_m && candidate.id < addresses_.size()) {
-            valid_indices.push_back(candidate.id);
-        }
+        LOG_WARN("Invalid distance parameters: min_distance=" << min_distance_m << "m, max_distance=" << max_distance_m << "m");
+        return result;
     }
     
-    if (valid_indices.empty()) {
-        LOG("No addresses found in annulus: center=(" << center_lat << "," << center_lon 
+    SamplingGrid::Ring ring = grid->ring(center_lat, center_lon, min_distance_m, max_distance_m);
+    if (ring.size() == 0) {
+        LOG_DEBUG("No addresses found in annulus: center=(" << center_lat << "," << center_lon 
             << "), min_dist=" << min_distance_km << "km, max_dist=" << max_distance_km << "km");
-        return std::nullopt;
+        return result;
     }
     
-    // Uniformly sample one address using the seed
+    // Independent uniform draws from the same seeded generator
     std::mt19937 gen(seed);
-    std::uniform_int_distribution<size_t> dist(0, valid_indices.size() - 1);
-    size_t selected_index = dist(gen);
+    result.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        result.push_back(addresses_.get(ring.draw(gen)));
+    }
     
-    LOG("Uniform annulus sampling: found " << valid_indices.size() << " candidates, selected index " 
-        << selected_index << " (address id " << valid_indices[selected_index] << ")");
+    LOG_DEBUG("Uniform annulus sampling: " << ring.size() << " candidates, drew " << count
+        << (category.empty() ? "" : " in category " + category));
     
-    return addresses_[valid_indices[selected_index]];
+    return result;
 }
 
 } // namespace RoutingServer 
\ No newline at end of file
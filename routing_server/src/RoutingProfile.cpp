@@ -0,0 +1,283 @@
+#include "../include/RoutingProfile.h"
+#include "../include/MemoryStats.h"
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+namespace RoutingServer {
+
+// Custom profile implementation - allows access to all road types
+bool is_osm_way_used_by_custom_profile(uint64_t osm_way_id, const RoutingKit::TagMap& tags, 
+                                       std::function<void(const std::string&)> log_message) {
+    // Log highway types for analysis (static set to avoid duplicates)
+    static std::set<std::string> highway_types_seen;
+    static std::set<std::string> other_tags_seen;
+    
+    const char* highway_value = tags["highway"];
+    if (highway_value != nullptr) {
+        std::string highway_str(highway_value);
+        if (highway_types_seen.insert(highway_str).second) {
+            if (log_message) {
+                log_message("Found highway type: " + highway_str);
+            }
+        }
+    }
+    
+    // Also log other relevant tags
+    const char* railway_value = tags["railway"];
+    if (railway_value != nullptr) {
+        std::string tag_str = "railway=" + std::string(railway_value);
+        if (other_tags_seen.insert(tag_str).second) {
+            if (log_message) {
+                log_message("Found tag: " + tag_str);
+            }
+        }
+    }
+    
+    const char* public_transport_value = tags["public_transport"];
+    if (public_transport_value != nullptr) {
+        std::string tag_str = "public_transport=" + std::string(public_transport_value);
+        if (other_tags_seen.insert(tag_str).second) {
+            if (log_message) {
+                log_message("Found tag: " + tag_str);
+            }
+        }
+    }
+
+    // Include all roads that cars, bicycles, or pedestrians can use
+    if (RoutingKit::is_osm_way_used_by_cars(osm_way_id, tags, log_message)) {
+        return true;
+    }
+    
+    if (RoutingKit::is_osm_way_used_by_bicycles(osm_way_id, tags, log_message)) {
+        return true;
+    }
+    
+    if (RoutingKit::is_osm_way_used_by_pedestrians(osm_way_id, tags, log_message)) {
+        return true;
+    }
+    
+    // Include ALL possible highway types from OSM documentation
+    if (highway_value != nullptr) {
+        std::string highway_str(highway_value);
+        
+        // Main road types
+        if (highway_str == "motorway" || highway_str == "trunk" || highway_str == "primary" ||
+            highway_str == "secondary" || highway_str == "tertiary" || highway_str == "unclassified" ||
+            highway_str == "residential") {
+            return true;
+        }
+        
+        // Link roads
+        if (highway_str == "motorway_link" || highway_str == "trunk_link" || highway_str == "primary_link" ||
+            highway_str == "secondary_link" || highway_str == "tertiary_link") {
+            return true;
+        }
+        
+        // Special road types
+        if (highway_str == "living_street" || highway_str == "service" || highway_str == "pedestrian" ||
+            highway_str == "track" || highway_str == "bus_guideway" || highway_str == "busway" ||
+            highway_str == "raceway" || highway_str == "road" || highway_str == "construction" ||
+            highway_str == "escape") {
+            return true;
+        }
+        
+        // Paths
+        if (highway_str == "path" || highway_str == "footway" || highway_str == "cycleway" ||
+            highway_str == "bridleway" || highway_str == "steps" || highway_str == "corridor") {
+            return true;
+        }
+        
+        // Other highway features mentioned in documentation
+        if (highway_str == "bus_stop" || highway_str == "crossing" || highway_str == "emergency_access_point" ||
+            highway_str == "give_way" || highway_str == "mini_roundabout" || highway_str == "motorway_junction" ||
+            highway_str == "passing_place" || highway_str == "platform" || highway_str == "rest_area" ||
+            highway_str == "services" || highway_str == "speed_camera" || highway_str == "stop" ||
+            highway_str == "street_lamp" || highway_str == "traffic_signals" || highway_str == "turning_circle" ||
+            highway_str == "turning_loop") {
+            return true;
+        }
+        
+        // Lifecycle states
+        if (highway_str == "proposed" || highway_str == "planned" || highway_str == "abandoned" ||
+            highway_str == "disused" || highway_str == "razed") {
+            return true;
+        }
+        
+        // Additional types that might exist
+        if (highway_str == "via_ferrata" || highway_str == "elevator" || highway_str == "escalator") {
+            return true;
+        }
+    }
+    
+    // Also include railway platforms and other transport infrastructure
+    const char* railway_value_check = tags["railway"];
+    if (railway_value_check != nullptr && strcmp(railway_value_check, "platform") == 0) {
+        return true;
+    }
+    
+    // Include public transport platforms
+    const char* public_transport_value_check = tags["public_transport"];
+    if (public_transport_value_check != nullptr && strcmp(public_transport_value_check, "platform") == 0) {
+        return true;
+    }
+    
+    return false;
+}
+
+unsigned get_custom_profile_speed(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
+                                  std::function<void(const std::string&)> log_message) {
+    // First try to get the standard speed from OSM maxspeed tags
+    unsigned standard_speed = RoutingKit::get_osm_way_speed(osm_way_id, tags, log_message);
+    
+    // For non-car infrastructure, apply conservative speed limits
+    const char* highway_value = tags["highway"];
+    if (highway_value != nullptr) {
+        std::string highway_str(highway_value);
+        
+        // Very slow infrastructure (walking pace)
+        if (highway_str == "steps" || highway_str == "via_ferrata" || highway_str == "elevator" ||
+            highway_str == "escalator") {
+            return 5u; // 5 km/h
+        }
+        
+        // Pedestrian and shared infrastructure (slow)
+        if (highway_str == "path" || highway_str == "footway" || highway_str == "cycleway" || 
+            highway_str == "pedestrian" || highway_str == "platform" || highway_str == "corridor") {
+            return std::min(standard_speed, 20u); // Max 20 km/h
+        }
+        
+        // Service roads and tracks (moderate)
+        if (highway_str == "service" || highway_str == "living_street" || highway_str == "track" ||
+            highway_str == "bridleway") {
+            return std::min(standard_speed, 30u); // Max 30 km/h
+        }
+        
+        // Construction and lifecycle states (conservative)
+        if (highway_str == "construction" || highway_str == "proposed" || highway_str == "planned") {
+            return std::min(standard_speed, 30u); // Max 30 km/h
+        }
+        
+        // Abandoned/disused (very slow)
+        if (highway_str == "abandoned" || highway_str == "disused" || highway_str == "razed") {
+            return 10u; // 10 km/h
+        }
+        
+        // Residential areas
+        if (highway_str == "residential" || highway_str == "unclassified") {
+            return std::min(standard_speed, 50u); // Max 50 km/h
+        }
+        
+        // Special purpose roads
+        if (highway_str == "bus_guideway" || highway_str == "busway") {
+            return std::min(standard_speed, 60u); // Max 60 km/h
+        }
+        
+        // Racing tracks (but still reasonable for routing)
+        if (highway_str == "raceway") {
+            return std::min(standard_speed, 80u); // Max 80 km/h
+        }
+        
+        // Emergency and escape roads
+        if (highway_str == "escape" || highway_str == "emergency_access_point") {
+            return std::min(standard_speed, 40u); // Max 40 km/h
+        }
+        
+        // Highway features (usually not routable, but just in case)
+        if (highway_str == "bus_stop" || highway_str == "crossing" || highway_str == "give_way" ||
+            highway_str == "mini_roundabout" || highway_str == "motorway_junction" || 
+            highway_str == "passing_place" || highway_str == "rest_area" || highway_str == "services" ||
+            highway_str == "speed_camera" || highway_str == "stop" || highway_str == "street_lamp" ||
+            highway_str == "traffic_signals" || highway_str == "turning_circle" || highway_str == "turning_loop") {
+            return 10u; // 10 km/h (these are usually point features anyway)
+        }
+        
+        // Unknown road type (for "road" and any others)
+        if (highway_str == "road") {
+            return std::min(standard_speed, 50u); // Max 50 km/h
+        }
+    }
+    
+    // Handle railway and public transport platforms
+    const char* railway_value = tags["railway"];
+    const char* public_transport_value = tags["public_transport"];
+    if ((railway_value != nullptr && strcmp(railway_value, "platform") == 0) ||
+        (public_transport_value != nullptr && strcmp(public_transport_value, "platform") == 0)) {
+        return 10u; // Very slow walking speed on platforms
+    }
+    
+    return standard_speed;
+}
+
+RoutingKit::OSMWayDirectionCategory get_custom_profile_direction_category(uint64_t osm_way_id, const RoutingKit::TagMap& tags,
+                                                                          std::function<void(const std::string&)> log_message) {
+    // For most pedestrian and cycling infrastructure, allow bidirectional access unless explicitly restricted
+    const char* highway_value = tags["highway"];
+    if (highway_value != nullptr && (
+        strcmp(highway_value, "path") == 0 ||
+        strcmp(highway_value, "footway") == 0 ||
+        strcmp(highway_value, "cycleway") == 0 ||
+        strcmp(highway_value, "pedestrian") == 0 ||
+        strcmp(highway_value, "bridleway") == 0)) {
+        
+        // Check for explicit oneway restrictions
+        const char* oneway_value = tags["oneway"];
+        if (oneway_value != nullptr) {
+            if (strcmp(oneway_value, "yes") == 0 || strcmp(oneway_value, "true") == 0 || strcmp(oneway_value, "1") == 0) {
+                return RoutingKit::OSMWayDirectionCategory::only_open_forwards;
+            } else if (strcmp(oneway_value, "-1") == 0 || strcmp(oneway_value, "reverse") == 0) {
+                return RoutingKit::OSMWayDirectionCategory::only_open_backwards;
+            }
+        }
+        
+        // Default to bidirectional for pedestrian/cycling infrastructure
+        return RoutingKit::OSMWayDirectionCategory::open_in_both;
+    }
+    
+    // For car roads and other infrastructure, use the standard car direction logic
+    return RoutingKit::get_osm_car_direction_category(osm_way_id, tags, log_message);
+}
+
+ProfileGraph loadProfileGraphFromPbf(const std::string& osm_file,
+                                     const std::function<void(const std::string&)>& log_message) {
+    // Load the ID mapping with our custom profile
+    auto mapping = RoutingKit::load_osm_id_mapping_from_pbf(
+        osm_file,
+        nullptr, // No special routing nodes
+        [](uint64_t osm_way_id, const RoutingKit::TagMap& tags) {
+            return is_osm_way_used_by_custom_profile(osm_way_id, tags);
+        },
+        log_message
+    );
+    
+    MemoryStats mem_after_mapping = MemoryStats::get_current();
+    log_message("ID mapping loaded, " + std::to_string(mapping.is_routing_way.population_count()) + " routing ways found");
+    log_message("Memory after ID mapping: RSS=" + mem_after_mapping.format() + ", Peak=" + mem_after_mapping.format_peak());
+    
+    // Prepare speed storage
+    ProfileGraph result;
+    unsigned routing_way_count = mapping.is_routing_way.population_count();
+    result.way_speed.resize(routing_way_count);
+    
+    // Load the routing graph with custom callbacks
+    result.graph = RoutingKit::load_osm_routing_graph_from_pbf(
+        osm_file,
+        mapping,
+        [&result](uint64_t osm_way_id, unsigned routing_way_id, const RoutingKit::TagMap& way_tags) {
+            // Store the speed for this way
+            result.way_speed[routing_way_id] = get_custom_profile_speed(osm_way_id, way_tags);
+            return get_custom_profile_direction_category(osm_way_id, way_tags);
+        },
+        nullptr, // No turn restrictions for now
+        log_message
+    );
+    
+    log_message("Routing graph loaded with " + std::to_string(result.graph.node_count()) + " nodes and " +
+                std::to_string(result.graph.arc_count()) + " arcs");
+    
+    MemoryStats mem_after_graph = MemoryStats::get_current();
+    log_message("Memory after graph loading: RSS=" + mem_after_graph.format() + ", Peak=" + mem_after_graph.format_peak());
+    return result;
+}
+
+} // namespace RoutingServer
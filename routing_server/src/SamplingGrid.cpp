@@ -0,0 +1,234 @@
+#include "../include/SamplingGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace RoutingServer {
+
+namespace {
+
+constexpr double EARTH_RADIUS_M = 6371000.0;
+constexpr double METERS_PER_DEGREE = EARTH_RADIUS_M * M_PI / 180.0;
+
+double haversineDistance(double lat1, double lon1, double lat2, double lon2) {
+    constexpr double to_radians = M_PI / 180.0;
+    double d_lat = (lat2 - lat1) * to_radians;
+    double d_lon = (lon2 - lon1) * to_radians;
+    double a = std::sin(d_lat / 2) * std::sin(d_lat / 2) +
+               std::cos(lat1 * to_radians) * std::cos(lat2 * to_radians) * std::sin(d_lon / 2) * std::sin(d_lon / 2);
+    return EARTH_RADIUS_M * 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+}
+
+} // namespace
+
+SamplingGrid::SamplingGrid(const AddressStore& addresses, std::vector<unsigned> ids) : addresses_(addresses) {
+    build(std::move(ids));
+}
+
+SamplingGrid::SamplingGrid(const AddressStore& addresses) : addresses_(addresses) {
+    std::vector<unsigned> ids(addresses.size());
+    std::iota(ids.begin(), ids.end(), 0u);
+    build(std::move(ids));
+}
+
+void SamplingGrid::build(std::vector<unsigned> ids) {
+    if (ids.empty()) {
+        cell_start_.assign(1, 0);
+        return;
+    }
+
+    double max_lat = addresses_.latitude(ids[0]);
+    double max_lon = addresses_.longitude(ids[0]);
+    min_lat_ = max_lat;
+    min_lon_ = max_lon;
+    for (unsigned id : ids) {
+        min_lat_ = std::min(min_lat_, addresses_.latitude(id));
+        max_lat = std::max(max_lat, addresses_.latitude(id));
+        min_lon_ = std::min(min_lon_, addresses_.longitude(id));
+        max_lon = std::max(max_lon, addresses_.longitude(id));
+    }
+
+    // Roughly square cells in meters, sized for TARGET_POINTS_PER_CELL on average
+    double lon_scale = std::max(0.01, std::cos((min_lat_ + max_lat) / 2 * M_PI / 180.0));
+    double lat_span = std::max(max_lat - min_lat_, 1e-6);
+    double lon_span = std::max(max_lon - min_lon_, 1e-6);
+    double target_cells = std::max(1.0, ids.size() / TARGET_POINTS_PER_CELL);
+    cell_lat_ = std::max(std::sqrt(lat_span * lon_span * lon_scale / target_cells), 1e-6);
+    while (true) {
+        cell_lon_ = cell_lat_ / lon_scale;
+        double rows = std::floor(lat_span / cell_lat_) + 1;
+        double cols = std::floor(lon_span / cell_lon_) + 1;
+        // Points spread along a line would otherwise get a huge, mostly empty grid
+        if (rows * cols <= 4 * target_cells + 16) {
+            rows_ = static_cast<uint32_t>(rows);
+            cols_ = static_cast<uint32_t>(cols);
+            break;
+        }
+        cell_lat_ *= 2;
+    }
+
+    auto cell_of = [this](unsigned id) {
+        uint32_t row = std::min(rows_ - 1, static_cast<uint32_t>((addresses_.latitude(id) - min_lat_) / cell_lat_));
+        uint32_t col = std::min(cols_ - 1, static_cast<uint32_t>((addresses_.longitude(id) - min_lon_) / cell_lon_));
+        return row * cols_ + col;
+    };
+
+    // Counting sort of the ids by cell
+    cell_start_.assign(static_cast<size_t>(rows_) * cols_ + 1, 0);
+    for (unsigned id : ids) {
+        ++cell_start_[cell_of(id) + 1];
+    }
+    std::partial_sum(cell_start_.begin(), cell_start_.end(), cell_start_.begin());
+    std::vector<uint32_t> next(cell_start_.begin(), cell_start_.end() - 1);
+    ids_.resize(ids.size());
+    for (unsigned id : ids) {
+        ids_[next[cell_of(id)]++] = id;
+    }
+}
+
+SamplingGrid::Ring SamplingGrid::ring(double center_lat, double center_lon, double min_distance_m,
+                                      double max_distance_m) const {
+    Ring result;
+    result.grid_ = this;
+    if (ids_.empty() || max_distance_m < min_distance_m) {
+        return result;
+    }
+
+    // Bounding box of the outer circle, as a range of cells
+    double d_lat = max_distance_m / METERS_PER_DEGREE;
+    double cos_lat = std::cos(center_lat * M_PI / 180.0);
+    bool covers_pole = std::fabs(center_lat) + d_lat >= 90.0 || cos_lat < 1e-6;
+    double d_lon = covers_pole ? 360.0 : d_lat / cos_lat;
+    auto clamp_index = [](double value, uint32_t count) {
+        return static_cast<uint32_t>(std::clamp(std::floor(value), 0.0, static_cast<double>(count - 1)));
+    };
+    if (center_lat + d_lat < min_lat_ || center_lat - d_lat > min_lat_ + rows_ * cell_lat_ ||
+        center_lon + d_lon < min_lon_ || center_lon - d_lon > min_lon_ + cols_ * cell_lon_) {
+        return result;
+    }
+    uint32_t row_begin = clamp_index((center_lat - d_lat - min_lat_) / cell_lat_, rows_);
+    uint32_t row_end = clamp_index((center_lat + d_lat - min_lat_) / cell_lat_, rows_);
+    uint32_t col_begin = clamp_index((center_lon - d_lon - min_lon_) / cell_lon_, cols_);
+    uint32_t col_end = clamp_index((center_lon + d_lon - min_lon_) / cell_lon_, cols_);
+
+    // The nearest point of a cell (clamped center) and its farthest corner are close
+    // approximations on cells this small, so cells within a margin of either circle are treated
+    // as boundary cells and tested point by point
+    const double margin = 1.0 + max_distance_m * 1e-4;
+    // Within a row, both distances grow with the longitude difference to the center as long as
+    // it stays below 180 degrees, so the cells inside the ring and the cells it reaches form
+    // runs that can be found by bisection instead of visiting every cell of the bounding box
+    const bool monotone = cols_ * cell_lon_ <= 180.0;
+
+    auto add_inside = [&](uint32_t begin, uint32_t end) {
+        if (begin < end) {
+            result.inside_count_ += end - begin;
+            result.inside_begins_.push_back(begin);
+            result.inside_ends_.push_back(result.inside_count_);
+        }
+    };
+    auto scan_cell = [&](uint32_t cell) {
+        for (uint32_t i = cell_start_[cell]; i < cell_start_[cell + 1]; ++i) {
+            unsigned id = ids_[i];
+            double distance = haversineDistance(center_lat, center_lon, addresses_.latitude(id),
+                                                addresses_.longitude(id));
+            if (distance >= min_distance_m && distance <= max_distance_m) {
+                result.boundary_ids_.push_back(id);
+            }
+        }
+    };
+
+    // Column holding the center, clamped to one past either end of the box
+    double center_col = std::floor((center_lon - min_lon_) / cell_lon_);
+    uint32_t split = static_cast<uint32_t>(std::clamp(center_col, static_cast<double>(col_begin),
+                                                      static_cast<double>(col_end) + 1.0));
+
+    for (uint32_t row = row_begin; row <= row_end; ++row) {
+        double lat0 = min_lat_ + row * cell_lat_;
+        double lat1 = lat0 + cell_lat_;
+        double nearest_lat = std::clamp(center_lat, lat0, lat1);
+        uint32_t row_cell = row * cols_;
+        auto nearest = [&](uint32_t col) {
+            double lon0 = min_lon_ + col * cell_lon_;
+            return haversineDistance(center_lat, center_lon, nearest_lat, std::clamp(center_lon, lon0, lon0 + cell_lon_));
+        };
+        auto farthest = [&](uint32_t col) {
+            double lon0 = min_lon_ + col * cell_lon_;
+            double lon1 = lon0 + cell_lon_;
+            return std::max({haversineDistance(center_lat, center_lon, lat0, lon0),
+                             haversineDistance(center_lat, center_lon, lat0, lon1),
+                             haversineDistance(center_lat, center_lon, lat1, lon0),
+                             haversineDistance(center_lat, center_lon, lat1, lon1)});
+        };
+
+        if (!monotone) {
+            for (uint32_t col = col_begin; col <= col_end; ++col) {
+                double near = nearest(col);
+                double far = farthest(col);
+                if (near > max_distance_m + margin || far < min_distance_m - margin) {
+                    continue;
+                }
+                if (near >= min_distance_m + margin && far <= max_distance_m - margin) {
+                    add_inside(cell_start_[row_cell + col], cell_start_[row_cell + col + 1]);
+                } else {
+                    scan_cell(row_cell + col);
+                }
+            }
+            continue;
+        }
+
+        // Columns at offsets [0, count) from the center, walking away from it on one side
+        auto walk = [&](uint32_t count, auto column) {
+            // First offset at which a predicate, false near the center and true further out, holds
+            auto first = [&](auto predicate) {
+                uint32_t low = 0;
+                uint32_t high = count;
+                while (low < high) {
+                    uint32_t mid = low + (high - low) / 2;
+                    if (predicate(column(mid))) {
+                        high = mid;
+                    } else {
+                        low = mid + 1;
+                    }
+                }
+                return low;
+            };
+            // Cells before reach are inside the inner circle, cells from stop on beyond the outer one
+            uint32_t reach = first([&](uint32_t col) { return farthest(col) >= min_distance_m - margin; });
+            uint32_t stop = std::max(reach, first([&](uint32_t col) { return nearest(col) > max_distance_m + margin; }));
+            uint32_t inside_begin = std::min(stop, std::max(reach, first([&](uint32_t col) {
+                return nearest(col) >= min_distance_m + margin;
+            })));
+            uint32_t inside_end = std::max(inside_begin, std::min(stop, first([&](uint32_t col) {
+                return farthest(col) > max_distance_m - margin;
+            })));
+            for (uint32_t offset = reach; offset < inside_begin; ++offset) {
+                scan_cell(row_cell + column(offset));
+            }
+            if (inside_begin < inside_end) {
+                // Consecutive columns of a row are consecutive in ids_
+                uint32_t low = std::min(column(inside_begin), column(inside_end - 1));
+                uint32_t high = std::max(column(inside_begin), column(inside_end - 1));
+                add_inside(cell_start_[row_cell + low], cell_start_[row_cell + high + 1]);
+            }
+            for (uint32_t offset = inside_end; offset < stop; ++offset) {
+                scan_cell(row_cell + column(offset));
+            }
+        };
+        walk(col_end + 1 - split, [split](uint32_t offset) { return split + offset; });
+        walk(split - col_begin, [split](uint32_t offset) { return split - 1 - offset; });
+    }
+    return result;
+}
+
+unsigned SamplingGrid::Ring::draw(std::mt19937& gen) const {
+    uint64_t index = std::uniform_int_distribution<uint64_t>(0, size() - 1)(gen);
+    if (index >= inside_count_) {
+        return boundary_ids_[index - inside_count_];
+    }
+    size_t position = std::upper_bound(inside_ends_.begin(), inside_ends_.end(), index) - inside_ends_.begin();
+    uint64_t cell_first = position == 0 ? 0 : inside_ends_[position - 1];
+    return grid_->ids_[inside_begins_[position] + (index - cell_first)];
+}
+
+} // namespace RoutingServer
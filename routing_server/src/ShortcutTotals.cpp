@@ -0,0 +1,122 @@
+#include "../include/ShortcutTotals.h"
+#include <routingkit/constants.h>
+#include <algorithm>
+#include <functional>
+
+namespace RoutingServer {
+
+ShortcutTotals::ShortcutTotals(const RoutingKit::ContractionHierarchy& ch, const std::vector<unsigned>& arc_values)
+    : forward_(ch.forward.head.size()), backward_(ch.backward.head.size()) {
+    // Both halves of a shortcut are stored at its middle node, which ranks below the node the
+    // shortcut is stored at, so one sweep in rank order sees the halves first. As in RoutingKit's
+    // unpacking, the first half is always a backward arc and the second a forward arc, on both sides.
+    const unsigned node_count = ch.node_count();
+    for (unsigned rank = 0; rank < node_count; ++rank) {
+        for (unsigned arc = ch.forward.first_out[rank]; arc < ch.forward.first_out[rank + 1]; ++arc) {
+            forward_[arc] = ch.forward.is_shortcut_an_original_arc.is_set(arc)
+                ? arc_values[ch.forward.shortcut_first_arc[arc]]
+                : backward_[ch.forward.shortcut_first_arc[arc]] + forward_[ch.forward.shortcut_second_arc[arc]];
+        }
+        for (unsigned arc = ch.backward.first_out[rank]; arc < ch.backward.first_out[rank + 1]; ++arc) {
+            backward_[arc] = ch.backward.is_shortcut_an_original_arc.is_set(arc)
+                ? arc_values[ch.backward.shortcut_first_arc[arc]]
+                : backward_[ch.backward.shortcut_first_arc[arc]] + forward_[ch.backward.shortcut_second_arc[arc]];
+        }
+    }
+}
+
+void ShortcutTotalsQuery::Search::reach(unsigned rank, unsigned new_distance, unsigned new_total) {
+    if (distance[rank] == RoutingKit::inf_weight) {
+        reached.push_back(rank);
+    }
+    distance[rank] = new_distance;
+    total[rank] = new_total;
+    heap.emplace_back(new_distance, rank);
+    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+}
+
+void ShortcutTotalsQuery::Search::clear() {
+    for (unsigned rank : reached) {
+        distance[rank] = RoutingKit::inf_weight;
+    }
+    reached.clear();
+    heap.clear();
+}
+
+void ShortcutTotalsQuery::step(Search& search, const Search& other, const RoutingKit::ContractionHierarchy::Side& up,
+                               const RoutingKit::ContractionHierarchy::Side& down, bool forward_side,
+                               const ShortcutTotals& totals, Result& best) {
+    std::pop_heap(search.heap.begin(), search.heap.end(), std::greater<>());
+    auto [distance, rank] = search.heap.back();
+    search.heap.pop_back();
+    if (distance != search.distance[rank]) {
+        return; // Superseded by a shorter entry
+    }
+
+    if (other.distance[rank] != RoutingKit::inf_weight && distance + other.distance[rank] < best.distance) {
+        best.distance = distance + other.distance[rank];
+        best.total = search.total[rank] + other.total[rank];
+    }
+
+    // Stall-on-demand: a higher node reaching this one more cheaply means no shortest path
+    // continues upward from here
+    for (unsigned arc = down.first_out[rank]; arc < down.first_out[rank + 1]; ++arc) {
+        unsigned higher = down.head[arc];
+        if (search.distance[higher] != RoutingKit::inf_weight && search.distance[higher] + down.weight[arc] < distance) {
+            return;
+        }
+    }
+
+    const unsigned total = search.total[rank];
+    for (unsigned arc = up.first_out[rank]; arc < up.first_out[rank + 1]; ++arc) {
+        unsigned head = up.head[arc];
+        unsigned new_distance = distance + up.weight[arc];
+        if (new_distance < search.distance[head]) {
+            search.reach(head, new_distance, total + (forward_side ? totals.forward(arc) : totals.backward(arc)));
+        }
+    }
+}
+
+ShortcutTotalsQuery::Result ShortcutTotalsQuery::run(const RoutingKit::ContractionHierarchy& ch, const ShortcutTotals& totals,
+                                                     unsigned source, unsigned target) {
+    const unsigned node_count = ch.node_count();
+    for (Search* search : {&forward_, &backward_}) {
+        if (search->distance.size() != node_count) {
+            search->distance.assign(node_count, RoutingKit::inf_weight);
+            search->total.assign(node_count, 0);
+            search->reached.clear();
+            search->heap.clear();
+        }
+    }
+
+    Result best{RoutingKit::inf_weight, 0};
+    forward_.reach(ch.rank[source], 0, 0);
+    backward_.reach(ch.rank[target], 0, 0);
+
+    // Alternate directions; a direction stops once its closest node is no closer than the best meeting
+    bool forward_turn = true;
+    while (true) {
+        bool forward_open = !forward_.heap.empty() && forward_.heap.front().first < best.distance;
+        bool backward_open = !backward_.heap.empty() && backward_.heap.front().first < best.distance;
+        if (!forward_open && !backward_open) {
+            break;
+        }
+        if (forward_open && (forward_turn || !backward_open)) {
+            step(forward_, backward_, ch.forward, ch.backward, true, totals, best);
+        } else {
+            step(backward_, forward_, ch.backward, ch.forward, false, totals, best);
+        }
+        forward_turn = !forward_turn;
+    }
+
+    forward_.clear();
+    backward_.clear();
+    return best;
+}
+
+size_t ShortcutTotalsQuery::memoryBytes() const {
+    return (forward_.distance.capacity() + forward_.total.capacity() +
+            backward_.distance.capacity() + backward_.total.capacity()) * sizeof(unsigned);
+}
+
+} // namespace RoutingServer
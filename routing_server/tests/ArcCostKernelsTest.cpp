@@ -0,0 +1,128 @@
+#include "../include/ArcCostKernels.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace RoutingServer;
+
+namespace {
+
+// Integer reference of computeWeights, one arc at a time
+uint32_t referenceWeight(uint32_t distance_m, uint16_t speed_kmh, unsigned cap_kmh, unsigned max_time_ms) {
+    unsigned speed = std::min<unsigned>(speed_kmh, std::min(cap_kmh, ArcCostKernels::NO_SPEED_CAP));
+    if (speed == 0) {
+        return max_time_ms;
+    }
+    uint64_t time = static_cast<uint64_t>(distance_m) * 3600 / speed;
+    return static_cast<uint32_t>(std::min<uint64_t>(time, max_time_ms));
+}
+
+// Arcs with the extremes the vector path has to get right: no speed, speeds above any cap,
+// and distances using all 32 bits
+struct TestArcs {
+    std::vector<uint32_t> distance;
+    std::vector<uint16_t> speed;
+};
+
+TestArcs makeArcs(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> short_distance(0, 5000);
+    std::uniform_int_distribution<uint32_t> any_distance(0, UINT32_MAX);
+    std::uniform_int_distribution<unsigned> speed(0, 140);
+    std::uniform_int_distribution<unsigned> kind(0, 19);
+    TestArcs arcs;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned k = kind(gen);
+        arcs.distance.push_back(k == 0 ? any_distance(gen) : short_distance(gen));
+        arcs.speed.push_back(static_cast<uint16_t>(k == 1 ? 0 : k == 2 ? UINT16_MAX : speed(gen)));
+    }
+    return arcs;
+}
+
+} // namespace
+
+TEST(ArcCostKernelsTest, WeightsMatchScalarReference) {
+    for (unsigned cap : {5u, 45u, 120u, ArcCostKernels::NO_SPEED_CAP, 100000u}) {
+        for (unsigned max_time : {1000u, ArcCostKernels::MAX_ARC_TIME_MS}) {
+            // Every remainder modulo the vector width, and enough arcs for many vector steps
+            for (size_t count : {0, 1, 2, 3, 4, 5, 7, 8, 9, 31, 1000, 4099}) {
+                TestArcs arcs = makeArcs(count, static_cast<unsigned>(count * 31 + cap + max_time));
+                std::vector<uint32_t> weights(count, 12345);
+                ArcCostKernels::WeightStats stats = ArcCostKernels::computeWeights(
+                    arcs.distance.data(), arcs.speed.data(), count, cap, max_time, weights.data());
+
+                ArcCostKernels::WeightStats expected;
+                for (size_t i = 0; i < count; ++i) {
+                    uint32_t weight = referenceWeight(arcs.distance[i], arcs.speed[i], cap, max_time);
+                    ASSERT_EQ(weights[i], weight) << "arc " << i << " of " << count << ", cap " << cap
+                                                  << ", distance " << arcs.distance[i] << ", speed " << arcs.speed[i];
+                    if (weight == 0) {
+                        ++expected.zero_count;
+                    } else {
+                        expected.min_ms = std::min(expected.min_ms, weight);
+                    }
+                    expected.max_ms = std::max(expected.max_ms, weight);
+                    expected.capped_count += weight == max_time;
+                }
+                EXPECT_EQ(stats.min_ms, expected.min_ms);
+                EXPECT_EQ(stats.max_ms, expected.max_ms);
+                EXPECT_EQ(stats.capped_count, expected.capped_count);
+                EXPECT_EQ(stats.zero_count, expected.zero_count);
+            }
+        }
+    }
+}
+
+TEST(ArcCostKernelsTest, PathTimesAndTotalMatchWeights) {
+    TestArcs arcs = makeArcs(500, 3);
+    // Path times are not capped, so keep every arc well below 2^32 ms
+    for (uint32_t& distance : arcs.distance) {
+        distance %= 100000;
+    }
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<unsigned> arc(0, 499);
+    std::vector<unsigned> path(200);
+    for (unsigned& a : path) {
+        a = arc(gen);
+    }
+    for (unsigned cap : {25u, ArcCostKernels::NO_SPEED_CAP}) {
+        std::vector<uint32_t> times(path.size());
+        std::vector<uint16_t> speeds(path.size());
+        ArcCostKernels::pathTimes(path.data(), path.size(), arcs.distance.data(), arcs.speed.data(), cap,
+                                  times.data(), speeds.data());
+        uint32_t total = 0;
+        for (size_t i = 0; i < path.size(); ++i) {
+            unsigned a = path[i];
+            // Arcs without speed take no time on a path instead of the CH's penalty
+            uint32_t expected = arcs.speed[a] == 0 ? 0 : referenceWeight(arcs.distance[a], arcs.speed[a], cap, UINT32_MAX);
+            ASSERT_EQ(times[i], expected) << "arc " << a;
+            EXPECT_EQ(speeds[i], std::min<unsigned>(arcs.speed[a], cap));
+            total += expected;
+        }
+        EXPECT_EQ(ArcCostKernels::pathTotal(path.data(), path.size(), arcs.distance.data(), arcs.speed.data(), cap), total);
+    }
+}
+
+TEST(ArcCostKernelsTest, PrefixSums) {
+    std::vector<uint32_t> values = {3, 0, 7, UINT32_MAX};
+    std::vector<uint32_t> sums(values.size() + 1);
+    ArcCostKernels::prefixSums(values.data(), values.size(), 10, sums.data());
+    EXPECT_EQ(sums, (std::vector<uint32_t>{10, 13, 13, 20, 19}));
+}
+
+TEST(ArcCostKernelsTest, NearestSpeedTier) {
+    std::vector<unsigned> tiers = {15, 25, 45, 120};
+    auto nearest = [&tiers](unsigned max_speed_kmh) {
+        return ArcCostKernels::nearestSpeedTier(tiers.size(), max_speed_kmh, [&tiers](size_t tier) { return tiers[tier]; });
+    };
+    EXPECT_EQ(nearest(0), 0u);
+    EXPECT_EQ(nearest(15), 0u);
+    EXPECT_EQ(nearest(20), 0u); // Ties go to the slower tier
+    EXPECT_EQ(nearest(21), 1u);
+    EXPECT_EQ(nearest(45), 2u);
+    EXPECT_EQ(nearest(83), 3u);
+    EXPECT_EQ(nearest(1000), 3u);
+    EXPECT_EQ(ArcCostKernels::nearestSpeedTier(0, 50, [](size_t) { return 0u; }), 0u);
+}
@@ -0,0 +1,118 @@
+#include "../include/GraphSnapshot.h"
+#include <routingkit/contraction_hierarchy.h>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace RoutingServer;
+
+namespace {
+
+std::string tempPath(const std::string& name) {
+    return testing::TempDir() + name;
+}
+
+// Two-way ring of five nodes with a chord, enough for a CH with shortcuts
+RoutingKit::ContractionHierarchy buildTestHierarchy() {
+    std::vector<unsigned> tail = {0, 1, 1, 2, 2, 3, 3, 4, 4, 0, 0, 2};
+    std::vector<unsigned> head = {1, 0, 2, 1, 3, 2, 4, 3, 0, 4, 2, 0};
+    std::vector<unsigned> weight = {4, 4, 3, 3, 7, 7, 2, 2, 5, 5, 9, 9};
+    return RoutingKit::ContractionHierarchy::build(5, tail, head, weight);
+}
+
+void expectSameSide(const RoutingKit::ContractionHierarchy::Side& actual,
+                    const RoutingKit::ContractionHierarchy::Side& expected) {
+    EXPECT_EQ(actual.first_out, expected.first_out);
+    EXPECT_EQ(actual.head, expected.head);
+    EXPECT_EQ(actual.weight, expected.weight);
+    EXPECT_EQ(actual.shortcut_first_arc, expected.shortcut_first_arc);
+    EXPECT_EQ(actual.shortcut_second_arc, expected.shortcut_second_arc);
+}
+
+} // namespace
+
+TEST(GraphSnapshotTest, SaveLoadRoundTrip) {
+    const std::string path = tempPath("graph_snapshot_round_trip.bin");
+    const SnapshotSource source{123456789, 987654321};
+    std::vector<unsigned> first_out = {0, 2, 3, 5, 5};
+    std::vector<float> latitude = {52.1f, 52.2f, 52.3f};        // 12 bytes, padded to 16
+    std::vector<uint16_t> speeds = {30, 50, 120};               // 6 bytes, padded to 8
+    std::vector<unsigned> empty;
+    RoutingKit::ContractionHierarchy ch = buildTestHierarchy();
+
+    GraphSnapshot::Writer writer(path, source);
+    writer.addVector(SnapshotSection::FirstOut, first_out);
+    writer.addVector(SnapshotSection::Latitude, latitude);
+    writer.addVector(SnapshotSection::WaySpeed, speeds);
+    writer.addVector(SnapshotSection::Tail, empty);
+    writer.addContractionHierarchy(SnapshotSection::TimeContractionHierarchy, ch);
+    writer.addVector(SnapshotSection::Head, first_out);
+    writer.finish();
+
+    GraphSnapshot::Reader reader(path);
+    EXPECT_EQ(reader.source(), source);
+    EXPECT_EQ(reader.readVector<unsigned>(SnapshotSection::FirstOut), first_out);
+    EXPECT_EQ(reader.readVector<float>(SnapshotSection::Latitude), latitude);
+    EXPECT_EQ(reader.readVector<uint16_t>(SnapshotSection::WaySpeed), speeds);
+    EXPECT_TRUE(reader.readVector<unsigned>(SnapshotSection::Tail).empty());
+    // A section after the hierarchy is still found, so the CH payload was sized and padded right
+    EXPECT_EQ(reader.readVector<unsigned>(SnapshotSection::Head), first_out);
+
+    RoutingKit::ContractionHierarchy loaded = reader.readContractionHierarchy(SnapshotSection::TimeContractionHierarchy);
+    EXPECT_EQ(loaded.rank, ch.rank);
+    EXPECT_EQ(loaded.order, ch.order);
+    expectSameSide(loaded.forward, ch.forward);
+    expectSameSide(loaded.backward, ch.backward);
+
+    EXPECT_FALSE(reader.hasSection(SnapshotSection::Longitude));
+    EXPECT_THROW(reader.readVector<float>(SnapshotSection::Longitude), std::runtime_error);
+    EXPECT_THROW(reader.readVector<uint32_t>(SnapshotSection::WaySpeed), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST(GraphSnapshotTest, ViewsServeSectionsInPlace) {
+    const std::string path = tempPath("graph_snapshot_view.bin");
+    std::vector<uint16_t> speeds = {30, 50, 120};
+    std::vector<uint64_t> wide = {1, UINT64_MAX, 42};
+    {
+        GraphSnapshot::Writer writer(path, SnapshotSource{});
+        writer.addVector(SnapshotSection::WaySpeed, speeds);
+        writer.addVector(SnapshotSection::GeoDistance, wide);
+        writer.finish();
+    }
+
+    GraphSnapshot::Reader reader(path, GraphSnapshot::Reader::Access::Serve);
+    SnapshotView<uint16_t> speed_view = reader.view<uint16_t>(SnapshotSection::WaySpeed);
+    SnapshotView<uint64_t> wide_view = reader.view<uint64_t>(SnapshotSection::GeoDistance);
+    EXPECT_EQ(std::vector<uint16_t>(speed_view.begin(), speed_view.end()), speeds);
+    EXPECT_EQ(std::vector<uint64_t>(wide_view.begin(), wide_view.end()), wide);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(wide_view.data) % alignof(uint64_t), 0u);
+    EXPECT_THROW(reader.view<uint32_t>(SnapshotSection::WaySpeed), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST(GraphSnapshotTest, UnfinishedWriterLeavesNoFile) {
+    const std::string path = tempPath("graph_snapshot_unfinished.bin");
+    std::remove(path.c_str());
+    {
+        GraphSnapshot::Writer writer(path, SnapshotSource{});
+        writer.addVector(SnapshotSection::FirstOut, std::vector<unsigned>{0, 1});
+    }
+    EXPECT_FALSE(std::filesystem::exists(path));
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+}
+
+TEST(GraphSnapshotTest, RejectsOtherFiles) {
+    const std::string path = tempPath("graph_snapshot_garbage.bin");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << std::string(64, 'x');
+    }
+    EXPECT_THROW(GraphSnapshot::Reader reader(path), std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(GraphSnapshot::Reader reader(path), std::runtime_error);
+}
@@ -0,0 +1,102 @@
+#include "../include/Logger.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace RoutingServer;
+
+namespace {
+
+// Message text of the captured lines that carry the given marker
+std::vector<std::string> linesWith(const std::string& output, const std::string& marker) {
+    std::vector<std::string> lines;
+    std::istringstream stream(output);
+    std::string line;
+    while (std::getline(stream, line)) {
+        size_t position = line.find(marker);
+        if (position != std::string::npos) {
+            lines.push_back(line.substr(position));
+        }
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST(LoggerTest, FullRingDropsInsteadOfBlocking) {
+    constexpr unsigned THREADS = 4;
+    constexpr unsigned MESSAGES_PER_THREAD = 50000;
+    Logger& logger = Logger::instance();
+    uint64_t dropped_before = logger.droppedCount();
+
+    testing::internal::CaptureStdout();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&logger, t]() {
+            for (unsigned i = 0; i < MESSAGES_PER_THREAD; ++i) {
+                logger.write(LogLevel::Warn, "ring-test " + std::to_string(t) + " " + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    logger.flush();
+    std::string output = testing::internal::GetCapturedStdout();
+
+    // Far more messages than the ring holds were queued faster than they can be printed
+    uint64_t dropped = logger.droppedCount() - dropped_before;
+    EXPECT_GT(dropped, 0u);
+    EXPECT_NE(output.find("[logger] dropped"), std::string::npos);
+
+    // Every message is either printed whole or counted as dropped, and each thread's messages
+    // come out in the order they were written
+    std::vector<std::string> lines = linesWith(output, "ring-test ");
+    EXPECT_EQ(lines.size() + dropped, uint64_t{THREADS} * MESSAGES_PER_THREAD);
+    std::vector<long> last(THREADS, -1);
+    for (const std::string& line : lines) {
+        std::istringstream fields(line.substr(10));
+        unsigned thread = 0;
+        long index = 0;
+        ASSERT_TRUE(fields >> thread >> index) << line;
+        ASSERT_LT(thread, THREADS) << line;
+        EXPECT_GT(index, last[thread]) << line;
+        last[thread] = index;
+    }
+}
+
+TEST(LoggerTest, FlushWritesEverythingQueued) {
+    Logger& logger = Logger::instance();
+    testing::internal::CaptureStdout();
+    for (int i = 0; i < 100; ++i) {
+        logger.write(LogLevel::Error, "flush-test " + std::to_string(i));
+    }
+    logger.flush();
+    std::vector<std::string> lines = linesWith(testing::internal::GetCapturedStdout(), "flush-test ");
+    ASSERT_EQ(lines.size(), 100u);
+    EXPECT_EQ(lines.back(), "flush-test 99");
+}
+
+TEST(LoggerTest, LongMessagesAreTruncated) {
+    Logger& logger = Logger::instance();
+    testing::internal::CaptureStdout();
+    logger.write(LogLevel::Error, "long-test " + std::string(1000, 'x'));
+    logger.flush();
+    std::vector<std::string> lines = linesWith(testing::internal::GetCapturedStdout(), "long-test ");
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0].size(), 480u);
+    EXPECT_EQ(lines[0].substr(lines[0].size() - 3), "...");
+}
+
+TEST(LoggerTest, MinLevelFiltersLowerLevels) {
+    Logger& logger = Logger::instance();
+    logger.setMinLevel(LogLevel::Warn);
+    EXPECT_FALSE(logger.enabled(LogLevel::Debug));
+    EXPECT_FALSE(logger.enabled(LogLevel::Info));
+    EXPECT_TRUE(logger.enabled(LogLevel::Warn));
+    EXPECT_TRUE(logger.enabled(LogLevel::Error));
+    logger.setMinLevel(LogLevel::Info);
+    EXPECT_TRUE(logger.enabled(LogLevel::Info));
+}
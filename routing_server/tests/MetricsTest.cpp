@@ -0,0 +1,59 @@
+#include "../include/Metrics.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+
+using namespace RoutingServer;
+
+TEST(LatencyHistogramTest, ExactBucketsBelowSubBucketCount) {
+    for (uint64_t micros = 0; micros < LatencyHistogram::SUB_BUCKETS; ++micros) {
+        EXPECT_EQ(LatencyHistogram::bucketIndex(micros), micros);
+        EXPECT_EQ(LatencyHistogram::bucketLimit(static_cast<unsigned>(micros)), micros + 1);
+    }
+}
+
+TEST(LatencyHistogramTest, BucketBoundsAreContiguousAndTight) {
+    uint64_t lower = 0;
+    for (unsigned index = 0; index < LatencyHistogram::BUCKET_COUNT; ++index) {
+        uint64_t limit = LatencyHistogram::bucketLimit(index);
+        ASSERT_GT(limit, lower) << "bucket " << index;
+        // Both ends of [lower, limit) land in the bucket, so buckets tile the range without gaps
+        EXPECT_EQ(LatencyHistogram::bucketIndex(lower), index);
+        EXPECT_EQ(LatencyHistogram::bucketIndex(limit - 1), index);
+        if (index >= LatencyHistogram::SUB_BUCKETS) {
+            // Within 12.5% of the bucket's bounds
+            EXPECT_LE((limit - lower) * LatencyHistogram::SUB_BUCKETS, lower) << "bucket " << index;
+        }
+        lower = limit;
+    }
+    EXPECT_EQ(lower, uint64_t{1} << LatencyHistogram::MAX_EXPONENT);
+}
+
+TEST(LatencyHistogramTest, LargeValuesLandInLastBucket) {
+    const unsigned last = LatencyHistogram::BUCKET_COUNT - 1;
+    EXPECT_EQ(LatencyHistogram::bucketIndex(uint64_t{1} << LatencyHistogram::MAX_EXPONENT), last);
+    EXPECT_EQ(LatencyHistogram::bucketIndex(UINT64_MAX), last);
+}
+
+TEST(LatencyHistogramTest, SnapshotQuantilesAndCounts) {
+    LatencyHistogram::Snapshot snapshot;
+    EXPECT_EQ(snapshot.quantile(0.5), 0u);
+    // 90 fast values and 10 slow ones
+    for (uint64_t micros : {uint64_t{3}, uint64_t{1000}}) {
+        unsigned repeat = micros == 3 ? 90 : 10;
+        snapshot.counts[LatencyHistogram::bucketIndex(micros)] += repeat;
+        snapshot.count += repeat;
+        snapshot.sum_us += micros * repeat;
+    }
+    EXPECT_EQ(snapshot.quantile(0.5), 4u);
+    EXPECT_EQ(snapshot.quantile(0.9), 4u);
+    uint64_t slow_limit = LatencyHistogram::bucketLimit(LatencyHistogram::bucketIndex(1000));
+    EXPECT_GT(slow_limit, 1000u);
+    EXPECT_EQ(snapshot.quantile(0.99), slow_limit);
+    EXPECT_EQ(snapshot.quantile(1.0), slow_limit);
+
+    // Powers of two are bucket bounds, so these counts are exact
+    EXPECT_EQ(snapshot.countBelow(2), 0u);
+    EXPECT_EQ(snapshot.countBelow(4), 90u);
+    EXPECT_EQ(snapshot.countBelow(512), 90u);
+    EXPECT_EQ(snapshot.countBelow(1024), 100u);
+}
@@ -0,0 +1,100 @@
+#include "../include/QueryArena.h"
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+
+using namespace RoutingServer;
+
+TEST(QueryArenaTest, ReusesReleasedSlots) {
+    QueryArena arena(2);
+    QueryArena::Slot* first = nullptr;
+    {
+        QueryArena::Lease lease = arena.acquire();
+        first = &*lease;
+        EXPECT_EQ(arena.stats().slots_in_use, 1u);
+    }
+    EXPECT_EQ(arena.stats().slots_in_use, 0u);
+
+    // The thread's last slot is tried first
+    QueryArena::Lease lease = arena.acquire();
+    EXPECT_EQ(&*lease, first);
+    QueryArena::Stats stats = arena.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.waits, 0u);
+    EXPECT_EQ(stats.temporary_allocations, 0u);
+}
+
+TEST(QueryArenaTest, KeepsPreferredSlotPerArena) {
+    QueryArena first(2);
+    QueryArena second(2);
+    QueryArena::Slot* last_used = nullptr;
+    {
+        QueryArena::Lease held = first.acquire();
+        QueryArena::Lease lease = first.acquire();
+        last_used = &*lease;
+    }
+
+    // Using another arena in between does not move this thread off its slot of the first one
+    { QueryArena::Lease other = second.acquire(); }
+    QueryArena::Lease lease = first.acquire();
+    EXPECT_EQ(&*lease, last_used);
+}
+
+TEST(QueryArenaTest, FallsBackToTemporarySlotWhenAllAreBusy) {
+    QueryArena arena(2);
+    std::vector<QueryArena::Lease> leases;
+    leases.push_back(arena.acquire());
+    leases.push_back(arena.acquire());
+    EXPECT_NE(&*leases[0], &*leases[1]);
+    EXPECT_EQ(arena.stats().slots_in_use, 2u);
+
+    {
+        QueryArena::Lease temporary = arena.acquire();
+        EXPECT_NE(&*temporary, &*leases[0]);
+        EXPECT_NE(&*temporary, &*leases[1]);
+        QueryArena::Stats stats = arena.stats();
+        EXPECT_EQ(stats.waits, 1u);
+        EXPECT_EQ(stats.temporary_allocations, 1u);
+        EXPECT_EQ(stats.slots_in_use, 2u);
+
+        // A temporary slot works like any other
+        temporary->phastQuery(100);
+        EXPECT_GT(temporary->memoryBytes(), 0u);
+    }
+    // Dropping the temporary lease neither frees an arena slot nor counts against the arena
+    QueryArena::Stats stats = arena.stats();
+    EXPECT_EQ(stats.slots_in_use, 2u);
+    EXPECT_EQ(stats.memory_bytes, 0u);
+
+    leases.pop_back();
+    QueryArena::Lease lease = arena.acquire();
+    EXPECT_EQ(arena.stats().temporary_allocations, 1u);
+    EXPECT_EQ(arena.stats().slots_in_use, 2u);
+}
+
+TEST(QueryArenaTest, EmptyArenaAlwaysUsesTemporarySlots) {
+    QueryArena arena(0);
+    std::set<QueryArena::Slot*> slots;
+    std::vector<QueryArena::Lease> leases;
+    for (int i = 0; i < 3; ++i) {
+        leases.push_back(arena.acquire());
+        slots.insert(&*leases.back());
+    }
+    EXPECT_EQ(slots.size(), 3u);
+    QueryArena::Stats stats = arena.stats();
+    EXPECT_EQ(stats.slot_count, 0u);
+    EXPECT_EQ(stats.temporary_allocations, 3u);
+    EXPECT_EQ(stats.hits, 0u);
+}
+
+TEST(QueryArenaTest, MovedLeaseReleasesOnce) {
+    QueryArena arena(1);
+    {
+        QueryArena::Lease lease = arena.acquire();
+        QueryArena::Lease moved(std::move(lease));
+        EXPECT_EQ(arena.stats().slots_in_use, 1u);
+    }
+    EXPECT_EQ(arena.stats().slots_in_use, 0u);
+    QueryArena::Lease again = arena.acquire();
+    EXPECT_EQ(arena.stats().temporary_allocations, 0u);
+}
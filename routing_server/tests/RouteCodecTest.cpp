@@ -0,0 +1,70 @@
+#include "../include/RouteCodec.h"
+#include <gtest/gtest.h>
+#include <optional>
+#include <string>
+
+using namespace RoutingServer;
+
+namespace {
+
+RouteToken makeToken() {
+    RouteToken token;
+    token.points = {{52.0907123, 5.1214567}, {-33.8688, 151.2093}, {0.0, -179.9999999}};
+    token.metric = RoutingMetric::GeoDistance;
+    token.max_speed_kmh = 45;
+    token.speed_multiplier = 0.8;
+    token.region = "nl";
+    return token;
+}
+
+} // namespace
+
+TEST(RouteCodecTest, TokenRoundTrip) {
+    RouteToken token = makeToken();
+    std::string encoded = RouteCodec::encodeRouteToken(token);
+    // URL-safe without padding, so it can go into a query string as is
+    EXPECT_EQ(encoded.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"),
+              std::string::npos);
+
+    std::optional<RouteToken> decoded = RouteCodec::decodeRouteToken(encoded);
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->metric, token.metric);
+    EXPECT_EQ(decoded->max_speed_kmh, token.max_speed_kmh);
+    EXPECT_EQ(decoded->speed_multiplier, token.speed_multiplier);
+    EXPECT_EQ(decoded->region, token.region);
+    ASSERT_EQ(decoded->points.size(), token.points.size());
+    for (size_t i = 0; i < token.points.size(); ++i) {
+        // Coordinates are quantized to 1e-7 degrees
+        EXPECT_NEAR(decoded->points[i].first, token.points[i].first, 0.6e-7);
+        EXPECT_NEAR(decoded->points[i].second, token.points[i].second, 0.6e-7);
+    }
+    EXPECT_EQ(RouteCodec::encodeRouteToken(*decoded), encoded);
+}
+
+TEST(RouteCodecTest, TokenDefaultsRoundTrip) {
+    RouteToken token;
+    token.points = {{52.1, 5.1}, {52.2, 5.2}};
+    std::optional<RouteToken> decoded = RouteCodec::decodeRouteToken(RouteCodec::encodeRouteToken(token));
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->metric, RoutingMetric::TravelTime);
+    EXPECT_EQ(decoded->max_speed_kmh, 0u);
+    EXPECT_EQ(decoded->speed_multiplier, 1.0);
+    EXPECT_TRUE(decoded->region.empty());
+    EXPECT_EQ(decoded->points.size(), 2u);
+}
+
+TEST(RouteCodecTest, RejectsMalformedTokens) {
+    EXPECT_FALSE(RouteCodec::decodeRouteToken("").has_value());
+    EXPECT_FALSE(RouteCodec::decodeRouteToken("not a token!").has_value());
+
+    std::string encoded = RouteCodec::encodeRouteToken(makeToken());
+    for (size_t length = 0; length < encoded.size(); ++length) {
+        EXPECT_FALSE(RouteCodec::decodeRouteToken(encoded.substr(0, length)).has_value()) << "prefix of " << length;
+    }
+    EXPECT_FALSE(RouteCodec::decodeRouteToken(encoded + "AAAA").has_value());
+
+    // The first character holds the top bits of the version byte
+    std::string other_version = encoded;
+    other_version[0] = other_version[0] == 'A' ? 'B' : 'A';
+    EXPECT_FALSE(RouteCodec::decodeRouteToken(other_version).has_value());
+}
@@ -0,0 +1,95 @@
+#include "../include/RoutingEngine.h"
+#include "../include/GraphSnapshot.h"
+#include <routingkit/constants.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace RoutingServer;
+
+namespace {
+
+std::string tempPath(const std::string& name) {
+    return testing::TempDir() + name;
+}
+
+// Engine on a two-way street of three nodes about 100 m apart, loaded from a snapshot without
+// contraction hierarchies; the OSM file does not exist, so the snapshot is never considered stale
+class RoutingEngineTest : public testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        snapshot_file_ = tempPath("routing_engine_test.graph_snapshot.bin");
+        ch_geo_file_ = tempPath("routing_engine_test.ch_geo.bin");
+        ch_time_file_ = tempPath("routing_engine_test.ch_time.bin");
+
+        std::vector<unsigned> first_out = {0, 1, 3, 4};
+        std::vector<unsigned> head = {1, 0, 2, 1};
+        std::vector<unsigned> tail = {0, 1, 1, 2};
+        std::vector<unsigned> geo_distance = {100, 100, 100, 100};
+        std::vector<unsigned> way = {0, 0, 0, 0};
+        std::vector<float> latitude = {52.0000f, 52.0009f, 52.0018f};
+        std::vector<float> longitude = {5.0f, 5.0f, 5.0f};
+        std::vector<unsigned> way_speed = {50};
+
+        GraphSnapshot::Writer writer(snapshot_file_, SnapshotSource{1, 1});
+        writer.addVector(SnapshotSection::FirstOut, first_out);
+        writer.addVector(SnapshotSection::Head, head);
+        writer.addVector(SnapshotSection::GeoDistance, geo_distance);
+        writer.addVector(SnapshotSection::Way, way);
+        writer.addVector(SnapshotSection::Latitude, latitude);
+        writer.addVector(SnapshotSection::Longitude, longitude);
+        writer.addVector(SnapshotSection::WaySpeed, way_speed);
+        writer.addVector(SnapshotSection::Tail, tail);
+        writer.finish();
+
+        engine_ = std::make_unique<RoutingEngine>(tempPath("routing_engine_test.osm.pbf"), ch_geo_file_,
+                                                  snapshot_file_, ch_time_file_);
+    }
+
+    static void TearDownTestSuite() {
+        engine_.reset();
+        std::remove(snapshot_file_.c_str());
+        std::remove(ch_geo_file_.c_str());
+        std::remove(ch_time_file_.c_str());
+    }
+
+    static std::string snapshot_file_;
+    static std::string ch_geo_file_;
+    static std::string ch_time_file_;
+    static std::unique_ptr<RoutingEngine> engine_;
+};
+
+std::string RoutingEngineTest::snapshot_file_;
+std::string RoutingEngineTest::ch_geo_file_;
+std::string RoutingEngineTest::ch_time_file_;
+std::unique_ptr<RoutingEngine> RoutingEngineTest::engine_;
+
+const std::pair<double, double> kStreetStart = {52.0000, 5.0};
+const std::pair<double, double> kStreetEnd = {52.0018, 5.0};
+const std::pair<double, double> kFarAway = {10.0, 10.0};
+
+} // namespace
+
+TEST_F(RoutingEngineTest, MatrixRoutesBetweenSnappedPoints) {
+    MatrixResult result = engine_->computeMatrix({kStreetStart, kFarAway}, {kStreetEnd, kStreetEnd},
+                                                 RoutingMetric::GeoDistance);
+    ASSERT_EQ(result.values.size(), 4u);
+    EXPECT_EQ(result.source_snapped, (std::vector<bool>{true, false}));
+    EXPECT_EQ(result.target_snapped, (std::vector<bool>{true, true}));
+    EXPECT_EQ(result.at(0, 0), 200u);
+    EXPECT_EQ(result.at(0, 1), 200u);
+    EXPECT_EQ(result.at(1, 0), RoutingKit::inf_weight);
+}
+
+TEST_F(RoutingEngineTest, MatrixReportsSnappedSourcesWhenNoTargetSnaps) {
+    MatrixResult result = engine_->computeMatrix({kStreetStart, kFarAway, kStreetEnd}, {kFarAway, kFarAway},
+                                                 RoutingMetric::TravelTime);
+    EXPECT_EQ(result.source_snapped, (std::vector<bool>{true, false, true}));
+    EXPECT_EQ(result.target_snapped, (std::vector<bool>{false, false}));
+    for (unsigned value : result.values) {
+        EXPECT_EQ(value, RoutingKit::inf_weight);
+    }
+}
@@ -0,0 +1,97 @@
+#include "../include/ShortcutTotals.h"
+#include <routingkit/constants.h>
+#include <routingkit/contraction_hierarchy.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace RoutingServer;
+
+namespace {
+
+// Grid with random weights on both directions of every edge and some one-way streets;
+// the weight range makes ties between shortest paths unlikely
+struct TestGraph {
+    unsigned node_count = 0;
+    std::vector<unsigned> tail;
+    std::vector<unsigned> head;
+    std::vector<unsigned> weight;
+    std::vector<unsigned> value; // Second per-arc value, unrelated to the weight
+};
+
+TestGraph makeGrid(unsigned side, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<unsigned> weight(1, 1000000);
+    std::uniform_int_distribution<unsigned> value(0, 5000);
+    std::uniform_int_distribution<unsigned> one_way(0, 9);
+    TestGraph graph;
+    graph.node_count = side * side;
+    auto add = [&](unsigned from, unsigned to) {
+        graph.tail.push_back(from);
+        graph.head.push_back(to);
+        graph.weight.push_back(weight(gen));
+        graph.value.push_back(value(gen));
+    };
+    for (unsigned y = 0; y < side; ++y) {
+        for (unsigned x = 0; x < side; ++x) {
+            unsigned node = y * side + x;
+            for (unsigned neighbor : {x + 1 < side ? node + 1 : node, y + 1 < side ? node + side : node}) {
+                if (neighbor == node) {
+                    continue;
+                }
+                unsigned direction = one_way(gen);
+                if (direction != 0) {
+                    add(node, neighbor);
+                }
+                if (direction != 1) {
+                    add(neighbor, node);
+                }
+            }
+        }
+    }
+    return graph;
+}
+
+} // namespace
+
+TEST(ShortcutTotalsTest, TotalsMatchUnpackedPathSums) {
+    TestGraph graph = makeGrid(12, 7);
+    RoutingKit::ContractionHierarchy ch =
+        RoutingKit::ContractionHierarchy::build(graph.node_count, graph.tail, graph.head, graph.weight);
+    ShortcutTotals totals(ch, graph.value);
+    ShortcutTotalsQuery totals_query;
+    RoutingKit::ContractionHierarchyQuery query(ch);
+
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<unsigned> node(0, graph.node_count - 1);
+    unsigned routed = 0;
+    for (int i = 0; i < 500; ++i) {
+        unsigned source = node(gen);
+        unsigned target = node(gen);
+        query.reset().add_source(source).add_target(target).run();
+        unsigned distance = query.get_distance();
+        ShortcutTotalsQuery::Result result = totals_query.run(ch, totals, source, target);
+        ASSERT_EQ(result.distance, distance) << source << " -> " << target;
+        if (distance == RoutingKit::inf_weight) {
+            continue;
+        }
+        unsigned expected = 0;
+        for (unsigned arc : query.get_arc_path()) {
+            expected += graph.value[arc];
+        }
+        ASSERT_EQ(result.total, expected) << source << " -> " << target;
+        ++routed;
+    }
+    EXPECT_GT(routed, 250u);
+}
+
+TEST(ShortcutTotalsTest, SourceEqualsTarget) {
+    TestGraph graph = makeGrid(4, 3);
+    RoutingKit::ContractionHierarchy ch =
+        RoutingKit::ContractionHierarchy::build(graph.node_count, graph.tail, graph.head, graph.weight);
+    ShortcutTotals totals(ch, graph.value);
+    ShortcutTotalsQuery query;
+    ShortcutTotalsQuery::Result result = query.run(ch, totals, 5, 5);
+    EXPECT_EQ(result.distance, 0u);
+    EXPECT_EQ(result.total, 0u);
+}